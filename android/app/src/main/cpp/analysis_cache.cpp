@@ -0,0 +1,287 @@
+#include "analysis_cache.h"
+#include "audio_analysis.h"
+#include "feature_store.h"
+#include "wav_file.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Entry keys of the two kinds never collide on the same inputs
+const char kFeaturesTag = 'F';
+const char kComparisonTag = 'C';
+
+template <typename T>
+uint64_t hashValue(const T& value, uint64_t hash) {
+    return fnv1a(&value, sizeof(value), hash);
+}
+
+bool hashFileContents(int fd, uint64_t& hash) {
+    static const size_t kChunk = 64 * 1024;
+    std::unique_ptr<uint8_t[]> buffer(new uint8_t[kChunk]);
+    for (;;) {
+        ssize_t n = read(fd, buffer.get(), kChunk);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return false;
+        if (n == 0) return true;
+        hash = fnv1a(buffer.get(), static_cast<size_t>(n), hash);
+    }
+}
+
+size_t featureBytes(const AudioFeatures& features) {
+    return sizeof(AudioFeatures) + features.frames.capacity() * kFeatureStride * sizeof(float);
+}
+
+size_t comparisonBytes(const CachedComparison& comparison) {
+    const TajweedAnalysis& analysis = comparison.analysis;
+    size_t bytes = sizeof(CachedComparison);
+    for (const std::string& error : analysis.errors) bytes += sizeof(std::string) + error.capacity();
+    for (const std::string& suggestion : analysis.suggestions) bytes += sizeof(std::string) + suggestion.capacity();
+    for (const auto& rule : analysis.ruleScores) bytes += 64 + rule.first.capacity();
+    return bytes;
+}
+
+} // namespace
+
+AnalysisCache::AnalysisCache(size_t budgetBytes) : budget_(budgetBytes) {}
+
+AnalysisCache& AnalysisCache::instance() {
+    static AnalysisCache cache;
+    return cache;
+}
+
+void AnalysisCache::setBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    evictTo(budget_);
+}
+
+size_t AnalysisCache::budget() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return budget_;
+}
+
+void AnalysisCache::setKeyMode(CacheKeyMode mode) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    keyMode_ = mode;
+}
+
+CacheKeyMode AnalysisCache::keyMode() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return keyMode_;
+}
+
+bool AnalysisCache::fileKey(const std::string& path, uint64_t& key) const {
+    CacheKeyMode mode = keyMode();
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat info;
+    bool ok = fstat(fd, &info) == 0;
+
+    // The size joins the content hash too: a cheap check against collisions
+    uint64_t hash = hashValue(static_cast<uint8_t>(mode), kFnvOffset);
+    if (ok) hash = hashValue(static_cast<int64_t>(info.st_size), hash);
+    if (ok && mode == CacheKeyMode::ContentHash) {
+        ok = hashFileContents(fd, hash);
+    } else if (ok) {
+        hash = fnv1a(path.data(), path.size(), hash);
+        hash = hashValue(static_cast<int64_t>(info.st_mtim.tv_sec), hash);
+        hash = hashValue(static_cast<int64_t>(info.st_mtim.tv_nsec), hash);
+    }
+    ::close(fd);
+    if (ok) key = hash;
+    return ok;
+}
+
+std::shared_ptr<const AudioFeatures> AnalysisCache::findFeatures(uint64_t fileKey, uint64_t configHash) {
+    uint64_t key = hashValue(configHash, hashValue(fileKey, hashValue(kFeaturesTag, kFnvOffset)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = find(key);
+    if (it == entries_.end() || !it->features) {
+        stats_.featureMisses++;
+        return nullptr;
+    }
+    stats_.featureHits++;
+    return it->features;
+}
+
+void AnalysisCache::putFeatures(uint64_t fileKey, uint64_t configHash, std::shared_ptr<const AudioFeatures> features) {
+    if (!features) return;
+    Entry entry;
+    entry.key = hashValue(configHash, hashValue(fileKey, hashValue(kFeaturesTag, kFnvOffset)));
+    entry.bytes = featureBytes(*features);
+    entry.features = std::move(features);
+    std::lock_guard<std::mutex> lock(mutex_);
+    insert(std::move(entry));
+}
+
+std::shared_ptr<const CachedComparison> AnalysisCache::findComparison(uint64_t userKey, uint64_t referenceKey,
+                                                                      uint64_t configHash) {
+    uint64_t key = hashValue(kComparisonTag, kFnvOffset);
+    key = hashValue(configHash, hashValue(referenceKey, hashValue(userKey, key)));
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = find(key);
+    if (it == entries_.end() || !it->comparison) {
+        stats_.comparisonMisses++;
+        return nullptr;
+    }
+    stats_.comparisonHits++;
+    return it->comparison;
+}
+
+void AnalysisCache::putComparison(uint64_t userKey, uint64_t referenceKey, uint64_t configHash,
+                                  std::shared_ptr<const CachedComparison> comparison) {
+    if (!comparison) return;
+    Entry entry;
+    entry.key = hashValue(kComparisonTag, kFnvOffset);
+    entry.key = hashValue(configHash, hashValue(referenceKey, hashValue(userKey, entry.key)));
+    entry.bytes = comparisonBytes(*comparison);
+    entry.comparison = std::move(comparison);
+    std::lock_guard<std::mutex> lock(mutex_);
+    insert(std::move(entry));
+}
+
+void AnalysisCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    index_.clear();
+    stats_.entries = 0;
+    stats_.bytes = 0;
+}
+
+AnalysisCacheStats AnalysisCache::stats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AnalysisCacheStats stats = stats_;
+    stats.budgetBytes = budget_;
+    return stats;
+}
+
+void AnalysisCache::resetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    AnalysisCacheStats fresh;
+    fresh.entries = stats_.entries;
+    fresh.bytes = stats_.bytes;
+    stats_ = fresh;
+}
+
+AnalysisCache::EntryList::iterator AnalysisCache::find(uint64_t key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) return entries_.end();
+
+    // Most recently used moves to the front
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second;
+}
+
+void AnalysisCache::insert(Entry entry) {
+    if (budget_ == 0) return;
+    if (entry.bytes > budget_) {
+        stats_.rejected++;
+        return;
+    }
+
+    // A re-extraction of the same key replaces the old entry
+    auto existing = index_.find(entry.key);
+    if (existing != index_.end()) {
+        stats_.bytes -= existing->second->bytes;
+        stats_.entries--;
+        entries_.erase(existing->second);
+        index_.erase(existing);
+    }
+
+    evictTo(budget_ - entry.bytes);
+    stats_.bytes += entry.bytes;
+    stats_.entries++;
+    entries_.push_front(std::move(entry));
+    index_[entries_.front().key] = entries_.begin();
+}
+
+void AnalysisCache::evictTo(size_t bytes) {
+    while (stats_.bytes > bytes && !entries_.empty()) {
+        const Entry& oldest = entries_.back();
+        stats_.bytes -= oldest.bytes;
+        stats_.entries--;
+        stats_.evictions++;
+        stats_.evictedBytes += oldest.bytes;
+        index_.erase(oldest.key);
+        entries_.pop_back();
+    }
+}
+
+namespace {
+
+uint64_t optionsConfigHash(const ResampleOptions& resample, const PreprocessOptions& preprocess,
+                           const VadOptions& vad) {
+    uint64_t hash = hashValue(analysisConfigHash(), kFnvOffset);
+
+    hash = hashValue(resample.enabled, hash);
+    if (resample.enabled) {
+        hash = hashValue(resample.targetRate, hash);
+        hash = hashValue(static_cast<int>(resample.quality), hash);
+    }
+
+    hash = hashValue(preprocess.enabled, hash);
+    if (preprocess.enabled) {
+        const double params[] = {preprocess.highPassHz, preprocess.lowPassHz, preprocess.oversubtraction,
+                                 preprocess.spectralFloor, preprocess.targetPeak, preprocess.maxGain};
+        hash = hashValue(params, hash);
+        hash = hashValue(preprocess.denoise, hash);
+        hash = hashValue(preprocess.normalize, hash);
+    }
+
+    hash = hashValue(vad.enabled, hash);
+    if (vad.enabled) {
+        const double params[] = {vad.frameSeconds, vad.noisePercentile, vad.marginDb, vad.minLevelDb,
+                                 vad.maxFlatness, vad.minUnvoicedZcr, vad.onsetSeconds, vad.hangoverSeconds,
+                                 vad.minSpeechSeconds, vad.padSeconds};
+        hash = hashValue(params, hash);
+    }
+    return hash;
+}
+
+} // namespace
+
+uint64_t extractionConfigHash(const FeatureWorkspace& workspace) {
+    return optionsConfigHash(workspace.resample, workspace.preprocess, workspace.vad);
+}
+
+uint64_t streamingConfigHash(const FeatureWorkspace& workspace) {
+    PreprocessOptions preprocess = workspace.preprocess;
+    preprocess.normalize = false;
+    VadOptions vad = workspace.vad;
+    vad.enabled = false;
+    return optionsConfigHash(workspace.resample, preprocess, vad);
+}
+
+uint64_t comparisonConfigHash(uint64_t userConfig, uint64_t referenceConfig, const DTWOptions& options,
+                              const char* what) {
+    uint64_t hash = hashValue(referenceConfig, hashValue(userConfig, kFnvOffset));
+    hash = hashValue(static_cast<int>(options.band), hash);
+    hash = hashValue(options.window, hash);
+    hash = hashValue(options.itakuraSlope, hash);
+    hash = hashValue(static_cast<int>(options.metric), hash);
+    hash = hashValue(options.abandonThreshold, hash);
+    return fnv1a(what, strlen(what), hash);
+}
+
+std::shared_ptr<const AudioFeatures> cachedFeatures(AnalysisCache& cache, const std::string& path, uint64_t fileKey,
+                                                    FeatureWorkspace& workspace, bool& hit) {
+    uint64_t config = extractionConfigHash(workspace);
+    std::shared_ptr<const AudioFeatures> features = cache.findFeatures(fileKey, config);
+    hit = features != nullptr;
+    if (hit) return features;
+
+    WavFile audio;
+    if (!audio.open(path)) return nullptr;
+    auto extracted = std::make_shared<AudioFeatures>();
+    extractFeatures(audio, workspace, *extracted);
+    cache.putFeatures(fileKey, config, extracted);
+    return extracted;
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,131 @@
+#ifndef TAJWEED_ANALYSIS_CACHE_H
+#define TAJWEED_ANALYSIS_CACHE_H
+
+#include "audio_features.h"
+#include "dtw.h"
+#include "workspace.h"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace TajweedAudio {
+
+// How a recording is identified. Path, size and modification time cost one
+// stat(); a content hash reads the whole file, but survives copies and
+// catches rewrites within the filesystem's mtime resolution.
+enum class CacheKeyMode {
+    PathSizeMtime = 0,
+    ContentHash = 1
+};
+
+// Enough for the features of a lesson's worth of takes and references
+// (about 10 KB per second of speech)
+const size_t kDefaultCacheBudget = 32u << 20;
+
+// A scored pair: DTW similarity and the rule analysis
+struct CachedComparison {
+    double similarity = 0.0;
+    TajweedAnalysis analysis = {};
+};
+
+struct AnalysisCacheStats {
+    size_t entries = 0;
+    size_t bytes = 0;                  // estimated heap held by the entries
+    size_t budgetBytes = 0;
+    uint64_t featureHits = 0;
+    uint64_t featureMisses = 0;
+    uint64_t comparisonHits = 0;
+    uint64_t comparisonMisses = 0;
+    uint64_t evictions = 0;
+    uint64_t evictedBytes = 0;
+    uint64_t rejected = 0;             // entries larger than the whole budget, never stored
+};
+
+// In-process LRU cache of extracted features and scored pairs, so
+// re-scoring a lesson after one segment is re-recorded extracts only that
+// segment. Features are keyed by (file key, extraction config hash),
+// comparisons by both files' keys and the comparison config hash; a changed
+// file or setting simply stops matching and ages out. Entries are immutable
+// and shared, so a reader keeps an evicted entry alive for as long as it
+// holds it. Thread-safe.
+class AnalysisCache {
+public:
+    explicit AnalysisCache(size_t budgetBytes = kDefaultCacheBudget);
+
+    AnalysisCache(const AnalysisCache&) = delete;
+    AnalysisCache& operator=(const AnalysisCache&) = delete;
+
+    // Process-wide cache used by the JNI entry points
+    static AnalysisCache& instance();
+
+    // Evicts down to the new budget at once; 0 turns caching off
+    void setBudget(size_t bytes);
+    size_t budget() const;
+    void setKeyMode(CacheKeyMode mode);
+    CacheKeyMode keyMode() const;
+
+    // Identity of the file at `path` as it is now; false when it cannot be read
+    bool fileKey(const std::string& path, uint64_t& key) const;
+
+    std::shared_ptr<const AudioFeatures> findFeatures(uint64_t fileKey, uint64_t configHash);
+    void putFeatures(uint64_t fileKey, uint64_t configHash, std::shared_ptr<const AudioFeatures> features);
+
+    std::shared_ptr<const CachedComparison> findComparison(uint64_t userKey, uint64_t referenceKey, uint64_t configHash);
+    void putComparison(uint64_t userKey, uint64_t referenceKey, uint64_t configHash,
+                       std::shared_ptr<const CachedComparison> comparison);
+
+    // Drops every entry; the hit and miss counters keep counting
+    void clear();
+    AnalysisCacheStats stats() const;
+    void resetStats();
+
+private:
+    struct Entry {
+        uint64_t key;
+        size_t bytes;
+        std::shared_ptr<const AudioFeatures> features;
+        std::shared_ptr<const CachedComparison> comparison;
+    };
+    typedef std::list<Entry> EntryList;
+
+    // Caller holds mutex_
+    EntryList::iterator find(uint64_t key);
+    void insert(Entry entry);
+    void evictTo(size_t bytes);
+
+    mutable std::mutex mutex_;
+    size_t budget_;
+    CacheKeyMode keyMode_ = CacheKeyMode::PathSizeMtime;
+    EntryList entries_;                                  // most recently used first
+    std::unordered_map<uint64_t, EntryList::iterator> index_;
+    AnalysisCacheStats stats_;
+};
+
+// Hash of everything that changes the features `workspace` extracts: the
+// frame layout and the resample, preprocess and VAD settings
+uint64_t extractionConfigHash(const FeatureWorkspace& workspace);
+
+// Hash of the features a StreamingAnalyzer extracts under the workspace's
+// resample and preprocess settings: no VAD trim and no peak normalization,
+// which both need the whole take. References decoded from compressed audio
+// are stamped with this one.
+uint64_t streamingConfigHash(const FeatureWorkspace& workspace);
+
+// Hash of what changes a pair's scores: both extraction configs, the DTW
+// options and which analyses ran (`what` names them, e.g. "dtw+rules")
+uint64_t comparisonConfigHash(uint64_t userConfig, uint64_t referenceConfig, const DTWOptions& options,
+                              const char* what);
+
+// Features of the WAV file at `path`, keyed by `fileKey`: from `cache` when
+// present, else extracted with `workspace` and stored. `hit` says which.
+// Null when the file cannot be opened.
+std::shared_ptr<const AudioFeatures> cachedFeatures(AnalysisCache& cache, const std::string& path, uint64_t fileKey,
+                                                    FeatureWorkspace& workspace, bool& hit);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_ANALYSIS_CACHE_H
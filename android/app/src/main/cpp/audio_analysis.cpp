@@ -0,0 +1,620 @@
+#include "audio_analysis.h"
+#include "fft.h"
+#include "formants.h"
+#include "log.h"
+#include "long_alignment.h"
+#include "perf_stats.h"
+#include "pitch.h"
+#include "spectral.h"
+#include "wav_file.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <numeric>
+
+namespace TajweedAudio {
+
+bool loadAudioFile(const std::string& path, std::vector<double>& samples, int& sampleRate, int& channels) {
+    LOGD("Loading audio file: %s", path.c_str());
+    
+    WavFile audio;
+    if (!audio.open(path)) {
+        LOGE("Failed to load %s: %s", path.c_str(), audio.lastError().c_str());
+        return false;
+    }
+    
+    sampleRate = audio.sampleRate();
+    channels = audio.channels();
+    
+    // Materializes the whole file; analysis paths read a WavFile directly instead
+    samples.resize(audio.frameCount());
+    audio.read(0, samples.size(), samples.data());
+    
+    LOGD("Loaded %zu samples at %d Hz", samples.size(), sampleRate);
+    return true;
+}
+
+// Frames per parallel block; a block re-reads one full frame where it starts
+static const size_t kFramesPerBlock = 64;
+
+void analyzeFrames(const SampleSource& source, const MelCepstrum& cepstrum, size_t begin, size_t end,
+                   float* rows, FormantCandidates* formants) {
+    FrameScratch& scratch = FrameScratch::forThisThread();
+    prepareStft(scratch.stft, kFrameSize);
+    PitchTracker& tracker = scratch.pitchTracker(source.sampleRate());
+    FormantAnalyzer& analyzer = scratch.formantAnalyzer(source.sampleRate());
+    
+    size_t frameLength = static_cast<size_t>(kFrameSize);
+    size_t hopLength = static_cast<size_t>(kHopSize);
+    size_t numBins = frameLength / 2 + 1;
+    double binWidth = static_cast<double>(source.sampleRate()) / kFrameSize;
+    double* raw = scratch.stft.raw.data();
+    double* power = growScratch(scratch.power, numBins, scratch.stats);
+    double mfcc[kNumMfcc];
+    TAJWEED_PERF_SPLIT(split);
+    
+    for (size_t f = begin; f < end; f++) {
+        size_t start = f * hopLength;
+        
+        // Overlapping frames only pull the new hop from the source
+        if (f > begin && hopLength < frameLength) {
+            size_t overlap = frameLength - hopLength;
+            std::copy(raw + hopLength, raw + frameLength, raw);
+            source.read(start + overlap, hopLength, raw + overlap);
+        } else {
+            source.read(start, frameLength, raw);
+        }
+        TAJWEED_PERF_LAP(split, Stft);
+        
+        // Pitch shares the raw window with the STFT, unless the rate needs a wider one
+        PitchFrame pitch = tracker.windowSize() == frameLength ? tracker.analyze(raw)
+                                                               : tracker.analyzeAt(source, start);
+        TAJWEED_PERF_LAP(split, Pitch);
+        double energy = framePowerSpectrum(raw, scratch.stft, power);
+        cepstrum.compute(power, mfcc);
+        
+        float* row = rows + (f - begin) * kFeatureStride;
+        for (int c = 0; c < kNumMfcc; c++) {
+            row[FeatureColumns::Mfcc.offset + c] = static_cast<float>(mfcc[c]);
+        }
+        row[FeatureColumns::Pitch.offset] = static_cast<float>(pitch.frequency);
+        row[FeatureColumns::PitchConfidence.offset] = static_cast<float>(pitch.confidence);
+        row[FeatureColumns::NormalizedPitch.offset] = static_cast<float>(pitch.frequency);
+        row[FeatureColumns::Energy.offset] = static_cast<float>(energy);
+        row[FeatureColumns::LogEnergy.offset] = static_cast<float>(log(energy + 1e-10));
+        row[FeatureColumns::SpectralCentroid.offset] = static_cast<float>(spectralCentroid(power, numBins, binWidth));
+        row[FeatureColumns::SpectralRolloff.offset] = static_cast<float>(spectralRolloff(power, numBins, binWidth));
+        TAJWEED_PERF_LAP(split, Stft);
+        
+        // LPC works on the STFT's windowed frame, and only where there is a voice
+        FormantCandidates& candidates = formants[f - begin];
+        if (pitch.voiced) {
+            analyzer.analyze(scratch.stft.frame.data(), candidates);
+        } else {
+            candidates.count = 0;
+        }
+        TAJWEED_PERF_LAP(split, Formants);
+    }
+    
+    TAJWEED_PERF_COMMIT(split);
+    scratch.publishStats();
+}
+
+void computeMfccDelta(float* rows, size_t f, size_t last) {
+    // Regression over +/-2 frames, clamped at the edges
+    const float* prev1 = rows + (f > 0 ? f - 1 : 0) * kFeatureStride;
+    const float* prev2 = rows + (f > 1 ? f - 2 : 0) * kFeatureStride;
+    const float* next1 = rows + std::min(f + 1, last) * kFeatureStride;
+    const float* next2 = rows + std::min(f + 2, last) * kFeatureStride;
+    float* row = rows + f * kFeatureStride;
+    for (int c = 0; c < kNumMfcc; c++) {
+        size_t column = FeatureColumns::Mfcc.offset + c;
+        double delta = (next1[column] - prev1[column]) + 2.0 * (next2[column] - prev2[column]);
+        row[FeatureColumns::MfccDelta.offset + c] = static_cast<float>(delta / 10.0);
+    }
+}
+
+// Cancellation checkpoint of the job the workspace is bound to, if any
+static bool cancelled(const FeatureWorkspace& workspace) {
+    return workspace.job && workspace.job->cancelled();
+}
+
+void extractFeatures(const SampleSource& input, FeatureWorkspace& workspace, AudioFeatures& features) {
+    TAJWEED_PERF_SCOPE(Extract);
+    workspace.reset();
+    
+    // Resampling and preprocessing each make one copy that the next stage reads
+    const SampleSource* selected = &input;
+    int targetRate = workspace.resample.targetRate;
+    if (workspace.resample.enabled && input.sampleRate() > 0 && targetRate > 0 && input.sampleRate() != targetRate) {
+        workspace.resampled.process(input, targetRate, workspace.resample.quality);
+        selected = &workspace.resampled;
+    }
+    if (workspace.preprocess.enabled && !cancelled(workspace)) {
+        workspace.preprocessed.process(*selected, workspace.preprocess);
+        selected = &workspace.preprocessed;
+    }
+    
+    // Silence never reaches the STFT or DTW; a recording with no detected
+    // speech is analyzed whole rather than not at all
+    if (workspace.vad.enabled && !cancelled(workspace)) {
+        workspace.activity.detect(*selected, workspace.vad);
+        if (!workspace.activity.regions().empty()) {
+            workspace.speech.assign(*selected, workspace.activity.regions());
+            workspace.trimmed = true;
+            selected = &workspace.speech;
+        }
+    }
+    const SampleSource& source = *selected;
+    features.duration = input.duration();
+    features.sampleRate = source.sampleRate();
+    features.channels = source.channels();
+    
+    size_t numFrames = source.sampleRate() > 0 ? stftFrameCount(source.frameCount(), kFrameSize, kHopSize) : 0;
+    if (cancelled(workspace)) numFrames = 0;
+    FeatureMatrix& frames = features.frames;
+    workspace.prepare(frames, numFrames, source.sampleRate(), kHopSize);
+    if (numFrames == 0) return;
+    TAJWEED_PERF_COUNT(FramesProcessed, numFrames);
+    
+    // Frame blocks run in parallel; the cepstrum tables are shared read-only
+    workspace.cepstrum.configure(kFrameSize / 2 + 1, kFrameSize, source.sampleRate());
+    const MelCepstrum& cepstrum = workspace.cepstrum;
+    FormantCandidates* formants = workspace.grow(workspace.formants, numFrames);
+    JobControl* job = workspace.job;
+    if (job) job->addWork(numFrames);
+    parallelFor(workspace.pool(), numFrames, kFramesPerBlock, [&](size_t begin, size_t end) {
+        if (job && job->cancelled()) return;
+        analyzeFrames(source, cepstrum, begin, end, frames.row(begin), formants + begin);
+        if (job) job->advance(end - begin);
+    });
+    
+    // A cancelled extraction leaves no frames rather than a partial matrix
+    if (cancelled(workspace)) {
+        workspace.prepare(frames, 0, source.sampleRate(), kHopSize);
+        return;
+    }
+    
+    for (size_t f = 0; f < numFrames; f++) {
+        computeMfccDelta(frames.data(), f, numFrames - 1);
+    }
+    
+    trackFormants(formants, frames);
+    
+    // The distance block is compared across recordings, so scale it per recording
+    frames.normalizeColumns(FeatureColumns::Distance);
+}
+
+void extractFeaturesConcurrently(const SampleSource& user, FeatureWorkspace& userWorkspace,
+                                 const SampleSource& reference, FeatureWorkspace& referenceWorkspace) {
+    // Both pipelines fan out into frame blocks on the same pool
+    parallelFor(userWorkspace.pool(), 2, 1, [&](size_t begin, size_t) {
+        if (begin == 0) {
+            extractFeatures(user, userWorkspace, userWorkspace.features);
+        } else {
+            extractFeatures(reference, referenceWorkspace, referenceWorkspace.features);
+        }
+    });
+}
+
+AudioFeatures extractFeatures(const SampleSource& source) {
+    AudioFeatures features;
+    extractFeatures(source, FeatureWorkspace::forThisThread(), features);
+    return features;
+}
+
+AudioFeatures extractFeatures(const std::vector<double>& samples, int sampleRate) {
+    return extractFeatures(BufferSource(samples, sampleRate));
+}
+
+std::vector<double> extractMFCC(const std::vector<double>& samples, int sampleRate) {
+    return computeMFCC(computeSpectrogram(samples, sampleRate));
+}
+
+void trackFormants(const FormantCandidates* candidates, FeatureMatrix& frames) {
+    FormantTracker tracker;
+    for (size_t f = 0; f < frames.numFrames(); f++) {
+        tracker.next(candidates[f], frames.row(f) + FeatureColumns::Formants.offset);
+    }
+}
+
+std::vector<double> extractFormants(const SampleSource& source) {
+    TAJWEED_PERF_SCOPE(Formants);
+    std::vector<double> formants(kNumFormants, 0.0);
+    size_t numFrames = source.sampleRate() > 0 ? stftFrameCount(source.frameCount(), kFrameSize, kHopSize) : 0;
+    if (numFrames == 0) return formants;
+    
+    StftScratch stft;
+    prepareStft(stft, kFrameSize);
+    std::vector<double> power(kFrameSize / 2 + 1);
+    PitchTracker pitch(source.sampleRate());
+    FormantAnalyzer analyzer(source.sampleRate());
+    FormantTracker tracker;
+    FormantCandidates candidates;
+    float frame[kNumFormants];
+    size_t counts[kNumFormants] = {};
+    
+    double* raw = stft.raw.data();
+    for (size_t f = 0; f < numFrames; f++) {
+        size_t start = f * kHopSize;
+        source.read(start, kFrameSize, raw);
+        candidates.count = 0;
+        bool voiced = pitch.windowSize() == static_cast<size_t>(kFrameSize) ? pitch.analyze(raw).voiced
+                                                                            : pitch.analyzeAt(source, start).voiced;
+        if (voiced) {
+            framePowerSpectrum(raw, stft, power.data());
+            analyzer.analyze(stft.frame.data(), candidates);
+        }
+        tracker.next(candidates, frame);
+        for (size_t k = 0; k < kNumFormants; k++) {
+            if (frame[k] <= 0.0f) continue;
+            formants[k] += frame[k];
+            counts[k]++;
+        }
+    }
+    
+    for (size_t k = 0; k < kNumFormants; k++) {
+        if (counts[k] > 0) formants[k] /= counts[k];
+    }
+    return formants;
+}
+
+std::vector<double> extractFormants(const std::vector<double>& samples, int sampleRate) {
+    return extractFormants(BufferSource(samples, sampleRate));
+}
+
+std::vector<double> extractEnergy(const SampleSource& source, int windowSize, int hopSize) {
+    size_t total = source.frameCount();
+    if (windowSize <= 0 || hopSize <= 0 || total < static_cast<size_t>(windowSize)) return {};
+    
+    size_t numWindows = (total - windowSize) / hopSize + 1;
+    std::vector<double> energy(numWindows, 0.0);
+    std::vector<double> window(windowSize);
+    
+    for (size_t i = 0; i < numWindows; i++) {
+        source.read(i * hopSize, windowSize, window.data());
+        
+        double sum = 0.0;
+        for (int j = 0; j < windowSize; j++) {
+            sum += window[j] * window[j];
+        }
+        energy[i] = sum / windowSize;
+    }
+    
+    return energy;
+}
+
+std::vector<double> extractEnergy(const std::vector<double>& samples, int windowSize, int hopSize) {
+    return extractEnergy(BufferSource(samples, 0), windowSize, hopSize);
+}
+
+std::vector<double> extractPitch(const SampleSource& source) {
+    std::vector<PitchFrame> frames = trackPitch(source);
+    std::vector<double> pitch(frames.size());
+    for (size_t i = 0; i < frames.size(); i++) {
+        pitch[i] = frames[i].frequency;
+    }
+    return pitch;
+}
+
+std::vector<double> extractPitch(const std::vector<double>& samples, int sampleRate) {
+    return extractPitch(BufferSource(samples, sampleRate));
+}
+
+std::vector<double> extractSpectralCentroid(const std::vector<double>& samples, int sampleRate) {
+    return computeSpectralCentroid(computeSpectrogram(samples, sampleRate));
+}
+
+std::vector<double> extractSpectralRolloff(const std::vector<double>& samples, int sampleRate) {
+    return computeSpectralRolloff(computeSpectrogram(samples, sampleRate));
+}
+
+std::vector<AudioSegment> segmentAudio(const SampleSource& source, const std::vector<double>& timestamps,
+                                       const VadOptions& options) {
+    VoiceActivityDetector detector;
+    detector.detect(source, options);
+    
+    std::vector<double> cuts(timestamps);
+    std::sort(cuts.begin(), cuts.end());
+    
+    std::vector<AudioSegment> segments;
+    double rate = static_cast<double>(source.sampleRate());
+    for (const SpeechRegion& region : detector.regions()) {
+        double start = region.start / rate;
+        double end = region.end / rate;
+        for (auto cut = std::upper_bound(cuts.begin(), cuts.end(), start); cut != cuts.end() && *cut < end; ++cut) {
+            AudioSegment segment{};
+            segment.startTime = start;
+            segment.endTime = *cut;
+            segments.push_back(segment);
+            start = *cut;
+        }
+        
+        AudioSegment segment{};
+        segment.startTime = start;
+        segment.endTime = end;
+        segments.push_back(segment);
+    }
+    return segments;
+}
+
+std::vector<AudioSegment> segmentAudio(const std::vector<double>& samples, int sampleRate, const std::vector<double>& timestamps) {
+    return segmentAudio(BufferSource(samples, sampleRate), timestamps);
+}
+
+ComparisonResult performDTW(const AudioFeatures& features1, const AudioFeatures& features2,
+                            const DTWOptions& options) {
+    return performDTW(features1, features2.frames.data(), features2.frames.numFrames(), features2.sampleRate, options);
+}
+
+ComparisonResult performDTW(const AudioFeatures& features1, const float* frames2, size_t n2, int sampleRate2,
+                            const DTWOptions& options) {
+    ComparisonResult result;
+    performDTW(features1, frames2, n2, sampleRate2, options, FeatureWorkspace::forThisThread(), result);
+    return result;
+}
+
+void performDTW(const AudioFeatures& features1, const float* frames2, size_t n2, int sampleRate2,
+                const DTWOptions& options, FeatureWorkspace& workspace, ComparisonResult& result,
+                const AlignmentTimelines& timelines) {
+    result.similarity = 0.0;
+    result.score = 0.0;
+    result.abandoned = false;
+    result.times.clear();
+    result.alignment.clear();
+    result.deviations.clear();
+    
+    const FeatureMatrix& frames1 = features1.frames;
+    size_t n1 = frames1.numFrames();
+    if (n1 == 0 || n2 == 0 || !frames2) return;
+    
+    // Unbanded grids past the cap (whole surahs) are aligned in chunks; the
+    // cutoff then applies to the stitched path's mean cost
+    if (options.band == DTWBand::None && n1 * n2 > kMaxDirectAlignmentCells) {
+        LongAlignmentOptions longOptions;
+        longOptions.chunk = options;
+        std::vector<AlignmentChunk> chunks;
+        performLongDTW(features1, frames2, n2, sampleRate2, longOptions, workspace, result, chunks, nullptr,
+                       timelines);
+        if (!workspace.path.costs.empty() &&
+            workspace.path.distance / workspace.path.costs.size() > options.abandonThreshold) {
+            result.similarity = 0.0;
+            result.score = 0.0;
+            result.abandoned = true;
+            result.times.clear();
+            result.alignment.clear();
+            result.deviations.clear();
+        }
+        return;
+    }
+    
+    // The cutoff is per path step, and a path has at most n1 + n2 - 1 steps
+    DTWOptions pathOptions = options;
+    pathOptions.abandonThreshold = options.abandonThreshold * (n1 + n2 - 1);
+    
+    // Only the distance block at the start of each row takes part in the frame cost
+    DTWAlignment& path = workspace.path;
+    dtwAlign(frames1.data(), n1, frames2, n2, FeatureColumns::Distance.count, kFeatureStride,
+             pathOptions, workspace.dtw, path);
+    double meanCost = path.abandoned ? INFINITY : path.distance / path.costs.size();
+    if (path.abandoned || meanCost > options.abandonThreshold) {
+        result.abandoned = true;
+        return;
+    }
+    
+    summarizeAlignment(path, n1, frames1.sampleRate(), sampleRate2, workspace, result, timelines);
+}
+
+double recordingSeconds(size_t frame, int sampleRate, const TrimmedSource* timeline, bool end) {
+    if (sampleRate <= 0) return 0.0;
+    size_t sample = frame * kHopSize;
+    if (timeline) {
+        sample = end && sample > 0 ? timeline->sourceSample(sample - 1) + 1 : timeline->sourceSample(sample);
+    }
+    return static_cast<double>(sample) / sampleRate;
+}
+
+void summarizeAlignment(const DTWAlignment& path, size_t n1, int sampleRate1, int sampleRate2,
+                        FeatureWorkspace& workspace, ComparisonResult& result, const AlignmentTimelines& timelines) {
+    result.similarity = 0.0;
+    result.score = 0.0;
+    result.times.clear();
+    result.alignment.clear();
+    result.deviations.clear();
+    if (path.costs.empty() || n1 == 0) return;
+    
+    // Convert distance to similarity (0-1 scale)
+    double meanCost = path.distance / path.costs.size();
+    result.similarity = 1.0 / (1.0 + meanCost);
+    result.score = result.similarity * 100.0;
+    
+    // Collapse the path to one entry per frame of the first input
+    int* hits = workspace.grow(workspace.hits, n1);
+    double* times = workspace.grow(result.times, n1);
+    double* alignment = workspace.grow(result.alignment, n1);
+    double* deviations = workspace.grow(result.deviations, n1);
+    std::fill(hits, hits + n1, 0);
+    std::fill(alignment, alignment + n1, 0.0);
+    std::fill(deviations, deviations + n1, 0.0);
+    for (size_t f = 0; f < n1; f++) times[f] = recordingSeconds(f, sampleRate1, timelines.first);
+    for (size_t k = 0; k < path.costs.size(); k++) {
+        size_t f = path.frames1[k];
+        alignment[f] += recordingSeconds(path.frames2[k], sampleRate2, timelines.second);
+        deviations[f] += path.costs[k];
+        hits[f]++;
+    }
+    for (size_t f = 0; f < n1; f++) {
+        if (hits[f] > 0) {
+            alignment[f] /= hits[f];
+            deviations[f] /= hits[f];
+        }
+    }
+}
+
+double similarityCutoffToDistance(double minSimilarity) {
+    // Inverse of similarity = 1 / (1 + mean frame distance)
+    if (minSimilarity <= 0.0) return INFINITY;
+    return 1.0 / minSimilarity - 1.0;
+}
+
+double calculateDTWDistance(const std::vector<double>& seq1, const std::vector<double>& seq2) {
+    return calculateDTWDistance(seq1, seq2, DTWOptions());
+}
+
+double calculateDTWDistance(const std::vector<double>& seq1, const std::vector<double>& seq2, const DTWOptions& options) {
+    return dtwDistance(seq1.data(), seq1.size(), seq2.data(), seq2.size(), options);
+}
+
+TajweedAnalysis analyzeTajweedRules(const AudioFeatures& userFeatures, const AudioFeatures& referenceFeatures) {
+    TAJWEED_PERF_SCOPE(Rules);
+    TajweedAnalysis analysis;
+    
+    // One pass over each take: the reference shows which rules the passage
+    // calls for, the user's take how they were recited
+    RuleEngine engine;
+    RuleReport expected, recited;
+    engine.run(referenceFeatures.frames, kAllRules, expected);
+    engine.run(userFeatures.frames, kAllRules, recited, &referenceFeatures.frames);
+    
+    const std::vector<RuleInfo>& rules = ruleRegistry();
+    double totalScore = 0.0;
+    size_t scored = 0;
+    for (const RuleResult& result : recited.results) {
+        const RuleInfo& info = rules[result.rule];
+        const RuleResult* reference = expected.result(result.rule);
+        bool required = info.needsReference || (reference && reference->detections > 0);
+        
+        // A rule the passage does not call for is met by not reciting it
+        bool correct;
+        double score;
+        if (result.detections > 0) {
+            correct = result.violations == 0;
+            score = result.score;
+        } else {
+            correct = !required;
+            score = correct ? 100.0 : 0.0;
+        }
+        
+        analysis.ruleScores[info.name] = score;
+        totalScore += score;
+        scored++;
+        if (!correct) {
+            analysis.errors.push_back(info.error);
+            analysis.suggestions.push_back(info.suggestion);
+        }
+    }
+    
+    analysis.overallScore = scored > 0 ? totalScore / scored : 0.0;
+    analysis.confidence = 0.8; // Placeholder confidence
+    return analysis;
+}
+
+// Single-rule checks: the rule was found and every finding is within tolerance
+static bool ruleMet(const char* name, const FeatureMatrix& features, const FeatureMatrix* reference,
+                    const RuleOptions& options = RuleOptions()) {
+    if (features.empty()) return false;
+    int rule = findRule(name);
+    if (rule < 0) return false;
+    
+    RuleEngine engine;
+    engine.options = options;
+    RuleReport report;
+    engine.run(features, ruleBit(rule), report, reference);
+    const RuleResult* result = report.result(rule);
+    return result && result->detections > 0 && result->violations == 0;
+}
+
+bool detectMadd(const FeatureMatrix& features, double expectedDuration) {
+    // expectedDuration is the Madd length in counts
+    RuleOptions options;
+    options.maddCounts = expectedDuration;
+    return ruleMet("madd", features, nullptr, options);
+}
+
+bool detectMakharij(const FeatureMatrix& features, const FeatureMatrix& referenceFeatures) {
+    return ruleMet("makharij", features, &referenceFeatures);
+}
+
+bool detectGhunna(const FeatureMatrix& features) {
+    return ruleMet("ghunna", features, nullptr);
+}
+
+bool detectQalqalah(const FeatureMatrix& features) {
+    return ruleMet("qalqalah", features, nullptr);
+}
+
+std::vector<double> normalizeFeatures(const std::vector<double>& features) {
+    std::vector<double> normalized(features.size(), 0.0);
+    if (features.empty()) return normalized;
+    
+    double mean = std::accumulate(features.begin(), features.end(), 0.0) / features.size();
+    double variance = 0.0;
+    for (double value : features) {
+        variance += (value - mean) * (value - mean);
+    }
+    double stddev = sqrt(variance / features.size());
+    
+    // Constant features carry no information; leave them at zero
+    if (stddev < 1e-12) return normalized;
+    
+    for (size_t i = 0; i < features.size(); i++) {
+        normalized[i] = (features[i] - mean) / stddev;
+    }
+    return normalized;
+}
+
+double calculateEuclideanDistance(const std::vector<double>& vec1, const std::vector<double>& vec2) {
+    size_t n = std::min(vec1.size(), vec2.size());
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        double diff = vec1[i] - vec2[i];
+        sum += diff * diff;
+    }
+    return sqrt(sum);
+}
+
+double calculateCosineSimilarity(const std::vector<double>& vec1, const std::vector<double>& vec2) {
+    size_t n = std::min(vec1.size(), vec2.size());
+    double dot = 0.0, norm1 = 0.0, norm2 = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        dot += vec1[i] * vec2[i];
+        norm1 += vec1[i] * vec1[i];
+        norm2 += vec2[i] * vec2[i];
+    }
+    double denom = sqrt(norm1 * norm2);
+    return denom > 0.0 ? dot / denom : 0.0;
+}
+
+std::vector<double> applyWindow(const std::vector<double>& samples, const std::string& windowType) {
+    std::vector<double> window = windowCoefficients(samples.size(), windowType);
+    std::vector<double> windowed(samples.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+        windowed[i] = samples[i] * window[i];
+    }
+    return windowed;
+}
+
+std::vector<double> computeFFT(const std::vector<double>& samples) {
+    // Full n-point spectrum: real parts in [0, n), imaginary parts in [n, 2n)
+    size_t n = samples.size();
+    std::vector<double> fft(n * 2, 0.0);
+    if (n == 0) return fft;
+    
+    std::shared_ptr<const FftPlan> plan = FftPlan::forSize(n);
+    std::vector<std::complex<double>> bins(plan->numBins());
+    plan->forward(samples.data(), bins.data());
+    
+    // Bins above Nyquist follow from conjugate symmetry of a real input
+    for (size_t k = 0; k < bins.size(); k++) {
+        fft[k] = bins[k].real();
+        fft[k + n] = bins[k].imag();
+    }
+    for (size_t k = bins.size(); k < n; k++) {
+        fft[k] = bins[n - k].real();
+        fft[k + n] = -bins[n - k].imag();
+    }
+    
+    return fft;
+}
+
+} // namespace TajweedAudio
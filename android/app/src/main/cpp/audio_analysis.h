@@ -0,0 +1,98 @@
+#ifndef TAJWEED_AUDIO_ANALYSIS_H
+#define TAJWEED_AUDIO_ANALYSIS_H
+
+#include "audio_features.h"
+#include "audio_source.h"
+#include "dtw.h"
+#include "formants.h"
+#include "preprocess.h"
+#include "rules.h"
+#include "spectral.h"
+#include "vad.h"
+#include "workspace.h"
+#include <string>
+#include <vector>
+
+// Platform-neutral analysis API; the JNI layer in tajweed_audio.cpp is a thin wrapper over it
+namespace TajweedAudio {
+    // Audio file loading and preprocessing
+    bool loadAudioFile(const std::string& path, std::vector<double>& samples, int& sampleRate, int& channels);
+    
+    // Feature extraction
+    // STFT, pitch, per-frame features and formant candidates of frames
+    // [begin, end) of `source`, written from rows[0] and formants[0] on. Every
+    // frame is computed the same way whatever block it falls in, so frames do
+    // not depend on how they were split across threads or stream chunks.
+    // Deltas, formant tracks and normalization are left to the caller.
+    void analyzeFrames(const SampleSource& source, const MelCepstrum& cepstrum, size_t begin, size_t end,
+                       float* rows, FormantCandidates* formants);
+    // MFCC delta columns of row f of frame-major `rows`, from the MFCCs of
+    // rows f - 2 to f + 2 clamped to [0, last]
+    void computeMfccDelta(float* rows, size_t f, size_t last);
+    void extractFeatures(const SampleSource& source, FeatureWorkspace& workspace, AudioFeatures& features);
+    AudioFeatures extractFeatures(const SampleSource& source);
+    // Runs two extraction pipelines at once; results land in each workspace's features slot
+    void extractFeaturesConcurrently(const SampleSource& user, FeatureWorkspace& userWorkspace,
+                                     const SampleSource& reference, FeatureWorkspace& referenceWorkspace);
+    AudioFeatures extractFeatures(const std::vector<double>& samples, int sampleRate);
+    std::vector<double> extractMFCC(const std::vector<double>& samples, int sampleRate);
+    // Fills the F1..F4 columns from per-frame LPC candidates, tracked in frame order
+    void trackFormants(const FormantCandidates* candidates, FeatureMatrix& frames);
+    // Mean F1..F4 over the voiced frames
+    std::vector<double> extractFormants(const SampleSource& source);
+    std::vector<double> extractFormants(const std::vector<double>& samples, int sampleRate);
+    std::vector<double> extractEnergy(const SampleSource& source, int windowSize, int hopSize = kHopSize);
+    std::vector<double> extractEnergy(const std::vector<double>& samples, int windowSize, int hopSize = kHopSize);
+    std::vector<double> extractPitch(const SampleSource& source);
+    std::vector<double> extractPitch(const std::vector<double>& samples, int sampleRate);
+    std::vector<double> extractSpectralCentroid(const std::vector<double>& samples, int sampleRate);
+    std::vector<double> extractSpectralRolloff(const std::vector<double>& samples, int sampleRate);
+    
+    // Audio segmentation: speech regions found by voice activity detection,
+    // cut again at any `timestamps` (seconds) that fall inside one. Segment
+    // text, rules and features are left for the caller to fill.
+    std::vector<AudioSegment> segmentAudio(const SampleSource& source, const std::vector<double>& timestamps,
+                                           const VadOptions& options = VadOptions());
+    std::vector<AudioSegment> segmentAudio(const std::vector<double>& samples, int sampleRate, const std::vector<double>& timestamps);
+    
+    // Dynamic Time Warping
+    ComparisonResult performDTW(const AudioFeatures& features1, const AudioFeatures& features2,
+                                const DTWOptions& options = DTWOptions());
+    // frames2 holds FeatureMatrix rows (kFeatureStride floats apart), e.g. from a mapped bundle
+    ComparisonResult performDTW(const AudioFeatures& features1, const float* frames2, size_t numFrames2,
+                                int sampleRate2, const DTWOptions& options = DTWOptions());
+    // With VAD-trimmed inputs, pass their timelines so the result's times
+    // are in the recordings, as rule events are
+    void performDTW(const AudioFeatures& features1, const float* frames2, size_t numFrames2, int sampleRate2,
+                    const DTWOptions& options, FeatureWorkspace& workspace, ComparisonResult& result,
+                    const AlignmentTimelines& timelines = AlignmentTimelines());
+    // Seconds into the recording at which `frame` starts, or with `end` at
+    // which the frame before it ends, following the VAD timeline when given
+    double recordingSeconds(size_t frame, int sampleRate, const TrimmedSource* timeline, bool end = false);
+    // Similarity, and per frame of the first input its time, matched time
+    // and mean path cost, from a warping path whose first sequence has n1
+    // frames; times go through `timelines` where the inputs were trimmed
+    void summarizeAlignment(const DTWAlignment& path, size_t n1, int sampleRate1, int sampleRate2,
+                            FeatureWorkspace& workspace, ComparisonResult& result,
+                            const AlignmentTimelines& timelines = AlignmentTimelines());
+    double calculateDTWDistance(const std::vector<double>& seq1, const std::vector<double>& seq2);
+    double calculateDTWDistance(const std::vector<double>& seq1, const std::vector<double>& seq2, const DTWOptions& options);
+    double similarityCutoffToDistance(double minSimilarity);
+    
+    // Tajweed rule detection. analyzeTajweedRules runs every registered rule
+    // through a RuleEngine; the detect* helpers run one rule each.
+    TajweedAnalysis analyzeTajweedRules(const AudioFeatures& userFeatures, const AudioFeatures& referenceFeatures);
+    bool detectMadd(const FeatureMatrix& features, double expectedDuration);
+    bool detectMakharij(const FeatureMatrix& features, const FeatureMatrix& referenceFeatures);
+    bool detectGhunna(const FeatureMatrix& features);
+    bool detectQalqalah(const FeatureMatrix& features);
+    
+    // Utility functions
+    std::vector<double> normalizeFeatures(const std::vector<double>& features);
+    double calculateEuclideanDistance(const std::vector<double>& vec1, const std::vector<double>& vec2);
+    double calculateCosineSimilarity(const std::vector<double>& vec1, const std::vector<double>& vec2);
+    std::vector<double> applyWindow(const std::vector<double>& samples, const std::string& windowType);
+    std::vector<double> computeFFT(const std::vector<double>& samples);
+}
+
+#endif // TAJWEED_AUDIO_ANALYSIS_H
@@ -0,0 +1,42 @@
+#ifndef TAJWEED_AUDIO_FEATURES_H
+#define TAJWEED_AUDIO_FEATURES_H
+
+#include "feature_matrix.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// Audio processing structures
+struct AudioFeatures {
+    TajweedAudio::FeatureMatrix frames;  // one row per STFT frame, see FeatureColumns
+    double duration;
+    int sampleRate;
+    int channels;
+};
+
+struct AudioSegment {
+    double startTime;
+    double endTime;
+    std::string text;
+    std::vector<std::string> tajweedRules;
+    AudioFeatures features;
+};
+
+struct TajweedAnalysis {
+    double overallScore;
+    std::vector<std::string> errors;
+    std::vector<std::string> suggestions;
+    std::map<std::string, double> ruleScores;
+    double confidence;
+};
+
+struct ComparisonResult {
+    double similarity;
+    double score;
+    bool abandoned;                  // DTW stopped early because the cutoff could not be met
+    std::vector<double> times;       // per frame of the first input: its time (s) in the first recording
+    std::vector<double> alignment;   // per frame of the first input: matched time (s) in the second recording
+    std::vector<double> deviations;  // per frame of the first input: mean frame distance on the path
+};
+
+#endif // TAJWEED_AUDIO_FEATURES_H
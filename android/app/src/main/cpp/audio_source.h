@@ -0,0 +1,57 @@
+#ifndef TAJWEED_AUDIO_SOURCE_H
+#define TAJWEED_AUDIO_SOURCE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Random-access view of a mono signal. Implementations convert and downmix
+// only the frames that are asked for, so extractors can walk a long file
+// window by window without a full decoded copy in memory.
+class SampleSource {
+public:
+    virtual ~SampleSource() = default;
+
+    virtual int sampleRate() const = 0;
+    virtual int channels() const = 0;      // channel count before downmixing
+    virtual size_t frameCount() const = 0;
+
+    // Writes mono frames [start, start + count) to out; returns frames written.
+    // Must be safe to call from several threads at once (frame blocks read in parallel).
+    virtual size_t read(size_t start, size_t count, double* out) const = 0;
+
+    double duration() const {
+        return sampleRate() > 0 ? static_cast<double>(frameCount()) / sampleRate() : 0.0;
+    }
+};
+
+// Non-owning view over samples already in memory
+class BufferSource : public SampleSource {
+public:
+    BufferSource(const double* samples, size_t count, int sampleRate)
+        : samples_(samples), count_(count), sampleRate_(sampleRate) {}
+    BufferSource(const std::vector<double>& samples, int sampleRate)
+        : BufferSource(samples.data(), samples.size(), sampleRate) {}
+
+    int sampleRate() const override { return sampleRate_; }
+    int channels() const override { return 1; }
+    size_t frameCount() const override { return count_; }
+
+    size_t read(size_t start, size_t count, double* out) const override {
+        if (start >= count_) return 0;
+        size_t n = std::min(count, count_ - start);
+        std::copy(samples_ + start, samples_ + start + n, out);
+        return n;
+    }
+
+private:
+    const double* samples_;
+    size_t count_;
+    int sampleRate_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_AUDIO_SOURCE_H
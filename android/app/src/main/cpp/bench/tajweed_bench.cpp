@@ -0,0 +1,340 @@
+// Per-stage benchmark of the analysis core on synthetic recitations and WAV fixtures.
+//
+//   tajweed_bench [--durations 1,10,60,600] [--reps 3] [--rate 16000] [--workers 0] [fixture.wav ...]
+//
+// Each input is timed through resampling at each quality, preprocessing, VAD,
+// FFT, STFT, MFCC, pitch, full feature extraction, DTW against a
+// time-stretched copy and rule detection. Reported per stage:
+// nanoseconds per analysis frame (median over the repetitions, after one
+// warm-up run), heap allocations and KiB allocated per steady-state run, and
+// the process peak RSS once the stage has run.
+
+#include "audio_analysis.h"
+#include "dtw.h"
+#include "fft.h"
+#include "pitch.h"
+#include "preprocess.h"
+#include "resample.h"
+#include "spectral.h"
+#include "thread_pool.h"
+#include "vad.h"
+#include "wav_file.h"
+#include <sys/resource.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Every operator new in the process is counted; aligned feature matrix
+// storage (posix_memalign) is not, see FeatureWorkspace::stats() for that
+static std::atomic<uint64_t> gAllocations{0};
+static std::atomic<uint64_t> gAllocatedBytes{0};
+
+// GCC pairs the inlined malloc/free below with new/delete expressions and warns
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void* operator new(size_t size) {
+    gAllocations++;
+    gAllocatedBytes += size;
+    void* memory = malloc(size ? size : 1);
+    if (!memory) throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void* memory) noexcept {
+    free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    free(memory);
+}
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::vector<double> durations = {1, 10, 60, 600};
+    int reps = 3;
+    int sampleRate = 16000;
+    size_t workers = 0;
+    std::vector<std::string> fixtures;
+};
+
+struct Input {
+    std::string name;
+    std::vector<double> samples;
+    std::vector<double> other;   // time-stretched variant, the DTW counterpart
+    int sampleRate;
+};
+
+struct StageResult {
+    double nsPerFrame;
+    double allocations;
+    double kilobytes;
+    double peakRssMb;
+};
+
+double peakRssMb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;  // ru_maxrss is in KiB on Linux
+}
+
+// Recitation-like test signal: a gliding harmonic voice in syllable-shaped
+// bursts with a low noise floor. Deterministic for a given seed.
+std::vector<double> synthesize(double seconds, int sampleRate, double stretch, uint32_t seed) {
+    size_t count = static_cast<size_t>(seconds * sampleRate);
+    std::vector<double> samples(count);
+    double phase = 0.0;
+    uint32_t state = seed;
+    for (size_t i = 0; i < count; i++) {
+        double t = i / (stretch * sampleRate);
+        double f0 = 150.0 + 50.0 * sin(2.0 * M_PI * 0.2 * t) + 5.0 * sin(2.0 * M_PI * 5.5 * t);
+        phase += 2.0 * M_PI * f0 / sampleRate;
+
+        double voice = 0.0;
+        for (int h = 1; h <= 8; h++) voice += sin(h * phase) / h;
+        double syllable = 0.5 + 0.5 * sin(2.0 * M_PI * 3.0 * t);
+
+        state = state * 1664525u + 1013904223u;
+        double noise = (state / 4294967296.0 - 0.5) * 0.02;
+        samples[i] = 0.3 * syllable * syllable * voice + noise;
+    }
+    return samples;
+}
+
+// Linear-interpolated copy played `stretch` times slower
+std::vector<double> stretchSamples(const std::vector<double>& samples, double stretch) {
+    size_t count = static_cast<size_t>(samples.size() * stretch);
+    std::vector<double> out(count);
+    for (size_t i = 0; i < count; i++) {
+        double position = i / stretch;
+        size_t index = static_cast<size_t>(position);
+        double frac = position - index;
+        double a = samples[std::min(index, samples.size() - 1)];
+        double b = samples[std::min(index + 1, samples.size() - 1)];
+        out[i] = a + (b - a) * frac;
+    }
+    return out;
+}
+
+template <typename Stage>
+StageResult runStage(size_t frames, int reps, Stage stage) {
+    stage();  // warm-up: plans, tables and scratch buffers are sized here
+
+    std::vector<double> times;
+    times.reserve(reps);
+    uint64_t allocations = gAllocations;
+    uint64_t bytes = gAllocatedBytes;
+    for (int r = 0; r < reps; r++) {
+        Clock::time_point start = Clock::now();
+        stage();
+        times.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+
+    std::sort(times.begin(), times.end());
+    StageResult result;
+    result.nsPerFrame = times[times.size() / 2] / std::max<size_t>(frames, 1);
+    result.allocations = static_cast<double>(gAllocations - allocations) / reps;
+    result.kilobytes = static_cast<double>(gAllocatedBytes - bytes) / reps / 1024.0;
+    result.peakRssMb = peakRssMb();
+    return result;
+}
+
+void report(const Input& input, const char* stage, size_t frames, const StageResult& result) {
+    printf("%-22s %-8s %8zu %12.0f %10.1f %10.1f %10.1f\n", input.name.c_str(), stage, frames,
+           result.nsPerFrame, result.allocations, result.kilobytes, result.peakRssMb);
+    fflush(stdout);
+}
+
+void benchInput(const Input& input, const Options& options, ThreadPool& pool) {
+    const int reps = options.reps;
+    BufferSource source(input.samples, input.sampleRate);
+    BufferSource otherSource(input.other, input.sampleRate);
+    size_t frames = stftFrameCount(input.samples.size(), kFrameSize, kHopSize);
+    if (frames == 0) {
+        printf("%-22s skipped: shorter than one frame\n", input.name.c_str());
+        return;
+    }
+
+    // Conversion to the analysis rate; 16 kHz input is taken as 44.1 kHz so
+    // the default run still measures a real ratio
+    int sourceRate = input.sampleRate != kAnalysisSampleRate ? input.sampleRate : 44100;
+    BufferSource rateSource(input.samples, sourceRate);
+    ResampledSource resampled;
+    const char* qualityNames[] = {"rs-fast", "rs-bal", "rs-best"};
+    for (int q = 0; q < 3; q++) {
+        report(input, qualityNames[q], frames, runStage(frames, reps, [&]() {
+            resampled.process(rateSource, kAnalysisSampleRate, static_cast<ResampleQuality>(q));
+        }));
+    }
+
+    // Filters, spectral subtraction and peak tracking in one blocked pass
+    PreprocessedSource preprocessed;
+    PreprocessOptions preprocessOptions;
+    report(input, "preproc", frames, runStage(frames, reps, [&]() {
+        preprocessed.process(source, preprocessOptions);
+    }));
+
+    // Energy, zero-crossing and flatness voice activity detection
+    VoiceActivityDetector detector;
+    VadOptions vadOptions;
+    report(input, "vad", frames, runStage(frames, reps, [&]() {
+        detector.detect(source, vadOptions);
+    }));
+
+    // FFT alone, unwindowed
+    std::shared_ptr<const FftPlan> plan = FftPlan::forSize(kFrameSize);
+    std::vector<std::complex<double>> bins(plan->numBins());
+    report(input, "fft", frames, runStage(frames, reps, [&]() {
+        for (size_t f = 0; f < frames; f++) plan->forward(input.samples.data() + f * kHopSize, bins.data());
+    }));
+
+    // Windowed power spectra
+    StftScratch stft;
+    prepareStft(stft, kFrameSize);
+    std::vector<double> power(kFrameSize / 2 + 1);
+    report(input, "stft", frames, runStage(frames, reps, [&]() {
+        for (size_t f = 0; f < frames; f++) framePowerSpectrum(input.samples.data() + f * kHopSize, stft, power.data());
+    }));
+
+    // Mel filterbank and DCT over precomputed spectra
+    Spectrogram spectrogram;
+    computeSpectrogram(source, spectrogram, stft);
+    MelCepstrum cepstrum;
+    cepstrum.configure(spectrogram);
+    double mfcc[kNumMfcc];
+    report(input, "mfcc", frames, runStage(frames, reps, [&]() {
+        for (size_t f = 0; f < frames; f++) cepstrum.compute(spectrogram.frame(f), mfcc);
+    }));
+    spectrogram = Spectrogram();
+
+    PitchTracker tracker(input.sampleRate);
+    std::vector<PitchFrame> pitch;
+    report(input, "pitch", frames, runStage(frames, reps, [&]() {
+        tracker.track(source, pitch);
+    }));
+
+    // Everything above plus deltas, formants and normalization, on the pool
+    FeatureWorkspace workspace;
+    workspace.setPool(&pool);
+    AudioFeatures features;
+    report(input, "extract", frames, runStage(frames, reps, [&]() {
+        extractFeatures(source, workspace, features);
+    }));
+
+    FeatureWorkspace otherWorkspace;
+    otherWorkspace.setPool(&pool);
+    AudioFeatures other;
+    extractFeatures(otherSource, otherWorkspace, other);
+
+    // Full DTW keeps n x m direction bytes, so long inputs use a 10% band
+    DTWOptions dtwOptions;
+    bool banded = input.samples.size() > static_cast<size_t>(60 * input.sampleRate);
+    if (banded) {
+        dtwOptions.band = DTWBand::SakoeChiba;
+        dtwOptions.window = static_cast<int>(frames / 10);
+    }
+    DTWScratch dtw;
+    DTWAlignment alignment;
+    report(input, banded ? "dtw-band" : "dtw", frames, runStage(frames, reps, [&]() {
+        dtwAlign(features.frames.data(), features.frames.numFrames(), other.frames.data(), other.frames.numFrames(),
+                 FeatureColumns::Distance.count, kFeatureStride, dtwOptions, dtw, alignment);
+    }));
+
+    report(input, "rules", frames, runStage(frames, reps, [&]() {
+        analyzeTajweedRules(features, other);
+    }));
+}
+
+std::vector<double> parseList(const char* text) {
+    std::vector<double> values;
+    for (const char* p = text; *p;) {
+        char* end;
+        double value = strtod(p, &end);
+        if (end == p) break;
+        values.push_back(value);
+        p = *end == ',' ? end + 1 : end;
+    }
+    return values;
+}
+
+bool parseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (!strcmp(arg, "--durations") && hasValue) {
+            options.durations = parseList(argv[++i]);
+        } else if (!strcmp(arg, "--reps") && hasValue) {
+            options.reps = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(arg, "--rate") && hasValue) {
+            options.sampleRate = atoi(argv[++i]);
+        } else if (!strcmp(arg, "--workers") && hasValue) {
+            options.workers = static_cast<size_t>(std::max(0, atoi(argv[++i])));
+        } else if (arg[0] == '-') {
+            return false;
+        } else {
+            options.fixtures.push_back(arg);
+        }
+    }
+    return options.sampleRate > 0;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s [--durations 1,10,60,600] [--reps N] [--rate HZ] [--workers N] [fixture.wav ...]\n",
+                argv[0]);
+        return 2;
+    }
+
+    ThreadPool pool(options.workers);
+    printf("frame %d, hop %d, %d reps, %zu pool workers\n", kFrameSize, kHopSize, options.reps, options.workers);
+    printf("%-22s %-8s %8s %12s %10s %10s %10s\n", "input", "stage", "frames", "ns/frame", "allocs", "KiB",
+           "peak MiB");
+
+    int failures = 0;
+    for (double seconds : options.durations) {
+        Input input;
+        char name[32];
+        snprintf(name, sizeof(name), "synthetic %gs", seconds);
+        input.name = name;
+        input.sampleRate = options.sampleRate;
+        input.samples = synthesize(seconds, options.sampleRate, 1.0, 1);
+        input.other = synthesize(seconds * 1.1, options.sampleRate, 1.1, 2);
+        benchInput(input, options, pool);
+    }
+
+    for (const std::string& path : options.fixtures) {
+        WavFile wav;
+        if (!wav.open(path)) {
+            fprintf(stderr, "%s: %s\n", path.c_str(), wav.lastError().c_str());
+            failures++;
+            continue;
+        }
+
+        Input input;
+        size_t slash = path.find_last_of('/');
+        input.name = slash == std::string::npos ? path : path.substr(slash + 1);
+        input.sampleRate = wav.sampleRate();
+        input.samples.resize(wav.frameCount());
+        wav.read(0, input.samples.size(), input.samples.data());
+        input.other = stretchSamples(input.samples, 1.1);
+        benchInput(input, options, pool);
+    }
+
+    return failures == 0 ? 0 : 1;
+}
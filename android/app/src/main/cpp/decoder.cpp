@@ -0,0 +1,110 @@
+#include "decoder.h"
+#include "jobs.h"
+#include "streaming.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace TajweedAudio {
+
+size_t SourceDecoder::decode(float* out, size_t maxFrames) {
+    if (block_.size() < maxFrames) block_.resize(maxFrames);
+    size_t n = source_.read(position_, maxFrames, block_.data());
+    for (size_t i = 0; i < n; i++) out[i] = static_cast<float>(block_[i]);
+    position_ += n;
+    return n;
+}
+
+bool decodeFeatures(AudioDecoder& decoder, StreamingAnalyzer& analyzer, JobControl* job,
+                    DecodeStats* stats, std::string& error) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point started = Clock::now();
+    DecodeStats local;
+
+    // One lock for both directions: the decoder waits for room, the analysis
+    // for samples. Either side takes it before notifying, so a wake-up cannot
+    // fall between the other's check and its wait.
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<bool> decoded{false};
+    std::atomic<bool> stop{false};
+    std::string decodeError;
+    auto signal = [&] {
+        { std::lock_guard<std::mutex> lock(mutex); }
+        wake.notify_all();
+    };
+    auto cancelled = [&] { return job && job->cancelled(); };
+
+    if (job && decoder.frameCountHint() > 0) job->addWork(decoder.frameCountHint());
+
+    std::thread ahead([&] {
+#if defined(__linux__)
+        pthread_setname_np(pthread_self(), "tajweed-decode");
+#endif
+        std::vector<float> block(kDecodeBlock);
+        while (!stop.load(std::memory_order_relaxed) && !cancelled()) {
+            size_t n = decoder.decode(block.data(), kDecodeBlock);
+            if (n == 0) {
+                decodeError = decoder.lastError();
+                break;
+            }
+            local.frames += n;
+            local.blocks++;
+
+            for (size_t written = 0; written < n;) {
+                size_t room;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (analyzer.writable() == 0) {
+                        local.stalls++;
+                        wake.wait(lock, [&] { return analyzer.writable() > 0 || stop.load(std::memory_order_relaxed); });
+                    }
+                    room = analyzer.writable();
+                }
+                if (stop.load(std::memory_order_relaxed)) break;
+                written += analyzer.push(block.data() + written, std::min(n - written, room));
+                signal();
+            }
+            if (job) job->advance(n);
+        }
+        decoded.store(true);
+        signal();
+    });
+
+    bool analyzed = false;
+    for (;;) {
+        if (cancelled()) break;
+        if (analyzer.process() > 0 && !analyzed) {
+            analyzed = true;
+            local.firstFrameMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+        }
+        signal();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        if (decoded.load() && analyzer.queued() == 0) break;
+        wake.wait(lock, [&] { return analyzer.queued() > 0 || decoded.load() || cancelled(); });
+    }
+    stop.store(true);
+    signal();
+    ahead.join();
+
+    bool ok = decodeError.empty() && !cancelled();
+    if (ok) {
+        analyzer.finish();
+        if (!analyzed) local.firstFrameMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    } else {
+        error = decodeError.empty() ? "cancelled" : decodeError;
+    }
+    local.totalMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+    if (stats) *stats = local;
+    return ok;
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,76 @@
+#ifndef TAJWEED_DECODER_H
+#define TAJWEED_DECODER_H
+
+#include "audio_source.h"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace TajweedAudio {
+
+class JobControl;
+class StreamingAnalyzer;
+
+// Sequential mono PCM from a recording that cannot be read at random, such
+// as a compressed file going through a platform codec. Frames come out in
+// order, block by block; nothing keeps the decoded signal.
+class AudioDecoder {
+public:
+    virtual ~AudioDecoder() = default;
+
+    virtual int sampleRate() const = 0;
+    virtual int channels() const = 0;          // channel count before downmixing
+    // Expected frames, from the container; 0 when it does not say
+    virtual size_t frameCountHint() const = 0;
+
+    // Writes up to maxFrames downmixed frames; returns 0 once the stream has
+    // ended, or on failure with lastError() set
+    virtual size_t decode(float* out, size_t maxFrames) = 0;
+
+    const std::string& lastError() const { return error_; }
+
+protected:
+    std::string error_;
+};
+
+// Any SampleSource read front to back, e.g. a mapped WavFile
+class SourceDecoder : public AudioDecoder {
+public:
+    explicit SourceDecoder(const SampleSource& source) : source_(source) {}
+
+    int sampleRate() const override { return source_.sampleRate(); }
+    int channels() const override { return source_.channels(); }
+    size_t frameCountHint() const override { return source_.frameCount(); }
+    size_t decode(float* out, size_t maxFrames) override;
+
+private:
+    const SampleSource& source_;
+    size_t position_ = 0;
+    std::vector<double> block_;
+};
+
+struct DecodeStats {
+    size_t frames = 0;           // decoded, at the decoder's rate
+    size_t blocks = 0;
+    size_t stalls = 0;           // times the decoder waited for the analysis to make room
+    double firstFrameMs = 0.0;   // until the first feature row existed
+    double totalMs = 0.0;
+};
+
+// Frames per decoded block
+const size_t kDecodeBlock = 4096;
+
+// Decodes on a decode-ahead thread straight into `analyzer`'s ring while
+// the calling thread analyzes what has arrived, then finish()es it, so the
+// features are ready when the last block is. The decoder waits for room in
+// the ring rather than dropping samples; at most the ring and one block are
+// ever held. `analyzer` must have been made for decoder.sampleRate(), and
+// must not be pushed to by anyone else meanwhile. Returns false on a decoder
+// error (with `error` set) or when `job` is cancelled; the analyzer is then
+// left unfinished.
+bool decodeFeatures(AudioDecoder& decoder, StreamingAnalyzer& analyzer, JobControl* job,
+                    DecodeStats* stats, std::string& error);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_DECODER_H
@@ -0,0 +1,378 @@
+#include "dtw.h"
+#include "perf_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+namespace TajweedAudio {
+
+namespace {
+
+const double kInf = std::numeric_limits<double>::infinity();
+
+// Inclusive column range [lo, hi] (1-based) allowed in row i of an n x m grid, m <= n
+void bandRange(const DTWOptions& options, size_t i, size_t n, size_t m, size_t& lo, size_t& hi) {
+    double x = static_cast<double>(i) / n;
+
+    switch (options.band) {
+        case DTWBand::SakoeChiba: {
+            double center = x * m;
+            double radius = std::max(1, options.window);
+            lo = static_cast<size_t>(std::max(1.0, floor(center - radius)));
+            hi = static_cast<size_t>(std::min(static_cast<double>(m), ceil(center + radius)));
+            break;
+        }
+        case DTWBand::Itakura: {
+            double s = std::max(1.0, options.itakuraSlope);
+            double low = std::max(x / s, 1.0 - s * (1.0 - x));
+            double high = std::min(s * x, 1.0 - (1.0 - x) / s);
+            lo = static_cast<size_t>(std::max(1.0, ceil(low * m)));
+            hi = static_cast<size_t>(std::min(static_cast<double>(m), floor(high * m)));
+
+            // Short sequences can leave a row empty; keep the diagonal cell
+            size_t diagonal = static_cast<size_t>(std::max(1.0, std::round(x * m)));
+            lo = std::min(lo, diagonal);
+            hi = std::max(hi, diagonal);
+            break;
+        }
+        case DTWBand::None:
+        default:
+            lo = 1;
+            hi = m;
+            break;
+    }
+}
+
+// Band for row i, widened if needed to stay connected to the previous row
+void connectedRange(const DTWOptions& options, size_t i, size_t n, size_t m, size_t prevHi,
+                    size_t& lo, size_t& hi) {
+    bandRange(options, i, n, m, lo, hi);
+    lo = std::min(lo, prevHi + 1);
+    hi = std::max(hi, lo);
+}
+
+enum Step : uint8_t {
+    kStepDiagonal = 0,
+    kStepUp = 1,   // from (i - 1, j)
+    kStepLeft = 2  // from (i, j - 1)
+};
+
+} // namespace
+
+double dtwDistance(const double* seq1, size_t n, const double* seq2, size_t m, const DTWOptions& options) {
+    if (n == 0 || m == 0) return 0.0;
+
+    // Rows run over the longer sequence so the buffers are O(min(n, m))
+    if (m > n) {
+        std::swap(seq1, seq2);
+        std::swap(n, m);
+    }
+
+    std::vector<double> prev(m + 1, kInf);
+    std::vector<double> curr(m + 1, kInf);
+    prev[0] = 0.0;
+
+    size_t prevLo = 0, prevHi = 0;   // range written in prev (row 0 is just column 0)
+    size_t staleLo = 1, staleHi = 0; // range curr still holds from two rows back
+
+    for (size_t i = 1; i <= n; i++) {
+        // Rows stay connected so (n, m) remains reachable
+        size_t lo, hi;
+        connectedRange(options, i, n, m, prevHi, lo, hi);
+
+        for (size_t j = staleLo; j <= staleHi; j++) curr[j] = kInf;
+        curr[0] = kInf;
+        if (lo > 1) curr[lo - 1] = kInf;
+
+        double rowMin = kInf;
+        double x = seq1[i - 1];
+        for (size_t j = lo; j <= hi; j++) {
+            double cost = fabs(x - seq2[j - 1]);
+            double best = std::min({prev[j], curr[j - 1], prev[j - 1]});
+            curr[j] = cost + best;
+            rowMin = std::min(rowMin, curr[j]);
+        }
+
+        // Costs are non-negative, so the final distance is at least this row's minimum
+        if (rowMin > options.abandonThreshold) return kInf;
+
+        std::swap(prev, curr);
+        staleLo = prevLo;
+        staleHi = prevHi;
+        prevLo = lo;
+        prevHi = hi;
+    }
+
+    return prev[m] > options.abandonThreshold ? kInf : prev[m];
+}
+
+DTWAlignment dtwAlign(const float* seq1, size_t n, const float* seq2, size_t m, size_t dims,
+                      const DTWOptions& options) {
+    return dtwAlign(seq1, n, seq2, m, dims, dims, options);
+}
+
+DTWAlignment dtwAlign(const float* seq1, size_t n, const float* seq2, size_t m, size_t dims, size_t stride,
+                      const DTWOptions& options) {
+    DTWScratch scratch;
+    DTWAlignment alignment;
+    dtwAlign(seq1, n, seq2, m, dims, stride, options, scratch, alignment);
+    return alignment;
+}
+
+void dtwAlign(const float* seq1, size_t n, const float* seq2, size_t m, size_t dims, size_t stride,
+              const DTWOptions& options, DTWScratch& scratch, DTWAlignment& alignment) {
+    TAJWEED_PERF_SCOPE(Dtw);
+    alignment.distance = 0.0;
+    alignment.abandoned = false;
+    alignment.frames1.clear();
+    alignment.frames2.clear();
+    alignment.costs.clear();
+    if (n == 0 || m == 0) return;
+
+    // Rows run over the longer sequence; the path is swapped back at the end
+    bool swapped = m > n;
+    if (swapped) {
+        std::swap(seq1, seq2);
+        std::swap(n, m);
+    }
+
+    AllocationStats& stats = scratch.stats;
+    double* prev = growScratch(scratch.prev, m + 1, stats);
+    double* curr = growScratch(scratch.curr, m + 1, stats);
+    std::fill(prev, prev + m + 1, kInf);
+    std::fill(curr, curr + m + 1, kInf);
+    prev[0] = 0.0;
+
+    // Direction bytes for each row's in-band cells, rows stored back to back
+    size_t* rowLo = growScratch(scratch.rowLo, n + 1, stats);
+    size_t* rowOffset = growScratch(scratch.rowOffset, n + 2, stats);
+    std::vector<uint8_t>& steps = scratch.steps;
+    steps.clear();
+    rowOffset[1] = 0;
+
+    size_t prevLo = 0, prevHi = 0;
+    size_t staleLo = 1, staleHi = 0;
+
+    for (size_t i = 1; i <= n; i++) {
+        size_t lo, hi;
+        connectedRange(options, i, n, m, prevHi, lo, hi);
+
+        for (size_t j = staleLo; j <= staleHi; j++) curr[j] = kInf;
+        curr[0] = kInf;
+        if (lo > 1) curr[lo - 1] = kInf;
+
+        rowLo[i] = lo;
+        rowOffset[i + 1] = rowOffset[i] + (hi - lo + 1);
+        growScratch(steps, rowOffset[i + 1], stats);
+        uint8_t* rowSteps = steps.data() + rowOffset[i];
+
+        double rowMin = kInf;
+        const float* frame1 = seq1 + (i - 1) * stride;
+        for (size_t j = lo; j <= hi; j++) {
+            double cost = frameDistance(options.metric, frame1, seq2 + (j - 1) * stride, dims);
+
+            // Ties prefer the diagonal so equal sequences align one-to-one
+            double best = prev[j - 1];
+            uint8_t step = kStepDiagonal;
+            if (prev[j] < best) {
+                best = prev[j];
+                step = kStepUp;
+            }
+            if (curr[j - 1] < best) {
+                best = curr[j - 1];
+                step = kStepLeft;
+            }
+
+            curr[j] = cost + best;
+            rowSteps[j - lo] = step;
+            rowMin = std::min(rowMin, curr[j]);
+        }
+
+        if (rowMin > options.abandonThreshold) {
+            alignment.distance = kInf;
+            alignment.abandoned = true;
+            return;
+        }
+
+        std::swap(prev, curr);
+        staleLo = prevLo;
+        staleHi = prevHi;
+        prevLo = lo;
+        prevHi = hi;
+    }
+
+    alignment.distance = prev[m];
+    if (alignment.distance > options.abandonThreshold) {
+        alignment.distance = kInf;
+        alignment.abandoned = true;
+        return;
+    }
+
+    // Walk the direction bytes back from (n, m); a path has at most n + m - 1 steps
+    size_t capacity1 = alignment.frames1.capacity();
+    size_t capacity2 = alignment.frames2.capacity();
+    alignment.frames1.reserve(n + m - 1);
+    alignment.frames2.reserve(n + m - 1);
+    recordGrowth(alignment.frames1, capacity1, stats);
+    recordGrowth(alignment.frames2, capacity2, stats);
+    size_t i = n, j = m;
+    while (i > 0 && j > 0) {
+        alignment.frames1.push_back(i - 1);
+        alignment.frames2.push_back(j - 1);
+
+        uint8_t step = steps[rowOffset[i] + (j - rowLo[i])];
+        if (step == kStepDiagonal) {
+            i--;
+            j--;
+        } else if (step == kStepUp) {
+            i--;
+        } else {
+            j--;
+        }
+    }
+
+    std::reverse(alignment.frames1.begin(), alignment.frames1.end());
+    std::reverse(alignment.frames2.begin(), alignment.frames2.end());
+    if (swapped) {
+        std::swap(alignment.frames1, alignment.frames2);
+        std::swap(seq1, seq2);
+    }
+
+    float* costs = growScratch(alignment.costs, alignment.frames1.size(), stats);
+    for (size_t k = 0; k < alignment.costs.size(); k++) {
+        costs[k] = frameDistance(options.metric, seq1 + alignment.frames1[k] * stride,
+                                 seq2 + alignment.frames2[k] * stride, dims);
+    }
+}
+
+void IncrementalDTW::reset(const float* reference, size_t m, size_t dims, size_t stride, FrameMetric metric,
+                           size_t maxPathCells) {
+    reference_ = reference;
+    m_ = m;
+    dims_ = dims;
+    stride_ = stride;
+    metric_ = metric;
+    maxPathCells_ = maxPathCells;
+    keepPath_ = m > 0 && m <= maxPathCells;
+    n_ = 0;
+    position_ = 0;
+    meanCost_ = 0.0;
+    steps_.clear();
+    frames_.clear();
+
+    // Row 0 only reaches the corner
+    double* prev = growScratch(prev_, m + 1, stats_);
+    growScratch(curr_, m + 1, stats_);
+    uint32_t* prevLength = growScratch(prevLength_, m + 1, stats_);
+    growScratch(currLength_, m + 1, stats_);
+    std::fill(prev, prev + m + 1, kInf);
+    std::fill(prevLength, prevLength + m + 1, 0u);
+    prev[0] = 0.0;
+}
+
+void IncrementalDTW::push(const float* frame) {
+    if (m_ == 0) return;
+
+    size_t row = n_++;
+
+    // A grid past the cap stops recording its path and frees what it held
+    if (keepPath_ && n_ * m_ > maxPathCells_) {
+        keepPath_ = false;
+        std::vector<uint8_t>().swap(steps_);
+        std::vector<float>().swap(frames_);
+    }
+    uint8_t* rowSteps = nullptr;
+    const float* stored = frame;
+    if (keepPath_) {
+        float* copy = growScratch(frames_, n_ * dims_, stats_) + row * dims_;
+        std::copy(frame, frame + dims_, copy);
+        stored = copy;
+        rowSteps = growScratch(steps_, n_ * m_, stats_) + row * m_;
+    }
+
+    double* prev = prev_.data();
+    double* curr = curr_.data();
+    uint32_t* prevLength = prevLength_.data();
+    uint32_t* currLength = currLength_.data();
+    curr[0] = kInf;
+    currLength[0] = 0;
+
+    double bestMean = kInf;
+    for (size_t j = 1; j <= m_; j++) {
+        double cost = frameDistance(metric_, stored, reference_ + (j - 1) * stride_, dims_);
+
+        // Same recurrence and tie order as dtwAlign
+        double best = prev[j - 1];
+        uint32_t length = prevLength[j - 1];
+        uint8_t step = kStepDiagonal;
+        if (prev[j] < best) {
+            best = prev[j];
+            length = prevLength[j];
+            step = kStepUp;
+        }
+        if (curr[j - 1] < best) {
+            best = curr[j - 1];
+            length = currLength[j - 1];
+            step = kStepLeft;
+        }
+
+        curr[j] = cost + best;
+        currLength[j] = length + 1;
+        if (rowSteps) rowSteps[j - 1] = step;
+
+        double mean = curr[j] / currLength[j];
+        if (mean < bestMean) {
+            bestMean = mean;
+            position_ = j - 1;
+        }
+    }
+    meanCost_ = bestMean;
+
+    std::swap(prev_, curr_);
+    std::swap(prevLength_, currLength_);
+}
+
+bool IncrementalDTW::finish(DTWAlignment& alignment) {
+    alignment.distance = 0.0;
+    alignment.abandoned = false;
+    alignment.frames1.clear();
+    alignment.frames2.clear();
+    alignment.costs.clear();
+    if (n_ == 0 || m_ == 0) return true;
+
+    alignment.distance = prev_[m_];
+    if (!keepPath_) return false;
+    size_t capacity1 = alignment.frames1.capacity();
+    size_t capacity2 = alignment.frames2.capacity();
+    alignment.frames1.reserve(n_ + m_ - 1);
+    alignment.frames2.reserve(n_ + m_ - 1);
+    recordGrowth(alignment.frames1, capacity1, stats_);
+    recordGrowth(alignment.frames2, capacity2, stats_);
+    size_t i = n_, j = m_;
+    while (i > 0 && j > 0) {
+        alignment.frames1.push_back(i - 1);
+        alignment.frames2.push_back(j - 1);
+
+        uint8_t step = steps_[(i - 1) * m_ + (j - 1)];
+        if (step == kStepDiagonal) {
+            i--;
+            j--;
+        } else if (step == kStepUp) {
+            i--;
+        } else {
+            j--;
+        }
+    }
+    std::reverse(alignment.frames1.begin(), alignment.frames1.end());
+    std::reverse(alignment.frames2.begin(), alignment.frames2.end());
+
+    float* costs = growScratch(alignment.costs, alignment.frames1.size(), stats_);
+    for (size_t k = 0; k < alignment.costs.size(); k++) {
+        costs[k] = frameDistance(metric_, frames_.data() + alignment.frames1[k] * dims_,
+                                 reference_ + alignment.frames2[k] * stride_, dims_);
+    }
+    return true;
+}
+
+} // namespace TajweedAudio
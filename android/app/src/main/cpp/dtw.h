@@ -0,0 +1,132 @@
+#ifndef TAJWEED_DTW_H
+#define TAJWEED_DTW_H
+
+#include "frame_distance.h"
+#include "scratch.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace TajweedAudio {
+
+enum class DTWBand {
+    None,        // full n x m search
+    SakoeChiba,  // fixed radius around the (length-scaled) diagonal
+    Itakura      // parallelogram with bounded local slope
+};
+
+struct DTWOptions {
+    DTWBand band = DTWBand::None;
+    int window = 0;             // Sakoe-Chiba radius, in frames of the shorter sequence
+    double itakuraSlope = 2.0;  // maximum local slope for the Itakura parallelogram
+    FrameMetric metric = FrameMetric::Euclidean; // frame cost for dtwAlign
+
+    // Alignment stops once every cell in a row exceeds this distance
+    double abandonThreshold = std::numeric_limits<double>::infinity();
+};
+
+// Scalar DTW with |a - b| cost. Memory is two rows of the shorter sequence;
+// time is proportional to the number of cells inside the band. Returns
+// +infinity when the distance would exceed options.abandonThreshold.
+double dtwDistance(const double* seq1, size_t n, const double* seq2, size_t m,
+                   const DTWOptions& options = DTWOptions());
+
+// Warping path between two frame sequences, ordered from the first frames to the last
+struct DTWAlignment {
+    double distance = 0.0;       // accumulated cost along the path
+    bool abandoned = false;      // distance exceeded options.abandonThreshold
+    std::vector<size_t> frames1; // frame index into seq1 at each path step
+    std::vector<size_t> frames2; // frame index into seq2 at each path step
+    std::vector<float> costs;    // local frame distance at each path step
+};
+
+// Multivariate DTW over frame-major sequences of `dims` floats per frame.
+// Cumulative costs use two rolling rows; one direction byte per in-band
+// cell is kept for backtracking the path.
+DTWAlignment dtwAlign(const float* seq1, size_t n, const float* seq2, size_t m, size_t dims,
+                      const DTWOptions& options = DTWOptions());
+
+// Same, for frames whose first `dims` floats are compared but which sit
+// `stride` floats apart (e.g. the distance block of FeatureMatrix rows)
+DTWAlignment dtwAlign(const float* seq1, size_t n, const float* seq2, size_t m, size_t dims, size_t stride,
+                      const DTWOptions& options);
+
+// Cost rows and direction bytes kept between dtwAlign calls
+struct DTWScratch {
+    std::vector<double> prev;
+    std::vector<double> curr;
+    std::vector<size_t> rowLo;
+    std::vector<size_t> rowOffset;
+    std::vector<uint8_t> steps;
+    AllocationStats stats;
+};
+
+// Allocation-free form once scratch and alignment have grown to the largest
+// problem seen; `alignment` is overwritten
+void dtwAlign(const float* seq1, size_t n, const float* seq2, size_t m, size_t dims, size_t stride,
+              const DTWOptions& options, DTWScratch& scratch, DTWAlignment& alignment);
+
+// Backtracking directions an IncrementalDTW keeps by default (16 MB, as
+// performDTW allows a direct alignment before chunking it)
+const size_t kMaxIncrementalPathCells = size_t(1) << 24;
+
+// DTW of a growing sequence against a fixed reference, one frame at a time.
+// push() adds the frame's row of the cost grid over the whole reference, so
+// the alignment of everything pushed so far is always up to date and
+// finish() only walks the stored directions back. While the path is kept,
+// memory grows by one direction byte per reference frame and one copy of
+// `dims` floats per push; past maxPathCells grid cells both are dropped and
+// only the running position and cost go on.
+class IncrementalDTW {
+public:
+    // Starts a new sequence; `reference` is not copied and must outlive the
+    // alignment. maxPathCells = 0 tracks the position without a path.
+    void reset(const float* reference, size_t m, size_t dims, size_t stride,
+               FrameMetric metric = FrameMetric::Euclidean, size_t maxPathCells = kMaxIncrementalPathCells);
+
+    // Adds the next frame (`dims` floats)
+    void push(const float* frame);
+
+    size_t frames() const { return n_; }
+    size_t referenceFrames() const { return m_; }
+
+    // Open-ended alignment of the frames so far: the reference frame whose
+    // path has the lowest cost per step, and that cost
+    size_t position() const { return position_; }
+    double meanCost() const { return meanCost_; }
+
+    // False once the grid has outgrown maxPathCells
+    bool hasPath() const { return keepPath_; }
+
+    // Path from the first frames to the last pushed and last reference frame;
+    // its distance is the one dtwAlign finds for the same frames. Without a
+    // path only the distance is set and this returns false; align the whole
+    // sequence with performDTW instead, which chunks grids that large.
+    bool finish(DTWAlignment& alignment);
+
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    const float* reference_ = nullptr;
+    size_t m_ = 0;
+    size_t dims_ = 0;
+    size_t stride_ = 0;
+    FrameMetric metric_ = FrameMetric::Euclidean;
+    size_t maxPathCells_ = 0;
+    bool keepPath_ = false;
+    size_t n_ = 0;
+    size_t position_ = 0;
+    double meanCost_ = 0.0;
+    std::vector<double> prev_;           // cumulative costs of the last row, m + 1
+    std::vector<double> curr_;
+    std::vector<uint32_t> prevLength_;   // path steps to each cell of the last row
+    std::vector<uint32_t> currLength_;
+    std::vector<uint8_t> steps_;         // n x m directions, while the path is kept
+    std::vector<float> frames_;          // n x dims pushed frames, for the path costs
+    AllocationStats stats_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_DTW_H
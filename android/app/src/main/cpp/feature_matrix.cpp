@@ -0,0 +1,129 @@
+#include "feature_matrix.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+namespace TajweedAudio {
+
+namespace {
+
+float* allocateRows(size_t numFrames) {
+    size_t bytes = numFrames * kFeatureStride * sizeof(float);
+    if (bytes == 0) return nullptr;
+
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kFeatureAlignment, bytes) != 0) throw std::bad_alloc();
+    return static_cast<float*>(memory);
+}
+
+} // namespace
+
+FeatureMatrix::FeatureMatrix(size_t numFrames, int sampleRate, int hopSize) {
+    reset(numFrames, sampleRate, hopSize);
+}
+
+FeatureMatrix::~FeatureMatrix() {
+    free(data_);
+}
+
+FeatureMatrix::FeatureMatrix(const FeatureMatrix& other) {
+    assign(other.data_, other.numFrames_, other.sampleRate_, other.hopSize_);
+}
+
+FeatureMatrix& FeatureMatrix::operator=(const FeatureMatrix& other) {
+    if (this != &other) {
+        assign(other.data_, other.numFrames_, other.sampleRate_, other.hopSize_);
+    }
+    return *this;
+}
+
+FeatureMatrix::FeatureMatrix(FeatureMatrix&& other) noexcept
+    : data_(other.data_), numFrames_(other.numFrames_), capacity_(other.capacity_),
+      sampleRate_(other.sampleRate_), hopSize_(other.hopSize_) {
+    other.data_ = nullptr;
+    other.numFrames_ = 0;
+    other.capacity_ = 0;
+}
+
+FeatureMatrix& FeatureMatrix::operator=(FeatureMatrix&& other) noexcept {
+    if (this != &other) {
+        free(data_);
+        data_ = other.data_;
+        numFrames_ = other.numFrames_;
+        capacity_ = other.capacity_;
+        sampleRate_ = other.sampleRate_;
+        hopSize_ = other.hopSize_;
+        other.data_ = nullptr;
+        other.numFrames_ = 0;
+        other.capacity_ = 0;
+    }
+    return *this;
+}
+
+void FeatureMatrix::reset(size_t numFrames, int sampleRate, int hopSize) {
+    if (numFrames > capacity_) {
+        float* rows = allocateRows(numFrames);
+        free(data_);
+        data_ = rows;
+        capacity_ = numFrames;
+    }
+    numFrames_ = numFrames;
+    sampleRate_ = sampleRate;
+    hopSize_ = hopSize;
+    if (data_) memset(data_, 0, sizeBytes());
+}
+
+void FeatureMatrix::assign(const float* rows, size_t numFrames, int sampleRate, int hopSize) {
+    reset(numFrames, sampleRate, hopSize);
+    if (rows && data_) memcpy(data_, rows, sizeBytes());
+}
+
+double FeatureMatrix::columnMean(size_t column, bool skipZeros) const {
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t f = 0; f < numFrames_; f++) {
+        float value = row(f)[column];
+        if (skipZeros && value == 0.0f) continue;
+        sum += value;
+        count++;
+    }
+    return count > 0 ? sum / count : 0.0;
+}
+
+double FeatureMatrix::columnMin(size_t column) const {
+    if (numFrames_ == 0) return 0.0;
+    float result = row(0)[column];
+    for (size_t f = 1; f < numFrames_; f++) result = std::min(result, row(f)[column]);
+    return result;
+}
+
+double FeatureMatrix::columnMax(size_t column) const {
+    if (numFrames_ == 0) return 0.0;
+    float result = row(0)[column];
+    for (size_t f = 1; f < numFrames_; f++) result = std::max(result, row(f)[column]);
+    return result;
+}
+
+void FeatureMatrix::normalizeColumns(const ColumnRange& range) {
+    if (numFrames_ == 0) return;
+
+    for (size_t c = range.offset; c < range.offset + range.count; c++) {
+        double mean = columnMean(c);
+        double variance = 0.0;
+        for (size_t f = 0; f < numFrames_; f++) {
+            double diff = row(f)[c] - mean;
+            variance += diff * diff;
+        }
+        double stddev = sqrt(variance / numFrames_);
+
+        // Constant features carry no information; leave them at zero
+        double scale = stddev < 1e-12 ? 0.0 : 1.0 / stddev;
+        for (size_t f = 0; f < numFrames_; f++) {
+            row(f)[c] = static_cast<float>((row(f)[c] - mean) * scale);
+        }
+    }
+}
+
+} // namespace TajweedAudio
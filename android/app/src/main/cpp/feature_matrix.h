@@ -0,0 +1,98 @@
+#ifndef TAJWEED_FEATURE_MATRIX_H
+#define TAJWEED_FEATURE_MATRIX_H
+
+#include "spectral.h"
+#include <cstddef>
+
+namespace TajweedAudio {
+
+// Contiguous span of columns within a feature row
+struct ColumnRange {
+    size_t offset;
+    size_t count;
+};
+
+// Row layout shared by DTW, rule detection and feature bundles. Every column
+// is sampled on the STFT time base: frame f starts at f * hopSize samples.
+namespace FeatureColumns {
+    // Distance block, z-normalized per recording so no feature dominates DTW
+    const ColumnRange Mfcc = {0, kNumMfcc};
+    const ColumnRange MfccDelta = {kNumMfcc, kNumMfcc};
+    const ColumnRange NormalizedPitch = {2 * kNumMfcc, 1};
+    const ColumnRange LogEnergy = {2 * kNumMfcc + 1, 1};
+    const ColumnRange Distance = {0, 2 * kNumMfcc + 2};
+
+    // Raw measurements used by rule detection
+    const ColumnRange Pitch = {2 * kNumMfcc + 2, 1};            // Hz, 0 when unvoiced
+    const ColumnRange PitchConfidence = {2 * kNumMfcc + 3, 1};  // 1 - YIN aperiodicity
+    const ColumnRange Energy = {2 * kNumMfcc + 4, 1};           // mean square of the frame
+    const ColumnRange SpectralCentroid = {2 * kNumMfcc + 5, 1}; // Hz
+    const ColumnRange SpectralRolloff = {2 * kNumMfcc + 6, 1};  // Hz
+    const ColumnRange Formants = {2 * kNumMfcc + 7, 4};         // F1..F4 in Hz
+} // namespace FeatureColumns
+
+const size_t kFeatureColumns = 2 * kNumMfcc + 11;
+const size_t kFeatureStride = 40;      // floats per row; rows stay 32-byte aligned
+const size_t kFeatureAlignment = 64;   // base alignment of the matrix storage
+
+static_assert(kFeatureColumns <= kFeatureStride, "feature row does not fit its stride");
+static_assert(kFeatureStride * sizeof(float) % 32 == 0, "rows must stay 32-byte aligned");
+
+// Frame-major float32 feature matrix with 64-byte aligned storage
+class FeatureMatrix {
+public:
+    FeatureMatrix() = default;
+    FeatureMatrix(size_t numFrames, int sampleRate, int hopSize = kHopSize);
+    ~FeatureMatrix();
+
+    FeatureMatrix(const FeatureMatrix& other);
+    FeatureMatrix& operator=(const FeatureMatrix& other);
+    FeatureMatrix(FeatureMatrix&& other) noexcept;
+    FeatureMatrix& operator=(FeatureMatrix&& other) noexcept;
+
+    // Resizes (zero-filled) for a new frame count and time base; storage is
+    // only reallocated when numFrames exceeds capacity()
+    void reset(size_t numFrames, int sampleRate, int hopSize = kHopSize);
+
+    // Copies rows laid out with kFeatureStride, e.g. from a mapped bundle
+    void assign(const float* rows, size_t numFrames, int sampleRate, int hopSize = kHopSize);
+
+    size_t numFrames() const { return numFrames_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return numFrames_ == 0; }
+    int sampleRate() const { return sampleRate_; }
+    int hopSize() const { return hopSize_; }
+
+    // Seconds between consecutive frames, and the start time of frame f
+    double frameSeconds() const { return sampleRate_ > 0 ? static_cast<double>(hopSize_) / sampleRate_ : 0.0; }
+    double frameTime(size_t f) const { return f * frameSeconds(); }
+
+    float* data() { return data_; }
+    const float* data() const { return data_; }
+    float* row(size_t f) { return data_ + f * kFeatureStride; }
+    const float* row(size_t f) const { return data_ + f * kFeatureStride; }
+    float& at(size_t f, const ColumnRange& range, size_t i = 0) { return row(f)[range.offset + i]; }
+    float at(size_t f, const ColumnRange& range, size_t i = 0) const { return row(f)[range.offset + i]; }
+
+    size_t sizeBytes() const { return numFrames_ * kFeatureStride * sizeof(float); }
+
+    // Column statistics over all frames; skipZeros ignores frames holding 0
+    // (e.g. unvoiced frames in the pitch column)
+    double columnMean(size_t column, bool skipZeros = false) const;
+    double columnMin(size_t column) const;
+    double columnMax(size_t column) const;
+
+    // Z-scores every column of the range in place; constant columns become 0
+    void normalizeColumns(const ColumnRange& range);
+
+private:
+    float* data_ = nullptr;
+    size_t numFrames_ = 0;
+    size_t capacity_ = 0;
+    int sampleRate_ = 0;
+    int hopSize_ = kHopSize;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_FEATURE_MATRIX_H
@@ -0,0 +1,323 @@
+#include "feature_store.h"
+#include "resample.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TajweedAudio {
+
+namespace {
+
+const char kBundleMagic[4] = {'T', 'J', 'F', 'B'};
+const size_t kSectionAlignment = 64;
+
+const uint64_t kFnvPrime = 1099511628211ULL;
+
+size_t alignUp(size_t value, size_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+struct PendingSection {
+    FeatureSection id;
+    size_t rows;
+    size_t cols;
+    const float* data;
+
+    size_t bytes() const { return rows * cols * sizeof(float); }
+};
+
+bool writeAll(FILE* file, const void* data, size_t size) {
+    return size == 0 || fwrite(data, 1, size, file) == size;
+}
+
+bool writePadding(FILE* file, size_t count) {
+    static const uint8_t zeros[kSectionAlignment] = {};
+    return writeAll(file, zeros, count);
+}
+
+bool accepts(std::initializer_list<uint64_t> configHashes, uint64_t configHash) {
+    return std::find(configHashes.begin(), configHashes.end(), configHash) != configHashes.end();
+}
+
+} // namespace
+
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+uint64_t analysisConfigHash() {
+    const int32_t params[] = {
+        static_cast<int32_t>(kBundleVersion),
+        kAnalysisSampleRate,
+        kFrameSize,
+        kHopSize,
+        kNumMfcc,
+        kNumMelFilters,
+        static_cast<int32_t>(kFeatureColumns),
+        static_cast<int32_t>(kFeatureStride),
+    };
+    uint64_t hash = fnv1a(params, sizeof(params));
+    return fnv1a("hann", 4, hash);
+}
+
+bool writeFeatureBundle(const std::string& path, const AudioFeatures& features,
+                        const std::vector<BundleSegment>& segments, uint64_t configHash, std::string& error) {
+    std::vector<PendingSection> sections;
+    sections.push_back({FeatureSection::Features, features.frames.numFrames(), kFeatureStride,
+                        features.frames.data()});
+
+    // Lay out header, tables and aligned section data
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, kBundleMagic, sizeof(kBundleMagic));
+    header.version = kBundleVersion;
+    header.configHash = configHash;
+    header.sampleRate = features.sampleRate;
+    header.channels = features.channels;
+    header.duration = features.duration;
+    header.sectionCount = static_cast<uint32_t>(sections.size());
+    header.segmentCount = static_cast<uint32_t>(segments.size());
+    header.sectionTableOffset = sizeof(BundleHeader);
+    header.segmentTableOffset = header.sectionTableOffset + sections.size() * sizeof(BundleSectionEntry);
+
+    std::vector<BundleSectionEntry> table(sections.size());
+    size_t offset = alignUp(header.segmentTableOffset + segments.size() * sizeof(BundleSegment), kSectionAlignment);
+    for (size_t i = 0; i < sections.size(); i++) {
+        table[i].id = static_cast<uint32_t>(sections[i].id);
+        table[i].rows = static_cast<uint32_t>(sections[i].rows);
+        table[i].cols = static_cast<uint32_t>(sections[i].cols);
+        table[i].reserved = 0;
+        table[i].offset = offset;
+        offset = alignUp(offset + sections[i].bytes(), kSectionAlignment);
+    }
+    header.fileSize = offset;
+
+    // A unique name beside the bundle, so concurrent writers of one id each
+    // rename a whole file into place
+    std::string tmpPath = path + ".XXXXXX";
+    int fd = mkstemp(&tmpPath[0]);
+    FILE* file = fd >= 0 ? fdopen(fd, "wb") : nullptr;
+    if (!file) {
+        error = "Cannot create " + tmpPath + ": " + strerror(errno);
+        if (fd >= 0) {
+            ::close(fd);
+            unlink(tmpPath.c_str());
+        }
+        return false;
+    }
+    fchmod(fd, 0644);
+
+    bool ok = writeAll(file, &header, sizeof(header)) &&
+              writeAll(file, table.data(), table.size() * sizeof(BundleSectionEntry)) &&
+              writeAll(file, segments.data(), segments.size() * sizeof(BundleSegment));
+
+    size_t written = header.segmentTableOffset + segments.size() * sizeof(BundleSegment);
+    for (size_t i = 0; ok && i < sections.size(); i++) {
+        ok = writePadding(file, table[i].offset - written) &&
+             writeAll(file, sections[i].data, sections[i].bytes());
+        written = table[i].offset + sections[i].bytes();
+    }
+    ok = ok && writePadding(file, header.fileSize - written);
+
+    if (fclose(file) != 0) ok = false;
+    if (!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        error = "Failed to write " + path + ": " + strerror(errno);
+        unlink(tmpPath.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+FeatureBundle::~FeatureBundle() {
+    close();
+}
+
+bool FeatureBundle::fail(const std::string& message) {
+    close();
+    error_ = message;
+    return false;
+}
+
+bool FeatureBundle::open(const std::string& path, uint64_t configHash) {
+    return open(path, {configHash});
+}
+
+bool FeatureBundle::open(const std::string& path, std::initializer_list<uint64_t> configHashes) {
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return fail("No feature bundle at " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(BundleHeader)) {
+        ::close(fd);
+        return fail("Truncated feature bundle " + path);
+    }
+
+    mappingSize_ = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mappingSize_ = 0;
+        return fail("Cannot map " + path);
+    }
+    mapping_ = mapping;
+
+    const uint8_t* base = static_cast<const uint8_t*>(mapping_);
+    header_ = reinterpret_cast<const BundleHeader*>(base);
+
+    if (memcmp(header_->magic, kBundleMagic, sizeof(kBundleMagic)) != 0) {
+        return fail("Not a feature bundle: " + path);
+    }
+    if (header_->version != kBundleVersion || !accepts(configHashes, header_->configHash)) {
+        return fail("Stale feature bundle (built with a different analysis config): " + path);
+    }
+    if (header_->fileSize != mappingSize_ ||
+        header_->sectionTableOffset + header_->sectionCount * sizeof(BundleSectionEntry) > mappingSize_ ||
+        header_->segmentTableOffset + header_->segmentCount * sizeof(BundleSegment) > mappingSize_) {
+        return fail("Corrupt feature bundle tables: " + path);
+    }
+
+    sections_ = reinterpret_cast<const BundleSectionEntry*>(base + header_->sectionTableOffset);
+    for (uint32_t i = 0; i < header_->sectionCount; i++) {
+        const BundleSectionEntry& entry = sections_[i];
+        uint64_t bytes = static_cast<uint64_t>(entry.rows) * entry.cols * sizeof(float);
+        if (entry.offset % kSectionAlignment != 0 || entry.offset + bytes > mappingSize_) {
+            return fail("Corrupt feature bundle section: " + path);
+        }
+    }
+
+    return true;
+}
+
+void FeatureBundle::close() {
+    if (mapping_) {
+        munmap(mapping_, mappingSize_);
+    }
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    header_ = nullptr;
+    sections_ = nullptr;
+    error_.clear();
+}
+
+const float* FeatureBundle::section(FeatureSection id, size_t& rows, size_t& cols) const {
+    rows = 0;
+    cols = 0;
+    if (!header_) return nullptr;
+
+    for (uint32_t i = 0; i < header_->sectionCount; i++) {
+        if (sections_[i].id == static_cast<uint32_t>(id)) {
+            rows = sections_[i].rows;
+            cols = sections_[i].cols;
+            return reinterpret_cast<const float*>(static_cast<const uint8_t*>(mapping_) + sections_[i].offset);
+        }
+    }
+    return nullptr;
+}
+
+const float* FeatureBundle::frames(size_t& numFrames) const {
+    size_t cols;
+    const float* rows = section(FeatureSection::Features, numFrames, cols);
+    if (rows && cols != kFeatureStride) {
+        numFrames = 0;
+        return nullptr;
+    }
+    return rows;
+}
+
+const BundleSegment* FeatureBundle::segments(size_t& count) const {
+    count = header_ ? header_->segmentCount : 0;
+    if (!header_) return nullptr;
+    return reinterpret_cast<const BundleSegment*>(static_cast<const uint8_t*>(mapping_) + header_->segmentTableOffset);
+}
+
+AudioFeatures FeatureBundle::features() const {
+    AudioFeatures features;
+    this->features(features);
+    return features;
+}
+
+void FeatureBundle::features(AudioFeatures& out) const {
+    out.duration = duration();
+    out.sampleRate = sampleRate();
+    out.channels = channels();
+
+    size_t numFrames;
+    const float* rows = frames(numFrames);
+    out.frames.assign(rows, numFrames, sampleRate());
+}
+
+FeatureStore& FeatureStore::instance() {
+    static FeatureStore store;
+    return store;
+}
+
+void FeatureStore::setDirectory(const std::string& directory) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    directory_ = directory;
+    open_.clear();
+    mkdir(directory_.c_str(), 0755);
+}
+
+std::string FeatureStore::pathFor(const std::string& bundleId) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.tjfb",
+             static_cast<unsigned long long>(fnv1a(bundleId.data(), bundleId.size())));
+    return directory_ + "/" + name;
+}
+
+bool FeatureStore::put(const std::string& bundleId, const AudioFeatures& features,
+                       const std::vector<BundleSegment>& segments, uint64_t configHash, std::string& error) {
+    std::string path = pathFor(bundleId);
+
+    // Drop our mapping first; readers holding the old bundle keep their pages
+    evict(bundleId);
+    return writeFeatureBundle(path, features, segments, configHash, error);
+}
+
+std::shared_ptr<const FeatureBundle> FeatureStore::open(const std::string& bundleId, uint64_t configHash,
+                                                        std::string& error) {
+    return open(bundleId, {configHash}, error);
+}
+
+std::shared_ptr<const FeatureBundle> FeatureStore::open(const std::string& bundleId,
+                                                        std::initializer_list<uint64_t> configHashes,
+                                                        std::string& error) {
+    {
+        // A mapping opened under another config is checked again from the file
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = open_.find(bundleId);
+        if (it != open_.end() && accepts(configHashes, it->second->configHash())) return it->second;
+    }
+
+    auto bundle = std::make_shared<FeatureBundle>();
+    if (!bundle->open(pathFor(bundleId), configHashes)) {
+        error = bundle->lastError();
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<const FeatureBundle>& slot = open_[bundleId];
+    if (!slot || slot->configHash() != bundle->configHash()) slot = bundle;
+    return slot;
+}
+
+void FeatureStore::evict(const std::string& bundleId) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    open_.erase(bundleId);
+}
+
+} // namespace TajweedAudio
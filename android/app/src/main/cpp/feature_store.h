@@ -0,0 +1,152 @@
+#ifndef TAJWEED_FEATURE_STORE_H
+#define TAJWEED_FEATURE_STORE_H
+
+#include "audio_features.h"
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Feature bundle file layout (little-endian):
+//
+//   BundleHeader                       64 bytes
+//   BundleSectionEntry[sectionCount]   section table
+//   BundleSegment[segmentCount]        segment table
+//   section data                       float32 row-major matrices, 64-byte aligned
+//
+// A bundle is only valid for the analysis configuration it was built with.
+// configHash is the extraction config hash of the workspace that built it
+// (extractionConfigHash: framing, MFCC and row layout, plus its resample,
+// preprocess and VAD settings), and readers pass the hash they expect.
+const uint32_t kBundleVersion = 5;
+
+enum class FeatureSection : uint32_t {
+    Features = 1  // numFrames x kFeatureStride FeatureMatrix rows
+};
+
+struct BundleHeader {
+    char magic[4];               // "TJFB"
+    uint32_t version;
+    uint64_t configHash;
+    int32_t sampleRate;
+    int32_t channels;
+    double duration;
+    uint32_t sectionCount;
+    uint32_t segmentCount;
+    uint64_t sectionTableOffset;
+    uint64_t segmentTableOffset;
+    uint64_t fileSize;
+};
+
+struct BundleSectionEntry {
+    uint32_t id;
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t reserved;
+    uint64_t offset;
+};
+
+struct BundleSegment {
+    double startTime;
+    double endTime;
+    uint32_t firstFrame;
+    uint32_t frameCount;
+};
+
+static_assert(sizeof(BundleHeader) == 64, "BundleHeader layout is part of the file format");
+static_assert(sizeof(BundleSectionEntry) == 24, "BundleSectionEntry layout is part of the file format");
+static_assert(sizeof(BundleSegment) == 24, "BundleSegment layout is part of the file format");
+
+// 64-bit FNV-1a; pass an earlier result as `hash` to chain
+const uint64_t kFnvOffset = 1469598103934665603ULL;
+uint64_t fnv1a(const void* data, size_t size, uint64_t hash = kFnvOffset);
+
+// Hash of the fixed analysis parameters that affect every extracted frame;
+// extractionConfigHash adds a workspace's own settings to it
+uint64_t analysisConfigHash();
+
+// Writes a bundle atomically (uniquely named temporary file + rename), stamped with `configHash`
+bool writeFeatureBundle(const std::string& path, const AudioFeatures& features,
+                        const std::vector<BundleSegment>& segments, uint64_t configHash, std::string& error);
+
+// Read-only memory-mapped bundle
+class FeatureBundle {
+public:
+    FeatureBundle() = default;
+    ~FeatureBundle();
+
+    FeatureBundle(const FeatureBundle&) = delete;
+    FeatureBundle& operator=(const FeatureBundle&) = delete;
+
+    // Fails, with lastError() set, unless the file is a complete bundle of
+    // this version built under `configHash` (or one of `configHashes`)
+    bool open(const std::string& path, uint64_t configHash);
+    bool open(const std::string& path, std::initializer_list<uint64_t> configHashes);
+    void close();
+    const std::string& lastError() const { return error_; }
+
+    uint64_t configHash() const { return header_ ? header_->configHash : 0; }
+
+    int sampleRate() const { return header_ ? header_->sampleRate : 0; }
+    int channels() const { return header_ ? header_->channels : 0; }
+    double duration() const { return header_ ? header_->duration : 0.0; }
+
+    // Pointer into the mapping, or nullptr when the section is absent
+    const float* section(FeatureSection id, size_t& rows, size_t& cols) const;
+
+    // Feature rows straight from the mapping (kFeatureStride floats apart)
+    const float* frames(size_t& numFrames) const;
+
+    const BundleSegment* segments(size_t& count) const;
+
+    // Copies the feature matrix out of the mapping; the second form reuses
+    // the storage already held by `out`
+    AudioFeatures features() const;
+    void features(AudioFeatures& out) const;
+
+private:
+    bool fail(const std::string& message);
+
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    const BundleHeader* header_ = nullptr;
+    const BundleSectionEntry* sections_ = nullptr;
+    std::string error_;
+};
+
+// Directory of reference bundles keyed by an opaque bundle ID; open bundles stay mapped
+class FeatureStore {
+public:
+    static FeatureStore& instance();
+
+    void setDirectory(const std::string& directory);
+    std::string pathFor(const std::string& bundleId) const;
+
+    bool put(const std::string& bundleId, const AudioFeatures& features,
+             const std::vector<BundleSegment>& segments, uint64_t configHash, std::string& error);
+
+    // Returns nullptr (with error set) when the bundle is missing or was
+    // built under another config than `configHash` (or all of `configHashes`)
+    std::shared_ptr<const FeatureBundle> open(const std::string& bundleId, uint64_t configHash, std::string& error);
+    std::shared_ptr<const FeatureBundle> open(const std::string& bundleId,
+                                              std::initializer_list<uint64_t> configHashes, std::string& error);
+
+    void evict(const std::string& bundleId);
+
+private:
+    FeatureStore() = default;
+
+    mutable std::mutex mutex_;
+    std::string directory_;
+    std::map<std::string, std::shared_ptr<const FeatureBundle>> open_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_FEATURE_STORE_H
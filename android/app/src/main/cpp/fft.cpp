@@ -0,0 +1,261 @@
+#include "fft.h"
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Whole-signal transforms come in one size per recording length, so plans
+// of other sizes are kept only while recently used
+const size_t kMaxCachedOddPlans = 8;
+
+// Bluestein's convolution buffer, reused by every plan run on this thread
+std::vector<std::complex<double>>& bluesteinWork(size_t size) {
+    thread_local std::vector<std::complex<double>> work;
+    if (work.size() < size) work.resize(size);
+    return work;
+}
+
+} // namespace
+
+bool isPowerOfTwo(size_t n) {
+    return n != 0 && (n & (n - 1)) == 0;
+}
+
+size_t nextPowerOfTwo(size_t n) {
+    size_t p = 1;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+void FftPlan::ComplexTransform::init(size_t n) {
+    size = n;
+    bitReverse.assign(n, 0);
+
+    int bits = 0;
+    while ((static_cast<size_t>(1) << bits) < n) bits++;
+
+    for (size_t i = 0; i < n; i++) {
+        size_t reversed = 0;
+        for (int b = 0; b < bits; b++) {
+            if (i & (static_cast<size_t>(1) << b)) {
+                reversed |= static_cast<size_t>(1) << (bits - 1 - b);
+            }
+        }
+        bitReverse[i] = reversed;
+    }
+
+    twiddles.resize(n / 2);
+    for (size_t k = 0; k < n / 2; k++) {
+        double angle = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(n);
+        twiddles[k] = std::complex<double>(cos(angle), sin(angle));
+    }
+}
+
+void FftPlan::ComplexTransform::run(std::complex<double>* data, bool inverse) const {
+    for (size_t i = 0; i < size; i++) {
+        size_t j = bitReverse[i];
+        if (i < j) std::swap(data[i], data[j]);
+    }
+
+    for (size_t len = 2; len <= size; len <<= 1) {
+        size_t halfLen = len / 2;
+        size_t stride = size / len;
+
+        for (size_t start = 0; start < size; start += len) {
+            for (size_t k = 0; k < halfLen; k++) {
+                std::complex<double> w = twiddles[k * stride];
+                if (inverse) w = std::conj(w);
+
+                std::complex<double> even = data[start + k];
+                std::complex<double> odd = data[start + k + halfLen] * w;
+                data[start + k] = even + odd;
+                data[start + k + halfLen] = even - odd;
+            }
+        }
+    }
+}
+
+FftPlan::FftPlan(size_t size) : size_(size), isPow2_(isPowerOfTwo(size)) {
+    if (size == 0) {
+        throw std::invalid_argument("FFT size must be positive");
+    }
+
+    if (isPow2_) {
+        // Pack n real samples into n/2 complex values and unscramble afterwards
+        size_t half = size / 2;
+        if (half > 0) half_.init(half);
+
+        splitTwiddles_.resize(half);
+        for (size_t k = 0; k < half; k++) {
+            double angle = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size);
+            splitTwiddles_[k] = std::complex<double>(cos(angle), sin(angle));
+        }
+        return;
+    }
+
+    // Bluestein: X[k] = c[k] * sum_j (x[j] * c[j]) * conj(c[k - j]), c[k] = e^{-i*pi*k^2/n}
+    size_t convSize = nextPowerOfTwo(2 * size - 1);
+    conv_.init(convSize);
+
+    chirp_.resize(size);
+    unsigned long long period = 2ULL * size;
+    for (size_t k = 0; k < size; k++) {
+        // Reduce k^2 modulo 2n first so the angle stays accurate for large k
+        unsigned long long k2 = (static_cast<unsigned long long>(k) * k) % period;
+        double angle = -M_PI * static_cast<double>(k2) / static_cast<double>(size);
+        chirp_[k] = std::complex<double>(cos(angle), sin(angle));
+    }
+
+    chirpSpectrum_.assign(convSize, std::complex<double>(0.0, 0.0));
+    chirpSpectrum_[0] = std::conj(chirp_[0]);
+    for (size_t k = 1; k < size; k++) {
+        chirpSpectrum_[k] = std::conj(chirp_[k]);
+        chirpSpectrum_[convSize - k] = std::conj(chirp_[k]);
+    }
+    conv_.run(chirpSpectrum_.data(), false);
+}
+
+void FftPlan::forward(const double* input, std::complex<double>* output) const {
+    if (isPow2_) {
+        forwardPow2(input, output);
+    } else {
+        forwardBluestein(input, output);
+    }
+}
+
+void FftPlan::forwardPow2(const double* input, std::complex<double>* output) const {
+    if (size_ == 1) {
+        output[0] = std::complex<double>(input[0], 0.0);
+        return;
+    }
+
+    size_t half = size_ / 2;
+
+    // z[k] = x[2k] + i*x[2k+1]
+    for (size_t k = 0; k < half; k++) {
+        output[k] = std::complex<double>(input[2 * k], input[2 * k + 1]);
+    }
+    half_.run(output, false);
+
+    // Split the packed spectrum into the spectrum of the real sequence
+    std::complex<double> z0 = output[0];
+    output[0] = std::complex<double>(z0.real() + z0.imag(), 0.0);
+    output[half] = std::complex<double>(z0.real() - z0.imag(), 0.0);
+
+    for (size_t k = 1; k <= half / 2; k++) {
+        size_t mirror = half - k;
+        std::complex<double> zk = output[k];
+        std::complex<double> zm = output[mirror];
+
+        std::complex<double> evenK = 0.5 * (zk + std::conj(zm));
+        std::complex<double> oddK = std::complex<double>(0.0, -0.5) * (zk - std::conj(zm));
+        std::complex<double> evenM = 0.5 * (zm + std::conj(zk));
+        std::complex<double> oddM = std::complex<double>(0.0, -0.5) * (zm - std::conj(zk));
+
+        output[k] = evenK + splitTwiddles_[k] * oddK;
+        output[mirror] = evenM + splitTwiddles_[mirror] * oddM;
+    }
+}
+
+void FftPlan::inverse(std::complex<double>* bins, double* output) const {
+    if (!isPow2_) {
+        throw std::invalid_argument("Inverse FFT needs a power-of-two size");
+    }
+    inversePow2(bins, output);
+}
+
+void FftPlan::inversePow2(std::complex<double>* bins, double* output) const {
+    if (size_ == 1) {
+        output[0] = bins[0].real();
+        return;
+    }
+
+    size_t half = size_ / 2;
+
+    // Re-pack the real spectrum as Z[k] = E[k] + i*O[k], the spectrum of
+    // z[k] = x[2k] + i*x[2k+1]; pairs k and half - k are rebuilt together
+    std::complex<double> x0 = bins[0];
+    std::complex<double> xh = bins[half];
+    bins[0] = std::complex<double>(0.5 * (x0.real() + xh.real()), 0.5 * (x0.real() - xh.real()));
+
+    const std::complex<double> i(0.0, 1.0);
+    for (size_t k = 1; k <= half / 2; k++) {
+        size_t mirror = half - k;
+        std::complex<double> xk = bins[k];
+        std::complex<double> xm = bins[mirror];
+
+        std::complex<double> evenK = 0.5 * (xk + std::conj(xm));
+        std::complex<double> oddK = 0.5 * (xk - std::conj(xm)) * std::conj(splitTwiddles_[k]);
+        std::complex<double> evenM = 0.5 * (xm + std::conj(xk));
+        std::complex<double> oddM = 0.5 * (xm - std::conj(xk)) * std::conj(splitTwiddles_[mirror]);
+
+        bins[k] = evenK + i * oddK;
+        bins[mirror] = evenM + i * oddM;
+    }
+    half_.run(bins, true);
+
+    double scale = 1.0 / static_cast<double>(half);
+    for (size_t k = 0; k < half; k++) {
+        output[2 * k] = bins[k].real() * scale;
+        output[2 * k + 1] = bins[k].imag() * scale;
+    }
+}
+
+void FftPlan::forwardBluestein(const double* input, std::complex<double>* output) const {
+    size_t convSize = conv_.size;
+    std::complex<double>* work = bluesteinWork(convSize).data();
+
+    for (size_t k = 0; k < size_; k++) {
+        work[k] = input[k] * chirp_[k];
+    }
+    std::fill(work + size_, work + convSize, std::complex<double>(0.0, 0.0));
+
+    conv_.run(work, false);
+    for (size_t k = 0; k < convSize; k++) {
+        work[k] *= chirpSpectrum_[k];
+    }
+    conv_.run(work, true);
+
+    double scale = 1.0 / static_cast<double>(convSize);
+    size_t bins = numBins();
+    for (size_t k = 0; k < bins; k++) {
+        output[k] = work[k] * chirp_[k] * scale;
+    }
+}
+
+std::shared_ptr<const FftPlan> FftPlan::forSize(size_t size) {
+    static std::mutex cacheMutex;
+    static std::map<size_t, std::shared_ptr<const FftPlan>> pow2Plans;
+    static std::list<std::shared_ptr<const FftPlan>> oddPlans; // most recently used first
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    // At most one power-of-two plan per bit of size_t: kept for good
+    if (isPowerOfTwo(size)) {
+        auto it = pow2Plans.find(size);
+        if (it != pow2Plans.end()) return it->second;
+        auto plan = std::make_shared<const FftPlan>(size);
+        pow2Plans.emplace(size, plan);
+        return plan;
+    }
+
+    for (auto it = oddPlans.begin(); it != oddPlans.end(); ++it) {
+        if ((*it)->size() != size) continue;
+        oddPlans.splice(oddPlans.begin(), oddPlans, it);
+        return oddPlans.front();
+    }
+
+    // Holders of an evicted plan keep it alive; the cache just forgets it
+    auto plan = std::make_shared<const FftPlan>(size);
+    oddPlans.push_front(plan);
+    if (oddPlans.size() > kMaxCachedOddPlans) oddPlans.pop_back();
+    return plan;
+}
+
+} // namespace TajweedAudio
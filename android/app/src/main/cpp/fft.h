@@ -0,0 +1,68 @@
+#ifndef TAJWEED_FFT_H
+#define TAJWEED_FFT_H
+
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Precomputed state for a forward real-input FFT of one fixed size.
+//
+// Power-of-two sizes run as a half-length complex radix-2 FFT followed by a
+// real-to-complex split; any other size falls back to Bluestein's chirp-z
+// algorithm on a power-of-two convolution, so every size is O(n log n).
+// A plan is immutable once built and can be shared freely between threads;
+// the Bluestein path convolves in a per-thread buffer, so after a thread's
+// first transform of the largest size it does not allocate.
+class FftPlan {
+public:
+    explicit FftPlan(size_t size);
+
+    size_t size() const { return size_; }
+    size_t numBins() const { return size_ / 2 + 1; }
+
+    // Transforms size() real samples into numBins() complex bins (DC..Nyquist).
+    void forward(const double* input, std::complex<double>* output) const;
+
+    // Inverse of forward(), including the 1/size() scale: numBins() bins back
+    // into size() real samples. `bins` doubles as the work buffer and is
+    // overwritten. Power-of-two sizes only.
+    void inverse(std::complex<double>* bins, double* output) const;
+
+    // Returns the cached plan for a size, building it on first use.
+    // Power-of-two plans stay cached; other sizes are kept in a small LRU,
+    // since whole-signal transforms would otherwise pin one per length.
+    static std::shared_ptr<const FftPlan> forSize(size_t size);
+
+private:
+    // In-place iterative radix-2 complex FFT of a power-of-two length.
+    struct ComplexTransform {
+        size_t size = 0;
+        std::vector<size_t> bitReverse;
+        std::vector<std::complex<double>> twiddles;
+
+        void init(size_t n);
+        void run(std::complex<double>* data, bool inverse) const;
+    };
+
+    void forwardPow2(const double* input, std::complex<double>* output) const;
+    void forwardBluestein(const double* input, std::complex<double>* output) const;
+    void inversePow2(std::complex<double>* bins, double* output) const;
+
+    size_t size_;
+    bool isPow2_;
+    ComplexTransform half_;                          // n/2-point transform (power-of-two path)
+    std::vector<std::complex<double>> splitTwiddles_; // e^{-2*pi*i*k/n}, k < n/2
+    ComplexTransform conv_;                          // convolution transform (Bluestein path)
+    std::vector<std::complex<double>> chirp_;        // e^{-i*pi*k^2/n}
+    std::vector<std::complex<double>> chirpSpectrum_; // FFT of the conjugate chirp filter
+};
+
+bool isPowerOfTwo(size_t n);
+size_t nextPowerOfTwo(size_t n);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_FFT_H
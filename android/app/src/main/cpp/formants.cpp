@@ -0,0 +1,201 @@
+#include "formants.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Aberth iteration: stop once no root moves more than this, give up after kMaxIterations
+const double kRootTolerance = 1e-9;
+const double kRootAcceptance = 1e-6;
+const int kMaxIterations = 80;
+
+// Relative white-noise floor added to r[0], keeps the recursion stable on pure tones
+const double kNoiseFloor = 1e-9;
+
+// Slot targets with nothing to follow: a neutral (schwa-like) vowel
+const double kNeutralFormants[kNumFormants] = {500.0, 1500.0, 2500.0, 3500.0};
+
+// Tracking costs: log-frequency distance, plus this per kHz of bandwidth,
+// against this for leaving a slot empty
+const double kBandwidthCostPerKhz = 0.5;
+const double kMissCost = 1.0;
+
+} // namespace
+
+FormantAnalyzer::FormantAnalyzer(int sampleRate, const FormantConfig& config)
+    : sampleRate_(sampleRate), config_(config) {
+    if (sampleRate <= 0 || config.frameSize < 2 * kMaxLpcOrder) {
+        throw std::invalid_argument("Formant analyzer needs a positive sample rate and frame size");
+    }
+    order_ = config.order > 0 ? config.order : 2 + sampleRate / 1000;
+    order_ = std::max(2, std::min(order_, kMaxLpcOrder));
+    growScratch(emphasized_, static_cast<size_t>(config.frameSize), stats_);
+}
+
+void FormantAnalyzer::analyze(const double* windowed, FormantCandidates& out) {
+    out.count = 0;
+    size_t n = static_cast<size_t>(config_.frameSize);
+    int p = order_;
+
+    // Pre-emphasis, then the first p + 1 autocorrelation lags
+    double* x = emphasized_.data();
+    x[0] = windowed[0];
+    for (size_t i = 1; i < n; i++) x[i] = windowed[i] - config_.preEmphasis * windowed[i - 1];
+    for (int k = 0; k <= p; k++) {
+        double sum = 0.0;
+        for (size_t i = 0; i + k < n; i++) sum += x[i] * x[i + k];
+        autocorrelation_[k] = sum;
+    }
+    if (autocorrelation_[0] <= 1e-20) return;
+    autocorrelation_[0] *= 1.0 + kNoiseFloor;
+
+    if (!levinsonDurbin() || !findRoots()) return;
+
+    // Upper-half-plane poles are the resonances: angle gives the frequency,
+    // distance from the unit circle the bandwidth
+    double nyquist = sampleRate_ / 2.0;
+    for (int k = 0; k < p; k++) {
+        const std::complex<double>& z = roots_[k];
+        if (z.imag() <= 0.0) continue;
+        double radius = std::abs(z);
+        if (radius >= 1.0) continue;
+        double frequency = std::arg(z) * sampleRate_ / (2.0 * M_PI);
+        double bandwidth = -log(radius) * sampleRate_ / M_PI;
+        if (frequency < config_.minFrequency || frequency > nyquist - config_.minFrequency) continue;
+        if (bandwidth > config_.maxBandwidth) continue;
+
+        // Insertion into the sorted list, dropping the highest when full
+        size_t slot = out.count;
+        while (slot > 0 && out.frequency[slot - 1] > frequency) slot--;
+        if (slot >= kMaxFormantCandidates) continue;
+        size_t last = std::min<size_t>(out.count, kMaxFormantCandidates - 1);
+        for (size_t i = last; i > slot; i--) {
+            out.frequency[i] = out.frequency[i - 1];
+            out.bandwidth[i] = out.bandwidth[i - 1];
+        }
+        out.frequency[slot] = static_cast<float>(frequency);
+        out.bandwidth[slot] = static_cast<float>(bandwidth);
+        if (out.count < kMaxFormantCandidates) out.count++;
+    }
+}
+
+bool FormantAnalyzer::levinsonDurbin() {
+    const double* r = autocorrelation_;
+    double* a = lpc_;
+    double* previous = scratch_;
+    int p = order_;
+
+    std::fill(a, a + p + 1, 0.0);
+    a[0] = 1.0;
+    double error = r[0];
+    for (int i = 1; i <= p; i++) {
+        double acc = r[i];
+        for (int j = 1; j < i; j++) acc += a[j] * r[i - j];
+        double reflection = -acc / error;
+
+        std::copy(a, a + i, previous);
+        a[i] = reflection;
+        for (int j = 1; j < i; j++) a[j] = previous[j] + reflection * previous[i - j];
+
+        error *= 1.0 - reflection * reflection;
+        if (error <= 0.0) return false;
+    }
+    return true;
+}
+
+bool FormantAnalyzer::findRoots() {
+    const double* a = lpc_;
+    int p = order_;
+
+    // Starting points spread round a circle inside the unit circle, off the real axis
+    for (int k = 0; k < p; k++) {
+        roots_[k] = std::polar(0.9, 2.0 * M_PI * (k + 0.25) / p);
+    }
+
+    double maxStep = 0.0;
+    for (int iteration = 0; iteration < kMaxIterations; iteration++) {
+        maxStep = 0.0;
+        for (int k = 0; k < p; k++) {
+            std::complex<double> z = roots_[k];
+
+            // z^p + a1 z^(p-1) + ... + ap and its derivative by Horner's rule
+            std::complex<double> value(1.0, 0.0);
+            std::complex<double> derivative(0.0, 0.0);
+            for (int j = 1; j <= p; j++) {
+                derivative = derivative * z + value;
+                value = value * z + a[j];
+            }
+            if (value == 0.0) continue;
+
+            std::complex<double> repulsion(0.0, 0.0);
+            for (int j = 0; j < p; j++) {
+                if (j != k) repulsion += 1.0 / (z - roots_[j]);
+            }
+            std::complex<double> ratio = value / derivative;
+            std::complex<double> step = ratio / (1.0 - ratio * repulsion);
+            if (!std::isfinite(step.real()) || !std::isfinite(step.imag())) return false;
+            roots_[k] = z - step;
+            maxStep = std::max(maxStep, std::abs(step));
+        }
+        if (maxStep < kRootTolerance) return true;
+    }
+    return maxStep < kRootAcceptance;
+}
+
+void FormantTracker::reset() {
+    gap_ = 0;
+    tracking_ = false;
+    std::fill(previous_, previous_ + kNumFormants, 0.0);
+}
+
+void FormantTracker::next(const FormantCandidates& candidates, float* formants) {
+    std::fill(formants, formants + kNumFormants, 0.0f);
+    size_t n = candidates.count;
+    if (n == 0) {
+        if (++gap_ > maxGapFrames_) tracking_ = false;
+        return;
+    }
+
+    double target[kNumFormants];
+    for (size_t k = 0; k < kNumFormants; k++) {
+        target[k] = tracking_ && previous_[k] > 0.0 ? previous_[k] : kNeutralFormants[k];
+    }
+
+    // best[k][i]: cheapest way to fill slots k.. from candidates i.., each
+    // slot either empty or taking a higher candidate than the slot before
+    double best[kNumFormants + 1][kMaxFormantCandidates + 1];
+    uint8_t choice[kNumFormants][kMaxFormantCandidates + 1];
+    for (size_t i = 0; i <= n; i++) best[kNumFormants][i] = 0.0;
+    for (size_t k = kNumFormants; k-- > 0;) {
+        for (size_t i = n + 1; i-- > 0;) {
+            double cost = kMissCost + best[k + 1][i];
+            uint8_t picked = kMaxFormantCandidates;
+            for (size_t j = i; j < n; j++) {
+                double distance = fabs(log(candidates.frequency[j] / target[k]));
+                double total = distance + kBandwidthCostPerKhz * candidates.bandwidth[j] / 1000.0 + best[k + 1][j + 1];
+                if (total < cost) {
+                    cost = total;
+                    picked = static_cast<uint8_t>(j);
+                }
+            }
+            best[k][i] = cost;
+            choice[k][i] = picked;
+        }
+    }
+
+    size_t i = 0;
+    for (size_t k = 0; k < kNumFormants; k++) {
+        uint8_t picked = choice[k][i];
+        if (picked == kMaxFormantCandidates) continue;
+        formants[k] = candidates.frequency[picked];
+        previous_[k] = candidates.frequency[picked];
+        i = picked + 1u;
+    }
+    tracking_ = true;
+    gap_ = 0;
+}
+
+} // namespace TajweedAudio
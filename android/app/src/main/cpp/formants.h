@@ -0,0 +1,88 @@
+#ifndef TAJWEED_FORMANTS_H
+#define TAJWEED_FORMANTS_H
+
+#include "scratch.h"
+#include "spectral.h"
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Formants reported per frame (F1..F4) and LPC resonances kept per frame
+const size_t kNumFormants = 4;
+const size_t kMaxFormantCandidates = 8;
+const int kMaxLpcOrder = 24;
+
+struct FormantConfig {
+    int frameSize = kFrameSize;
+    int order = 0;                  // LPC order; 0 picks 2 + sampleRate / 1000, capped at kMaxLpcOrder
+    double preEmphasis = 0.97;      // first-order high-pass ahead of LPC, lifts the upper formants
+    double minFrequency = 90.0;     // resonances below this are glottal, not vocal tract
+    double maxBandwidth = 600.0;    // wider poles shape the spectral tilt, they are not formants
+};
+
+// Vocal tract resonances of one frame, sorted by frequency; count == 0 for
+// frames that were not analyzed (unvoiced or silent)
+struct FormantCandidates {
+    uint8_t count = 0;
+    float frequency[kMaxFormantCandidates];  // Hz
+    float bandwidth[kMaxFormantCandidates];  // Hz
+};
+
+// LPC formant analysis of one frame: pre-emphasis, autocorrelation,
+// Levinson-Durbin, then the roots of the predictor polynomial (Aberth
+// iteration). Scratch is owned by the analyzer, so a frame never allocates.
+class FormantAnalyzer {
+public:
+    FormantAnalyzer(int sampleRate, const FormantConfig& config = FormantConfig());
+
+    // `windowed` holds config.frameSize samples already tapered by the
+    // analysis window, e.g. the STFT's windowed frame
+    void analyze(const double* windowed, FormantCandidates& out);
+
+    // Predictor coefficients of the last analyzed frame, a[0] = 1
+    const double* lpc() const { return lpc_; }
+    int order() const { return order_; }
+
+    int sampleRate() const { return sampleRate_; }
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    bool levinsonDurbin();
+    bool findRoots();
+
+    int sampleRate_;
+    FormantConfig config_;
+    int order_;
+    std::vector<double> emphasized_;
+    double autocorrelation_[kMaxLpcOrder + 1];
+    double lpc_[kMaxLpcOrder + 1];
+    double scratch_[kMaxLpcOrder + 1];
+    std::complex<double> roots_[kMaxLpcOrder];
+    AllocationStats stats_;
+};
+
+// Assigns candidates to F1..F4 frame by frame. Each slot takes the
+// candidate closest (on a log scale) to its value in the previous analyzed
+// frame, or to a neutral vowel after a long gap, with slots kept in
+// frequency order and sharp resonances preferred. Unfilled slots are 0.
+class FormantTracker {
+public:
+    // Frames without candidates longer than this break the track
+    explicit FormantTracker(size_t maxGapFrames = 6) : maxGapFrames_(maxGapFrames) { reset(); }
+
+    void reset();
+    void next(const FormantCandidates& candidates, float* formants);
+
+private:
+    size_t maxGapFrames_;
+    size_t gap_;
+    bool tracking_;
+    double previous_[kNumFormants];
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_FORMANTS_H
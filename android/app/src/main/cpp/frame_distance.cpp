@@ -0,0 +1,117 @@
+#include "frame_distance.h"
+#include <cmath>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TAJWEED_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TAJWEED_SSE2 1
+#endif
+
+namespace TajweedAudio {
+
+namespace {
+
+#if defined(TAJWEED_NEON)
+inline float horizontalSum(float32x4_t v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    float32x2_t pair = vadd_f32(vget_low_f32(v), vget_high_f32(v));
+    return vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+}
+#elif defined(TAJWEED_SSE2)
+inline float horizontalSum(__m128 v) {
+    __m128 shuffled = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(v, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+    return _mm_cvtss_f32(sums);
+}
+#endif
+
+} // namespace
+
+float squaredEuclideanDistance(const float* a, const float* b, size_t dims) {
+    size_t i = 0;
+    float sum = 0.0f;
+
+#if defined(TAJWEED_NEON)
+    float32x4_t acc = vdupq_n_f32(0.0f);
+    for (; i + 4 <= dims; i += 4) {
+        float32x4_t diff = vsubq_f32(vld1q_f32(a + i), vld1q_f32(b + i));
+        acc = vmlaq_f32(acc, diff, diff);
+    }
+    sum = horizontalSum(acc);
+#elif defined(TAJWEED_SSE2)
+    __m128 acc = _mm_setzero_ps();
+    for (; i + 4 <= dims; i += 4) {
+        __m128 diff = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        acc = _mm_add_ps(acc, _mm_mul_ps(diff, diff));
+    }
+    sum = horizontalSum(acc);
+#endif
+
+    for (; i < dims; i++) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+float euclideanDistance(const float* a, const float* b, size_t dims) {
+    return sqrtf(squaredEuclideanDistance(a, b, dims));
+}
+
+float cosineDistance(const float* a, const float* b, size_t dims) {
+    size_t i = 0;
+    float dot = 0.0f, normA = 0.0f, normB = 0.0f;
+
+#if defined(TAJWEED_NEON)
+    float32x4_t accDot = vdupq_n_f32(0.0f);
+    float32x4_t accA = vdupq_n_f32(0.0f);
+    float32x4_t accB = vdupq_n_f32(0.0f);
+    for (; i + 4 <= dims; i += 4) {
+        float32x4_t va = vld1q_f32(a + i);
+        float32x4_t vb = vld1q_f32(b + i);
+        accDot = vmlaq_f32(accDot, va, vb);
+        accA = vmlaq_f32(accA, va, va);
+        accB = vmlaq_f32(accB, vb, vb);
+    }
+    dot = horizontalSum(accDot);
+    normA = horizontalSum(accA);
+    normB = horizontalSum(accB);
+#elif defined(TAJWEED_SSE2)
+    __m128 accDot = _mm_setzero_ps();
+    __m128 accA = _mm_setzero_ps();
+    __m128 accB = _mm_setzero_ps();
+    for (; i + 4 <= dims; i += 4) {
+        __m128 va = _mm_loadu_ps(a + i);
+        __m128 vb = _mm_loadu_ps(b + i);
+        accDot = _mm_add_ps(accDot, _mm_mul_ps(va, vb));
+        accA = _mm_add_ps(accA, _mm_mul_ps(va, va));
+        accB = _mm_add_ps(accB, _mm_mul_ps(vb, vb));
+    }
+    dot = horizontalSum(accDot);
+    normA = horizontalSum(accA);
+    normB = horizontalSum(accB);
+#endif
+
+    for (; i < dims; i++) {
+        dot += a[i] * b[i];
+        normA += a[i] * a[i];
+        normB += b[i] * b[i];
+    }
+
+    float denom = sqrtf(normA * normB);
+    if (denom <= 0.0f) return normA == normB ? 0.0f : 1.0f;
+    return 1.0f - dot / denom;
+}
+
+float frameDistance(FrameMetric metric, const float* a, const float* b, size_t dims) {
+    return metric == FrameMetric::Cosine ? cosineDistance(a, b, dims) : euclideanDistance(a, b, dims);
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,22 @@
+#ifndef TAJWEED_FRAME_DISTANCE_H
+#define TAJWEED_FRAME_DISTANCE_H
+
+#include <cstddef>
+
+namespace TajweedAudio {
+
+enum class FrameMetric {
+    Euclidean,
+    Cosine  // 1 - cosine similarity
+};
+
+// Vectorized (NEON / SSE2, scalar fallback) distances between two feature
+// frames of `dims` floats. Any dims works; multiples of 4 avoid the tail loop.
+float squaredEuclideanDistance(const float* a, const float* b, size_t dims);
+float euclideanDistance(const float* a, const float* b, size_t dims);
+float cosineDistance(const float* a, const float* b, size_t dims);
+float frameDistance(FrameMetric metric, const float* a, const float* b, size_t dims);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_FRAME_DISTANCE_H
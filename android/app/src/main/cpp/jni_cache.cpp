@@ -0,0 +1,148 @@
+#include "jni_cache.h"
+
+namespace {
+
+JniCache gCache = {};
+
+jclass globalClass(JNIEnv *env, const char *name) {
+    jclass local = env->FindClass(name);
+    if (!local) return nullptr;
+    jclass global = static_cast<jclass>(env->NewGlobalRef(local));
+    env->DeleteLocalRef(local);
+    return global;
+}
+
+} // namespace
+
+bool jni_cache_init(JNIEnv *env) {
+    JniCache cache = {};
+
+    cache.mapClass = globalClass(env, "com/facebook/react/bridge/WritableNativeMap");
+    cache.arrayClass = globalClass(env, "com/facebook/react/bridge/WritableNativeArray");
+    cache.readableMapClass = globalClass(env, "com/facebook/react/bridge/ReadableMap");
+    cache.moduleClass = globalClass(env, "com/tajweedtutor/TajweedAudioModule");
+    if (!cache.mapClass || !cache.arrayClass || !cache.readableMapClass || !cache.moduleClass) return false;
+
+    cache.mapInit = env->GetMethodID(cache.mapClass, "<init>", "()V");
+    cache.mapPutDouble = env->GetMethodID(cache.mapClass, "putDouble", "(Ljava/lang/String;D)V");
+    cache.mapPutInt = env->GetMethodID(cache.mapClass, "putInt", "(Ljava/lang/String;I)V");
+    cache.mapPutBoolean = env->GetMethodID(cache.mapClass, "putBoolean", "(Ljava/lang/String;Z)V");
+    cache.mapPutString = env->GetMethodID(cache.mapClass, "putString", "(Ljava/lang/String;Ljava/lang/String;)V");
+    cache.mapPutArray = env->GetMethodID(cache.mapClass, "putArray",
+                                         "(Ljava/lang/String;Lcom/facebook/react/bridge/ReadableArray;)V");
+    cache.mapPutMap = env->GetMethodID(cache.mapClass, "putMap",
+                                       "(Ljava/lang/String;Lcom/facebook/react/bridge/ReadableMap;)V");
+    cache.arrayInit = env->GetMethodID(cache.arrayClass, "<init>", "()V");
+    cache.arrayPushString = env->GetMethodID(cache.arrayClass, "pushString", "(Ljava/lang/String;)V");
+    cache.arrayPushMap = env->GetMethodID(cache.arrayClass, "pushMap", "(Lcom/facebook/react/bridge/ReadableMap;)V");
+    cache.readableMapHasKey = env->GetMethodID(cache.readableMapClass, "hasKey", "(Ljava/lang/String;)Z");
+    cache.readableMapGetBoolean = env->GetMethodID(cache.readableMapClass, "getBoolean", "(Ljava/lang/String;)Z");
+    cache.moduleOnJobEvent = env->GetMethodID(cache.moduleClass, "onJobEvent",
+                                              "(Ljava/lang/String;Lcom/facebook/react/bridge/WritableMap;)V");
+
+    if (!cache.mapInit || !cache.mapPutDouble || !cache.mapPutInt || !cache.mapPutBoolean ||
+        !cache.mapPutString || !cache.mapPutArray || !cache.mapPutMap ||
+        !cache.arrayInit || !cache.arrayPushString || !cache.arrayPushMap ||
+        !cache.readableMapHasKey || !cache.readableMapGetBoolean || !cache.moduleOnJobEvent) {
+        return false;
+    }
+
+    gCache = cache;
+    return true;
+}
+
+const JniCache& jni_cache() {
+    return gCache;
+}
+
+jobject jni_new_map(JNIEnv *env) {
+    return env->NewObject(gCache.mapClass, gCache.mapInit);
+}
+
+void jni_put_double(JNIEnv *env, jobject map, const char *key, double value) {
+    jstring jkey = env->NewStringUTF(key);
+    env->CallVoidMethod(map, gCache.mapPutDouble, jkey, value);
+    env->DeleteLocalRef(jkey);
+}
+
+void jni_put_int(JNIEnv *env, jobject map, const char *key, int value) {
+    jstring jkey = env->NewStringUTF(key);
+    env->CallVoidMethod(map, gCache.mapPutInt, jkey, static_cast<jint>(value));
+    env->DeleteLocalRef(jkey);
+}
+
+void jni_put_boolean(JNIEnv *env, jobject map, const char *key, bool value) {
+    jstring jkey = env->NewStringUTF(key);
+    env->CallVoidMethod(map, gCache.mapPutBoolean, jkey, static_cast<jboolean>(value ? JNI_TRUE : JNI_FALSE));
+    env->DeleteLocalRef(jkey);
+}
+
+void jni_put_string(JNIEnv *env, jobject map, const char *key, const std::string& value) {
+    jstring jkey = env->NewStringUTF(key);
+    jstring jvalue = env->NewStringUTF(value.c_str());
+    env->CallVoidMethod(map, gCache.mapPutString, jkey, jvalue);
+    env->DeleteLocalRef(jvalue);
+    env->DeleteLocalRef(jkey);
+}
+
+void jni_put_string_list(JNIEnv *env, jobject map, const char *key, const std::vector<std::string>& values) {
+    jobject array = env->NewObject(gCache.arrayClass, gCache.arrayInit);
+    for (const std::string& value : values) {
+        jstring jvalue = env->NewStringUTF(value.c_str());
+        env->CallVoidMethod(array, gCache.arrayPushString, jvalue);
+        env->DeleteLocalRef(jvalue);
+    }
+
+    jstring jkey = env->NewStringUTF(key);
+    env->CallVoidMethod(map, gCache.mapPutArray, jkey, array);
+    env->DeleteLocalRef(jkey);
+    env->DeleteLocalRef(array);
+}
+
+void jni_put_double_map(JNIEnv *env, jobject map, const char *key, const std::map<std::string, double>& values) {
+    jobject inner = jni_new_map(env);
+    for (const auto& entry : values) {
+        jni_put_double(env, inner, entry.first.c_str(), entry.second);
+    }
+    jni_put_map(env, map, key, inner);
+}
+
+void jni_put_map(JNIEnv *env, jobject map, const char *key, jobject value) {
+    jstring jkey = env->NewStringUTF(key);
+    env->CallVoidMethod(map, gCache.mapPutMap, jkey, value);
+    env->DeleteLocalRef(jkey);
+    env->DeleteLocalRef(value);
+}
+
+void jni_put_array(JNIEnv *env, jobject map, const char *key, jobject value) {
+    jstring jkey = env->NewStringUTF(key);
+    env->CallVoidMethod(map, gCache.mapPutArray, jkey, value);
+    env->DeleteLocalRef(jkey);
+    env->DeleteLocalRef(value);
+}
+
+jobject jni_new_array(JNIEnv *env) {
+    return env->NewObject(gCache.arrayClass, gCache.arrayInit);
+}
+
+void jni_push_map(JNIEnv *env, jobject array, jobject value) {
+    env->CallVoidMethod(array, gCache.arrayPushMap, value);
+    env->DeleteLocalRef(value);
+}
+
+bool jni_get_flag(JNIEnv *env, jobject map, const char *key, bool fallback) {
+    if (!map) return fallback;
+    jstring jkey = env->NewStringUTF(key);
+    bool result = fallback;
+    if (env->CallBooleanMethod(map, gCache.readableMapHasKey, jkey)) {
+        // getBoolean throws on null or non-boolean values
+        jboolean value = env->CallBooleanMethod(map, gCache.readableMapGetBoolean, jkey);
+        if (env->ExceptionCheck()) {
+            env->ExceptionClear();
+        } else {
+            result = value == JNI_TRUE;
+        }
+    }
+    env->DeleteLocalRef(jkey);
+    return result;
+}
@@ -0,0 +1,60 @@
+#ifndef TAJWEED_JNI_CACHE_H
+#define TAJWEED_JNI_CACHE_H
+
+#include <jni.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// Classes and method IDs resolved once in JNI_OnLoad. Results are written
+// straight into React Native's WritableNativeMap/WritableNativeArray, so
+// numbers cross as primitives instead of boxed java.lang.Double objects.
+struct JniCache {
+    jclass mapClass;             // com.facebook.react.bridge.WritableNativeMap (global ref)
+    jmethodID mapInit;
+    jmethodID mapPutDouble;
+    jmethodID mapPutInt;
+    jmethodID mapPutBoolean;
+    jmethodID mapPutString;
+    jmethodID mapPutArray;
+    jmethodID mapPutMap;
+
+    jclass arrayClass;           // com.facebook.react.bridge.WritableNativeArray (global ref)
+    jmethodID arrayInit;
+    jmethodID arrayPushString;
+    jmethodID arrayPushMap;
+
+    jclass readableMapClass;     // com.facebook.react.bridge.ReadableMap (global ref)
+    jmethodID readableMapHasKey;
+    jmethodID readableMapGetBoolean;
+
+    jclass moduleClass;          // com.tajweedtutor.TajweedAudioModule (global ref)
+    jmethodID moduleOnJobEvent;  // void onJobEvent(String eventName, WritableMap params)
+};
+
+// Fills the cache; must run while the app class loader is current (JNI_OnLoad)
+bool jni_cache_init(JNIEnv *env);
+const JniCache& jni_cache();
+
+// Map builders. Every local reference they create is released before returning.
+jobject jni_new_map(JNIEnv *env);
+void jni_put_double(JNIEnv *env, jobject map, const char *key, double value);
+void jni_put_int(JNIEnv *env, jobject map, const char *key, int value);
+void jni_put_boolean(JNIEnv *env, jobject map, const char *key, bool value);
+void jni_put_string(JNIEnv *env, jobject map, const char *key, const std::string& value);
+void jni_put_string_list(JNIEnv *env, jobject map, const char *key, const std::vector<std::string>& values);
+void jni_put_double_map(JNIEnv *env, jobject map, const char *key, const std::map<std::string, double>& values);
+
+// Stores `value` under `key` and releases the local reference to it
+void jni_put_map(JNIEnv *env, jobject map, const char *key, jobject value);
+void jni_put_array(JNIEnv *env, jobject map, const char *key, jobject value);
+
+// Array builders; jni_push_map releases the local reference to `value`
+jobject jni_new_array(JNIEnv *env);
+void jni_push_map(JNIEnv *env, jobject array, jobject value);
+
+// Boolean entry of a ReadableMap argument; a null map, a missing key or a
+// value of another type gives `fallback`
+bool jni_get_flag(JNIEnv *env, jobject map, const char *key, bool fallback);
+
+#endif // TAJWEED_JNI_CACHE_H
@@ -0,0 +1,183 @@
+#include "jobs.h"
+#include "log.h"
+#include "workspace.h"
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace TajweedAudio {
+
+const char* jobStateName(JobState state) {
+    switch (state) {
+        case JobState::Queued: return "queued";
+        case JobState::Running: return "running";
+        case JobState::Done: return "done";
+        case JobState::Cancelled: return "cancelled";
+        case JobState::Failed: return "failed";
+    }
+    return "unknown";
+}
+
+JobControl::JobControl(uint64_t id, const std::string& key, JobProgress progress)
+    : id_(id), key_(key), onProgress_(std::move(progress)) {}
+
+void JobControl::advance(size_t units) {
+    done_.fetch_add(units, std::memory_order_relaxed);
+    if (!onProgress_) return;
+
+    // Crossing a step is rare; the lock keeps reports in order when two
+    // frame blocks cross steps at once
+    if (static_cast<int>(progress() / kJobProgressStep) <= reportedSteps_.load(std::memory_order_relaxed)) return;
+    std::lock_guard<std::mutex> lock(progressMutex_);
+    int steps = static_cast<int>(progress() / kJobProgressStep);
+    if (steps <= reportedSteps_.load(std::memory_order_relaxed)) return;
+    reportedSteps_.store(steps, std::memory_order_relaxed);
+    onProgress_(*this, steps * kJobProgressStep);
+}
+
+double JobControl::progress() const {
+    size_t total = total_.load(std::memory_order_relaxed);
+    size_t done = done_.load(std::memory_order_relaxed);
+    return total > 0 ? std::min(1.0, static_cast<double>(done) / total) : 0.0;
+}
+
+JobScheduler::JobScheduler() : thread_(&JobScheduler::run, this) {}
+
+JobScheduler::~JobScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+        for (Job& job : queue_) job.control->cancel();
+        if (running_) running_->cancel();
+    }
+    wake_.notify_all();
+    thread_.join();
+}
+
+JobScheduler& JobScheduler::shared() {
+    static JobScheduler scheduler;
+    return scheduler;
+}
+
+uint64_t JobScheduler::submit(const std::string& key, JobWork work, JobDone done, JobProgress progress) {
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = nextId_++;
+        if (!key.empty()) {
+            for (Job& job : queue_) {
+                if (job.control->key() == key) job.control->cancel();
+            }
+            if (running_ && running_->key() == key) running_->cancel();
+        }
+        Job job;
+        job.control = std::make_shared<JobControl>(id, key, std::move(progress));
+        job.work = std::move(work);
+        job.done = std::move(done);
+        queue_.push_back(std::move(job));
+    }
+    wake_.notify_all();
+    return id;
+}
+
+bool JobScheduler::cancel(uint64_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_ && running_->id() == id) {
+        running_->cancel();
+        return true;
+    }
+    for (Job& job : queue_) {
+        if (job.control->id() == id) {
+            job.control->cancel();
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t JobScheduler::cancelAll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = queue_.size();
+    for (Job& job : queue_) job.control->cancel();
+    if (running_) {
+        running_->cancel();
+        count++;
+    }
+    return count;
+}
+
+void JobScheduler::wait(uint64_t id) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [&] { return reported_ >= id || id >= nextId_; });
+}
+
+size_t JobScheduler::pending() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + (running_ ? 1 : 0);
+}
+
+void JobScheduler::run() {
+#if defined(__linux__)
+    pthread_setname_np(pthread_self(), "tajweed-jobs");
+#endif
+
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) return;
+            job = std::move(queue_.front());
+            queue_.pop_front();
+            running_ = job.control;
+        }
+
+        // Jobs cancelled while queued are reported without running
+        JobState state = JobState::Cancelled;
+        std::string error;
+        if (!job.control->cancelled()) {
+            try {
+                job.work(*job.control);
+                state = job.control->cancelled() ? JobState::Cancelled : JobState::Done;
+            } catch (const std::exception& e) {
+                state = JobState::Failed;
+                error = e.what();
+            } catch (...) {
+                state = JobState::Failed;
+                error = "unknown error";
+            }
+        }
+        if (state == JobState::Failed) {
+            LOGE("Job %llu failed: %s", static_cast<unsigned long long>(job.control->id()), error.c_str());
+        }
+
+        if (job.done) {
+            try {
+                job.done(*job.control, state, error);
+            } catch (...) {
+                LOGE("Job %llu: completion callback threw", static_cast<unsigned long long>(job.control->id()));
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_.reset();
+            reported_ = job.control->id();
+        }
+        finished_.notify_all();
+    }
+}
+
+JobBinding::JobBinding(FeatureWorkspace& workspace, JobControl& job) : workspace_(workspace) {
+    workspace_.job = &job;
+}
+
+JobBinding::~JobBinding() {
+    workspace_.job = nullptr;
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,133 @@
+#ifndef TAJWEED_JOBS_H
+#define TAJWEED_JOBS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace TajweedAudio {
+
+class FeatureWorkspace;
+
+enum class JobState {
+    Queued = 0,
+    Running,
+    Done,
+    Cancelled,
+    Failed
+};
+
+const char* jobStateName(JobState state);
+
+class JobControl;
+typedef std::function<void(JobControl& job)> JobWork;
+// Called once per job on the scheduler thread, whatever the outcome
+typedef std::function<void(const JobControl& job, JobState state, const std::string& error)> JobDone;
+// Called from whichever thread advanced the job, at most once per kJobProgressStep
+typedef std::function<void(const JobControl& job, double progress)> JobProgress;
+
+const double kJobProgressStep = 0.05;
+
+// Cancellation flag and progress of one job. Work checks cancelled() at its
+// checkpoints (between frame blocks, between stages) and returns early; it
+// counts what it has to do with addWork() and what it did with advance().
+class JobControl {
+public:
+    JobControl(uint64_t id, const std::string& key, JobProgress progress);
+
+    uint64_t id() const { return id_; }
+    const std::string& key() const { return key_; }
+
+    bool cancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+    void cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+    // Units are whatever the work counts, typically frames. Work added late
+    // never makes the reported progress go back.
+    void addWork(size_t units) { total_.fetch_add(units, std::memory_order_relaxed); }
+    void advance(size_t units);
+    double progress() const;
+
+private:
+    uint64_t id_;
+    std::string key_;
+    JobProgress onProgress_;
+    std::atomic<bool> cancelled_{false};
+    std::atomic<size_t> total_{0};
+    std::atomic<size_t> done_{0};
+    std::atomic<int> reportedSteps_{0};
+    std::mutex progressMutex_;
+};
+
+// Runs analysis jobs one after another on a scheduler thread; the work
+// itself fans its frame blocks out onto the ThreadPool as usual. A job
+// submitted under a non-empty key cancels every earlier job with that key,
+// queued or running, so a re-recorded segment only pays for its latest take.
+class JobScheduler {
+public:
+    JobScheduler();
+    // Cancels every job and reports it before the thread exits
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    // Process-wide scheduler used by the JNI entry points
+    static JobScheduler& shared();
+
+    uint64_t submit(const std::string& key, JobWork work, JobDone done, JobProgress progress = JobProgress());
+
+    // False when the job is unknown or already finished
+    bool cancel(uint64_t id);
+    size_t cancelAll();
+
+    // Blocks until the job's done callback has returned
+    void wait(uint64_t id);
+
+    // Jobs submitted and not yet reported
+    size_t pending() const;
+
+private:
+    struct Job {
+        std::shared_ptr<JobControl> control;
+        JobWork work;
+        JobDone done;
+    };
+
+    void run();
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_;
+    std::deque<Job> queue_;
+    std::shared_ptr<JobControl> running_;
+    uint64_t nextId_ = 1;
+    uint64_t reported_ = 0;           // jobs run in id order, so every id up to this one is reported
+    bool stopping_ = false;
+    std::thread thread_;
+};
+
+// Points a workspace's cancellation checkpoints and progress at `job` for
+// the binding's lifetime
+class JobBinding {
+public:
+    JobBinding(FeatureWorkspace& workspace, JobControl& job);
+    ~JobBinding();
+
+    JobBinding(const JobBinding&) = delete;
+    JobBinding& operator=(const JobBinding&) = delete;
+
+private:
+    FeatureWorkspace& workspace_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_JOBS_H
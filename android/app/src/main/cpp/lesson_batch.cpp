@@ -0,0 +1,293 @@
+#include "lesson_batch.h"
+#include "audio_analysis.h"
+#include "feature_store.h"
+#include "wav_file.h"
+#include <chrono>
+#include <map>
+#include <memory>
+
+namespace TajweedAudio {
+
+const char* const kBatchRules[kBatchRuleCount] = {"madd", "makharij", "ghunna", "qalqalah"};
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+double elapsedMs(Clock::time_point since) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - since).count();
+}
+
+// A distinct reference and the workspace holding its features
+struct ReferenceSlot {
+    std::string path;
+    FeatureWorkspace workspace;
+    std::shared_ptr<const AudioFeatures> cached;  // set when the features came from, or went to, the cache
+    const AudioFeatures* features = nullptr;
+    bool needed = true;                           // some segment is not answered by the cache
+    bool keyed = false;
+    uint64_t key = 0;
+    bool loaded = false;
+    bool fromStore = false;
+    double ms = 0.0;
+};
+
+// A reference is its bundle when one has been built, else its file; the
+// key covers both, so rebuilding either invalidates what was cached
+bool referenceKey(const AnalysisCache& cache, const std::string& path, uint64_t& key) {
+    uint64_t bundleKey = 0, fileKey = 0;
+    bool bundled = cache.fileKey(FeatureStore::instance().pathFor(path), bundleKey);
+    bool onDisk = cache.fileKey(path, fileKey);
+    key = fnv1a(&fileKey, sizeof(fileKey), fnv1a(&bundleKey, sizeof(bundleKey)));
+    return bundled || onDisk;
+}
+
+void loadReference(ReferenceSlot& slot, AnalysisCache* cache) {
+    Clock::time_point start = Clock::now();
+    AudioFeatures& features = slot.workspace.features;
+
+    try {
+        // A prebuilt bundle is mapped, whether extracted from a WAV file or
+        // streamed from compressed audio; only unbundled references are decoded
+        std::string error;
+        std::shared_ptr<const FeatureBundle> bundle = FeatureStore::instance().open(
+            slot.path, {extractionConfigHash(slot.workspace), streamingConfigHash(slot.workspace)}, error);
+        if (bundle) {
+            bundle->features(features);
+            slot.features = &features;
+            slot.fromStore = true;
+            slot.loaded = true;
+        } else if (cache && slot.keyed) {
+            bool hit;
+            slot.cached = cachedFeatures(*cache, slot.path, slot.key, slot.workspace, hit);
+            slot.features = slot.cached.get();
+            slot.loaded = slot.cached != nullptr;
+        } else {
+            WavFile audio;
+            if (audio.open(slot.path)) {
+                extractFeatures(audio, slot.workspace, features);
+                slot.features = &features;
+                slot.loaded = true;
+            }
+        }
+    } catch (const std::exception&) {
+        slot.loaded = false;
+    }
+
+    slot.ms = elapsedMs(start);
+}
+
+// The user's take of one segment
+struct UserSlot {
+    FeatureWorkspace workspace;
+    std::shared_ptr<const AudioFeatures> cached;
+    const AudioFeatures* features = nullptr;
+    bool keyed = false;
+    uint64_t key = 0;
+    bool fromCache = false;
+};
+
+void extractUser(const std::string& path, UserSlot& user, AnalysisCache* cache, BatchSegmentResult& result) {
+    Clock::time_point start = Clock::now();
+
+    try {
+        if (cache && user.keyed) {
+            user.cached = cachedFeatures(*cache, path, user.key, user.workspace, user.fromCache);
+            user.features = user.cached.get();
+            result.status = user.features ? BatchStatus::Ok : BatchStatus::UserAudioFailed;
+        } else {
+            WavFile audio;
+            if (audio.open(path)) {
+                extractFeatures(audio, user.workspace, user.workspace.features);
+                user.features = &user.workspace.features;
+                result.status = BatchStatus::Ok;
+            } else {
+                result.status = BatchStatus::UserAudioFailed;
+            }
+        }
+    } catch (const std::exception&) {
+        result.status = BatchStatus::Error;
+    }
+
+    result.userMs = elapsedMs(start);
+}
+
+void applyComparison(const CachedComparison& comparison, BatchSegmentResult& result) {
+    const TajweedAnalysis& analysis = comparison.analysis;
+    result.similarity = comparison.similarity;
+    result.score = analysis.overallScore;
+    result.confidence = analysis.confidence;
+    for (size_t r = 0; r < kBatchRuleCount; r++) {
+        auto rule = analysis.ruleScores.find(kBatchRules[r]);
+        result.ruleScores[r] = rule != analysis.ruleScores.end() ? rule->second : 0.0;
+    }
+}
+
+std::shared_ptr<const CachedComparison> compareSegment(UserSlot& user, const AudioFeatures& reference,
+                                                       BatchSegmentResult& result) {
+    Clock::time_point start = Clock::now();
+    std::shared_ptr<CachedComparison> comparison;
+
+    try {
+        FeatureWorkspace& workspace = user.workspace;
+        const FeatureMatrix& frames = reference.frames;
+        performDTW(*user.features, frames.data(), frames.numFrames(), reference.sampleRate,
+                   DTWOptions(), workspace, workspace.comparison);
+
+        comparison = std::make_shared<CachedComparison>();
+        comparison->similarity = workspace.comparison.similarity;
+        comparison->analysis = analyzeTajweedRules(*user.features, reference);
+        applyComparison(*comparison, result);
+    } catch (const std::exception&) {
+        result.status = BatchStatus::Error;
+        comparison.reset();
+    }
+
+    result.compareMs = elapsedMs(start);
+    return comparison;
+}
+
+} // namespace
+
+void analyzeLessonBatch(const std::vector<BatchSegment>& segments, std::vector<BatchSegmentResult>& results,
+                        BatchStats& stats, ThreadPool& pool, AnalysisCache* cache) {
+    Clock::time_point start = Clock::now();
+    size_t numSegments = segments.size();
+    results.assign(numSegments, BatchSegmentResult());
+    stats = BatchStats();
+    stats.segments = numSegments;
+
+    // Segments of a lesson often share a reference; load each one once
+    std::map<std::string, size_t> referenceIndex;
+    std::vector<std::unique_ptr<ReferenceSlot>> references;
+    std::vector<size_t> segmentReference(numSegments);
+    for (size_t i = 0; i < numSegments; i++) {
+        auto inserted = referenceIndex.insert(std::make_pair(segments[i].referencePath, references.size()));
+        if (inserted.second) {
+            references.emplace_back(new ReferenceSlot());
+            references.back()->path = segments[i].referencePath;
+            references.back()->workspace.setPool(&pool);
+            references.back()->workspace.resample.enabled = true;
+            references.back()->workspace.vad.enabled = true;
+        }
+        segmentReference[i] = inserted.first->second;
+    }
+
+    // Batch tasks nest on the pool, so each one gets its own workspace
+    // rather than the calling thread's
+    std::vector<std::unique_ptr<UserSlot>> users;
+    users.reserve(numSegments);
+    for (size_t i = 0; i < numSegments; i++) {
+        users.emplace_back(new UserSlot());
+        FeatureWorkspace& workspace = users.back()->workspace;
+        workspace.setPool(&pool);
+        workspace.resample.enabled = true;
+        workspace.preprocess.enabled = true;
+        workspace.vad.enabled = true;
+    }
+
+    // Unchanged pairs are answered before anything is loaded: a stat (or a
+    // hash) per file, then one lookup per segment
+    std::vector<bool> answered(numSegments, false);
+    uint64_t comparisonConfig = 0;
+    if (cache && numSegments > 0) {
+        comparisonConfig = comparisonConfigHash(extractionConfigHash(users[0]->workspace),
+                                                extractionConfigHash(references[0]->workspace), DTWOptions(),
+                                                "dtw+rules");
+        for (auto& reference : references) reference->keyed = referenceKey(*cache, reference->path, reference->key);
+        for (size_t i = 0; i < numSegments; i++) {
+            UserSlot& user = *users[i];
+            const ReferenceSlot& reference = *references[segmentReference[i]];
+            user.keyed = cache->fileKey(segments[i].userPath, user.key);
+            if (!user.keyed || !reference.keyed) continue;
+            std::shared_ptr<const CachedComparison> comparison =
+                cache->findComparison(user.key, reference.key, comparisonConfig);
+            if (comparison) {
+                results[i].status = BatchStatus::Ok;
+                applyComparison(*comparison, results[i]);
+                answered[i] = true;
+                stats.comparisonsFromCache++;
+            }
+        }
+        for (auto& reference : references) reference->needed = false;
+        for (size_t i = 0; i < numSegments; i++) {
+            if (!answered[i]) references[segmentReference[i]]->needed = true;
+        }
+    }
+
+    // Every extraction still needed at once, references first so they are
+    // ready earliest; frame blocks of each extraction fan out on the same pool
+    std::vector<size_t> tasks;
+    size_t numReferences = references.size();
+    for (size_t r = 0; r < numReferences; r++) {
+        if (references[r]->needed) tasks.push_back(r);
+    }
+    for (size_t i = 0; i < numSegments; i++) {
+        if (!answered[i]) tasks.push_back(numReferences + i);
+    }
+    parallelFor(pool, tasks.size(), 1, [&](size_t task, size_t) {
+        if (tasks[task] < numReferences) {
+            loadReference(*references[tasks[task]], cache);
+        } else {
+            size_t i = tasks[task] - numReferences;
+            extractUser(segments[i].userPath, *users[i], cache, results[i]);
+        }
+    });
+
+    parallelFor(pool, numSegments, 1, [&](size_t i, size_t) {
+        if (answered[i]) return;
+        BatchSegmentResult& result = results[i];
+        const ReferenceSlot& reference = *references[segmentReference[i]];
+        result.referenceMs = reference.ms;
+        if (result.status != BatchStatus::Ok) return;
+        if (!reference.loaded) {
+            result.status = BatchStatus::ReferenceFailed;
+            return;
+        }
+        UserSlot& user = *users[i];
+        std::shared_ptr<const CachedComparison> comparison = compareSegment(user, *reference.features, result);
+        if (cache && comparison && user.keyed && reference.keyed) {
+            cache->putComparison(user.key, reference.key, comparisonConfig, comparison);
+        }
+    });
+
+    stats.references = numReferences;
+    for (const auto& reference : references) {
+        if (reference->fromStore) stats.referencesFromStore++;
+    }
+    for (const auto& user : users) {
+        if (user->fromCache) stats.usersFromCache++;
+    }
+    stats.totalMs = elapsedMs(start);
+}
+
+size_t packedBatchSize(size_t numSegments) {
+    return kBatchHeaderSize + numSegments * kBatchRecordSize;
+}
+
+void packBatchResults(const std::vector<BatchSegmentResult>& results, const BatchStats& stats, double* out) {
+    out[0] = static_cast<double>(kBatchHeaderSize);
+    out[1] = static_cast<double>(kBatchRecordSize);
+    out[2] = static_cast<double>(stats.segments);
+    out[3] = static_cast<double>(stats.references);
+    out[4] = static_cast<double>(stats.referencesFromStore);
+    out[5] = stats.totalMs;
+    out[6] = static_cast<double>(stats.usersFromCache);
+    out[7] = static_cast<double>(stats.comparisonsFromCache);
+
+    double* record = out + kBatchHeaderSize;
+    for (const BatchSegmentResult& result : results) {
+        size_t k = 0;
+        record[k++] = static_cast<double>(static_cast<int>(result.status));
+        record[k++] = result.similarity;
+        record[k++] = result.score;
+        record[k++] = result.confidence;
+        for (size_t r = 0; r < kBatchRuleCount; r++) record[k++] = result.ruleScores[r];
+        record[k++] = result.userMs;
+        record[k++] = result.referenceMs;
+        record[k++] = result.compareMs;
+        record += kBatchRecordSize;
+    }
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,75 @@
+#ifndef TAJWEED_LESSON_BATCH_H
+#define TAJWEED_LESSON_BATCH_H
+
+#include "analysis_cache.h"
+#include "thread_pool.h"
+#include <string>
+#include <vector>
+
+namespace TajweedAudio {
+
+// One lesson segment: the user's recording and the reference it is scored
+// against. The reference path doubles as its FeatureStore bundle id, which
+// is how downloaded references are bundled.
+struct BatchSegment {
+    std::string userPath;
+    std::string referencePath;
+};
+
+enum class BatchStatus {
+    Ok = 0,
+    UserAudioFailed = 1,
+    ReferenceFailed = 2,
+    Error = 3
+};
+
+// Rule scores of a segment, in this order
+const size_t kBatchRuleCount = 4;
+extern const char* const kBatchRules[kBatchRuleCount];
+
+struct BatchSegmentResult {
+    BatchStatus status = BatchStatus::Error;
+    double similarity = 0.0;
+    double score = 0.0;                      // rule score (0-100), as analyzeTajweed reports it
+    double confidence = 0.0;
+    double ruleScores[kBatchRuleCount] = {};
+    double userMs = 0.0;                     // decoding and extracting the user recording
+    double referenceMs = 0.0;                // loading the reference, shared by every segment using it
+    double compareMs = 0.0;                  // DTW and rule analysis
+};
+
+struct BatchStats {
+    size_t segments = 0;
+    size_t references = 0;                   // distinct references in the batch
+    size_t referencesFromStore = 0;          // of those, mapped from a bundle instead of extracted
+    size_t usersFromCache = 0;               // user takes whose features came from the cache
+    size_t comparisonsFromCache = 0;         // segments whose scores came from the cache, unextracted
+    double totalMs = 0.0;
+};
+
+// Packed layout: kBatchHeaderSize values (header size, record size,
+// segments, references, references from store, total ms, users from cache,
+// comparisons from cache), then one record per segment: status, similarity,
+// score, confidence, rule scores, userMs, referenceMs, compareMs. Readers
+// take both sizes from the first two values.
+const size_t kBatchHeaderSize = 8;
+const size_t kBatchRecordSize = 4 + kBatchRuleCount + 3;
+
+// Scores every segment of a lesson in one go. Each distinct reference is
+// loaded once, from its bundle when one exists. All user and reference
+// extractions are scheduled on the pool together; alignment and rule
+// analysis follow once features are ready. A segment that fails does not
+// affect the others.
+//
+// With a cache, a segment whose take and reference are unchanged since they
+// were last scored is answered from it without loading either; a changed
+// take is re-extracted and scored against its reference's cached features.
+void analyzeLessonBatch(const std::vector<BatchSegment>& segments, std::vector<BatchSegmentResult>& results,
+                        BatchStats& stats, ThreadPool& pool = ThreadPool::shared(), AnalysisCache* cache = nullptr);
+
+size_t packedBatchSize(size_t numSegments);
+void packBatchResults(const std::vector<BatchSegmentResult>& results, const BatchStats& stats, double* out);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_LESSON_BATCH_H
@@ -0,0 +1,41 @@
+#include "log.h"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+namespace TajweedAudio {
+
+namespace {
+
+void stderrSink(LogLevel level, const char* tag, const char* message) {
+    static const char* const names[] = {"D", "I", "W", "E"};
+    fprintf(stderr, "%s/%s: %s\n", names[static_cast<int>(level)], tag, message);
+}
+
+std::atomic<LogSink> gSink{stderrSink};
+std::atomic<int> gMinLevel{static_cast<int>(LogLevel::Info)};
+
+} // namespace
+
+void setLogSink(LogSink sink) {
+    gSink = sink ? sink : stderrSink;
+}
+
+void setMinLogLevel(LogLevel level) {
+    gMinLevel = static_cast<int>(level);
+}
+
+void logMessage(LogLevel level, const char* tag, const char* format, ...) {
+    if (static_cast<int>(level) < gMinLevel) return;
+
+    // Long messages are truncated rather than allocated for
+    char message[1024];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    gSink.load()(level, tag, message);
+}
+
+} // namespace TajweedAudio
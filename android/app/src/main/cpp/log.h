@@ -0,0 +1,40 @@
+#ifndef TAJWEED_LOG_H
+#define TAJWEED_LOG_H
+
+namespace TajweedAudio {
+
+enum class LogLevel {
+    Debug = 0,
+    Info = 1,
+    Warn = 2,
+    Error = 3
+};
+
+// Receives each formatted message. Called from whichever thread logs,
+// including pool workers, so it must be thread-safe.
+typedef void (*LogSink)(LogLevel level, const char* tag, const char* message);
+
+// Replaces the sink; nullptr restores the default, which writes to stderr
+void setLogSink(LogSink sink);
+
+// Messages below this level are dropped before formatting (default: Info)
+void setMinLogLevel(LogLevel level);
+
+void logMessage(LogLevel level, const char* tag, const char* format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 3, 4)))
+#endif
+    ;
+
+} // namespace TajweedAudio
+
+#ifndef LOG_TAG
+#define LOG_TAG "TajweedAudio"
+#endif
+
+#define LOGD(...) TajweedAudio::logMessage(TajweedAudio::LogLevel::Debug, LOG_TAG, __VA_ARGS__)
+#define LOGI(...) TajweedAudio::logMessage(TajweedAudio::LogLevel::Info, LOG_TAG, __VA_ARGS__)
+#define LOGW(...) TajweedAudio::logMessage(TajweedAudio::LogLevel::Warn, LOG_TAG, __VA_ARGS__)
+#define LOGE(...) TajweedAudio::logMessage(TajweedAudio::LogLevel::Error, LOG_TAG, __VA_ARGS__)
+
+#endif // TAJWEED_LOG_H
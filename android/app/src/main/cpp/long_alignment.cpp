@@ -0,0 +1,255 @@
+#include "long_alignment.h"
+#include "audio_analysis.h"
+#include "jobs.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace TajweedAudio {
+
+namespace {
+
+double frameEnergyDb(const float* row) {
+    return 10.0 * log10(row[FeatureColumns::Energy.offset] + 1e-10);
+}
+
+// The distance block of every `factor` consecutive rows averaged into one
+// frame of FeatureColumns::Distance.count floats
+void poolFrames(const float* frames, size_t numFrames, size_t factor, std::vector<float>& pooled) {
+    const ColumnRange& distance = FeatureColumns::Distance;
+    size_t count = (numFrames + factor - 1) / factor;
+    pooled.assign(count * distance.count, 0.0f);
+    for (size_t k = 0; k < count; k++) {
+        size_t begin = k * factor;
+        size_t end = std::min(numFrames, begin + factor);
+        float* out = pooled.data() + k * distance.count;
+        for (size_t f = begin; f < end; f++) {
+            const float* row = frames + f * kFeatureStride + distance.offset;
+            for (size_t d = 0; d < distance.count; d++) out[d] += row[d];
+        }
+        float scale = 1.0f / (end - begin);
+        for (size_t d = 0; d < distance.count; d++) out[d] *= scale;
+    }
+}
+
+// Centre frame of each pause, in order
+std::vector<size_t> pauseCentres(const std::vector<std::pair<size_t, size_t>>& pauses) {
+    std::vector<size_t> centres;
+    centres.reserve(pauses.size());
+    for (const auto& pause : pauses) centres.push_back((pause.first + pause.second) / 2);
+    return centres;
+}
+
+// The centre in [lo, hi) nearest `target`, or SIZE_MAX
+size_t nearestCentre(const std::vector<size_t>& centres, size_t lo, size_t hi, size_t target) {
+    auto at = std::lower_bound(centres.begin(), centres.end(), target);
+    size_t best = SIZE_MAX;
+    size_t bestDistance = SIZE_MAX;
+    for (auto it : {at, at == centres.begin() ? centres.end() : at - 1}) {
+        if (it == centres.end() || *it < lo || *it >= hi) continue;
+        size_t distance = *it > target ? *it - target : target - *it;
+        if (distance < bestDistance) {
+            bestDistance = distance;
+            best = *it;
+        }
+    }
+    return best;
+}
+
+// Chunks run on pool workers; each keeps the grid of the largest chunk it has aligned
+DTWScratch& chunkScratch() {
+    thread_local DTWScratch scratch;
+    return scratch;
+}
+
+} // namespace
+
+void findPauses(const float* frames, size_t numFrames, size_t minFrames, double pauseDb,
+                std::vector<std::pair<size_t, size_t>>& pauses) {
+    pauses.clear();
+    if (numFrames == 0) return;
+
+    // Relative to the loud frames, so the recording level does not matter
+    std::vector<double> levels(numFrames);
+    for (size_t f = 0; f < numFrames; f++) levels[f] = frameEnergyDb(frames + f * kFeatureStride);
+    std::vector<double> sorted(levels);
+    size_t loud = numFrames * 95 / 100;
+    std::nth_element(sorted.begin(), sorted.begin() + loud, sorted.end());
+    double threshold = sorted[loud] - pauseDb;
+
+    size_t start = 0;
+    bool quiet = false;
+    for (size_t f = 0; f <= numFrames; f++) {
+        bool below = f < numFrames && levels[f] < threshold;
+        if (below && !quiet) start = f;
+        if (!below && quiet && f - start >= std::max<size_t>(minFrames, 1)) pauses.emplace_back(start, f);
+        quiet = below;
+    }
+}
+
+void performLongDTW(const AudioFeatures& features1, const float* frames2, size_t n2, int sampleRate2,
+                    const LongAlignmentOptions& options, FeatureWorkspace& workspace, ComparisonResult& result,
+                    std::vector<AlignmentChunk>& chunks, LongAlignmentStats* stats,
+                    const AlignmentTimelines& timelines) {
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point started = Clock::now();
+    LongAlignmentStats local;
+    result.similarity = 0.0;
+    result.score = 0.0;
+    result.abandoned = false;
+    result.times.clear();
+    result.alignment.clear();
+    result.deviations.clear();
+    chunks.clear();
+
+    const float* frames1 = features1.frames.data();
+    size_t n1 = features1.frames.numFrames();
+    if (n1 == 0 || n2 == 0 || !frames2) {
+        if (stats) *stats = local;
+        return;
+    }
+    double frameSeconds1 = features1.frames.frameSeconds();
+    double frameSeconds2 = sampleRate2 > 0 ? static_cast<double>(kHopSize) / sampleRate2 : 0.0;
+    const size_t dims = FeatureColumns::Distance.count;
+
+    // Coarse pass: both inputs pooled by the same factor, so the path keeps
+    // the tempo ratio, and never more than maxCoarseFrames^2 cells
+    size_t maxCoarse = std::max<size_t>(options.maxCoarseFrames, 1);
+    size_t factor = std::max<size_t>(1, (std::max(n1, n2) + maxCoarse - 1) / maxCoarse);
+    local.coarseFactor = factor;
+    std::vector<float> coarse1, coarse2;
+    poolFrames(frames1, n1, factor, coarse1);
+    poolFrames(frames2, n2, factor, coarse2);
+    size_t c1 = coarse1.size() / dims;
+    size_t c2 = coarse2.size() / dims;
+    DTWAlignment coarsePath;
+    dtwAlign(coarse1.data(), c1, coarse2.data(), c2, dims, dims, DTWOptions(), workspace.dtw, coarsePath);
+
+    // Mean reference frame each coarse user frame is matched to
+    std::vector<double> mapped(c1, 0.0);
+    std::vector<size_t> hits(c1, 0);
+    for (size_t k = 0; k < coarsePath.frames1.size(); k++) {
+        mapped[coarsePath.frames1[k]] += coarsePath.frames2[k];
+        hits[coarsePath.frames1[k]]++;
+    }
+    auto referenceFrameOf = [&](size_t f) {
+        size_t i = std::min(f / factor, c1 - 1);
+        double centre = (hits[i] > 0 ? mapped[i] / hits[i] : 0.0) * factor + 0.5 * factor;
+        return std::min(static_cast<size_t>(centre), n2 - 1);
+    };
+    local.coarseMs = std::chrono::duration<double, std::milli>(Clock::now() - started).count();
+
+    // Waqf candidates in both inputs
+    std::vector<std::pair<size_t, size_t>> pauses1, pauses2;
+    size_t minPause1 = frameSeconds1 > 0.0 ? static_cast<size_t>(options.pauseSeconds / frameSeconds1 + 0.5) : 1;
+    size_t minPause2 = frameSeconds2 > 0.0 ? static_cast<size_t>(options.pauseSeconds / frameSeconds2 + 0.5) : 1;
+    findPauses(frames1, n1, minPause1, options.pauseDb, pauses1);
+    findPauses(frames2, n2, minPause2, options.pauseDb, pauses2);
+    local.pauses1 = pauses1.size();
+    local.pauses2 = pauses2.size();
+    std::vector<size_t> centres1 = pauseCentres(pauses1);
+    std::vector<size_t> centres2 = pauseCentres(pauses2);
+    size_t snap = frameSeconds2 > 0.0 ? static_cast<size_t>(options.snapSeconds / frameSeconds2) : 0;
+
+    // Anchors every ~chunkFrames user frames: the user pause nearest the
+    // target when one is within half a chunk, moved onto its reference
+    // counterpart when the coarse path lands close to one
+    size_t target = std::max<size_t>(options.chunkFrames, 16);
+    struct Anchor {
+        size_t frame1;
+        size_t frame2;
+        bool pause;
+    };
+    std::vector<Anchor> anchors = {{0, 0, false}};
+    while (n1 - anchors.back().frame1 > target + target / 2) {
+        const Anchor& last = anchors.back();
+        size_t want = last.frame1 + target;
+        Anchor next = {want, 0, false};
+        size_t pause1 = nearestCentre(centres1, last.frame1 + target / 2, last.frame1 + target + target / 2, want);
+        if (pause1 != SIZE_MAX) next.frame1 = pause1;
+        next.frame2 = referenceFrameOf(next.frame1);
+        if (pause1 != SIZE_MAX) {
+            size_t lo = next.frame2 > snap ? next.frame2 - snap : 0;
+            size_t pause2 = nearestCentre(centres2, lo, next.frame2 + snap + 1, next.frame2);
+            if (pause2 != SIZE_MAX) {
+                next.frame2 = pause2;
+                next.pause = true;
+            }
+        }
+
+        // Both sides strictly increase and leave the last chunk a frame
+        if (next.frame2 <= last.frame2) next.frame2 = last.frame2 + 1;
+        if (next.frame2 >= n2) break;
+        local.pauseAnchors += next.pause ? 1 : 0;
+        anchors.push_back(next);
+    }
+    anchors.push_back({n1, n2, false});
+
+    chunks.resize(anchors.size() - 1);
+    for (size_t k = 0; k + 1 < anchors.size(); k++) {
+        AlignmentChunk& chunk = chunks[k];
+        chunk.begin1 = anchors[k].frame1;
+        chunk.end1 = anchors[k + 1].frame1;
+        chunk.begin2 = anchors[k].frame2;
+        chunk.end2 = anchors[k + 1].frame2;
+        chunk.startTime1 = recordingSeconds(chunk.begin1, features1.frames.sampleRate(), timelines.first);
+        chunk.endTime1 = recordingSeconds(chunk.end1, features1.frames.sampleRate(), timelines.first, true);
+        chunk.startTime2 = recordingSeconds(chunk.begin2, sampleRate2, timelines.second);
+        chunk.endTime2 = recordingSeconds(chunk.end2, sampleRate2, timelines.second, true);
+        chunk.pauseAnchored = anchors[k].pause;
+        local.largestChunkCells = std::max(local.largestChunkCells, (chunk.end1 - chunk.begin1) * (chunk.end2 - chunk.begin2));
+    }
+
+    // Chunks are independent once the anchors are fixed
+    Clock::time_point aligning = Clock::now();
+    std::vector<DTWAlignment> paths(chunks.size());
+    DTWOptions chunkOptions = options.chunk;
+    chunkOptions.abandonThreshold = std::numeric_limits<double>::infinity();
+    JobControl* job = workspace.job;
+    if (job) job->addWork(n1);
+    parallelFor(workspace.pool(), chunks.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t k = begin; k < end; k++) {
+            if (job && job->cancelled()) return;
+            AlignmentChunk& chunk = chunks[k];
+            dtwAlign(frames1 + chunk.begin1 * kFeatureStride, chunk.end1 - chunk.begin1,
+                     frames2 + chunk.begin2 * kFeatureStride, chunk.end2 - chunk.begin2, dims, kFeatureStride,
+                     chunkOptions, chunkScratch(), paths[k]);
+            chunk.distance = paths[k].distance;
+            chunk.steps = paths[k].costs.size();
+            chunk.similarity = chunk.steps > 0 ? 1.0 / (1.0 + chunk.distance / chunk.steps) : 0.0;
+            chunk.score = chunk.similarity * 100.0;
+            if (job) job->advance(chunk.end1 - chunk.begin1);
+        }
+    });
+    local.chunksMs = std::chrono::duration<double, std::milli>(Clock::now() - aligning).count();
+    if (stats) *stats = local;
+    if (job && job->cancelled()) {
+        chunks.clear();
+        return;
+    }
+
+    // Stitched: each chunk's path starts one diagonal step after the last one's end
+    DTWAlignment& path = workspace.path;
+    size_t steps = 0;
+    for (const DTWAlignment& piece : paths) steps += piece.costs.size();
+    path.distance = 0.0;
+    path.abandoned = false;
+    path.frames1.resize(steps);
+    path.frames2.resize(steps);
+    path.costs.resize(steps);
+    size_t at = 0;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        const DTWAlignment& piece = paths[k];
+        for (size_t s = 0; s < piece.costs.size(); s++, at++) {
+            path.frames1[at] = chunks[k].begin1 + piece.frames1[s];
+            path.frames2[at] = chunks[k].begin2 + piece.frames2[s];
+            path.costs[at] = piece.costs[s];
+        }
+        path.distance += piece.distance;
+    }
+    summarizeAlignment(path, n1, features1.frames.sampleRate(), sampleRate2, workspace, result, timelines);
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,71 @@
+#ifndef TAJWEED_LONG_ALIGNMENT_H
+#define TAJWEED_LONG_ALIGNMENT_H
+
+#include "audio_features.h"
+#include "dtw.h"
+#include "workspace.h"
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace TajweedAudio {
+
+// performDTW hands unbanded grids larger than this (16 MB of backtracking
+// directions, a little over a minute against a minute) to performLongDTW
+const size_t kMaxDirectAlignmentCells = size_t(1) << 24;
+
+struct LongAlignmentOptions {
+    size_t chunkFrames = 640;          // target chunk length, in frames of the first input (~10 s at 16 kHz)
+    size_t maxCoarseFrames = 1024;     // the coarse pass pools both inputs down to at most this many frames
+    double pauseSeconds = 0.15;        // a waqf candidate is a quiet run at least this long; VAD-trimmed
+                                       // features keep about 0.3 s of every pause it cut
+    double pauseDb = 30.0;             // quiet: this far below the recording's loud (95th percentile) frames
+    double snapSeconds = 1.5;          // a reference pause this close to where the coarse path maps a
+                                       // user pause is taken as its counterpart
+    DTWOptions chunk;                  // per-chunk DTW (band, window, metric); no abandonThreshold
+};
+
+// One independently aligned piece of the recitation. Frames are [begin, end)
+// in each input; consecutive chunks meet at an anchor.
+struct AlignmentChunk {
+    size_t begin1 = 0, end1 = 0;       // frames of the first input (the user's take)
+    size_t begin2 = 0, end2 = 0;       // frames of the second (the reference)
+    double startTime1 = 0.0, endTime1 = 0.0;
+    double startTime2 = 0.0, endTime2 = 0.0;
+    bool pauseAnchored = false;        // starts on a pause found in both inputs, not just on the coarse path
+    double distance = 0.0;             // accumulated cost of the chunk's path
+    size_t steps = 0;
+    double similarity = 0.0;           // 1 / (1 + mean step cost), as for a whole take
+    double score = 0.0;
+};
+
+struct LongAlignmentStats {
+    size_t coarseFactor = 1;           // frames pooled per coarse frame
+    size_t pauses1 = 0;                // waqf candidates found in each input
+    size_t pauses2 = 0;
+    size_t pauseAnchors = 0;           // chunk boundaries on a matched pause
+    size_t largestChunkCells = 0;      // bounds the DTW memory held per worker
+    double coarseMs = 0.0;
+    double chunksMs = 0.0;
+};
+
+// Quiet runs of at least minFrames frames, judged on the raw Energy column
+void findPauses(const float* frames, size_t numFrames, size_t minFrames, double pauseDb,
+                std::vector<std::pair<size_t, size_t>>& pauses);
+
+// Alignment of a long recitation (a whole surah against its reference) in
+// bounded memory and linear time. A coarse DTW over both inputs pooled to at
+// most maxCoarseFrames frames maps the take onto the reference; anchors are
+// placed every ~chunkFrames frames, on a pause that has a counterpart in the
+// reference where there is one and on the coarse path otherwise. The chunks
+// between anchors are aligned in parallel on the workspace's pool, and their
+// paths stitched into workspace.path, which `result` summarizes as
+// performDTW would. Each worker only ever holds one chunk's DTW grid.
+void performLongDTW(const AudioFeatures& features1, const float* frames2, size_t numFrames2, int sampleRate2,
+                    const LongAlignmentOptions& options, FeatureWorkspace& workspace, ComparisonResult& result,
+                    std::vector<AlignmentChunk>& chunks, LongAlignmentStats* stats = nullptr,
+                    const AlignmentTimelines& timelines = AlignmentTimelines());
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_LONG_ALIGNMENT_H
@@ -0,0 +1,224 @@
+#include "media_decoder.h"
+
+#if defined(__ANDROID__)
+
+#include "perf_stats.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <media/NdkMediaCodec.h>
+#include <media/NdkMediaExtractor.h>
+#include <media/NdkMediaFormat.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Codec calls wait this long for a buffer before the loop tries the other side
+const int64_t kDequeueTimeoutUs = 10000;
+
+// AudioFormat.ENCODING_PCM_FLOAT under MediaFormat's "pcm-encoding" key;
+// codecs default to 16-bit
+const char* const kPcmEncodingKey = "pcm-encoding";
+const int32_t kEncodingPcmFloat = 4;
+
+} // namespace
+
+MediaDecoder::~MediaDecoder() {
+    close();
+}
+
+bool MediaDecoder::open(const std::string& path) {
+    close();
+    error_.clear();
+
+    fd_ = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd_ < 0) return fail("cannot open " + path + ": " + strerror(errno));
+    struct stat info;
+    if (fstat(fd_, &info) != 0) return fail("cannot stat " + path + ": " + strerror(errno));
+
+    extractor_ = AMediaExtractor_new();
+    if (!extractor_ || AMediaExtractor_setDataSourceFd(extractor_, fd_, 0, info.st_size) != AMEDIA_OK) {
+        return fail("unrecognized container: " + path);
+    }
+
+    // First audio track
+    size_t tracks = AMediaExtractor_getTrackCount(extractor_);
+    for (size_t t = 0; t < tracks && !codec_; t++) {
+        AMediaFormat* format = AMediaExtractor_getTrackFormat(extractor_, t);
+        const char* mime = nullptr;
+        if (format && AMediaFormat_getString(format, AMEDIAFORMAT_KEY_MIME, &mime) && mime &&
+            strncmp(mime, "audio/", 6) == 0) {
+            int32_t rate = 0, channels = 0;
+            int64_t durationUs = 0;
+            AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_SAMPLE_RATE, &rate);
+            AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_CHANNEL_COUNT, &channels);
+            AMediaFormat_getInt64(format, AMEDIAFORMAT_KEY_DURATION, &durationUs);
+            sampleRate_ = rate;
+            channels_ = channels;
+
+            codec_ = AMediaCodec_createDecoderByType(mime);
+            if (!codec_) {
+                error_ = std::string("no decoder for ") + mime;
+            } else if (AMediaCodec_configure(codec_, format, nullptr, nullptr, 0) != AMEDIA_OK ||
+                       AMediaCodec_start(codec_) != AMEDIA_OK) {
+                error_ = std::string("cannot start the ") + mime + " decoder";
+                AMediaCodec_delete(codec_);
+                codec_ = nullptr;
+            } else {
+                AMediaExtractor_selectTrack(extractor_, t);
+                if (durationUs > 0 && rate > 0) frameCountHint_ = static_cast<size_t>(durationUs * rate / 1000000);
+            }
+        }
+        if (format) AMediaFormat_delete(format);
+    }
+    if (!codec_) return fail(error_.empty() ? "no audio track in " + path : error_);
+
+    // The output format is only certain once the codec has produced something
+    drainOutput();
+    if (!error_.empty()) return fail(error_);
+    if (sampleRate_ <= 0 || channels_ <= 0) return fail("decoder reported no sample rate or channel count");
+    return true;
+}
+
+void MediaDecoder::close() {
+    if (codec_) {
+        AMediaCodec_stop(codec_);
+        AMediaCodec_delete(codec_);
+        codec_ = nullptr;
+    }
+    if (extractor_) {
+        AMediaExtractor_delete(extractor_);
+        extractor_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    sampleRate_ = 0;
+    channels_ = 0;
+    floatOutput_ = false;
+    frameCountHint_ = 0;
+    inputDone_ = false;
+    outputDone_ = false;
+    pending_.clear();
+    pendingOffset_ = 0;
+}
+
+size_t MediaDecoder::decode(float* out, size_t maxFrames) {
+    size_t written = 0;
+    while (written < maxFrames) {
+        if (pendingOffset_ < pending_.size()) {
+            size_t n = std::min(maxFrames - written, pending_.size() - pendingOffset_);
+            std::copy(pending_.begin() + pendingOffset_, pending_.begin() + pendingOffset_ + n, out + written);
+            pendingOffset_ += n;
+            written += n;
+            continue;
+        }
+        pending_.clear();
+        pendingOffset_ = 0;
+        if (!drainOutput()) break;
+    }
+    return written;
+}
+
+bool MediaDecoder::fail(const std::string& message) {
+    std::string saved = message;
+    close();
+    error_ = saved;
+    return false;
+}
+
+void MediaDecoder::queueInput() {
+    if (inputDone_) return;
+    ssize_t index = AMediaCodec_dequeueInputBuffer(codec_, 0);
+    if (index < 0) return;
+
+    size_t capacity = 0;
+    uint8_t* buffer = AMediaCodec_getInputBuffer(codec_, index, &capacity);
+    ssize_t size = buffer ? AMediaExtractor_readSampleData(extractor_, buffer, capacity) : -1;
+    if (size < 0) {
+        AMediaCodec_queueInputBuffer(codec_, index, 0, 0, 0, AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM);
+        inputDone_ = true;
+        return;
+    }
+    TAJWEED_PERF_COUNT(BytesDecoded, size);
+    int64_t time = AMediaExtractor_getSampleTime(extractor_);
+    AMediaCodec_queueInputBuffer(codec_, index, 0, size, time > 0 ? time : 0, 0);
+    AMediaExtractor_advance(extractor_);
+}
+
+bool MediaDecoder::drainOutput() {
+    if (!codec_ || outputDone_) return false;
+
+    for (;;) {
+        queueInput();
+
+        AMediaCodecBufferInfo info;
+        ssize_t index = AMediaCodec_dequeueOutputBuffer(codec_, &info, kDequeueTimeoutUs);
+        if (index == AMEDIACODEC_INFO_OUTPUT_FORMAT_CHANGED) {
+            readOutputFormat();
+            continue;
+        }
+        if (index == AMEDIACODEC_INFO_TRY_AGAIN_LATER || index == AMEDIACODEC_INFO_OUTPUT_BUFFERS_CHANGED) continue;
+        if (index < 0) {
+            error_ = "decoder failed";
+            outputDone_ = true;
+            return false;
+        }
+
+        size_t capacity = 0;
+        const uint8_t* buffer = AMediaCodec_getOutputBuffer(codec_, index, &capacity);
+        size_t channels = static_cast<size_t>(std::max(1, channels_));
+        if (buffer && info.size > 0) {
+            const uint8_t* data = buffer + info.offset;
+            size_t bytesPerSample = floatOutput_ ? sizeof(float) : sizeof(int16_t);
+            size_t frames = info.size / (bytesPerSample * channels);
+            pending_.resize(frames);
+
+            // Interleaved, native-endian; the codec buffer may not be aligned for floats
+            float scale = 1.0f / channels;
+            for (size_t i = 0; i < frames; i++) {
+                float sum = 0.0f;
+                for (size_t c = 0; c < channels; c++) {
+                    const uint8_t* p = data + (i * channels + c) * bytesPerSample;
+                    if (floatOutput_) {
+                        float value;
+                        memcpy(&value, p, sizeof(value));
+                        sum += value;
+                    } else {
+                        int16_t value;
+                        memcpy(&value, p, sizeof(value));
+                        sum += value / 32768.0f;
+                    }
+                }
+                pending_[i] = sum * scale;
+            }
+        }
+        AMediaCodec_releaseOutputBuffer(codec_, index, false);
+
+        if (info.flags & AMEDIACODEC_BUFFER_FLAG_END_OF_STREAM) outputDone_ = true;
+        if (!pending_.empty() || outputDone_) return !pending_.empty();
+    }
+}
+
+void MediaDecoder::readOutputFormat() {
+    AMediaFormat* format = AMediaCodec_getOutputFormat(codec_);
+    if (!format) return;
+    int32_t value = 0;
+    if (AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_SAMPLE_RATE, &value) && value > 0) {
+        // Rates only change before the first output, so the hint follows along
+        if (sampleRate_ > 0 && value != sampleRate_) frameCountHint_ = frameCountHint_ * value / sampleRate_;
+        sampleRate_ = value;
+    }
+    if (AMediaFormat_getInt32(format, AMEDIAFORMAT_KEY_CHANNEL_COUNT, &value) && value > 0) channels_ = value;
+    floatOutput_ = AMediaFormat_getInt32(format, kPcmEncodingKey, &value) && value == kEncodingPcmFloat;
+    AMediaFormat_delete(format);
+}
+
+} // namespace TajweedAudio
+
+#endif // __ANDROID__
@@ -0,0 +1,64 @@
+#ifndef TAJWEED_MEDIA_DECODER_H
+#define TAJWEED_MEDIA_DECODER_H
+
+#include "decoder.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(__ANDROID__)
+
+struct AMediaCodec;
+struct AMediaExtractor;
+
+namespace TajweedAudio {
+
+// Compressed audio (MP3, AAC/M4A, Ogg, FLAC: whatever the device's codecs
+// take) through the NDK's AMediaExtractor and AMediaCodec. Output buffers
+// are converted and downmixed as they are dequeued, so only one codec
+// buffer of PCM exists at a time.
+class MediaDecoder : public AudioDecoder {
+public:
+    MediaDecoder() = default;
+    ~MediaDecoder() override;
+
+    MediaDecoder(const MediaDecoder&) = delete;
+    MediaDecoder& operator=(const MediaDecoder&) = delete;
+
+    // Opens the first audio track and decodes up to its first output buffer,
+    // so sampleRate() is the rate the codec actually produces (HE-AAC
+    // doubles the container's); on failure lastError() says why
+    bool open(const std::string& path);
+    void close();
+
+    int sampleRate() const override { return sampleRate_; }
+    int channels() const override { return channels_; }
+    size_t frameCountHint() const override { return frameCountHint_; }
+    size_t decode(float* out, size_t maxFrames) override;
+
+private:
+    bool fail(const std::string& message);
+    void queueInput();
+    // Dequeues one output buffer into pending_; false once nothing more will come
+    bool drainOutput();
+    void readOutputFormat();
+
+    int fd_ = -1;
+    AMediaExtractor* extractor_ = nullptr;
+    AMediaCodec* codec_ = nullptr;
+    int sampleRate_ = 0;
+    int channels_ = 0;
+    bool floatOutput_ = false;
+    size_t frameCountHint_ = 0;
+    bool inputDone_ = false;
+    bool outputDone_ = false;
+    std::vector<float> pending_;   // mono frames of the last output buffer not yet handed out
+    size_t pendingOffset_ = 0;
+};
+
+} // namespace TajweedAudio
+
+#endif // __ANDROID__
+
+#endif // TAJWEED_MEDIA_DECODER_H
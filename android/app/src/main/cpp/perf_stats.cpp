@@ -0,0 +1,228 @@
+#include "perf_stats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Log-linear histogram: values below 4 ns get a bucket each, every power of
+// two above is split into 4 sub-buckets, so a bucket spans at most 25% of
+// its lower bound and 64-bit nanosecond values need 252 buckets
+const size_t kSubBuckets = 4;
+const size_t kBuckets = 256;
+
+size_t bucketIndex(uint64_t value) {
+    if (value < kSubBuckets) return static_cast<size_t>(value);
+    int exponent = 63 - __builtin_clzll(value);               // >= 2
+    size_t sub = static_cast<size_t>(value >> (exponent - 2)) & (kSubBuckets - 1);
+    return kSubBuckets * static_cast<size_t>(exponent - 1) + sub;
+}
+
+double bucketMidpoint(size_t index) {
+    if (index < kSubBuckets) return static_cast<double>(index);
+    int exponent = static_cast<int>(index / kSubBuckets) + 1;
+    double width = static_cast<double>(uint64_t(1) << (exponent - 2));
+    double low = (kSubBuckets + index % kSubBuckets) * width;
+    return low + width / 2.0;
+}
+
+struct StageAccumulator {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalNs{0};
+    std::atomic<uint64_t> maxNs{0};
+    std::atomic<uint64_t> buckets[kBuckets];
+
+    StageAccumulator() {
+        for (auto& bucket : buckets) bucket.store(0, std::memory_order_relaxed);
+    }
+};
+
+// One thread's accumulators. Only the owning thread adds to them (relaxed
+// atomics, no contention); readers and reset go through the registry.
+struct ThreadStats {
+    StageAccumulator stages[kPerfStageCount];
+    std::atomic<uint64_t> counters[kPerfCounterCount];
+
+    ThreadStats() {
+        for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        for (StageAccumulator& stage : stages) {
+            stage.count.store(0, std::memory_order_relaxed);
+            stage.totalNs.store(0, std::memory_order_relaxed);
+            stage.maxNs.store(0, std::memory_order_relaxed);
+            for (auto& bucket : stage.buckets) bucket.store(0, std::memory_order_relaxed);
+        }
+        for (auto& counter : counters) counter.store(0, std::memory_order_relaxed);
+    }
+
+    // Adds this block into `target` (used when a thread exits)
+    void mergeInto(ThreadStats& target) const {
+        for (size_t s = 0; s < kPerfStageCount; s++) {
+            const StageAccumulator& from = stages[s];
+            StageAccumulator& to = target.stages[s];
+            to.count.fetch_add(from.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            to.totalNs.fetch_add(from.totalNs.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            uint64_t max = from.maxNs.load(std::memory_order_relaxed);
+            if (max > to.maxNs.load(std::memory_order_relaxed)) to.maxNs.store(max, std::memory_order_relaxed);
+            for (size_t b = 0; b < kBuckets; b++) {
+                uint64_t hits = from.buckets[b].load(std::memory_order_relaxed);
+                if (hits) to.buckets[b].fetch_add(hits, std::memory_order_relaxed);
+            }
+        }
+        for (size_t c = 0; c < kPerfCounterCount; c++) {
+            target.counters[c].fetch_add(counters[c].load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    }
+};
+
+// Every live thread's block, plus the totals of threads that have exited
+struct Registry {
+    std::mutex mutex;
+    std::vector<ThreadStats*> live;
+    ThreadStats retired;
+};
+
+// Never destroyed: pool threads may still exit during static destruction
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+class ThreadSlot {
+public:
+    ThreadSlot() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.live.push_back(&stats_);
+    }
+
+    ~ThreadSlot() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        stats_.mergeInto(reg.retired);
+        reg.live.erase(std::remove(reg.live.begin(), reg.live.end(), &stats_), reg.live.end());
+    }
+
+    ThreadStats& stats() { return stats_; }
+
+private:
+    ThreadStats stats_;
+};
+
+ThreadStats& threadStats() {
+    thread_local ThreadSlot slot;
+    return slot.stats();
+}
+
+double percentileUs(const uint64_t* buckets, uint64_t count, double fraction) {
+    uint64_t rank = static_cast<uint64_t>(fraction * count + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count));
+    uint64_t seen = 0;
+    for (size_t b = 0; b < kBuckets; b++) {
+        seen += buckets[b];
+        if (seen >= rank) return bucketMidpoint(b) / 1000.0;
+    }
+    return 0.0;
+}
+
+} // namespace
+
+const char* perfStageName(PerfStage stage) {
+    switch (stage) {
+        case PerfStage::Load: return "load";
+        case PerfStage::Resample: return "resample";
+        case PerfStage::Preprocess: return "preprocess";
+        case PerfStage::Vad: return "vad";
+        case PerfStage::Stft: return "stft";
+        case PerfStage::Pitch: return "pitch";
+        case PerfStage::Formants: return "formants";
+        case PerfStage::Extract: return "extract";
+        case PerfStage::Dtw: return "dtw";
+        case PerfStage::Rules: return "rules";
+        case PerfStage::Search: return "search";
+        default: return "unknown";
+    }
+}
+
+const char* perfCounterName(PerfCounter counter) {
+    switch (counter) {
+        case PerfCounter::FramesProcessed: return "framesProcessed";
+        case PerfCounter::BytesDecoded: return "bytesDecoded";
+        case PerfCounter::Allocations: return "allocations";
+        case PerfCounter::AllocatedBytes: return "allocatedBytes";
+        default: return "unknown";
+    }
+}
+
+uint64_t perfNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void recordStage(PerfStage stage, uint64_t nanoseconds) {
+    StageAccumulator& accumulator = threadStats().stages[static_cast<size_t>(stage)];
+    accumulator.count.fetch_add(1, std::memory_order_relaxed);
+    accumulator.totalNs.fetch_add(nanoseconds, std::memory_order_relaxed);
+    accumulator.buckets[bucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    if (nanoseconds > accumulator.maxNs.load(std::memory_order_relaxed)) {
+        accumulator.maxNs.store(nanoseconds, std::memory_order_relaxed);
+    }
+}
+
+void countPerf(PerfCounter counter, uint64_t amount) {
+    threadStats().counters[static_cast<size_t>(counter)].fetch_add(amount, std::memory_order_relaxed);
+}
+
+PerfSnapshot perfSnapshot() {
+    PerfSnapshot snapshot;
+    snapshot.enabled = TAJWEED_PERF_STATS != 0;
+
+    ThreadStats total;
+    {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.retired.mergeInto(total);
+        for (const ThreadStats* stats : reg.live) stats->mergeInto(total);
+    }
+
+    uint64_t buckets[kBuckets];
+    for (size_t s = 0; s < kPerfStageCount; s++) {
+        const StageAccumulator& stage = total.stages[s];
+        StageSnapshot& out = snapshot.stages[s];
+        out.count = stage.count.load(std::memory_order_relaxed);
+        if (out.count == 0) continue;
+
+        // Samples land in the buckets last, so a racing recorder can leave
+        // count a step ahead; percentiles use the bucket total
+        uint64_t bucketCount = 0;
+        for (size_t b = 0; b < kBuckets; b++) {
+            buckets[b] = stage.buckets[b].load(std::memory_order_relaxed);
+            bucketCount += buckets[b];
+        }
+        out.totalMs = stage.totalNs.load(std::memory_order_relaxed) / 1e6;
+        out.maxUs = stage.maxNs.load(std::memory_order_relaxed) / 1000.0;
+        out.p50Us = std::min(percentileUs(buckets, bucketCount, 0.50), out.maxUs);
+        out.p95Us = std::min(percentileUs(buckets, bucketCount, 0.95), out.maxUs);
+        out.p99Us = std::min(percentileUs(buckets, bucketCount, 0.99), out.maxUs);
+    }
+
+    for (size_t c = 0; c < kPerfCounterCount; c++) {
+        snapshot.counters[c] = total.counters[c].load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+void resetPerfStats() {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    reg.retired.clear();
+    for (ThreadStats* stats : reg.live) stats->clear();
+}
+
+} // namespace TajweedAudio
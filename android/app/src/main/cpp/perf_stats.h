@@ -0,0 +1,130 @@
+#ifndef TAJWEED_PERF_STATS_H
+#define TAJWEED_PERF_STATS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Hot-path instrumentation. Build with TAJWEED_PERF_STATS=0 to compile every
+// timer and counter out; the snapshot API then reports enabled = false.
+#ifndef TAJWEED_PERF_STATS
+#define TAJWEED_PERF_STATS 1
+#endif
+
+namespace TajweedAudio {
+
+enum class PerfStage {
+    Load = 0,       // opening and parsing an audio file
+    Resample,       // conversion to the analysis sample rate
+    Preprocess,     // filtering and denoising ahead of analysis
+    Vad,            // voice activity detection
+    Stft,           // windowed power spectra and per-frame spectral features
+    Pitch,          // pitch tracking
+    Formants,       // formant estimation
+    Extract,        // a whole feature extraction, every stage above included
+    Dtw,            // one alignment
+    Rules,          // one round of Tajweed rule evaluation
+    Search,         // one reference index search
+    Count
+};
+
+enum class PerfCounter {
+    FramesProcessed = 0,  // analysis frames extracted
+    BytesDecoded,         // encoded audio bytes turned into samples
+    Allocations,          // scratch buffer (re)allocations
+    AllocatedBytes,       // bytes requested by those allocations
+    Count
+};
+
+const size_t kPerfStageCount = static_cast<size_t>(PerfStage::Count);
+const size_t kPerfCounterCount = static_cast<size_t>(PerfCounter::Count);
+
+const char* perfStageName(PerfStage stage);
+const char* perfCounterName(PerfCounter counter);
+
+struct StageSnapshot {
+    uint64_t count = 0;     // samples recorded
+    double totalMs = 0.0;
+    double p50Us = 0.0;     // percentiles are bucket midpoints, within ~10%
+    double p95Us = 0.0;
+    double p99Us = 0.0;
+    double maxUs = 0.0;
+};
+
+struct PerfSnapshot {
+    bool enabled = false;
+    StageSnapshot stages[kPerfStageCount];
+    uint64_t counters[kPerfCounterCount] = {};
+};
+
+// Sums every thread's accumulators (threads that have exited included)
+PerfSnapshot perfSnapshot();
+void resetPerfStats();
+
+// Adds one duration sample to the calling thread's histogram for `stage`.
+// Lock-free: each thread writes only its own accumulators.
+void recordStage(PerfStage stage, uint64_t nanoseconds);
+void countPerf(PerfCounter counter, uint64_t amount);
+
+// Monotonic clock used by the timers
+uint64_t perfNow();
+
+// Records the lifetime of a scope as one sample
+class ScopedStageTimer {
+public:
+    explicit ScopedStageTimer(PerfStage stage) : stage_(stage), start_(perfNow()) {}
+    ~ScopedStageTimer() { recordStage(stage_, perfNow() - start_); }
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    PerfStage stage_;
+    uint64_t start_;
+};
+
+// Splits one stretch of work between interleaved stages: lap() charges the
+// time since the previous lap to a stage, commit() records one sample per
+// stage that was charged. Used where stages alternate frame by frame.
+class SplitStageTimer {
+public:
+    SplitStageTimer() : last_(perfNow()) {}
+
+    void lap(PerfStage stage) {
+        uint64_t now = perfNow();
+        elapsed_[static_cast<size_t>(stage)] += now - last_;
+        last_ = now;
+    }
+
+    void commit() {
+        for (size_t s = 0; s < kPerfStageCount; s++) {
+            if (elapsed_[s] > 0) recordStage(static_cast<PerfStage>(s), elapsed_[s]);
+        }
+    }
+
+private:
+    uint64_t last_;
+    uint64_t elapsed_[kPerfStageCount] = {};
+};
+
+} // namespace TajweedAudio
+
+#define TAJWEED_PERF_CONCAT_INNER(a, b) a##b
+#define TAJWEED_PERF_CONCAT(a, b) TAJWEED_PERF_CONCAT_INNER(a, b)
+
+#if TAJWEED_PERF_STATS
+#define TAJWEED_PERF_SCOPE(stage) \
+    TajweedAudio::ScopedStageTimer TAJWEED_PERF_CONCAT(perfScope, __LINE__)(TajweedAudio::PerfStage::stage)
+#define TAJWEED_PERF_SPLIT(name) TajweedAudio::SplitStageTimer name
+#define TAJWEED_PERF_LAP(name, stage) name.lap(TajweedAudio::PerfStage::stage)
+#define TAJWEED_PERF_COMMIT(name) name.commit()
+#define TAJWEED_PERF_COUNT(counter, amount) \
+    TajweedAudio::countPerf(TajweedAudio::PerfCounter::counter, static_cast<uint64_t>(amount))
+#else
+#define TAJWEED_PERF_SCOPE(stage) ((void)0)
+#define TAJWEED_PERF_SPLIT(name) ((void)0)
+#define TAJWEED_PERF_LAP(name, stage) ((void)0)
+#define TAJWEED_PERF_COMMIT(name) ((void)0)
+#define TAJWEED_PERF_COUNT(counter, amount) ((void)0)
+#endif
+
+#endif // TAJWEED_PERF_STATS_H
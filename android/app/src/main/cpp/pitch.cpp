@@ -0,0 +1,164 @@
+#include "pitch.h"
+#include "resample.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace TajweedAudio {
+
+PitchTracker::PitchTracker(int sampleRate, const PitchConfig& config)
+    : sampleRate_(sampleRate), config_(config) {
+    if (sampleRate <= 0 || config.frameSize < 8) {
+        throw std::invalid_argument("Pitch tracker needs a positive sample rate and frame size");
+    }
+
+    // A frame of samples covers less time at higher rates; widen the window
+    // so that the longest period still fits twice
+    size_t frameSize = static_cast<size_t>(config.frameSize);
+    windowSize_ = frameSize;
+    while (windowSize_ * kAnalysisSampleRate < frameSize * static_cast<size_t>(sampleRate)) windowSize_ *= 2;
+
+    maxLag_ = std::min(windowSize_ / 2, static_cast<size_t>(ceil(sampleRate / config.minFrequency)));
+    minLag_ = std::max<size_t>(2, static_cast<size_t>(floor(sampleRate / config.maxFrequency)));
+    if (minLag_ + 1 >= maxLag_) minLag_ = 2;
+
+    plan_ = FftPlan::forSize(2 * windowSize_);
+    growScratch(padded_, 2 * windowSize_, stats_);
+    growScratch(spectrum_, plan_->numBins(), stats_);
+    growScratch(energyPrefix_, windowSize_ + 1, stats_);
+    growScratch(difference_, maxLag_ + 2, stats_);
+    growScratch(window_, windowSize_, stats_);
+}
+
+PitchFrame PitchTracker::analyze(const double* window) {
+    PitchFrame result;
+    size_t w = windowSize_;
+    size_t n = 2 * w;
+
+    energyPrefix_[0] = 0.0;
+    for (size_t i = 0; i < w; i++) {
+        energyPrefix_[i + 1] = energyPrefix_[i] + window[i] * window[i];
+    }
+    if (sqrt(energyPrefix_[w] / w) < config_.silenceRms) return result;
+
+    // Linear autocorrelation: |FFT(x zero-padded to 2W)|^2, transformed back.
+    // The power spectrum is real and even, so a forward FFT inverts it (up to 1/n).
+    std::copy(window, window + w, padded_.begin());
+    std::fill(padded_.begin() + w, padded_.end(), 0.0);
+    plan_->forward(padded_.data(), spectrum_.data());
+
+    size_t half = n / 2;
+    for (size_t k = 0; k <= half; k++) {
+        double power = std::norm(spectrum_[k]);
+        padded_[k] = power;
+        if (k > 0 && k < half) padded_[n - k] = power;
+    }
+    plan_->forward(padded_.data(), spectrum_.data());
+
+    // YIN cumulative mean normalized difference
+    //   d(tau) = sum (x[j] - x[j + tau])^2 = E(0, W - tau) + E(tau, W) - 2 r(tau)
+    double scale = 1.0 / n;
+    double runningSum = 0.0;
+    difference_[0] = 1.0;
+    for (size_t tau = 1; tau <= maxLag_; tau++) {
+        double acf = spectrum_[tau].real() * scale;
+        double d = energyPrefix_[w - tau] + (energyPrefix_[w] - energyPrefix_[tau]) - 2.0 * acf;
+        d = std::max(0.0, d);
+        runningSum += d;
+        difference_[tau] = runningSum > 0.0 ? d * tau / runningSum : 1.0;
+    }
+
+    // First dip below the threshold, followed down to its local minimum
+    size_t bestLag = 0;
+    for (size_t tau = minLag_; tau <= maxLag_; tau++) {
+        if (difference_[tau] < config_.threshold) {
+            while (tau + 1 <= maxLag_ && difference_[tau + 1] < difference_[tau]) tau++;
+            bestLag = tau;
+            result.voiced = true;
+            break;
+        }
+    }
+
+    if (!result.voiced) {
+        bestLag = minLag_;
+        for (size_t tau = minLag_ + 1; tau <= maxLag_; tau++) {
+            if (difference_[tau] < difference_[bestLag]) bestLag = tau;
+        }
+    }
+
+    result.confidence = std::min(1.0, std::max(0.0, 1.0 - difference_[bestLag]));
+    if (!result.voiced) return result;
+
+    // Parabolic interpolation for a sub-sample lag
+    double lag = static_cast<double>(bestLag);
+    if (bestLag > minLag_ && bestLag < maxLag_) {
+        double a = difference_[bestLag - 1];
+        double b = difference_[bestLag];
+        double c = difference_[bestLag + 1];
+        double denom = a - 2.0 * b + c;
+        if (denom > 0.0) lag += 0.5 * (a - c) / denom;
+    }
+
+    result.frequency = sampleRate_ / lag;
+    return result;
+}
+
+PitchFrame PitchTracker::analyzeAt(const SampleSource& source, size_t frameStart) {
+    size_t frameSize = static_cast<size_t>(config_.frameSize);
+    size_t total = source.frameCount();
+    double* window = window_.data();
+
+    // Centred on the frame, shifted back inside the source at its edges
+    size_t centre = frameStart + frameSize / 2;
+    size_t start = centre > windowSize_ / 2 ? centre - windowSize_ / 2 : 0;
+    if (total >= windowSize_) start = std::min(start, total - windowSize_);
+    size_t read = source.read(start, windowSize_, window);
+    std::fill(window + read, window + windowSize_, 0.0);
+    return analyze(window);
+}
+
+void PitchTracker::track(const SampleSource& source, std::vector<PitchFrame>& frames) {
+    size_t frameSize = static_cast<size_t>(config_.frameSize);
+    size_t hopSize = static_cast<size_t>(config_.hopSize);
+    size_t total = source.frameCount();
+    if (total < frameSize || hopSize == 0) {
+        frames.clear();
+        return;
+    }
+
+    size_t numFrames = (total - frameSize) / hopSize + 1;
+    PitchFrame* out = growScratch(frames, numFrames, stats_);
+    double* window = window_.data();
+
+    // A widened window is read whole around each frame
+    if (windowSize_ != frameSize) {
+        for (size_t f = 0; f < numFrames; f++) out[f] = analyzeAt(source, f * hopSize);
+        return;
+    }
+
+    for (size_t f = 0; f < numFrames; f++) {
+        size_t start = f * hopSize;
+
+        // Overlapping frames only pull the new hop from the source
+        if (f > 0 && hopSize < frameSize) {
+            size_t overlap = frameSize - hopSize;
+            std::copy(window + hopSize, window + frameSize, window);
+            source.read(start + overlap, hopSize, window + overlap);
+        } else {
+            source.read(start, frameSize, window);
+        }
+
+        out[f] = analyze(window);
+    }
+}
+
+std::vector<PitchFrame> trackPitch(const SampleSource& source, const PitchConfig& config) {
+    std::vector<PitchFrame> frames;
+    if (source.sampleRate() <= 0) return frames;
+
+    PitchTracker tracker(source.sampleRate(), config);
+    tracker.track(source, frames);
+    return frames;
+}
+
+} // namespace TajweedAudio
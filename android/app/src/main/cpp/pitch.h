@@ -0,0 +1,78 @@
+#ifndef TAJWEED_PITCH_H
+#define TAJWEED_PITCH_H
+
+#include "audio_source.h"
+#include "fft.h"
+#include "scratch.h"
+#include "spectral.h"
+#include <complex>
+#include <memory>
+#include <vector>
+
+namespace TajweedAudio {
+
+struct PitchFrame {
+    double frequency = 0.0;   // Hz, 0 when unvoiced
+    double confidence = 0.0;  // 1 - YIN aperiodicity, in [0, 1]
+    bool voiced = false;
+};
+
+struct PitchConfig {
+    int frameSize = kFrameSize;
+    int hopSize = kHopSize;
+    double minFrequency = 60.0;
+    double maxFrequency = 1000.0;
+    double threshold = 0.15;       // YIN absolute threshold on the normalized difference
+    double silenceRms = 1e-4;      // frames quieter than this are unvoiced outright
+};
+
+// YIN pitch estimator for one frame size. The difference function comes from
+// an FFT autocorrelation (O(W log W)); all scratch buffers are owned by the
+// tracker, so analyzing a frame does not allocate.
+//
+// The YIN window W spans at least as long as config.frameSize does at
+// kAnalysisSampleRate: it is config.frameSize at 16 kHz, and doubled until
+// it covers the same time at higher rates (2048 at 44.1 and 48 kHz), so the
+// lags down to minFrequency fit in W / 2 whatever the input rate.
+class PitchTracker {
+public:
+    PitchTracker(int sampleRate, const PitchConfig& config = PitchConfig());
+
+    // Analyzes windowSize() samples starting at `window`
+    PitchFrame analyze(const double* window);
+
+    // Analyzes the frame of config.frameSize samples at `frameStart`, with a
+    // YIN window of windowSize() centred on it (kept inside the source where
+    // it fits, zero-padded where it does not)
+    PitchFrame analyzeAt(const SampleSource& source, size_t frameStart);
+
+    // Slides the analysis window over a whole source, one result per
+    // config.frameSize frame; `frames` keeps its capacity
+    void track(const SampleSource& source, std::vector<PitchFrame>& frames);
+
+    int sampleRate() const { return sampleRate_; }
+    size_t windowSize() const { return windowSize_; }
+    const PitchConfig& config() const { return config_; }
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    int sampleRate_;
+    PitchConfig config_;
+    size_t windowSize_;
+    size_t minLag_;
+    size_t maxLag_;
+    std::shared_ptr<const FftPlan> plan_;  // 2 * windowSize, for linear (not circular) correlation
+    std::vector<double> padded_;
+    std::vector<std::complex<double>> spectrum_;
+    std::vector<double> energyPrefix_;
+    std::vector<double> difference_;
+    std::vector<double> window_;
+    AllocationStats stats_;
+};
+
+// Runs the tracker over a whole source with a sliding window
+std::vector<PitchFrame> trackPitch(const SampleSource& source, const PitchConfig& config = PitchConfig());
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_PITCH_H
@@ -0,0 +1,330 @@
+#include "preprocess.h"
+#include "perf_stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Analysis frame of the denoiser, about 32 ms
+const double kDenoiseFrameSeconds = 0.032;
+
+// Leading frames averaged into the initial noise estimate (~0.25 s at 50% overlap)
+const size_t kNoiseInitFrames = 16;
+
+// Frames within this factor of the noise energy update the estimate
+const double kNoiseUpdateRatio = 2.5;
+const double kNoiseSmoothing = 0.95;
+
+// Q of the two sections of a 4th-order Butterworth filter
+const double kButterworthQ[2] = {0.54119610014619701, 1.3065629648763766};
+
+} // namespace
+
+Biquad Biquad::highPass(int sampleRate, double cutoffHz, double q) {
+    double w0 = 2.0 * M_PI * cutoffHz / sampleRate;
+    double alpha = sin(w0) / (2.0 * q);
+    double cosW0 = cos(w0);
+    double a0 = 1.0 + alpha;
+
+    Biquad section;
+    section.b0 = (1.0 + cosW0) / 2.0 / a0;
+    section.b1 = -(1.0 + cosW0) / a0;
+    section.b2 = section.b0;
+    section.a1 = -2.0 * cosW0 / a0;
+    section.a2 = (1.0 - alpha) / a0;
+    return section;
+}
+
+Biquad Biquad::lowPass(int sampleRate, double cutoffHz, double q) {
+    double w0 = 2.0 * M_PI * cutoffHz / sampleRate;
+    double alpha = sin(w0) / (2.0 * q);
+    double cosW0 = cos(w0);
+    double a0 = 1.0 + alpha;
+
+    Biquad section;
+    section.b0 = (1.0 - cosW0) / 2.0 / a0;
+    section.b1 = (1.0 - cosW0) / a0;
+    section.b2 = section.b0;
+    section.a1 = -2.0 * cosW0 / a0;
+    section.a2 = (1.0 - alpha) / a0;
+    return section;
+}
+
+bool BiquadCascade::add(const Biquad& section) {
+    if (numSections_ >= kMaxSections) return false;
+    sections_[numSections_++] = section;
+    return true;
+}
+
+bool BiquadCascade::addButterworthHighPass(int sampleRate, double cutoffHz) {
+    if (numSections_ + 2 > kMaxSections) return false;
+    for (double q : kButterworthQ) add(Biquad::highPass(sampleRate, cutoffHz, q));
+    return true;
+}
+
+bool BiquadCascade::addButterworthLowPass(int sampleRate, double cutoffHz) {
+    if (numSections_ + 2 > kMaxSections) return false;
+    for (double q : kButterworthQ) add(Biquad::lowPass(sampleRate, cutoffHz, q));
+    return true;
+}
+
+void BiquadCascade::process(double* samples, size_t count) {
+    if (numSections_ == 0) return;
+
+    // Work on local copies so the state stays in registers across the block
+    Biquad sections[kMaxSections];
+    std::copy(sections_, sections_ + numSections_, sections);
+    for (size_t i = 0; i < count; i++) {
+        double x = samples[i];
+        for (size_t s = 0; s < numSections_; s++) x = sections[s].process(x);
+        samples[i] = x;
+    }
+    std::copy(sections, sections + numSections_, sections_);
+}
+
+void BiquadCascade::clearState() {
+    for (size_t s = 0; s < numSections_; s++) sections_[s].clearState();
+}
+
+void SpectralDenoiser::configure(int sampleRate, double oversubtraction, double spectralFloor) {
+    oversubtraction_ = oversubtraction;
+    spectralFloor_ = spectralFloor;
+
+    if (sampleRate != sampleRate_) {
+        sampleRate_ = sampleRate;
+        frameSize_ = nextPowerOfTwo(static_cast<size_t>(std::max(1.0, sampleRate * kDenoiseFrameSeconds)));
+        frameSize_ = std::max<size_t>(frameSize_, 4);
+        hopSize_ = frameSize_ / 2;
+        plan_ = FftPlan::forSize(frameSize_);
+
+        // Square-root periodic Hann: analysis times synthesis sums to 1 at 50% overlap
+        growScratch(window_, frameSize_, stats_);
+        for (size_t i = 0; i < frameSize_; i++) {
+            window_[i] = sqrt(0.5 - 0.5 * cos(2.0 * M_PI * i / frameSize_));
+        }
+
+        size_t numBins = plan_->numBins();
+        growScratch(input_, frameSize_, stats_);
+        growScratch(frame_, frameSize_, stats_);
+        growScratch(accumulator_, frameSize_, stats_);
+        growScratch(output_, hopSize_, stats_);
+        growScratch(bins_, numBins, stats_);
+        growScratch(noise_, numBins, stats_);
+    }
+    clearState();
+}
+
+void SpectralDenoiser::clearState() {
+    std::fill(input_.begin(), input_.end(), 0.0);
+    std::fill(accumulator_.begin(), accumulator_.end(), 0.0);
+    std::fill(output_.begin(), output_.end(), 0.0);
+    std::fill(noise_.begin(), noise_.end(), 0.0);
+    fill_ = 0;
+    framesSeen_ = 0;
+}
+
+void SpectralDenoiser::process(double* samples, size_t count) {
+    if (frameSize_ == 0) return;
+
+    size_t overlap = frameSize_ - hopSize_;
+    size_t i = 0;
+    while (i < count) {
+        // Swap the next stretch of input for output of the previous frame
+        size_t take = std::min(hopSize_ - fill_, count - i);
+        double* in = input_.data() + overlap + fill_;
+        const double* out = output_.data() + fill_;
+        for (size_t j = 0; j < take; j++) {
+            in[j] = samples[i + j];
+            samples[i + j] = out[j];
+        }
+
+        fill_ += take;
+        i += take;
+        if (fill_ == hopSize_) {
+            processFrame();
+            fill_ = 0;
+        }
+    }
+}
+
+void SpectralDenoiser::processFrame() {
+    size_t numBins = plan_->numBins();
+    const double* window = window_.data();
+    double* frame = frame_.data();
+    std::complex<double>* bins = bins_.data();
+    double* noise = noise_.data();
+
+    for (size_t i = 0; i < frameSize_; i++) frame[i] = input_[i] * window[i];
+    plan_->forward(frame, bins);
+
+    double frameEnergy = 0.0;
+    double noiseEnergy = 0.0;
+    for (size_t k = 0; k < numBins; k++) {
+        frameEnergy += std::norm(bins[k]);
+        noiseEnergy += noise[k];
+    }
+
+    // Leading frames set the noise floor; later frames near it keep it current
+    if (framesSeen_ < kNoiseInitFrames) {
+        double weight = 1.0 / static_cast<double>(framesSeen_ + 1);
+        for (size_t k = 0; k < numBins; k++) noise[k] += (std::norm(bins[k]) - noise[k]) * weight;
+        noiseEnergy = 0.0;
+        for (size_t k = 0; k < numBins; k++) noiseEnergy += noise[k];
+    } else if (frameEnergy < kNoiseUpdateRatio * noiseEnergy) {
+        for (size_t k = 0; k < numBins; k++) {
+            noise[k] = kNoiseSmoothing * noise[k] + (1.0 - kNoiseSmoothing) * std::norm(bins[k]);
+        }
+    }
+    framesSeen_++;
+
+    // Power subtraction as a per-bin gain
+    for (size_t k = 0; k < numBins; k++) {
+        double power = std::norm(bins[k]);
+        double gain = power > 0.0 ? 1.0 - oversubtraction_ * noise[k] / power : 0.0;
+        bins[k] *= sqrt(std::max(gain, spectralFloor_));
+    }
+
+    plan_->inverse(bins, frame);
+
+    double* accumulator = accumulator_.data();
+    for (size_t i = 0; i < frameSize_; i++) accumulator[i] += frame[i] * window[i];
+
+    // The first hop has every overlapping frame in it now
+    std::copy(accumulator, accumulator + hopSize_, output_.data());
+    std::copy(accumulator + hopSize_, accumulator + frameSize_, accumulator);
+    std::fill(accumulator + frameSize_ - hopSize_, accumulator + frameSize_, 0.0);
+    std::copy(input_.begin() + hopSize_, input_.end(), input_.begin());
+}
+
+void Preprocessor::configure(int sampleRate, const PreprocessOptions& options) {
+    sampleRate_ = sampleRate;
+    options_ = options;
+    peak_ = 0.0;
+
+    filters_.clear();
+    if (sampleRate <= 0) {
+        options_.denoise = false;
+        return;
+    }
+
+    double nyquistLimit = 0.45 * sampleRate;
+    if (options.highPassHz > 0.0 && options.highPassHz < nyquistLimit) {
+        filters_.addButterworthHighPass(sampleRate, options.highPassHz);
+    }
+    if (options.lowPassHz > 0.0 && options.lowPassHz < nyquistLimit) {
+        filters_.addButterworthLowPass(sampleRate, options.lowPassHz);
+    }
+    if (options_.denoise) {
+        denoiser_.configure(sampleRate, options.oversubtraction, options.spectralFloor);
+    }
+}
+
+void Preprocessor::process(double* samples, size_t count) {
+    filters_.process(samples, count);
+    if (options_.denoise) denoiser_.process(samples, count);
+
+    double peak = peak_;
+    for (size_t i = 0; i < count; i++) peak = std::max(peak, std::fabs(samples[i]));
+    peak_ = peak;
+}
+
+double Preprocessor::normalizationGain() const {
+    if (!options_.normalize || peak_ <= 0.0) return 1.0;
+    return std::min(options_.targetPeak / peak_, options_.maxGain);
+}
+
+AllocationStats Preprocessor::stats() const {
+    return denoiser_.stats();
+}
+
+void PreprocessedSource::process(const SampleSource& input, const PreprocessOptions& options) {
+    TAJWEED_PERF_SCOPE(Preprocess);
+    sampleRate_ = input.sampleRate();
+    channels_ = input.channels();
+    frameCount_ = input.frameCount();
+
+    preprocessor_.configure(sampleRate_, options);
+    offset_ = preprocessor_.latency();
+
+    // The denoiser's latency is flushed with trailing silence, so processed
+    // sample i of the input lands at samples_[offset_ + i]
+    size_t total = frameCount_ + offset_;
+    float* stored = growScratch(samples_, total, stats_);
+    double* block = growScratch(block_, kPreprocessBlockSize, stats_);
+    for (size_t position = 0; position < total; position += kPreprocessBlockSize) {
+        size_t count = std::min(kPreprocessBlockSize, total - position);
+        size_t got = position < frameCount_ ? input.read(position, std::min(count, frameCount_ - position), block) : 0;
+        std::fill(block + got, block + count, 0.0);
+
+        preprocessor_.process(block, count);
+        for (size_t i = 0; i < count; i++) stored[position + i] = static_cast<float>(block[i]);
+    }
+
+    gain_ = preprocessor_.normalizationGain();
+}
+
+size_t PreprocessedSource::read(size_t start, size_t count, double* out) const {
+    if (start >= frameCount_) return 0;
+    size_t n = std::min(count, frameCount_ - start);
+    const float* samples = samples_.data() + offset_ + start;
+    for (size_t i = 0; i < n; i++) out[i] = samples[i] * gain_;
+    return n;
+}
+
+AllocationStats PreprocessedSource::stats() const {
+    AllocationStats total = stats_;
+    total += preprocessor_.stats();
+    return total;
+}
+
+void preprocessAudio(std::vector<double>& samples, int sampleRate, const PreprocessOptions& options) {
+    TAJWEED_PERF_SCOPE(Preprocess);
+    Preprocessor preprocessor;
+    preprocessor.configure(sampleRate, options);
+
+    // Room for the denoiser to flush its latency, then one pass in blocks
+    size_t count = samples.size();
+    size_t latency = preprocessor.latency();
+    samples.resize(count + latency, 0.0);
+    for (size_t position = 0; position < samples.size(); position += kPreprocessBlockSize) {
+        preprocessor.process(samples.data() + position, std::min(kPreprocessBlockSize, samples.size() - position));
+    }
+
+    // Dropping the latency and applying the gain share one sweep
+    double gain = preprocessor.normalizationGain();
+    for (size_t i = 0; i < count; i++) samples[i] = samples[i + latency] * gain;
+    samples.resize(count);
+}
+
+void removeNoise(std::vector<double>& samples, int sampleRate) {
+    PreprocessOptions options;
+    options.highPassHz = 0.0;
+    options.lowPassHz = 0.0;
+    options.normalize = false;
+    preprocessAudio(samples, sampleRate, options);
+}
+
+void normalizeAudio(std::vector<double>& samples, double targetPeak) {
+    double peak = 0.0;
+    for (double sample : samples) peak = std::max(peak, std::fabs(sample));
+    if (peak <= 0.0) return;
+
+    double gain = targetPeak / peak;
+    for (double& sample : samples) sample *= gain;
+}
+
+void applyHighPassFilter(std::vector<double>& samples, int sampleRate, double cutoffFreq) {
+    BiquadCascade filter;
+    if (sampleRate <= 0 || !filter.addButterworthHighPass(sampleRate, cutoffFreq)) return;
+    filter.process(samples.data(), samples.size());
+}
+
+void applyLowPassFilter(std::vector<double>& samples, int sampleRate, double cutoffFreq) {
+    BiquadCascade filter;
+    if (sampleRate <= 0 || !filter.addButterworthLowPass(sampleRate, cutoffFreq)) return;
+    filter.process(samples.data(), samples.size());
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,170 @@
+#ifndef TAJWEED_PREPROCESS_H
+#define TAJWEED_PREPROCESS_H
+
+#include "audio_source.h"
+#include "fft.h"
+#include "scratch.h"
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Samples per block of the fused preprocessing pass
+const size_t kPreprocessBlockSize = 4096;
+
+struct PreprocessOptions {
+    bool enabled = false;          // read by extractFeatures; the functions below always run
+    double highPassHz = 60.0;      // removes DC and handling rumble; <= 0 disables
+    double lowPassHz = 7600.0;     // removes hiss above the speech band; <= 0 or >= 0.45 * rate disables
+    bool denoise = true;           // spectral subtraction
+    double oversubtraction = 2.0;  // multiple of the noise estimate removed from each bin
+    double spectralFloor = 0.02;   // minimum power gain, limits musical noise
+    bool normalize = true;         // scale to targetPeak (gain capped at maxGain)
+    double targetPeak = 0.9;
+    double maxGain = 10.0;
+};
+
+// One second-order IIR section in transposed direct form II. Coefficients
+// follow the RBJ audio EQ cookbook with a0 normalized to 1.
+struct Biquad {
+    double b0 = 1.0, b1 = 0.0, b2 = 0.0;
+    double a1 = 0.0, a2 = 0.0;
+    double z1 = 0.0, z2 = 0.0;
+
+    static Biquad highPass(int sampleRate, double cutoffHz, double q);
+    static Biquad lowPass(int sampleRate, double cutoffHz, double q);
+
+    double process(double x) {
+        double y = b0 * x + z1;
+        z1 = b1 * x - a1 * y + z2;
+        z2 = b2 * x - a2 * y;
+        return y;
+    }
+
+    void clearState() { z1 = z2 = 0.0; }
+};
+
+// Up to kMaxSections biquads run sample by sample through every section, so
+// a block is read and written once whatever the filter order.
+class BiquadCascade {
+public:
+    static const size_t kMaxSections = 4;
+
+    void clear() { numSections_ = 0; }
+    bool add(const Biquad& section);
+    size_t numSections() const { return numSections_; }
+
+    // Adds a 4th-order Butterworth high- or low-pass (two sections)
+    bool addButterworthHighPass(int sampleRate, double cutoffHz);
+    bool addButterworthLowPass(int sampleRate, double cutoffHz);
+
+    // Filters in place; state carries over to the next block
+    void process(double* samples, size_t count);
+    void clearState();
+
+private:
+    Biquad sections_[kMaxSections];
+    size_t numSections_ = 0;
+};
+
+// Frame-wise spectral subtraction with overlap-add resynthesis (square-root
+// Hann windows, 50% overlap). The noise spectrum starts from the first
+// frames and keeps adapting on frames close to the noise floor. Output is
+// delayed by latency() samples.
+class SpectralDenoiser {
+public:
+    void configure(int sampleRate, double oversubtraction, double spectralFloor);
+    void clearState();
+
+    // Replaces `count` samples with denoised output from latency() samples earlier
+    void process(double* samples, size_t count);
+
+    size_t latency() const { return frameSize_; }
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    void processFrame();
+
+    int sampleRate_ = 0;
+    size_t frameSize_ = 0;
+    size_t hopSize_ = 0;
+    double oversubtraction_ = 2.0;
+    double spectralFloor_ = 0.02;
+
+    std::shared_ptr<const FftPlan> plan_;
+    std::vector<double> window_;                 // sqrt of periodic Hann
+    std::vector<double> input_;                  // last frameSize_ input samples
+    std::vector<double> frame_;
+    std::vector<double> accumulator_;            // overlap-add sum
+    std::vector<double> output_;                 // hopSize_ samples ready to emit
+    std::vector<std::complex<double>> bins_;
+    std::vector<double> noise_;                  // noise power per bin
+    size_t fill_ = 0;                            // input samples gathered for the next frame
+    size_t framesSeen_ = 0;
+    AllocationStats stats_;
+};
+
+// Filters, denoiser and peak tracking run as one pass over fixed-size
+// blocks. Output of the denoiser trails the input by latency() samples.
+class Preprocessor {
+public:
+    // Rebuilds the chain when the rate or options changed; always clears state
+    void configure(int sampleRate, const PreprocessOptions& options);
+
+    // Processes one block in place and tracks the output peak
+    void process(double* samples, size_t count);
+
+    size_t latency() const { return options_.denoise ? denoiser_.latency() : 0; }
+    double peak() const { return peak_; }
+    // Gain that brings the peak seen so far to the target (1 when normalization is off)
+    double normalizationGain() const;
+
+    AllocationStats stats() const;
+
+private:
+    int sampleRate_ = 0;
+    PreprocessOptions options_;
+    BiquadCascade filters_;
+    SpectralDenoiser denoiser_;
+    double peak_ = 0.0;
+};
+
+// A source run through the preprocessing chain once, block by block, and
+// kept as floats. Normalization is applied as a gain when samples are read.
+// Reusable: process() keeps the buffer's capacity.
+class PreprocessedSource : public SampleSource {
+public:
+    void process(const SampleSource& input, const PreprocessOptions& options);
+
+    int sampleRate() const override { return sampleRate_; }
+    int channels() const override { return channels_; }
+    size_t frameCount() const override { return frameCount_; }
+    size_t read(size_t start, size_t count, double* out) const override;
+
+    AllocationStats stats() const;
+
+private:
+    Preprocessor preprocessor_;
+    std::vector<float> samples_;                 // latency + frameCount_ processed samples
+    std::vector<double> block_;
+    size_t offset_ = 0;                          // preprocessor latency
+    size_t frameCount_ = 0;
+    int sampleRate_ = 0;
+    int channels_ = 0;
+    double gain_ = 1.0;
+    AllocationStats stats_;
+};
+
+// In-place processing of samples already in memory
+void preprocessAudio(std::vector<double>& samples, int sampleRate,
+                     const PreprocessOptions& options = PreprocessOptions());
+void removeNoise(std::vector<double>& samples, int sampleRate);
+void normalizeAudio(std::vector<double>& samples, double targetPeak = 0.9);
+void applyHighPassFilter(std::vector<double>& samples, int sampleRate, double cutoffFreq);
+void applyLowPassFilter(std::vector<double>& samples, int sampleRate, double cutoffFreq);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_PREPROCESS_H
@@ -0,0 +1,361 @@
+#include "reference_index.h"
+#include "frame_distance.h"
+#include "perf_stats.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <limits>
+
+namespace TajweedAudio {
+
+namespace {
+
+const double kInf = std::numeric_limits<double>::infinity();
+
+// Lloyd iterations when clustering; the lists only steer the shortlist, so
+// a rough partition is as good as a converged one
+const int kClusterIterations = 8;
+
+// Sketch columns: the MFCCs, then normalized pitch and log energy
+const size_t kSketchColumns[kNumMfcc + 2] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12,
+                                             2 * kNumMfcc, 2 * kNumMfcc + 1};
+static_assert(kNumMfcc == 13, "kSketchColumns lists the MFCC columns");
+
+// Mean and deviation of `count` sketch columns over a segment, for z-scoring
+// it on its own: a segment cut from a long recording is scaled like the
+// rest of that recording, and a take like itself
+void segmentStats(const float* frames, size_t numFrames, const size_t* columns, size_t count,
+                  double* mean, double* scale) {
+    for (size_t c = 0; c < count; c++) {
+        double sum = 0.0, sumSquares = 0.0;
+        for (size_t f = 0; f < numFrames; f++) {
+            double value = frames[f * kFeatureStride + columns[c]];
+            sum += value;
+            sumSquares += value * value;
+        }
+        mean[c] = numFrames > 0 ? sum / numFrames : 0.0;
+        double variance = numFrames > 0 ? sumSquares / numFrames - mean[c] * mean[c] : 0.0;
+        scale[c] = variance > 1e-12 ? 1.0 / sqrt(variance) : 0.0;
+    }
+}
+
+// Rows of the banded sketch DTW
+struct SketchScratch {
+    double prev[kSketchFrames + 1];
+    double curr[kSketchFrames + 1];
+};
+
+} // namespace
+
+void poolEmbedding(const float* frames, size_t numFrames, float* embedding) {
+    std::fill(embedding, embedding + kEmbeddingDims, 0.0f);
+    if (numFrames == 0) return;
+
+    double mean[kNumMfcc], scale[kNumMfcc];
+    segmentStats(frames, numFrames, kSketchColumns, kNumMfcc, mean, scale);
+
+    for (size_t s = 0; s < kEmbeddingSections; s++) {
+        size_t begin = s * numFrames / kEmbeddingSections;
+        size_t end = std::max(begin + 1, (s + 1) * numFrames / kEmbeddingSections);
+        float* out = embedding + s * 2 * kNumMfcc;
+        for (size_t c = 0; c < kNumMfcc; c++) {
+            double sum = 0.0, sumSquares = 0.0;
+            for (size_t f = begin; f < end; f++) {
+                double value = (frames[f * kFeatureStride + c] - mean[c]) * scale[c];
+                sum += value;
+                sumSquares += value * value;
+            }
+            double sectionMean = sum / (end - begin);
+            out[c] = static_cast<float>(sectionMean);
+            out[kNumMfcc + c] = static_cast<float>(sqrt(std::max(0.0, sumSquares / (end - begin) - sectionMean * sectionMean)));
+        }
+    }
+}
+
+void sketchFrames(const float* frames, size_t numFrames, float* sketch) {
+    std::fill(sketch, sketch + kSketchFrames * kSketchDims, 0.0f);
+    if (numFrames == 0) return;
+
+    const size_t columns = kNumMfcc + 2;
+    double mean[kNumMfcc + 2], scale[kNumMfcc + 2];
+    segmentStats(frames, numFrames, kSketchColumns, columns, mean, scale);
+
+    // Segments shorter than the sketch repeat frames rather than leave gaps
+    for (size_t k = 0; k < kSketchFrames; k++) {
+        size_t begin = k * numFrames / kSketchFrames;
+        size_t end = std::max(begin + 1, (k + 1) * numFrames / kSketchFrames);
+        float* out = sketch + k * kSketchDims;
+        for (size_t c = 0; c < columns; c++) {
+            double sum = 0.0;
+            for (size_t f = begin; f < end; f++) sum += frames[f * kFeatureStride + kSketchColumns[c]];
+            out[c] = static_cast<float>((sum / (end - begin) - mean[c]) * scale[c]);
+        }
+    }
+}
+
+void sketchEnvelope(const float* sketch, int window, float* upper, float* lower) {
+    size_t radius = static_cast<size_t>(std::max(0, window));
+    for (size_t k = 0; k < kSketchFrames; k++) {
+        size_t lo = k > radius ? k - radius : 0;
+        size_t hi = std::min(kSketchFrames - 1, k + radius);
+        float* up = upper + k * kSketchDims;
+        float* low = lower + k * kSketchDims;
+        std::copy(sketch + lo * kSketchDims, sketch + (lo + 1) * kSketchDims, up);
+        std::copy(sketch + lo * kSketchDims, sketch + (lo + 1) * kSketchDims, low);
+        for (size_t j = lo + 1; j <= hi; j++) {
+            const float* frame = sketch + j * kSketchDims;
+            for (size_t d = 0; d < kSketchDims; d++) {
+                up[d] = std::max(up[d], frame[d]);
+                low[d] = std::min(low[d], frame[d]);
+            }
+        }
+    }
+}
+
+double lbKeogh(const float* sketch, const float* upper, const float* lower) {
+    double bound = 0.0;
+    for (size_t k = 0; k < kSketchFrames; k++) {
+        const float* frame = sketch + k * kSketchDims;
+        const float* up = upper + k * kSketchDims;
+        const float* low = lower + k * kSketchDims;
+        float sum = 0.0f;
+        for (size_t d = 0; d < kSketchDims; d++) {
+            float excess = frame[d] > up[d] ? frame[d] - up[d] : (frame[d] < low[d] ? low[d] - frame[d] : 0.0f);
+            sum += excess * excess;
+        }
+        bound += sqrt(sum);
+    }
+    return bound;
+}
+
+double sketchDistance(const float* a, const float* b, int window, double abandonThreshold) {
+    thread_local SketchScratch scratch;
+    double* prev = scratch.prev;
+    double* curr = scratch.curr;
+    size_t radius = static_cast<size_t>(std::max(0, window));
+
+    // Same steps as dtwAlign: each cell adds its frame distance to the
+    // cheapest of the diagonal, upper and left cells; out-of-band cells are
+    // infinite
+    std::fill(prev, prev + kSketchFrames + 1, kInf);
+    prev[0] = 0.0;
+    for (size_t i = 1; i <= kSketchFrames; i++) {
+        size_t lo = i > radius + 1 ? i - radius : 1;
+        size_t hi = std::min(kSketchFrames, i + radius);
+        std::fill(curr, curr + kSketchFrames + 1, kInf);
+        double rowMin = kInf;
+        const float* frame = a + (i - 1) * kSketchDims;
+        for (size_t j = lo; j <= hi; j++) {
+            double best = std::min(prev[j - 1], std::min(prev[j], curr[j - 1]));
+            curr[j] = best + euclideanDistance(frame, b + (j - 1) * kSketchDims, kSketchDims);
+            rowMin = std::min(rowMin, curr[j]);
+        }
+        if (rowMin > abandonThreshold) return kInf;
+        std::swap(prev, curr);
+    }
+    return prev[kSketchFrames];
+}
+
+size_t ReferenceIndex::add(const std::string& id, const float* frames, size_t numFrames,
+                           const BundleSegment* segments, size_t numSegments) {
+    size_t added = 0;
+    for (size_t s = 0; s < numSegments; s++) {
+        const BundleSegment& segment = segments[s];
+        if (segment.frameCount == 0 || segment.firstFrame + segment.frameCount > numFrames) continue;
+
+        const float* rows = frames + segment.firstFrame * kFeatureStride;
+        size_t entry = entries_.size();
+        embeddings_.resize((entry + 1) * kEmbeddingDims);
+        sketches_.resize((entry + 1) * kSketchFrames * kSketchDims);
+        poolEmbedding(rows, segment.frameCount, embeddings_.data() + entry * kEmbeddingDims);
+        sketchFrames(rows, segment.frameCount, sketches_.data() + entry * kSketchFrames * kSketchDims);
+        entries_.push_back(Entry{id, s, segment.startTime, segment.endTime});
+        added++;
+    }
+
+    // Lists built earlier no longer cover every entry
+    centroids_.clear();
+    listOffsets_.clear();
+    listEntries_.clear();
+    return added;
+}
+
+size_t ReferenceIndex::add(const std::string& id, const AudioFeatures& features) {
+    BundleSegment whole;
+    whole.startTime = 0.0;
+    whole.endTime = features.duration;
+    whole.firstFrame = 0;
+    whole.frameCount = features.frames.numFrames();
+    return add(id, features.frames.data(), features.frames.numFrames(), &whole, 1);
+}
+
+void ReferenceIndex::build() {
+    centroids_.clear();
+    listOffsets_.clear();
+    listEntries_.clear();
+    size_t n = entries_.size();
+    if (n < kMinClusteredEntries) return;
+
+    // k-means from evenly spaced entries, so a rebuild of the same library
+    // gives the same lists
+    size_t lists = static_cast<size_t>(sqrt(static_cast<double>(n)) + 0.5);
+    centroids_.resize(lists * kEmbeddingDims);
+    for (size_t l = 0; l < lists; l++) {
+        const float* seed = embeddings_.data() + (l * n / lists) * kEmbeddingDims;
+        std::copy(seed, seed + kEmbeddingDims, centroids_.data() + l * kEmbeddingDims);
+    }
+
+    std::vector<size_t> assignment(n, 0);
+    std::vector<double> sums(lists * kEmbeddingDims);
+    std::vector<size_t> counts(lists);
+    for (int iteration = 0; iteration < kClusterIterations; iteration++) {
+        bool moved = false;
+        for (size_t e = 0; e < n; e++) {
+            const float* embedding = embeddings_.data() + e * kEmbeddingDims;
+            size_t nearest = 0;
+            float nearestDistance = std::numeric_limits<float>::max();
+            for (size_t l = 0; l < lists; l++) {
+                float distance = squaredEuclideanDistance(embedding, centroids_.data() + l * kEmbeddingDims, kEmbeddingDims);
+                if (distance < nearestDistance) {
+                    nearestDistance = distance;
+                    nearest = l;
+                }
+            }
+            if (iteration == 0 || assignment[e] != nearest) moved = true;
+            assignment[e] = nearest;
+        }
+        if (!moved) break;
+
+        // Lists left empty keep their centroid
+        std::fill(sums.begin(), sums.end(), 0.0);
+        std::fill(counts.begin(), counts.end(), 0);
+        for (size_t e = 0; e < n; e++) {
+            const float* embedding = embeddings_.data() + e * kEmbeddingDims;
+            double* sum = sums.data() + assignment[e] * kEmbeddingDims;
+            for (size_t d = 0; d < kEmbeddingDims; d++) sum[d] += embedding[d];
+            counts[assignment[e]]++;
+        }
+        for (size_t l = 0; l < lists; l++) {
+            if (counts[l] == 0) continue;
+            for (size_t d = 0; d < kEmbeddingDims; d++) {
+                centroids_[l * kEmbeddingDims + d] = static_cast<float>(sums[l * kEmbeddingDims + d] / counts[l]);
+            }
+        }
+    }
+
+    // Entries grouped by list, in counting-sort order
+    std::fill(counts.begin(), counts.end(), 0);
+    for (size_t e = 0; e < n; e++) counts[assignment[e]]++;
+    listOffsets_.assign(lists + 1, 0);
+    for (size_t l = 0; l < lists; l++) listOffsets_[l + 1] = listOffsets_[l] + counts[l];
+    listEntries_.resize(n);
+    std::vector<size_t> fill(listOffsets_.begin(), listOffsets_.end() - 1);
+    for (size_t e = 0; e < n; e++) listEntries_[fill[assignment[e]]++] = e;
+}
+
+void ReferenceIndex::clear() {
+    entries_.clear();
+    embeddings_.clear();
+    sketches_.clear();
+    centroids_.clear();
+    listOffsets_.clear();
+    listEntries_.clear();
+}
+
+void ReferenceIndex::shortlist(const float* embedding, const IndexSearchOptions& options,
+                               std::vector<std::pair<float, size_t>>& candidates, IndexSearchStats& stats) const {
+    candidates.clear();
+    auto scan = [&](size_t e) {
+        candidates.emplace_back(squaredEuclideanDistance(embedding, embeddings_.data() + e * kEmbeddingDims, kEmbeddingDims), e);
+    };
+
+    if (clustered()) {
+        size_t lists = listOffsets_.size() - 1;
+        std::vector<std::pair<float, size_t>> nearest(lists);
+        for (size_t l = 0; l < lists; l++) {
+            nearest[l] = {squaredEuclideanDistance(embedding, centroids_.data() + l * kEmbeddingDims, kEmbeddingDims), l};
+        }
+        size_t probes = std::min(std::max<size_t>(options.probes, 1), lists);
+        std::partial_sort(nearest.begin(), nearest.begin() + probes, nearest.end());
+        for (size_t p = 0; p < probes; p++) {
+            size_t l = nearest[p].second;
+            for (size_t i = listOffsets_[l]; i < listOffsets_[l + 1]; i++) scan(listEntries_[i]);
+        }
+    } else {
+        for (size_t e = 0; e < entries_.size(); e++) scan(e);
+    }
+    stats.scanned = candidates.size();
+
+    size_t keep = std::min(std::max<size_t>(options.shortlist, 1), candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + keep, candidates.end());
+    candidates.resize(keep);
+    stats.shortlisted = keep;
+}
+
+void ReferenceIndex::search(const FeatureMatrix& frames, size_t k, const IndexSearchOptions& options,
+                            std::vector<IndexMatch>& matches, IndexSearchStats* stats) const {
+    TAJWEED_PERF_SCOPE(Search);
+    auto started = std::chrono::steady_clock::now();
+    IndexSearchStats local;
+    local.entries = entries_.size();
+    matches.clear();
+
+    if (k > 0 && !entries_.empty() && !frames.empty()) {
+        float embedding[kEmbeddingDims];
+        float sketch[kSketchFrames * kSketchDims];
+        float upper[kSketchFrames * kSketchDims];
+        float lower[kSketchFrames * kSketchDims];
+        poolEmbedding(frames.data(), frames.numFrames(), embedding);
+        sketchFrames(frames.data(), frames.numFrames(), sketch);
+        sketchEnvelope(sketch, options.window, upper, lower);
+
+        std::vector<std::pair<float, size_t>> candidates;
+        shortlist(embedding, options, candidates, local);
+
+        // Cheapest bound first, so the k-th best distance tightens early and
+        // cuts off the rest of the shortlist
+        std::vector<std::pair<double, size_t>> bounds;
+        bounds.reserve(candidates.size());
+        for (const auto& candidate : candidates) {
+            const float* other = sketches_.data() + candidate.second * kSketchFrames * kSketchDims;
+            bounds.emplace_back(lbKeogh(other, upper, lower), candidate.second);
+        }
+        std::sort(bounds.begin(), bounds.end());
+
+        std::vector<std::pair<double, size_t>> best;  // sorted, at most k
+        for (size_t b = 0; b < bounds.size(); b++) {
+            double kth = best.size() == k ? best.back().first : kInf;
+            if (bounds[b].first >= kth) {
+                local.pruned += bounds.size() - b;
+                break;
+            }
+
+            size_t e = bounds[b].second;
+            double distance = sketchDistance(sketches_.data() + e * kSketchFrames * kSketchDims, sketch, options.window, kth);
+            local.aligned++;
+            if (distance >= kth) continue;
+
+            auto at = std::upper_bound(best.begin(), best.end(), std::make_pair(distance, e));
+            best.insert(at, std::make_pair(distance, e));
+            if (best.size() > k) best.pop_back();
+        }
+
+        for (const auto& found : best) {
+            const Entry& entry = entries_[found.second];
+            IndexMatch match;
+            match.id = entry.id;
+            match.segment = entry.segment;
+            match.startTime = entry.startTime;
+            match.endTime = entry.endTime;
+            match.distance = found.first;
+            match.similarity = 1.0 / (1.0 + found.first / kSketchFrames);
+            match.score = match.similarity * 100.0;
+            matches.push_back(match);
+        }
+    }
+
+    local.searchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - started).count();
+    if (stats) *stats = local;
+}
+
+} // namespace TajweedAudio
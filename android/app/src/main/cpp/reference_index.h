@@ -0,0 +1,121 @@
+#ifndef TAJWEED_REFERENCE_INDEX_H
+#define TAJWEED_REFERENCE_INDEX_H
+
+#include "audio_features.h"
+#include "feature_matrix.h"
+#include "feature_store.h"
+#include <cstddef>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Pooled embedding: mean and deviation of the z-scored MFCCs over each
+// third of a segment. Whole-segment statistics are 0 and 1 by construction,
+// so the thirds carry what the embedding knows about its shape.
+const size_t kEmbeddingSections = 3;
+const size_t kEmbeddingDims = 80;  // 2 x 3 x kNumMfcc, padded to a multiple of 4
+
+// Sketch: a segment average-pooled to a fixed number of frames of its
+// z-scored MFCCs, pitch and energy, so every candidate is the same length
+// for LB_Keogh and a banded DTW
+const size_t kSketchFrames = 48;
+const size_t kSketchDims = 16;     // kNumMfcc + 2, padded to a multiple of 4
+
+static_assert(kEmbeddingDims >= 2 * kEmbeddingSections * kNumMfcc, "embedding does not fit");
+static_assert(kSketchDims >= kNumMfcc + 2, "sketch frame does not fit");
+
+// Fixed-size summaries of FeatureMatrix rows (kFeatureStride floats apart)
+void poolEmbedding(const float* frames, size_t numFrames, float* embedding);
+void sketchFrames(const float* frames, size_t numFrames, float* sketch);
+
+// Per-dimension envelope of a sketch over +/-window frames, and the
+// LB_Keogh bound it gives on the banded DTW distance of any other sketch:
+// every frame of `sketch` is at least its distance to the envelope box away
+// from whichever frame within the band it is matched to
+void sketchEnvelope(const float* sketch, int window, float* upper, float* lower);
+double lbKeogh(const float* sketch, const float* upper, const float* lower);
+
+// DTW distance between two sketches within a Sakoe-Chiba band of `window`
+// frames, with dtwAlign's steps and Euclidean frame cost; +infinity once a
+// whole row exceeds abandonThreshold
+double sketchDistance(const float* a, const float* b, int window,
+                      double abandonThreshold = std::numeric_limits<double>::infinity());
+
+struct IndexSearchOptions {
+    size_t shortlist = 64;    // candidates kept by embedding distance
+    size_t probes = 8;        // lists searched once the index is clustered
+    int window = 4;           // Sakoe-Chiba radius of the sketch DTW, in sketch frames
+};
+
+struct IndexMatch {
+    std::string id;           // reference (bundle) id
+    size_t segment = 0;       // segment of that reference
+    double startTime = 0.0;   // of the segment, seconds into the reference
+    double endTime = 0.0;
+    double distance = 0.0;    // banded DTW distance between the sketches
+    double similarity = 0.0;  // 1 / (1 + distance per sketch frame)
+    double score = 0.0;       // similarity * 100
+};
+
+struct IndexSearchStats {
+    size_t entries = 0;       // segments in the index
+    size_t scanned = 0;       // embedding distances computed
+    size_t shortlisted = 0;
+    size_t pruned = 0;        // skipped on their LB_Keogh bound
+    size_t aligned = 0;       // sketch DTWs run (abandoned ones included)
+    double searchMs = 0.0;
+};
+
+// Searchable summaries of every segment of a reference library. A search
+// shortlists segments by embedding distance (every embedding, or the IVF
+// lists nearest the query once the index is clustered), orders the shortlist
+// by LB_Keogh and runs the banded sketch DTW until the bound rules out the
+// rest. Built once, then searched from any number of threads; add() and
+// build() must not run during a search.
+class ReferenceIndex {
+public:
+    // Clustering pays off from this many segments; below it every embedding is scanned
+    static const size_t kMinClusteredEntries = 512;
+
+    // Adds each segment of a reference; returns the segments added
+    size_t add(const std::string& id, const float* frames, size_t numFrames,
+               const BundleSegment* segments, size_t numSegments);
+    // The whole recording as one segment
+    size_t add(const std::string& id, const AudioFeatures& features);
+
+    // Clusters the embeddings into about sqrt(size()) inverted lists when
+    // there are at least kMinClusteredEntries; call after the last add()
+    void build();
+    void clear();
+
+    size_t size() const { return entries_.size(); }
+    bool clustered() const { return !centroids_.empty(); }
+
+    // Best k segments for a take, most similar first
+    void search(const FeatureMatrix& frames, size_t k, const IndexSearchOptions& options,
+                std::vector<IndexMatch>& matches, IndexSearchStats* stats = nullptr) const;
+
+private:
+    struct Entry {
+        std::string id;
+        size_t segment;
+        double startTime;
+        double endTime;
+    };
+
+    void shortlist(const float* embedding, const IndexSearchOptions& options,
+                   std::vector<std::pair<float, size_t>>& candidates, IndexSearchStats& stats) const;
+
+    std::vector<Entry> entries_;
+    std::vector<float> embeddings_;      // size() x kEmbeddingDims
+    std::vector<float> sketches_;        // size() x kSketchFrames x kSketchDims
+    std::vector<float> centroids_;       // lists x kEmbeddingDims
+    std::vector<size_t> listOffsets_;    // lists + 1 offsets into listEntries_
+    std::vector<size_t> listEntries_;    // entry indices grouped by list
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_REFERENCE_INDEX_H
@@ -0,0 +1,275 @@
+#include "resample.h"
+#include "perf_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define TAJWEED_NEON 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define TAJWEED_SSE2 1
+#endif
+
+namespace TajweedAudio {
+
+namespace {
+
+struct QualityParams {
+    double passband;      // fraction of the narrower Nyquist kept flat
+    double stopbandDb;    // attenuation from the narrower Nyquist up
+};
+
+const QualityParams kQualityParams[] = {
+    {0.85, 60.0},
+    {0.90, 85.0},
+    {0.94, 100.0},
+};
+
+// Zeroth-order modified Bessel function, by its power series
+double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    double quarter = x * x / 4.0;
+    for (int k = 1; k < 64 && term > sum * 1e-17; k++) {
+        term *= quarter / (static_cast<double>(k) * k);
+        sum += term;
+    }
+    return sum;
+}
+
+double sinc(double x) {
+    if (fabs(x) < 1e-12) return 1.0;
+    return sin(M_PI * x) / (M_PI * x);
+}
+
+// Taps come in multiples of four, so the scalar loop only runs without SIMD
+float dotProduct(const float* a, const float* b, size_t count) {
+    size_t i = 0;
+    float sum = 0.0f;
+
+#if defined(TAJWEED_NEON)
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    for (; i + 8 <= count; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    for (; i + 4 <= count; i += 4) acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    float32x4_t acc = vaddq_f32(acc0, acc1);
+#if defined(__aarch64__)
+    sum = vaddvq_f32(acc);
+#else
+    float32x2_t pair = vadd_f32(vget_low_f32(acc), vget_high_f32(acc));
+    sum = vget_lane_f32(vpadd_f32(pair, pair), 0);
+#endif
+#elif defined(TAJWEED_SSE2)
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    for (; i + 4 <= count; i += 4) acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    __m128 shuffled = _mm_shuffle_ps(acc, acc, _MM_SHUFFLE(2, 3, 0, 1));
+    __m128 sums = _mm_add_ps(acc, shuffled);
+    shuffled = _mm_movehl_ps(shuffled, sums);
+    sums = _mm_add_ss(sums, shuffled);
+    sum = _mm_cvtss_f32(sums);
+#endif
+
+    for (; i < count; i++) sum += a[i] * b[i];
+    return sum;
+}
+
+} // namespace
+
+bool PolyphaseResampler::configure(int inputRate, int outputRate, ResampleQuality quality) {
+    if (inputRate <= 0 || outputRate <= 0) {
+        inputRate_ = outputRate_ = 0;
+        taps_ = phases_ = 0;
+        return false;
+    }
+    if (inputRate == inputRate_ && outputRate == outputRate_ && quality == quality_ && taps_ > 0) {
+        clearState();
+        return true;
+    }
+    inputRate_ = inputRate;
+    outputRate_ = outputRate;
+    quality_ = quality;
+
+    uint64_t divisor = std::gcd(inputRate, outputRate);
+    up_ = static_cast<uint64_t>(outputRate) / divisor;
+    down_ = static_cast<uint64_t>(inputRate) / divisor;
+    phases_ = static_cast<size_t>(std::min<uint64_t>(up_, kMaxPhases));
+
+    // Flat to passband * Nyquist, stopband from Nyquist, both of the lower
+    // rate; Kaiser's estimate gives the length for that transition
+    const QualityParams& params = kQualityParams[static_cast<int>(quality)];
+    double nyquist = std::min(inputRate, outputRate) / 2.0;
+    double transition = 2.0 * M_PI * (1.0 - params.passband) * nyquist / inputRate;
+    double length = (params.stopbandDb - 8.0) / (2.285 * transition);
+    taps_ = std::max<size_t>(8, (static_cast<size_t>(ceil(length)) + 3) & ~static_cast<size_t>(3));
+    double beta = 0.1102 * (params.stopbandDb - 8.7);
+    double cutoff = (1.0 + params.passband) * nyquist / inputRate;  // fraction of the input Nyquist
+
+    // Row r holds the taps for an output r / phases_ of the way from one
+    // input to the next, centred on it and normalized to unit DC gain
+    size_t half = taps_ / 2;
+    float* coefficients = growScratch(coefficients_, phases_ * taps_, stats_);
+    double norm = besselI0(beta);
+    for (size_t r = 0; r < phases_; r++) {
+        double fraction = static_cast<double>(r) / phases_;
+        float* row = coefficients + r * taps_;
+        double sum = 0.0;
+        for (size_t k = 0; k < taps_; k++) {
+            double offset = static_cast<double>(k) - (half - 1) - fraction;
+            double x = std::min(1.0, fabs(offset) / half);
+            double value = cutoff * sinc(cutoff * offset) * besselI0(beta * sqrt(1.0 - x * x)) / norm;
+            row[k] = static_cast<float>(value);
+            sum += value;
+        }
+        for (size_t k = 0; k < taps_; k++) row[k] = static_cast<float>(row[k] / sum);
+    }
+
+    growScratch(history_, taps_ + kResampleBlockSize, stats_);
+    clearState();
+    return true;
+}
+
+void PolyphaseResampler::clearState() {
+    // The first output's taps reach half_ - 1 samples before the input
+    filled_ = taps_ > 0 ? taps_ / 2 - 1 : 0;
+    std::fill(history_.begin(), history_.begin() + filled_, 0.0f);
+    next_ = 0;
+    phase_ = 0;
+    consumed_ = 0;
+    produced_ = 0;
+}
+
+size_t PolyphaseResampler::maxOutput(size_t count) const {
+    if (taps_ == 0) return 0;
+    return static_cast<size_t>(count * up_ / down_) + 2;
+}
+
+size_t PolyphaseResampler::outputLength(size_t count) const {
+    if (taps_ == 0) return 0;
+    return static_cast<size_t>((count * up_ + down_ - 1) / down_);
+}
+
+size_t PolyphaseResampler::process(const double* input, size_t count, double* output) {
+    if (taps_ == 0) return 0;
+    consumed_ += count;
+    return consume(input, count, output, UINT64_MAX);
+}
+
+size_t PolyphaseResampler::flush(double* output) {
+    if (taps_ == 0) return 0;
+    // Trailing zeros complete the lookahead of the last outputs
+    return consume(nullptr, taps_ / 2, output, outputLength(consumed_));
+}
+
+size_t PolyphaseResampler::consume(const double* input, size_t count, double* output, uint64_t limit) {
+    size_t written = 0;
+    while (count > 0) {
+        size_t n = std::min(count, history_.size() - filled_);
+        if (n == 0) break;  // output limit reached, history not draining
+        float* tail = history_.data() + filled_;
+        if (input) {
+            for (size_t i = 0; i < n; i++) tail[i] = static_cast<float>(input[i]);
+            input += n;
+        } else {
+            std::fill(tail, tail + n, 0.0f);
+        }
+        filled_ += n;
+        count -= n;
+        written += produce(output + written, limit);
+    }
+    return written;
+}
+
+size_t PolyphaseResampler::produce(double* output, uint64_t limit) {
+    const float* history = history_.data();
+    const float* coefficients = coefficients_.data();
+    size_t written = 0;
+    while (next_ + taps_ <= filled_ && produced_ < limit) {
+        size_t row = phases_ == up_ ? static_cast<size_t>(phase_) : static_cast<size_t>(phase_ * phases_ / up_);
+        output[written++] = dotProduct(history + next_, coefficients + row * taps_, taps_);
+        produced_++;
+        phase_ += down_;
+        next_ += static_cast<size_t>(phase_ / up_);
+        phase_ %= up_;
+    }
+
+    // Keep only the history the next output still needs
+    if (next_ > 0) {
+        size_t keep = filled_ - std::min(next_, filled_);
+        std::copy(history_.begin() + next_, history_.begin() + next_ + keep, history_.begin());
+        filled_ = keep;
+        next_ = 0;
+    }
+    return written;
+}
+
+void ResampledSource::process(const SampleSource& input, int outputRate, ResampleQuality quality) {
+    TAJWEED_PERF_SCOPE(Resample);
+    channels_ = input.channels();
+    if (!resampler_.configure(input.sampleRate(), outputRate, quality)) {
+        sampleRate_ = 0;
+        frameCount_ = 0;
+        return;
+    }
+    sampleRate_ = outputRate;
+
+    size_t inputCount = input.frameCount();
+    frameCount_ = resampler_.outputLength(inputCount);
+    float* stored = growScratch(samples_, frameCount_, stats_);
+    double* block = growScratch(input_, kResampleBlockSize, stats_);
+    double* converted = growScratch(output_, std::max(resampler_.maxOutput(kResampleBlockSize),
+                                                      resampler_.flushSize()), stats_);
+
+    size_t written = 0;
+    auto store = [&](size_t count) {
+        count = std::min(count, frameCount_ - written);
+        for (size_t i = 0; i < count; i++) stored[written + i] = static_cast<float>(converted[i]);
+        written += count;
+    };
+    for (size_t position = 0; position < inputCount; position += kResampleBlockSize) {
+        size_t count = input.read(position, std::min(kResampleBlockSize, inputCount - position), block);
+        store(resampler_.process(block, count, converted));
+        if (count == 0) break;
+    }
+    store(resampler_.flush(converted));
+    frameCount_ = written;
+}
+
+size_t ResampledSource::read(size_t start, size_t count, double* out) const {
+    if (start >= frameCount_) return 0;
+    size_t n = std::min(count, frameCount_ - start);
+    const float* samples = samples_.data() + start;
+    for (size_t i = 0; i < n; i++) out[i] = samples[i];
+    return n;
+}
+
+AllocationStats ResampledSource::stats() const {
+    AllocationStats total = stats_;
+    total += resampler_.stats();
+    return total;
+}
+
+std::vector<double> resampleAudio(const std::vector<double>& samples, int inputRate, int outputRate,
+                                  ResampleQuality quality) {
+    if (inputRate == outputRate) return samples;
+    PolyphaseResampler resampler;
+    if (!resampler.configure(inputRate, outputRate, quality)) return std::vector<double>();
+
+    std::vector<double> output(resampler.maxOutput(samples.size()) + resampler.flushSize());
+    size_t written = resampler.process(samples.data(), samples.size(), output.data());
+    written += resampler.flush(output.data() + written);
+    output.resize(written);
+    return output;
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,116 @@
+#ifndef TAJWEED_RESAMPLE_H
+#define TAJWEED_RESAMPLE_H
+
+#include "audio_source.h"
+#include "scratch.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Rate every recording is analyzed at. Speech features live below 8 kHz, so
+// 44.1/48 kHz input only multiplies the frame count.
+const int kAnalysisSampleRate = 16000;
+
+// Input samples per block of the streaming conversion
+const size_t kResampleBlockSize = 4096;
+
+// Filter length against cost. Each step doubles the taps per output sample.
+enum class ResampleQuality {
+    Fast = 0,       // ~60 dB stopband, 85% of the output band kept
+    Balanced = 1,   // ~85 dB stopband, 90% kept
+    Best = 2        // ~100 dB stopband, 94% kept
+};
+
+struct ResampleOptions {
+    bool enabled = false;                          // read by extractFeatures
+    int targetRate = kAnalysisSampleRate;
+    ResampleQuality quality = ResampleQuality::Balanced;
+};
+
+// Rational-ratio polyphase resampler with a Kaiser-windowed sinc prototype.
+// The rate ratio is reduced to up/down; each output sample is one dot
+// product of a phase's taps with the input history (NEON/SSE2 where
+// available). Output is time-aligned with the input: no group delay.
+// Ratios with more than kMaxPhases phases use the nearest lower phase.
+class PolyphaseResampler {
+public:
+    static const size_t kMaxPhases = 1024;
+
+    // Builds the filter bank; false if either rate is not positive
+    bool configure(int inputRate, int outputRate, ResampleQuality quality = ResampleQuality::Balanced);
+    void clearState();
+
+    // Upper bound on the samples process() writes for `count` inputs
+    size_t maxOutput(size_t count) const;
+
+    // Consumes `count` input samples and writes the outputs they complete
+    size_t process(const double* input, size_t count, double* output);
+
+    // Writes the outputs still held back for lookahead, at most flushSize()
+    size_t flush(double* output);
+    size_t flushSize() const { return maxOutput(taps_ / 2); }
+
+    // Output samples for `count` inputs once flushed
+    size_t outputLength(size_t count) const;
+
+    int inputRate() const { return inputRate_; }
+    int outputRate() const { return outputRate_; }
+    size_t tapsPerPhase() const { return taps_; }
+    size_t numPhases() const { return phases_; }
+
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    size_t consume(const double* input, size_t count, double* output, uint64_t limit);
+    size_t produce(double* output, uint64_t limit);
+
+    int inputRate_ = 0;
+    int outputRate_ = 0;
+    ResampleQuality quality_ = ResampleQuality::Balanced;
+    uint64_t up_ = 1;
+    uint64_t down_ = 1;
+    size_t phases_ = 0;
+    size_t taps_ = 0;                    // per phase, a multiple of 4
+    std::vector<float> coefficients_;    // phases_ x taps_
+    std::vector<float> history_;         // taps_ + kResampleBlockSize input samples
+    size_t filled_ = 0;
+    size_t next_ = 0;                    // history index of the next output's first tap
+    uint64_t phase_ = 0;                 // position between inputs, in 1/up_ steps
+    uint64_t consumed_ = 0;
+    uint64_t produced_ = 0;
+    AllocationStats stats_;
+};
+
+// A source converted to another rate once, block by block, and kept as
+// floats. Reusable: process() keeps the buffer's capacity.
+class ResampledSource : public SampleSource {
+public:
+    void process(const SampleSource& input, int outputRate, ResampleQuality quality = ResampleQuality::Balanced);
+
+    int sampleRate() const override { return sampleRate_; }
+    int channels() const override { return channels_; }
+    size_t frameCount() const override { return frameCount_; }
+    size_t read(size_t start, size_t count, double* out) const override;
+
+    AllocationStats stats() const;
+
+private:
+    PolyphaseResampler resampler_;
+    std::vector<float> samples_;
+    std::vector<double> input_;
+    std::vector<double> output_;
+    size_t frameCount_ = 0;
+    int sampleRate_ = 0;
+    int channels_ = 0;
+    AllocationStats stats_;
+};
+
+// Converts samples already in memory; returns them unchanged when the rates match
+std::vector<double> resampleAudio(const std::vector<double>& samples, int inputRate, int outputRate,
+                                  ResampleQuality quality = ResampleQuality::Balanced);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_RESAMPLE_H
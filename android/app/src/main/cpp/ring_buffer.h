@@ -0,0 +1,84 @@
+#ifndef TAJWEED_RING_BUFFER_H
+#define TAJWEED_RING_BUFFER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Lock-free ring for exactly one producer thread and one consumer thread,
+// e.g. a recording callback handing PCM to an analysis thread. Neither side
+// blocks or allocates; each owns one index and only reads the other's.
+// Capacity is rounded up to a power of two.
+template <typename T>
+class SpscRing {
+public:
+    explicit SpscRing(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size <<= 1;
+        buffer_.resize(size);
+        mask_ = size - 1;
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    size_t capacity() const { return buffer_.size(); }
+
+    // Producer: copies up to `count` items, fewer when the ring is full;
+    // returns how many were written
+    size_t write(const T* items, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        size_t n = std::min(count, capacity() - (head - tail));
+        copyIn(head, items, n);
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer: moves up to `count` items to `out`; returns how many
+    size_t read(T* out, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t n = std::min(count, head - tail);
+        copyOut(tail, out, n);
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // Items waiting; exact on the consumer side, a lower bound elsewhere
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    // Consumer: drops everything queued so far
+    void clear() { tail_.store(head_.load(std::memory_order_acquire), std::memory_order_release); }
+
+private:
+    // Indices run freely and wrap through the mask, so a full ring is head - tail == capacity
+    void copyIn(size_t position, const T* items, size_t count) {
+        size_t start = position & mask_;
+        size_t first = std::min(count, capacity() - start);
+        std::copy(items, items + first, buffer_.begin() + start);
+        std::copy(items + first, items + count, buffer_.begin());
+    }
+
+    void copyOut(size_t position, T* out, size_t count) const {
+        size_t start = position & mask_;
+        size_t first = std::min(count, capacity() - start);
+        std::copy(buffer_.begin() + start, buffer_.begin() + start + first, out);
+        std::copy(buffer_.begin(), buffer_.begin() + (count - first), out + first);
+    }
+
+    std::vector<T> buffer_;
+    size_t mask_ = 0;
+    // On separate cache lines so the two threads do not invalidate each other's index
+    alignas(64) std::atomic<size_t> head_{0};  // next slot the producer writes
+    alignas(64) std::atomic<size_t> tail_{0};  // next slot the consumer reads
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_RING_BUFFER_H
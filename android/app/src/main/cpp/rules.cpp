@@ -0,0 +1,464 @@
+#include "rules.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Madd: vowels held at least this long are candidates, and those of at
+// least kMinMaddCounts are elongations; a held vowel breaks when F1 or F2
+// moves this far from the run's mean, or after kMaxGapFrames weak frames
+const double kMinVowelSeconds = 0.06;
+const double kMinMaddCounts = 1.5;
+const double kMaddToleranceCounts = 0.5;
+const double kMaxFormantDrift = 0.25;
+const size_t kMaxGapFrames = 1;
+
+// Ghunna: a nasal murmur is voiced, dark (low centroid) and quieter than
+// the vowels around it; it should last about two counts
+const double kNasalCentroidHz = 700.0;
+const double kNasalMaxF1Hz = 450.0;
+const double kNasalCeilingDb = -6.0;
+const double kMinNasalSeconds = 0.05;
+const double kGhunnaCounts = 2.0;
+const double kMinGhunnaCounts = 1.5;
+
+// Qalqalah: a closure below kClosureDb, then a release that rises at least
+// kMinBurstDb within kRiseFrames and falls kBurstDecayDb again within
+// kMaxBurstSeconds; releases that stay up are vowel onsets
+const double kClosureDb = -25.0;
+const size_t kClosureFrames = 3;
+const size_t kRiseFrames = 2;
+const double kMinBurstDb = 6.0;
+const double kClearBurstDb = 12.0;
+const double kBurstDecayDb = 6.0;
+const double kMaxBurstSeconds = 0.08;
+
+// Makharij: mean formant distance from the reference that is still accepted
+const double kMakharijToleranceHz = 200.0;
+
+// Tempo: one count is the median voiced run, within these bounds
+const double kDefaultHarakaSeconds = 0.2;
+const double kMinHarakaSeconds = 0.12;
+const double kMaxHarakaSeconds = 0.4;
+
+const double kSilenceDb = -120.0;
+
+class MaddDetector : public RuleDetector {
+public:
+    void begin(const RuleContext& context) override {
+        spans_.clear();
+        open_ = false;
+        floorDb_ = context.options->vowelFloorDb;
+        minFrames_ = static_cast<size_t>(ceil(kMinVowelSeconds / context.frameSeconds));
+    }
+
+    void frame(const RuleFrame& frame) override {
+        const float* formants = frame.row + FeatureColumns::Formants.offset;
+        bool held = frame.voiced && frame.energyDb > floorDb_;
+        if (held && open_ && formants[0] > 0.0f && formants[1] > 0.0f && count_ > 0) {
+            double f1 = sum_[0] / count_, f2 = sum_[1] / count_;
+            if (fabs(formants[0] / f1 - 1.0) > kMaxFormantDrift || fabs(formants[1] / f2 - 1.0) > kMaxFormantDrift) {
+                close();
+            }
+        }
+
+        if (held) {
+            if (!open_) {
+                open_ = true;
+                start_ = frame.index;
+                count_ = 0;
+                sum_[0] = sum_[1] = 0.0;
+            }
+            end_ = frame.index + 1;
+            gap_ = 0;
+            if (formants[0] > 0.0f && formants[1] > 0.0f) {
+                sum_[0] += formants[0];
+                sum_[1] += formants[1];
+                count_++;
+            }
+        } else if (open_ && ++gap_ > kMaxGapFrames) {
+            close();
+        }
+    }
+
+    void finish(const RuleContext& context, RuleEmitter& emitter) override {
+        close();
+        for (const Span& span : spans_) {
+            double counts = (span.end - span.start) * context.frameSeconds / context.harakaSeconds;
+            if (counts < kMinMaddCounts) continue;
+
+            double expected = context.options->maddCounts;
+            if (expected <= 0.0) expected = counts < 3.0 ? 2.0 : counts < 5.0 ? 4.0 : 6.0;
+            double error = fabs(counts - expected);
+            double score = 100.0 * std::max(0.0, 1.0 - error / 2.0);
+            emitter.emit(span.start, span.end, counts, expected, score, error > kMaddToleranceCounts);
+        }
+    }
+
+private:
+    struct Span {
+        size_t start;
+        size_t end;
+    };
+
+    void close() {
+        if (open_ && end_ - start_ >= minFrames_) spans_.push_back({start_, end_});
+        open_ = false;
+    }
+
+    std::vector<Span> spans_;
+    double floorDb_ = -30.0;
+    size_t minFrames_ = 1;
+    bool open_ = false;
+    size_t start_ = 0, end_ = 0, gap_ = 0, count_ = 0;
+    double sum_[2] = {};
+};
+
+class GhunnaDetector : public RuleDetector {
+public:
+    void begin(const RuleContext& context) override {
+        spans_.clear();
+        open_ = false;
+        floorDb_ = context.options->vowelFloorDb;
+        minFrames_ = static_cast<size_t>(ceil(kMinNasalSeconds / context.frameSeconds));
+    }
+
+    void frame(const RuleFrame& frame) override {
+        float centroid = frame.row[FeatureColumns::SpectralCentroid.offset];
+        float f1 = frame.row[FeatureColumns::Formants.offset];
+        bool nasal = frame.voiced && frame.energyDb > floorDb_ && frame.energyDb < kNasalCeilingDb &&
+                     centroid < kNasalCentroidHz && f1 < kNasalMaxF1Hz;
+        if (nasal) {
+            if (!open_) start_ = frame.index;
+            open_ = true;
+            end_ = frame.index + 1;
+        } else if (open_) {
+            close();
+        }
+    }
+
+    void finish(const RuleContext& context, RuleEmitter& emitter) override {
+        close();
+        for (const auto& span : spans_) {
+            double counts = (span.second - span.first) * context.frameSeconds / context.harakaSeconds;
+            double score = 100.0 * std::min(1.0, counts / kGhunnaCounts);
+            emitter.emit(span.first, span.second, counts, kGhunnaCounts, score, counts < kMinGhunnaCounts);
+        }
+    }
+
+private:
+    void close() {
+        if (open_ && end_ - start_ >= minFrames_) spans_.push_back({start_, end_});
+        open_ = false;
+    }
+
+    std::vector<std::pair<size_t, size_t>> spans_;
+    double floorDb_ = -30.0;
+    size_t minFrames_ = 1;
+    bool open_ = false;
+    size_t start_ = 0, end_ = 0;
+};
+
+class QalqalahDetector : public RuleDetector {
+public:
+    void begin(const RuleContext& context) override {
+        bursts_.clear();
+        bursting_ = false;
+        maxBurstFrames_ = static_cast<size_t>(ceil(kMaxBurstSeconds / context.frameSeconds));
+        std::fill(recent_, recent_ + kClosureFrames, 0.0);
+    }
+
+    void frame(const RuleFrame& frame) override {
+        // On entry recent_[i] holds the level of frame f - kClosureFrames + i
+        size_t f = frame.index;
+        double level = frame.energyDb;
+        if (bursting_) {
+            if (level > peakDb_ && f <= riseFrame_ + kRiseFrames) {
+                peakDb_ = level;
+                peakFrame_ = f;
+            } else if (peakDb_ - level >= kBurstDecayDb) {
+                bursts_.push_back({closureFrame_, f + 1, peakDb_ - closureDb_});
+                bursting_ = false;
+            } else if (f > peakFrame_ + maxBurstFrames_) {
+                bursting_ = false;
+            }
+        } else if (f >= kClosureFrames) {
+            // The quietest of the last few frames is the closure
+            size_t quietest = 0;
+            for (size_t i = 1; i < kClosureFrames; i++) {
+                if (recent_[i] < recent_[quietest]) quietest = i;
+            }
+            double closure = recent_[quietest];
+            if (closure < kClosureDb && level - closure >= kMinBurstDb) {
+                bursting_ = true;
+                closureDb_ = closure;
+                closureFrame_ = f - kClosureFrames + quietest;
+                riseFrame_ = peakFrame_ = f;
+                peakDb_ = level;
+            }
+        }
+
+        std::copy(recent_ + 1, recent_ + kClosureFrames, recent_);
+        recent_[kClosureFrames - 1] = level;
+    }
+
+    void finish(const RuleContext&, RuleEmitter& emitter) override {
+        for (const Burst& burst : bursts_) {
+            double score = 100.0 * std::min(1.0, burst.riseDb / kClearBurstDb);
+            emitter.emit(burst.start, burst.end, burst.riseDb, kClearBurstDb, score, burst.riseDb < kClearBurstDb);
+        }
+    }
+
+private:
+    struct Burst {
+        size_t start;
+        size_t end;
+        double riseDb;
+    };
+
+    std::vector<Burst> bursts_;
+    double recent_[kClosureFrames];
+    bool bursting_ = false;
+    size_t maxBurstFrames_ = 1;
+    size_t closureFrame_ = 0, riseFrame_ = 0, peakFrame_ = 0;
+    double closureDb_ = 0.0, peakDb_ = 0.0;
+};
+
+class MakharijDetector : public RuleDetector {
+public:
+    void begin(const RuleContext& context) override {
+        for (size_t k = 0; k < kNumFormants; k++) {
+            size_t column = FeatureColumns::Formants.offset + k;
+            reference_[k] = context.reference ? context.reference->columnMean(column, true) : 0.0;
+            sum_[k] = 0.0;
+            count_[k] = 0;
+        }
+        first_ = last_ = 0;
+        seen_ = false;
+    }
+
+    void frame(const RuleFrame& frame) override {
+        const float* formants = frame.row + FeatureColumns::Formants.offset;
+        if (formants[0] <= 0.0f) return;
+        for (size_t k = 0; k < kNumFormants; k++) {
+            if (formants[k] <= 0.0f) continue;
+            sum_[k] += formants[k];
+            count_[k]++;
+        }
+        if (!seen_) first_ = frame.index;
+        seen_ = true;
+        last_ = frame.index;
+    }
+
+    // One finding over the voiced part of the take: formants are compared
+    // as averages, since the take is not aligned to the reference here
+    void finish(const RuleContext&, RuleEmitter& emitter) override {
+        if (!seen_) return;
+        double totalDiff = 0.0;
+        for (size_t k = 0; k < kNumFormants; k++) {
+            double mean = count_[k] > 0 ? sum_[k] / count_[k] : 0.0;
+            totalDiff += fabs(mean - reference_[k]);
+        }
+        double diff = totalDiff / kNumFormants;
+        double score = 100.0 * std::max(0.0, 1.0 - diff / (2.0 * kMakharijToleranceHz));
+        emitter.emit(first_, last_ + 1, diff, kMakharijToleranceHz, score, diff >= kMakharijToleranceHz);
+    }
+
+private:
+    double reference_[kNumFormants];
+    double sum_[kNumFormants];
+    size_t count_[kNumFormants];
+    size_t first_ = 0, last_ = 0;
+    bool seen_ = false;
+};
+
+template <typename Detector>
+std::unique_ptr<RuleDetector> makeDetector() {
+    return std::unique_ptr<RuleDetector>(new Detector());
+}
+
+std::vector<RuleInfo>& registry() {
+    static std::vector<RuleInfo> rules = {
+        {"madd", "Madd", "counts", kRulePitch | kRuleEnergy | kRuleFormants | kRuleTempo, false,
+         "Madd not properly elongated", "Focus on elongating the Madd letters", makeDetector<MaddDetector>},
+        {"makharij", "Makharij", "Hz", kRuleFormants, true,
+         "Articulation point needs adjustment", "Practice the articulation points of Arabic letters",
+         makeDetector<MakharijDetector>},
+        {"ghunna", "Ghunna", "counts", kRulePitch | kRuleEnergy | kRuleSpectrum | kRuleFormants | kRuleTempo, false,
+         "Ghunna not properly pronounced", "Practice nasal sounds", makeDetector<GhunnaDetector>},
+        {"qalqalah", "Qalqalah", "dB", kRuleEnergy, false,
+         "Qalqalah not properly pronounced", "Practice the bouncing sound of Qalqalah letters",
+         makeDetector<QalqalahDetector>},
+    };
+    return rules;
+}
+
+// Collects one rule's findings, stamping them with recording times
+class EventCollector : public RuleEmitter {
+public:
+    EventCollector(const FeatureMatrix& frames, const TrimmedSource* timeline, RuleReport& report,
+                   RuleResult& result)
+        : frames_(frames), timeline_(timeline), report_(report), result_(result) {}
+
+    void emit(size_t startFrame, size_t endFrame, double measured, double expected,
+              double score, bool violation) override {
+        const RuleInfo& info = ruleRegistry()[result_.rule];
+        RuleEvent event;
+        event.rule = result_.rule;
+        event.startFrame = startFrame;
+        event.endFrame = std::max(endFrame, startFrame + 1);
+        event.startTime = time(startFrame * frames_.hopSize(), false);
+        event.endTime = time(event.endFrame * frames_.hopSize(), true);
+        event.measured = measured;
+        event.expected = expected;
+        event.score = score;
+        event.violation = violation;
+
+        char message[160];
+        snprintf(message, sizeof(message), "%s %.2f-%.2f s, measured %.1f %s vs expected %g", info.label,
+                 event.startTime, event.endTime, measured, info.unit, expected);
+        event.message = message;
+        report_.events.push_back(std::move(event));
+
+        result_.detections++;
+        if (violation) result_.violations++;
+        result_.score += score;
+    }
+
+private:
+    // Seconds into the recording of matrix sample `sample`; an end position
+    // maps its last sample so a span never runs across a dropped gap
+    double time(size_t sample, bool end) const {
+        if (frames_.sampleRate() <= 0) return 0.0;
+        if (timeline_) {
+            sample = end && sample > 0 ? timeline_->sourceSample(sample - 1) + 1 : timeline_->sourceSample(sample);
+        }
+        return static_cast<double>(sample) / frames_.sampleRate();
+    }
+
+    const FeatureMatrix& frames_;
+    const TrimmedSource* timeline_;
+    RuleReport& report_;
+    RuleResult& result_;
+};
+
+} // namespace
+
+const RuleResult* RuleReport::result(size_t rule) const {
+    for (const RuleResult& entry : results) {
+        if (entry.rule == rule) return &entry;
+    }
+    return nullptr;
+}
+
+const std::vector<RuleInfo>& ruleRegistry() {
+    return registry();
+}
+
+size_t registerRule(const RuleInfo& info) {
+    registry().push_back(info);
+    return registry().size() - 1;
+}
+
+int findRule(const std::string& name) {
+    const std::vector<RuleInfo>& rules = ruleRegistry();
+    for (size_t i = 0; i < rules.size(); i++) {
+        if (name == rules[i].name) return static_cast<int>(i);
+    }
+    return -1;
+}
+
+RuleEngine::RuleEngine() {
+    for (const RuleInfo& info : ruleRegistry()) detectors_.push_back(info.create());
+    active_.reserve(detectors_.size());
+}
+
+void RuleEngine::run(const FeatureMatrix& frames, RuleSet rules, RuleReport& report,
+                     const FeatureMatrix* reference, const TrimmedSource* timeline) {
+    const std::vector<RuleInfo>& registered = ruleRegistry();
+    report.events.clear();
+    report.results.clear();
+    report.harakaSeconds = 0.0;
+
+    // Requested rules, and the union of what they read
+    active_.clear();
+    uint32_t inputs = 0;
+    for (size_t i = 0; i < detectors_.size(); i++) {
+        if (!(rules & ruleBit(i))) continue;
+        RuleResult result;
+        result.rule = i;
+        result.evaluated = !registered[i].needsReference || (reference && !reference->empty());
+        report.results.push_back(result);
+        if (!result.evaluated) continue;
+        active_.push_back(i);
+        inputs |= registered[i].inputs;
+    }
+    if (inputs & kRuleTempo) inputs |= kRulePitch | kRuleEnergy;
+
+    RuleContext context;
+    context.frameSeconds = frames.frameSeconds();
+    context.reference = reference;
+    context.options = &options;
+    if (frames.empty() || active_.empty()) return;
+
+    // Energies are taken relative to the loudest frame, so the rules do not
+    // depend on recording level
+    double peakEnergy = 0.0;
+    if (inputs & kRuleEnergy) peakEnergy = frames.columnMax(FeatureColumns::Energy.offset);
+
+    for (size_t i : active_) detectors_[i]->begin(context);
+
+    // The one pass over the frames every requested rule shares
+    bool tempo = (inputs & kRuleTempo) && options.harakaSeconds <= 0.0;
+    size_t run = 0;
+    runs_.clear();
+    RuleFrame frame;
+    for (size_t f = 0; f < frames.numFrames(); f++) {
+        frame.index = f;
+        frame.row = frames.row(f);
+        if (inputs & kRulePitch) frame.voiced = frame.row[FeatureColumns::Pitch.offset] > 0.0f;
+        if (inputs & kRuleEnergy) {
+            double energy = frame.row[FeatureColumns::Energy.offset];
+            frame.energyDb = energy > 0.0 && peakEnergy > 0.0 ? 10.0 * log10(energy / peakEnergy) : kSilenceDb;
+        }
+        if (tempo) {
+            if (frame.voiced && frame.energyDb > options.vowelFloorDb) {
+                run++;
+            } else if (run > 0) {
+                runs_.push_back(static_cast<float>(run));
+                run = 0;
+            }
+        }
+        for (size_t i : active_) detectors_[i]->frame(frame);
+    }
+
+    // One count: the median vowel, since most vowels are short
+    if (inputs & kRuleTempo) {
+        double haraka = options.harakaSeconds;
+        if (haraka <= 0.0) {
+            if (run > 0) runs_.push_back(static_cast<float>(run));
+            float minRun = static_cast<float>(kMinVowelSeconds / context.frameSeconds);
+            runs_.erase(std::remove_if(runs_.begin(), runs_.end(), [&](float r) { return r < minRun; }), runs_.end());
+            haraka = kDefaultHarakaSeconds;
+            if (!runs_.empty()) {
+                std::nth_element(runs_.begin(), runs_.begin() + runs_.size() / 2, runs_.end());
+                haraka = runs_[runs_.size() / 2] * context.frameSeconds;
+                haraka = std::max(kMinHarakaSeconds, std::min(haraka, kMaxHarakaSeconds));
+            }
+        }
+        context.harakaSeconds = haraka;
+        report.harakaSeconds = haraka;
+    }
+
+    for (RuleResult& result : report.results) {
+        if (!result.evaluated) continue;
+        EventCollector collector(frames, timeline, report, result);
+        detectors_[result.rule]->finish(context, collector);
+        if (result.detections > 0) result.score /= result.detections;
+    }
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,142 @@
+#ifndef TAJWEED_RULES_H
+#define TAJWEED_RULES_H
+
+#include "feature_matrix.h"
+#include "formants.h"
+#include "vad.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Per-frame inputs a detector reads; the engine derives only those some
+// requested detector declares
+enum RuleInput : uint32_t {
+    kRulePitch = 1u << 0,      // RuleFrame::voiced, from the Pitch column
+    kRuleEnergy = 1u << 1,     // RuleFrame::energyDb, relative to the loudest frame
+    kRuleSpectrum = 1u << 2,   // SpectralCentroid and SpectralRolloff columns
+    kRuleFormants = 1u << 3,   // Formants columns
+    kRuleTempo = 1u << 4       // RuleContext::harakaSeconds, estimated from the voiced runs
+};
+
+// Bit i selects rule i of ruleRegistry()
+typedef uint32_t RuleSet;
+const RuleSet kAllRules = ~0u;
+inline RuleSet ruleBit(size_t index) { return index < 32 ? 1u << index : 0u; }
+
+struct RuleOptions {
+    double harakaSeconds = 0.0;    // one count; 0 estimates it from the recitation's short vowels
+    double maddCounts = 0.0;       // expected Madd length; 0 takes the nearest of 2, 4 and 6
+    double vowelFloorDb = -30.0;   // quieter frames (re the loudest) are not held vowels or nasals
+};
+
+// One frame as the engine hands it to detectors. Fields whose input no
+// requested detector declared are left at their defaults.
+struct RuleFrame {
+    size_t index = 0;
+    const float* row = nullptr;    // the FeatureMatrix row, kFeatureStride floats
+    bool voiced = false;
+    double energyDb = 0.0;
+};
+
+struct RuleContext {
+    double frameSeconds = 0.0;
+    double harakaSeconds = 0.0;            // set before finish() when kRuleTempo was requested
+    const FeatureMatrix* reference = nullptr;
+    const RuleOptions* options = nullptr;
+};
+
+// A time-stamped finding. Times are in seconds of the original recording:
+// frames of a VAD-trimmed take are mapped back through the trimmed timeline.
+struct RuleEvent {
+    size_t rule = 0;                // index into ruleRegistry()
+    size_t startFrame = 0;          // frames [startFrame, endFrame) of the matrix
+    size_t endFrame = 0;
+    double startTime = 0.0;
+    double endTime = 0.0;
+    double measured = 0.0;          // in the rule's unit
+    double expected = 0.0;
+    double score = 0.0;             // 0..100
+    bool violation = false;
+    std::string message;            // e.g. "Madd 1.20-1.85 s, measured 4.1 counts vs expected 4"
+};
+
+struct RuleResult {
+    size_t rule = 0;
+    bool evaluated = false;         // false when the rule needs a reference and none was given
+    size_t detections = 0;
+    size_t violations = 0;
+    double score = 0.0;             // mean event score, 0 without detections
+};
+
+struct RuleReport {
+    std::vector<RuleEvent> events;  // in rule order, then time order
+    std::vector<RuleResult> results;  // one per requested rule, in registry order
+    double harakaSeconds = 0.0;
+
+    const RuleResult* result(size_t rule) const;
+};
+
+// Sink a detector reports findings to from finish()
+class RuleEmitter {
+public:
+    virtual ~RuleEmitter() = default;
+    virtual void emit(size_t startFrame, size_t endFrame, double measured, double expected,
+                      double score, bool violation) = 0;
+};
+
+// One Tajweed rule. The engine calls begin(), then frame() for every frame
+// in order, then finish() once the whole take has been seen. Detectors keep
+// whatever they need between calls and never scan the matrix themselves.
+class RuleDetector {
+public:
+    virtual ~RuleDetector() = default;
+    virtual void begin(const RuleContext& context) = 0;
+    virtual void frame(const RuleFrame& frame) = 0;
+    virtual void finish(const RuleContext& context, RuleEmitter& emitter) = 0;
+};
+
+struct RuleInfo {
+    const char* name;               // key in the JS rules map, e.g. "madd"
+    const char* label;              // used in messages, e.g. "Madd"
+    const char* unit;               // of measured and expected, e.g. "counts"
+    uint32_t inputs;                // RuleInput bits
+    bool needsReference;
+    const char* error;              // reported when the rule is not met
+    const char* suggestion;
+    std::unique_ptr<RuleDetector> (*create)();
+};
+
+// Built-in rules (madd, makharij, ghunna, qalqalah) followed by any
+// registered since. Register rules before the first RuleEngine is built.
+const std::vector<RuleInfo>& ruleRegistry();
+size_t registerRule(const RuleInfo& info);
+// Index of the rule called `name`, or -1
+int findRule(const std::string& name);
+
+// Runs the requested detectors over a feature matrix in one pass. An engine
+// holds one instance of every registered detector and reuses it from run to
+// run, so it is used by one thread at a time.
+class RuleEngine {
+public:
+    RuleEngine();
+
+    // `reference` enables the rules that compare against one; `timeline`
+    // maps frames of a VAD-trimmed matrix back to the recording
+    void run(const FeatureMatrix& frames, RuleSet rules, RuleReport& report,
+             const FeatureMatrix* reference = nullptr, const TrimmedSource* timeline = nullptr);
+
+    RuleOptions options;
+
+private:
+    std::vector<std::unique_ptr<RuleDetector>> detectors_;
+    std::vector<size_t> active_;
+    std::vector<float> runs_;  // voiced run lengths in frames, for the tempo estimate
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_RULES_H
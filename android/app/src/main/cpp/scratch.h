@@ -0,0 +1,56 @@
+#ifndef TAJWEED_SCRATCH_H
+#define TAJWEED_SCRATCH_H
+
+#include "perf_stats.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Heap growth of reusable scratch buffers
+struct AllocationStats {
+    uint64_t allocations = 0;  // times a buffer had to (re)allocate
+    uint64_t bytes = 0;        // bytes requested by those allocations
+
+    AllocationStats& operator+=(const AllocationStats& other) {
+        allocations += other.allocations;
+        bytes += other.bytes;
+        return *this;
+    }
+};
+
+// Records one allocation in `stats` and the process-wide perf counters
+inline void countAllocation(AllocationStats& stats, uint64_t bytes) {
+    stats.allocations++;
+    stats.bytes += bytes;
+    TAJWEED_PERF_COUNT(Allocations, 1);
+    TAJWEED_PERF_COUNT(AllocatedBytes, bytes);
+}
+
+// Records a reallocation if `buffer` grew beyond the capacity it had before
+template <typename T>
+inline void recordGrowth(const std::vector<T>& buffer, size_t capacityBefore, AllocationStats& stats) {
+    if (buffer.capacity() > capacityBefore) {
+        countAllocation(stats, buffer.capacity() * sizeof(T));
+    }
+}
+
+// Resizes a scratch buffer to `count` elements. Capacity only ever grows
+// (geometrically), so once a buffer has seen its largest size it never
+// touches the heap again.
+template <typename T>
+inline T* growScratch(std::vector<T>& buffer, size_t count, AllocationStats& stats) {
+    size_t capacity = buffer.capacity();
+    if (count > capacity) {
+        buffer.reserve(std::max(count, capacity * 2));
+        recordGrowth(buffer, capacity, stats);
+    }
+    buffer.resize(count);
+    return buffer.data();
+}
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_SCRATCH_H
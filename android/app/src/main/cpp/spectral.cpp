@@ -0,0 +1,269 @@
+#include "spectral.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <stdexcept>
+
+namespace TajweedAudio {
+
+namespace {
+
+double hzToMel(double hz) {
+    return 2595.0 * log10(1.0 + hz / 700.0);
+}
+
+double melToHz(double mel) {
+    return 700.0 * (pow(10.0, mel / 2595.0) - 1.0);
+}
+
+} // namespace
+
+std::vector<double> windowCoefficients(size_t length, const std::string& windowType) {
+    std::vector<double> window(length, 1.0);
+    if (length < 2 || windowType == "rectangular") return window;
+
+    double denom = static_cast<double>(length - 1);
+    for (size_t i = 0; i < length; i++) {
+        double phase = 2.0 * M_PI * i / denom;
+        if (windowType == "hann") {
+            window[i] = 0.5 - 0.5 * cos(phase);
+        } else if (windowType == "hamming") {
+            window[i] = 0.54 - 0.46 * cos(phase);
+        } else if (windowType == "blackman") {
+            window[i] = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2.0 * phase);
+        } else {
+            throw std::invalid_argument("Unknown window type: " + windowType);
+        }
+    }
+
+    return window;
+}
+
+void prepareStft(StftScratch& scratch, int frameSize, const std::string& windowType) {
+    if (frameSize <= 0) {
+        throw std::invalid_argument("Frame size must be positive");
+    }
+
+    size_t frameLength = static_cast<size_t>(frameSize);
+    if (scratch.plan && scratch.plan->size() == frameLength && scratch.windowType == windowType) return;
+
+    scratch.plan = FftPlan::forSize(frameLength);
+    scratch.window = windowCoefficients(frameLength, windowType);
+    scratch.windowType = windowType;
+    countAllocation(scratch.stats, frameLength * sizeof(double));
+
+    growScratch(scratch.raw, frameLength, scratch.stats);
+    growScratch(scratch.frame, frameLength, scratch.stats);
+    growScratch(scratch.bins, scratch.plan->numBins(), scratch.stats);
+}
+
+double framePowerSpectrum(const double* samples, StftScratch& scratch, double* power) {
+    const FftPlan& plan = *scratch.plan;
+    size_t frameLength = plan.size();
+    const double* window = scratch.window.data();
+    double* frame = scratch.frame.data();
+    std::complex<double>* bins = scratch.bins.data();
+
+    double sumSquares = 0.0;
+    for (size_t i = 0; i < frameLength; i++) {
+        sumSquares += samples[i] * samples[i];
+        frame[i] = samples[i] * window[i];
+    }
+
+    plan.forward(frame, bins);
+    for (size_t k = 0; k < plan.numBins(); k++) {
+        power[k] = std::norm(bins[k]);
+    }
+
+    return sumSquares / frameLength;
+}
+
+void computeSpectrogram(const SampleSource& source, Spectrogram& out, StftScratch& scratch,
+                        int frameSize, int hopSize, const std::string& windowType) {
+    if (frameSize <= 0 || hopSize <= 0) {
+        throw std::invalid_argument("Frame and hop size must be positive");
+    }
+
+    out.frameSize = frameSize;
+    out.hopSize = hopSize;
+    out.sampleRate = source.sampleRate();
+    out.numBins = frameSize / 2 + 1;
+    out.numFrames = stftFrameCount(source.frameCount(), frameSize, hopSize);
+
+    growScratch(out.power, out.numFrames * out.numBins, scratch.stats);
+    growScratch(out.energy, out.numFrames, scratch.stats);
+    if (out.numFrames == 0) return;
+
+    prepareStft(scratch, frameSize, windowType);
+    size_t frameLength = static_cast<size_t>(frameSize);
+    size_t hopLength = static_cast<size_t>(hopSize);
+    double* raw = scratch.raw.data();
+
+    for (size_t f = 0; f < out.numFrames; f++) {
+        size_t start = f * hopLength;
+
+        // Overlapping frames only pull the new hop from the source
+        if (f > 0 && hopLength < frameLength) {
+            size_t overlap = frameLength - hopLength;
+            std::copy(raw + hopLength, raw + frameLength, raw);
+            source.read(start + overlap, hopLength, raw + overlap);
+        } else {
+            source.read(start, frameLength, raw);
+        }
+
+        out.energy[f] = framePowerSpectrum(raw, scratch, out.power.data() + f * out.numBins);
+    }
+}
+
+Spectrogram computeSpectrogram(const SampleSource& source,
+                               int frameSize, int hopSize, const std::string& windowType) {
+    Spectrogram spectrogram;
+    StftScratch scratch;
+    computeSpectrogram(source, spectrogram, scratch, frameSize, hopSize, windowType);
+    return spectrogram;
+}
+
+Spectrogram computeSpectrogram(const std::vector<double>& samples, int sampleRate,
+                               int frameSize, int hopSize, const std::string& windowType) {
+    return computeSpectrogram(BufferSource(samples, sampleRate), frameSize, hopSize, windowType);
+}
+
+void MelCepstrum::configure(size_t numBins, int frameSize, int sampleRate, int numCoefficients, int numFilters) {
+    if (numCoefficients == numCoefficients_ && numFilters == numFilters_ &&
+        numBins == numBins_ && frameSize == frameSize_ && sampleRate == sampleRate_) {
+        return;
+    }
+    if (numFilters <= 0 || numFilters > kMaxMelFilters) {
+        throw std::invalid_argument("Unsupported mel filter count");
+    }
+
+    numCoefficients_ = numCoefficients;
+    numFilters_ = numFilters;
+    numBins_ = numBins;
+    frameSize_ = frameSize;
+    sampleRate_ = sampleRate;
+
+    growScratch(firstBin_, numFilters, stats_);
+    growScratch(weightOffset_, numFilters, stats_);
+    growScratch(weightCount_, numFilters, stats_);
+    growScratch(dct_, static_cast<size_t>(numCoefficients) * numFilters, stats_);
+
+    // Triangular filters between mel-spaced edges
+    double maxMel = hzToMel(sampleRate_ / 2.0);
+    auto edge = [&](int i) { return melToHz(maxMel * i / (numFilters + 1)); };
+    double binWidth = frameSize_ > 0 ? static_cast<double>(sampleRate_) / frameSize_ : 1.0;
+
+    size_t capacity = weights_.capacity();
+    weights_.clear();
+    for (int f = 0; f < numFilters; f++) {
+        double left = edge(f);
+        double center = edge(f + 1);
+        double right = edge(f + 2);
+
+        size_t first = static_cast<size_t>(ceil(left / binWidth));
+        size_t last = numBins_ > 0 ? std::min(numBins_ - 1, static_cast<size_t>(floor(right / binWidth))) : 0;
+
+        firstBin_[f] = first;
+        weightOffset_[f] = weights_.size();
+        for (size_t bin = first; bin <= last && first <= last; bin++) {
+            double freq = bin * binWidth;
+            double weight = freq <= center ? (freq - left) / (center - left)
+                                           : (right - freq) / (right - center);
+            weights_.push_back(std::max(0.0, weight));
+        }
+        weightCount_[f] = weights_.size() - weightOffset_[f];
+    }
+    recordGrowth(weights_, capacity, stats_);
+
+    // Orthonormal DCT-II basis, numCoefficients x numFilters
+    for (int c = 0; c < numCoefficients; c++) {
+        double scale = sqrt((c == 0 ? 1.0 : 2.0) / numFilters);
+        for (int m = 0; m < numFilters; m++) {
+            dct_[c * numFilters + m] = scale * cos(M_PI * c * (m + 0.5) / numFilters);
+        }
+    }
+}
+
+void MelCepstrum::compute(const double* power, double* out) const {
+    double logEnergies[kMaxMelFilters];
+    for (int m = 0; m < numFilters_; m++) {
+        const double* weights = weights_.data() + weightOffset_[m];
+        const double* bins = power + firstBin_[m];
+        double energy = 0.0;
+        for (size_t i = 0; i < weightCount_[m]; i++) {
+            energy += weights[i] * bins[i];
+        }
+        logEnergies[m] = log(std::max(energy, 1e-10));
+    }
+
+    for (int c = 0; c < numCoefficients_; c++) {
+        const double* basis = dct_.data() + c * numFilters_;
+        double sum = 0.0;
+        for (int m = 0; m < numFilters_; m++) {
+            sum += basis[m] * logEnergies[m];
+        }
+        out[c] = sum;
+    }
+}
+
+double spectralCentroid(const double* power, size_t numBins, double binWidth) {
+    double weightedSum = 0.0;
+    double magnitudeSum = 0.0;
+
+    for (size_t k = 0; k < numBins; k++) {
+        double magnitude = sqrt(power[k]);
+        weightedSum += k * binWidth * magnitude;
+        magnitudeSum += magnitude;
+    }
+
+    return magnitudeSum > 0 ? weightedSum / magnitudeSum : 0.0;
+}
+
+double spectralRolloff(const double* power, size_t numBins, double binWidth, double fraction) {
+    double totalEnergy = 0.0;
+    for (size_t k = 0; k < numBins; k++) {
+        totalEnergy += power[k];
+    }
+
+    // Lowest frequency below which `fraction` of the energy lies
+    double targetEnergy = fraction * totalEnergy;
+    double currentEnergy = 0.0;
+    for (size_t k = 0; k < numBins; k++) {
+        currentEnergy += power[k];
+        if (currentEnergy >= targetEnergy) {
+            return k * binWidth;
+        }
+    }
+    return 0.0;
+}
+
+std::vector<double> computeMFCC(const Spectrogram& spectrogram, int numCoefficients, int numFilters) {
+    std::vector<double> mfcc(spectrogram.numFrames * numCoefficients, 0.0);
+    if (spectrogram.numFrames == 0) return mfcc;
+
+    MelCepstrum cepstrum;
+    cepstrum.configure(spectrogram, numCoefficients, numFilters);
+    for (size_t f = 0; f < spectrogram.numFrames; f++) {
+        cepstrum.compute(spectrogram.frame(f), mfcc.data() + f * numCoefficients);
+    }
+
+    return mfcc;
+}
+
+std::vector<double> computeSpectralCentroid(const Spectrogram& spectrogram) {
+    std::vector<double> centroid(spectrogram.numFrames, 0.0);
+    for (size_t f = 0; f < spectrogram.numFrames; f++) {
+        centroid[f] = spectralCentroid(spectrogram.frame(f), spectrogram.numBins, spectrogram.binFrequency(1));
+    }
+    return centroid;
+}
+
+std::vector<double> computeSpectralRolloff(const Spectrogram& spectrogram, double fraction) {
+    std::vector<double> rolloff(spectrogram.numFrames, 0.0);
+    for (size_t f = 0; f < spectrogram.numFrames; f++) {
+        rolloff[f] = spectralRolloff(spectrogram.frame(f), spectrogram.numBins, spectrogram.binFrequency(1), fraction);
+    }
+    return rolloff;
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,126 @@
+#ifndef TAJWEED_SPECTRAL_H
+#define TAJWEED_SPECTRAL_H
+
+#include "audio_source.h"
+#include "fft.h"
+#include "scratch.h"
+#include <complex>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Analysis framing shared by every spectral feature: 32 ms frames, 16 ms
+// apart at the 16 kHz analysis rate
+const int kFrameSize = 512;
+const int kHopSize = 256;
+const int kNumMfcc = 13;
+const int kNumMelFilters = 26;
+const int kMaxMelFilters = 128;
+
+// Number of whole frames of frameSize samples, hopSize apart
+inline size_t stftFrameCount(size_t totalSamples, int frameSize, int hopSize) {
+    if (frameSize <= 0 || hopSize <= 0 || totalSamples < static_cast<size_t>(frameSize)) return 0;
+    return (totalSamples - frameSize) / hopSize + 1;
+}
+
+// Power spectrum of every STFT frame, stored frame-major
+struct Spectrogram {
+    size_t numFrames = 0;
+    size_t numBins = 0;
+    int frameSize = 0;
+    int hopSize = 0;
+    int sampleRate = 0;
+    std::vector<double> power;  // numFrames x numBins, |X[k]|^2
+    std::vector<double> energy; // numFrames, mean square of each unwindowed frame
+
+    const double* frame(size_t index) const { return power.data() + index * numBins; }
+    double binFrequency(size_t bin) const {
+        return static_cast<double>(bin) * sampleRate / frameSize;
+    }
+};
+
+// Window coefficients for "hann", "hamming", "blackman" or "rectangular"
+std::vector<double> windowCoefficients(size_t length, const std::string& windowType);
+
+// FFT plan, window and buffers for analyzing one frame at a time. Not
+// shareable between threads; each thread keeps its own.
+struct StftScratch {
+    std::shared_ptr<const FftPlan> plan;
+    std::string windowType;
+    std::vector<double> window;  // cached coefficients for plan->size() and windowType
+    std::vector<double> raw;
+    std::vector<double> frame;
+    std::vector<std::complex<double>> bins;
+    AllocationStats stats;
+};
+
+// Sets up the plan and window for frameSize; a no-op when already set up
+void prepareStft(StftScratch& scratch, int frameSize, const std::string& windowType = "hann");
+
+// Windowed power spectrum (frameSize / 2 + 1 bins) of one prepared-size frame.
+// Returns the mean square of the unwindowed samples.
+double framePowerSpectrum(const double* samples, StftScratch& scratch, double* power);
+
+// One windowed STFT pass over the whole signal. The overload taking scratch
+// buffers fills `out` in place and allocates only when a buffer must grow.
+void computeSpectrogram(const SampleSource& source, Spectrogram& out, StftScratch& scratch,
+                        int frameSize = kFrameSize, int hopSize = kHopSize,
+                        const std::string& windowType = "hann");
+Spectrogram computeSpectrogram(const SampleSource& source,
+                               int frameSize = kFrameSize, int hopSize = kHopSize,
+                               const std::string& windowType = "hann");
+Spectrogram computeSpectrogram(const std::vector<double>& samples, int sampleRate,
+                               int frameSize = kFrameSize, int hopSize = kHopSize,
+                               const std::string& windowType = "hann");
+
+// Mel filterbank and DCT-II basis for one STFT configuration. configure() is
+// cheap when nothing changed, so a long-lived instance never reallocates.
+class MelCepstrum {
+public:
+    void configure(size_t numBins, int frameSize, int sampleRate, int numCoefficients = kNumMfcc,
+                   int numFilters = kNumMelFilters);
+    void configure(const Spectrogram& spectrogram, int numCoefficients = kNumMfcc,
+                   int numFilters = kNumMelFilters) {
+        configure(spectrogram.numBins, spectrogram.frameSize, spectrogram.sampleRate, numCoefficients, numFilters);
+    }
+
+    int numCoefficients() const { return numCoefficients_; }
+
+    // Cepstrum of one power spectrum frame; writes numCoefficients() values.
+    // Safe to call from several threads once configured.
+    void compute(const double* power, double* out) const;
+
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    int numCoefficients_ = 0;
+    int numFilters_ = 0;
+    size_t numBins_ = 0;
+    int frameSize_ = 0;
+    int sampleRate_ = 0;
+
+    // Triangular filters stored flat: filter f covers weightCount_[f] bins from firstBin_[f]
+    std::vector<size_t> firstBin_;
+    std::vector<size_t> weightOffset_;
+    std::vector<size_t> weightCount_;
+    std::vector<double> weights_;
+    std::vector<double> dct_;          // numCoefficients x numFilters
+    AllocationStats stats_;
+};
+
+// Single-frame spectral shape measures, in Hz; binWidth = sampleRate / frameSize
+double spectralCentroid(const double* power, size_t numBins, double binWidth);
+double spectralRolloff(const double* power, size_t numBins, double binWidth, double fraction = 0.85);
+
+// Features derived from a spectrogram, one value (or kNumMfcc values) per frame
+std::vector<double> computeMFCC(const Spectrogram& spectrogram, int numCoefficients = kNumMfcc,
+                                int numFilters = kNumMelFilters);
+std::vector<double> computeSpectralCentroid(const Spectrogram& spectrogram);
+std::vector<double> computeSpectralRolloff(const Spectrogram& spectrogram, double fraction = 0.85);
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_SPECTRAL_H
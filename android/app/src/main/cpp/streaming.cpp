@@ -0,0 +1,311 @@
+#include "streaming.h"
+#include "audio_analysis.h"
+#include "perf_stats.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace TajweedAudio {
+
+namespace {
+
+// Samples drained from the ring per step
+const size_t kStreamChunk = 1024;
+
+// The unconsumed tail of a take as a SampleSource: samples [start, start +
+// count) in the take's own numbering, so frame f is still read at f * hop
+class HistorySource : public SampleSource {
+public:
+    HistorySource(const double* samples, size_t start, size_t count, int sampleRate)
+        : samples_(samples), start_(start), count_(count), sampleRate_(sampleRate) {}
+
+    int sampleRate() const override { return sampleRate_; }
+    int channels() const override { return 1; }
+    size_t frameCount() const override { return start_ + count_; }
+
+    size_t read(size_t start, size_t count, double* out) const override {
+        if (start < start_ || start >= start_ + count_) return 0;
+        size_t n = std::min(count, start_ + count_ - start);
+        std::copy(samples_ + (start - start_), samples_ + (start - start_) + n, out);
+        return n;
+    }
+
+private:
+    const double* samples_;
+    size_t start_;
+    size_t count_;
+    int sampleRate_;
+};
+
+} // namespace
+
+StreamingAnalyzer::StreamingAnalyzer(int sampleRate, const StreamingOptions& options)
+    : inputRate_(sampleRate), analysisRate_(sampleRate), options_(options),
+      ring_(options.ringCapacity > 0 ? options.ringCapacity : 1) {
+    if (sampleRate <= 0 || options.ringCapacity == 0) {
+        throw std::invalid_argument("Streaming analysis needs a positive sample rate and ring capacity");
+    }
+
+    int target = options.resample.targetRate;
+    resampling_ = options.resample.enabled && target > 0 && target != sampleRate;
+    if (resampling_) {
+        resampler_.configure(sampleRate, target, options.resample.quality);
+        analysisRate_ = target;
+    }
+    workspace_.cepstrum.configure(kFrameSize / 2 + 1, kFrameSize, analysisRate_);
+    reset();
+}
+
+size_t StreamingAnalyzer::push(const float* samples, size_t count) {
+    size_t queued = ring_.write(samples, count);
+    if (queued < count) dropped_.fetch_add(count - queued, std::memory_order_relaxed);
+    return queued;
+}
+
+size_t StreamingAnalyzer::push(const int16_t* samples, size_t count) {
+    // Converted through a stack block, so the callback still never allocates
+    float block[256];
+    size_t queued = 0;
+    for (size_t position = 0; position < count; position += 256) {
+        size_t n = std::min<size_t>(256, count - position);
+        for (size_t i = 0; i < n; i++) block[i] = samples[position + i] / 32768.0f;
+        size_t written = ring_.write(block, n);
+        queued += written;
+        if (written < n) {
+            dropped_.fetch_add(count - position - written, std::memory_order_relaxed);
+            break;
+        }
+    }
+    return queued;
+}
+
+void StreamingAnalyzer::setReference(const AudioFeatures& reference) {
+    reference_ = reference.frames;
+    dtw_.reset(reference_.data(), reference_.numFrames(), FeatureColumns::Distance.count, kFeatureStride,
+               FrameMetric::Euclidean, options_.maxPathCells);
+}
+
+void StreamingAnalyzer::reset() {
+    ring_.clear();
+    dropped_.store(0, std::memory_order_relaxed);
+    if (resampling_) resampler_.clearState();
+    warmup_ = 0;
+    if (options_.preprocess.enabled) {
+        preprocessor_.configure(analysisRate_, options_.preprocess);
+        warmup_ = preprocessor_.latency();
+    }
+
+    history_.clear();
+    historyStart_ = 0;
+    received_ = 0;
+    finished_ = false;
+    numFrames_ = 0;
+    completed_ = 0;
+    formantTracker_.reset();
+    voicedRun_ = 0;
+    statsCount_ = 0;
+    std::fill(mean_, mean_ + kFeatureStride, 0.0);
+    std::fill(m2_, m2_ + kFeatureStride, 0.0);
+    dtw_.reset(reference_.data(), reference_.numFrames(), FeatureColumns::Distance.count, kFeatureStride,
+               FrameMetric::Euclidean, options_.maxPathCells);
+
+    workspace_.reset();
+    AudioFeatures& features = workspace_.features;
+    workspace_.prepare(features.frames, 0, analysisRate_, kHopSize);
+    features.duration = 0.0;
+    features.sampleRate = analysisRate_;
+    features.channels = 1;
+    workspace_.comparison = ComparisonResult();
+
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    status_ = StreamingStatus();
+}
+
+size_t StreamingAnalyzer::process() {
+    if (finished_) return 0;
+    size_t before = numFrames_;
+
+    float* chunk = workspace_.grow(chunk_, kStreamChunk);
+    double* input = workspace_.grow(input_, kStreamChunk);
+    double* converted = resampling_ ? workspace_.grow(converted_, resampler_.maxOutput(kStreamChunk)) : nullptr;
+    for (;;) {
+        size_t count = ring_.read(chunk, kStreamChunk);
+        if (count == 0) break;
+        received_ += count;
+        for (size_t i = 0; i < count; i++) input[i] = chunk[i];
+
+        if (resampling_) {
+            append(converted, resampler_.process(input, count, converted));
+        } else {
+            append(input, count);
+        }
+        analyzeReady();
+    }
+    return numFrames_ - before;
+}
+
+void StreamingAnalyzer::finish() {
+    if (finished_) return;
+    process();
+
+    // Outputs held back for the resampler's lookahead, then the denoiser's
+    // latency flushed with trailing silence, as PreprocessedSource does
+    if (resampling_) {
+        double* converted = workspace_.grow(converted_, std::max(resampler_.maxOutput(kStreamChunk),
+                                                                 resampler_.flushSize()));
+        append(converted, resampler_.flush(converted));
+    }
+    if (options_.preprocess.enabled && preprocessor_.latency() > 0) {
+        size_t latency = preprocessor_.latency();
+        double* silence = workspace_.grow(input_, std::max(kStreamChunk, latency));
+        std::fill(silence, silence + latency, 0.0);
+        append(silence, latency);
+    }
+    analyzeReady();
+
+    // The last two frames had no lookahead for their deltas
+    while (completed_ < numFrames_) completeFrame(completed_, numFrames_ - 1);
+    finished_ = true;
+
+    AudioFeatures& features = workspace_.features;
+    features.duration = static_cast<double>(received_) / inputRate_;
+    workspace_.prepare(features.frames, numFrames_, analysisRate_, kHopSize);
+    std::copy(rows_.begin(), rows_.begin() + numFrames_ * kFeatureStride, features.frames.data());
+    features.frames.normalizeColumns(FeatureColumns::Distance);
+
+    // The running path z-scored each row against the take so far; its steps
+    // are costed again on the rows normalized over the whole take
+    if (!reference_.empty() && numFrames_ > 0) {
+        DTWAlignment& path = workspace_.path;
+        if (dtw_.finish(path)) {
+            path.distance = 0.0;
+            for (size_t k = 0; k < path.costs.size(); k++) {
+                path.costs[k] = frameDistance(FrameMetric::Euclidean, features.frames.row(path.frames1[k]),
+                                              reference_.row(path.frames2[k]), FeatureColumns::Distance.count);
+                path.distance += path.costs[k];
+            }
+            summarizeAlignment(path, numFrames_, analysisRate_, reference_.sampleRate(), workspace_,
+                               workspace_.comparison);
+        } else {
+            performDTW(features, reference_.data(), reference_.numFrames(), reference_.sampleRate(), DTWOptions(),
+                       workspace_, workspace_.comparison);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    status_.frames = numFrames_;
+    status_.finished = true;
+}
+
+StreamingStatus StreamingAnalyzer::status() const {
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    StreamingStatus status = status_;
+    status.dropped = dropped_.load(std::memory_order_relaxed);
+    return status;
+}
+
+AllocationStats StreamingAnalyzer::stats() const {
+    AllocationStats total = workspace_.stats();
+    total += resampler_.stats();
+    total += preprocessor_.stats();
+    total += dtw_.stats();
+    return total;
+}
+
+void StreamingAnalyzer::append(double* samples, size_t count) {
+    if (options_.preprocess.enabled) {
+        preprocessor_.process(samples, count);
+
+        // The denoiser's first outputs are its warm-up, not the take
+        size_t skip = std::min(warmup_, count);
+        samples += skip;
+        count -= skip;
+        warmup_ -= skip;
+    }
+    if (count == 0) return;
+
+    size_t held = history_.size();
+    double* history = workspace_.grow(history_, held + count);
+    std::copy(samples, samples + count, history + held);
+}
+
+void StreamingAnalyzer::analyzeReady() {
+    size_t ready = stftFrameCount(historyStart_ + history_.size(), kFrameSize, kHopSize);
+    if (ready <= numFrames_) return;
+    size_t begin = numFrames_;
+
+    float* rows = workspace_.grow(rows_, ready * kFeatureStride);
+    FormantCandidates* formants = workspace_.grow(workspace_.formants, ready);
+    HistorySource source(history_.data(), historyStart_, history_.size(), analysisRate_);
+    analyzeFrames(source, workspace_.cepstrum, begin, ready, rows + begin * kFeatureStride, formants + begin);
+    numFrames_ = ready;
+    TAJWEED_PERF_COUNT(FramesProcessed, ready - begin);
+
+    double frameSeconds = static_cast<double>(kHopSize) / analysisRate_;
+    for (size_t f = begin; f < ready; f++) {
+        // Frames two behind now have their delta lookahead
+        while (completed_ + 2 <= f) completeFrame(completed_, ready - 1);
+
+        const float* row = rows + f * kFeatureStride;
+        StreamFrame frame;
+        frame.index = f;
+        frame.time = f * frameSeconds;
+        frame.pitch = row[FeatureColumns::Pitch.offset];
+        frame.confidence = row[FeatureColumns::PitchConfidence.offset];
+        frame.voiced = frame.pitch > 0.0;
+        frame.energyDb = 10.0 * log10(row[FeatureColumns::Energy.offset] + 1e-10);
+        voicedRun_ = frame.voiced ? voicedRun_ + 1 : 0;
+        frame.voicedSeconds = voicedRun_ * frameSeconds;
+        frame.counts = options_.harakaSeconds > 0.0 ? frame.voicedSeconds / options_.harakaSeconds : 0.0;
+        if (dtw_.frames() > 0) {
+            frame.referenceTime = reference_.frameTime(dtw_.position());
+            frame.similarity = 1.0 / (1.0 + dtw_.meanCost());
+        }
+        publish(frame);
+    }
+
+    // Only the next frame's window onwards is still needed
+    size_t consumed = std::min(numFrames_ * static_cast<size_t>(kHopSize) - historyStart_, history_.size());
+    std::copy(history_.begin() + consumed, history_.end(), history_.begin());
+    history_.resize(history_.size() - consumed);
+    historyStart_ += consumed;
+}
+
+void StreamingAnalyzer::completeFrame(size_t f, size_t last) {
+    float* row = rows_.data() + f * kFeatureStride;
+    computeMfccDelta(rows_.data(), f, last);
+    formantTracker_.next(workspace_.formants[f], row + FeatureColumns::Formants.offset);
+    completed_ = f + 1;
+    if (!reference_.empty()) alignFrame(f);
+}
+
+void StreamingAnalyzer::alignFrame(size_t f) {
+    const float* row = rows_.data() + f * kFeatureStride;
+    const ColumnRange& distance = FeatureColumns::Distance;
+
+    // Welford updates, then z-scores against the take so far; columns that
+    // have not varied yet stay at zero, as constant columns do in normalizeColumns
+    statsCount_++;
+    float normalized[kFeatureStride];
+    for (size_t c = distance.offset; c < distance.offset + distance.count; c++) {
+        double value = row[c];
+        double diff = value - mean_[c];
+        mean_[c] += diff / statsCount_;
+        m2_[c] += diff * (value - mean_[c]);
+
+        double stddev = sqrt(m2_[c] / statsCount_);
+        normalized[c - distance.offset] = stddev < 1e-12 ? 0.0f : static_cast<float>((value - mean_[c]) / stddev);
+    }
+    dtw_.push(normalized);
+}
+
+void StreamingAnalyzer::publish(const StreamFrame& frame) {
+    if (onFrame_) onFrame_(frame);
+
+    std::lock_guard<std::mutex> lock(statusMutex_);
+    status_.latest = frame;
+    status_.frames = numFrames_;
+    status_.seconds = static_cast<double>(received_) / inputRate_;
+}
+
+} // namespace TajweedAudio
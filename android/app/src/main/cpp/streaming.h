@@ -0,0 +1,173 @@
+#ifndef TAJWEED_STREAMING_H
+#define TAJWEED_STREAMING_H
+
+#include "audio_features.h"
+#include "dtw.h"
+#include "feature_matrix.h"
+#include "formants.h"
+#include "preprocess.h"
+#include "resample.h"
+#include "ring_buffer.h"
+#include "workspace.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace TajweedAudio {
+
+struct StreamingOptions {
+    // Input at another rate is converted on the fly, as extractFeatures does
+    // for files; on by default so frames match references extracted at 16 kHz
+    ResampleOptions resample;
+    // Filters and denoiser run block by block. Peak normalization needs the
+    // whole take and is skipped.
+    PreprocessOptions preprocess;
+    size_t ringCapacity = 1 << 16;  // samples queued between the recorder and the analysis
+    double harakaSeconds = 0.2;     // one count, for the live Madd length
+    // The running DTW keeps its path up to this many grid cells; a longer
+    // take is aligned again by performDTW in finish()
+    size_t maxPathCells = kMaxIncrementalPathCells;
+
+    StreamingOptions() { resample.enabled = true; }
+};
+
+// Live measurements of one frame, handed out as soon as it is analyzed
+struct StreamFrame {
+    size_t index = 0;
+    double time = 0.0;            // start of the frame, seconds into the take
+    double pitch = 0.0;           // Hz, 0 when unvoiced
+    double confidence = 0.0;
+    bool voiced = false;
+    double energyDb = -100.0;     // 10 log10 of the frame's mean square
+    double voicedSeconds = 0.0;   // length of the voiced run the frame ends, for a Madd indicator
+    double counts = 0.0;          // the same in counts of StreamingOptions::harakaSeconds
+    // Partial alignment against the reference, two frames behind (the MFCC
+    // deltas need two frames of lookahead); 0 without a reference. It settles
+    // once the running statistics have seen the first syllable.
+    double referenceTime = 0.0;   // seconds into the reference the take has reached
+    double similarity = 0.0;      // 1 / (1 + mean path cost) so far
+};
+
+struct StreamingStatus {
+    StreamFrame latest;
+    size_t frames = 0;
+    double seconds = 0.0;         // analyzed input, at the analysis rate
+    size_t dropped = 0;           // samples lost to a full ring
+    bool finished = false;
+};
+
+typedef std::function<void(const StreamFrame& frame)> StreamFrameCallback;
+
+// Feature extraction while a take is being recorded. The recording thread
+// push()es PCM into a lock-free ring; an analysis thread calls process() to
+// drain it, carrying the partial window and filter state from chunk to
+// chunk, so each hop of audio becomes a feature row (STFT, pitch, energy,
+// formants) as it arrives. With a reference set, every row also extends a
+// running DTW, so after finish() the comparison costs one backtrack rather
+// than a whole extraction and alignment.
+//
+// The rows match extractFeatures on the same samples with VAD off: silence
+// cannot be trimmed before the take is over. The running DTW z-scores each
+// row with the statistics of the take so far, so its path approximates
+// performDTW's; finish() re-scores that path on the rows normalized over the
+// whole take. Takes past StreamingOptions::maxPathCells are aligned again
+// with performDTW instead.
+class StreamingAnalyzer {
+public:
+    StreamingAnalyzer(int sampleRate, const StreamingOptions& options = StreamingOptions());
+
+    StreamingAnalyzer(const StreamingAnalyzer&) = delete;
+    StreamingAnalyzer& operator=(const StreamingAnalyzer&) = delete;
+
+    // Producer thread only. Lock-free and allocation-free: samples that do not
+    // fit in the ring are dropped and counted. Returns the samples queued.
+    size_t push(const float* samples, size_t count);
+    size_t push(const int16_t* samples, size_t count);
+
+    // Samples push() can queue right now without dropping any (producer
+    // thread), and samples waiting for process() (any thread)
+    size_t writable() const { return ring_.capacity() - ring_.size(); }
+    size_t queued() const { return ring_.size(); }
+
+    // Reference features (as extracted by extractFeatures) for the running
+    // DTW. Copied; set between takes.
+    void setReference(const AudioFeatures& reference);
+
+    // Analysis thread only. Called for every frame from process() and finish().
+    void setFrameCallback(StreamFrameCallback callback) { onFrame_ = std::move(callback); }
+
+    // Analyzes whatever the ring holds; returns the frames added
+    size_t process();
+
+    // Ends the take: drains the ring, flushes the filters, completes the last
+    // frames and the alignment, and fills features() and comparison()
+    void finish();
+
+    // Starts a new take, keeping the reference and every buffer's capacity.
+    // The producer must not push while this runs.
+    void reset();
+
+    // Any thread
+    StreamingStatus status() const;
+
+    // After finish(): the take's features, normalized over the whole take as
+    // extractFeatures leaves them, and the DTW against the reference
+    const AudioFeatures& features() const { return workspace_.features; }
+    const ComparisonResult& comparison() const { return workspace_.comparison; }
+
+    int sampleRate() const { return inputRate_; }
+    int analysisRate() const { return analysisRate_; }
+
+    AllocationStats stats() const;
+
+private:
+    void append(double* samples, size_t count);
+    void analyzeReady();
+    void completeFrame(size_t f, size_t last);
+    void alignFrame(size_t f);
+    void publish(const StreamFrame& frame);
+
+    int inputRate_;
+    int analysisRate_;
+    StreamingOptions options_;
+    SpscRing<float> ring_;
+    std::atomic<size_t> dropped_{0};
+
+    // Consumer state
+    bool resampling_ = false;
+    PolyphaseResampler resampler_;
+    Preprocessor preprocessor_;
+    size_t warmup_ = 0;                  // preprocessor output still to skip (its latency)
+    std::vector<float> chunk_;           // drained from the ring
+    std::vector<double> input_;
+    std::vector<double> converted_;
+    std::vector<double> history_;        // samples from historyStart_ on: the next frame's window and beyond
+    size_t historyStart_ = 0;
+    size_t received_ = 0;                // samples at the analysis rate so far
+    bool finished_ = false;
+
+    FeatureWorkspace workspace_;         // cepstrum, candidates, path and result slots
+    std::vector<float> rows_;            // kFeatureStride floats per analyzed frame
+    size_t numFrames_ = 0;
+    size_t completed_ = 0;               // frames with deltas and formant tracks
+    FormantTracker formantTracker_;
+    size_t voicedRun_ = 0;
+
+    // Running z-scores of the distance block, for the partial DTW
+    FeatureMatrix reference_;
+    IncrementalDTW dtw_;
+    size_t statsCount_ = 0;
+    double mean_[kFeatureStride] = {};
+    double m2_[kFeatureStride] = {};
+
+    StreamFrameCallback onFrame_;
+    mutable std::mutex statusMutex_;
+    StreamingStatus status_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_STREAMING_H
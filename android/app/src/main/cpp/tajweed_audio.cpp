@@ -1,15 +1,27 @@
 #include "tajweed_audio.h"
+#include "wav_file.h"
+#include "analysis_cache.h"
+#include "decoder.h"
+#include "feature_store.h"
+#include "jni_cache.h"
+#include "jobs.h"
+#include "lesson_batch.h"
+#include "log.h"
+#include "long_alignment.h"
+#include "media_decoder.h"
+#include "perf_stats.h"
+#include "reference_index.h"
+#include "streaming.h"
 #include <android/log.h>
-#include <fstream>
-#include <sstream>
-#include <algorithm>
-#include <cmath>
-#include <complex>
-#include <numeric>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
 
-#define LOG_TAG "TajweedAudio"
-#define LOGD(...) __android_log_print(ANDROID_LOG_DEBUG, LOG_TAG, __VA_ARGS__)
-#define LOGE(...) __android_log_print(ANDROID_LOG_ERROR, LOG_TAG, __VA_ARGS__)
+// Routes core log messages to logcat
+static void android_log_sink(TajweedAudio::LogLevel level, const char *tag, const char *message) {
+    static const int priorities[] = {ANDROID_LOG_DEBUG, ANDROID_LOG_INFO, ANDROID_LOG_WARN, ANDROID_LOG_ERROR};
+    __android_log_write(priorities[static_cast<int>(level)], tag, message);
+}
 
 // JNI Helper functions
 std::string jstring_to_string(JNIEnv *env, jstring jstr) {
@@ -20,56 +32,286 @@ std::string jstring_to_string(JNIEnv *env, jstring jstr) {
     return str;
 }
 
-jdoubleArray vector_to_jdoubleArray(JNIEnv *env, const std::vector<double>& vec) {
-    jdoubleArray result = env->NewDoubleArray(vec.size());
-    env->SetDoubleArrayRegion(result, 0, vec.size(), vec.data());
+jobject analysis_to_map(JNIEnv *env, const TajweedAnalysis& analysis) {
+    jobject result = jni_new_map(env);
+    if (!result) return nullptr;
+    
+    jni_put_double(env, result, "score", analysis.overallScore);
+    jni_put_double(env, result, "confidence", analysis.confidence);
+    jni_put_string_list(env, result, "errors", analysis.errors);
+    jni_put_string_list(env, result, "suggestions", analysis.suggestions);
+    jni_put_double_map(env, result, "analysis", analysis.ruleScores);
+    
     return result;
 }
 
-std::vector<double> jdoubleArray_to_vector(JNIEnv *env, jdoubleArray array) {
-    jsize length = env->GetArrayLength(array);
-    std::vector<double> vec(length);
-    env->GetDoubleArrayRegion(array, 0, length, vec.data());
-    return vec;
+// Rules a JS rules map asks for by key ("madd", ...); no map asks for all.
+// Keys without a detector are ignored.
+TajweedAudio::RuleSet rule_set_from_map(JNIEnv *env, jobject rules) {
+    const std::vector<TajweedAudio::RuleInfo>& registry = TajweedAudio::ruleRegistry();
+    TajweedAudio::RuleSet selected = 0;
+    for (size_t i = 0; i < registry.size(); i++) {
+        if (jni_get_flag(env, rules, registry[i].name, rules == nullptr)) selected |= TajweedAudio::ruleBit(i);
+    }
+    return selected;
+}
+
+jobject rule_report_to_map(JNIEnv *env, const TajweedAudio::RuleReport& report) {
+    const std::vector<TajweedAudio::RuleInfo>& registry = TajweedAudio::ruleRegistry();
+    std::vector<std::string> detectedRules;
+    std::vector<std::string> violations;
+    std::vector<std::string> recommendations;
+    std::vector<std::string> skipped;
+    for (const TajweedAudio::RuleResult& entry : report.results) {
+        const TajweedAudio::RuleInfo& info = registry[entry.rule];
+        if (!entry.evaluated) skipped.push_back(info.name);
+        if (entry.detections > 0) detectedRules.push_back(info.label);
+        if (entry.violations > 0) recommendations.push_back(info.suggestion);
+    }
+    
+    jobject events = jni_new_array(env);
+    for (const TajweedAudio::RuleEvent& event : report.events) {
+        if (event.violation) violations.push_back(event.message);
+        
+        jobject item = jni_new_map(env);
+        jni_put_string(env, item, "rule", registry[event.rule].name);
+        jni_put_double(env, item, "start", event.startTime);
+        jni_put_double(env, item, "end", event.endTime);
+        jni_put_double(env, item, "measured", event.measured);
+        jni_put_double(env, item, "expected", event.expected);
+        jni_put_string(env, item, "unit", registry[event.rule].unit);
+        jni_put_double(env, item, "score", event.score);
+        jni_put_boolean(env, item, "violation", event.violation);
+        jni_put_string(env, item, "message", event.message);
+        jni_push_map(env, events, item);
+    }
+    
+    jobject result = jni_new_map(env);
+    if (!result) return nullptr;
+    jni_put_string_list(env, result, "detectedRules", detectedRules);
+    jni_put_string_list(env, result, "violations", violations);
+    jni_put_string_list(env, result, "recommendations", recommendations);
+    jni_put_string_list(env, result, "skipped", skipped);
+    jni_put_array(env, result, "events", events);
+    jni_put_double(env, result, "harakaSeconds", report.harakaSeconds);
+    return result;
+}
+
+// Feature handles are owned AudioFeatures passed to Java as a jlong
+AudioFeatures* features_from_handle(jlong handle) {
+    return reinterpret_cast<AudioFeatures*>(static_cast<intptr_t>(handle));
+}
+
+// Background analysis jobs
+
+static JavaVM *gJavaVm = nullptr;
+
+// Detaches a thread that attached itself through current_env() when it exits
+struct ThreadAttachment {
+    bool attached = false;
+    ~ThreadAttachment() {
+        if (attached) gJavaVm->DetachCurrentThread();
+    }
+};
+
+// JNIEnv of the calling thread. Job results are reported from the scheduler
+// thread and progress from pool workers, which attach on first use.
+static JNIEnv *current_env() {
+    JNIEnv *env = nullptr;
+    if (!gJavaVm) return nullptr;
+    if (gJavaVm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) == JNI_OK) return env;
+    thread_local ThreadAttachment attachment;
+    if (gJavaVm->AttachCurrentThreadAsDaemon(&env, nullptr) != JNI_OK) return nullptr;
+    attachment.attached = true;
+    return env;
+}
+
+// Releases a global reference when it goes out of scope, attaching the
+// thread if it has to, so every exit of a job callback lets go of the module
+struct GlobalRefRelease {
+    jobject ref;
+    ~GlobalRefRelease() {
+        JNIEnv *env = current_env();
+        if (env && ref) env->DeleteGlobalRef(ref);
+    }
+};
+
+enum class JobKind {
+    Similarity,
+    Tajweed,
+    Rules
+};
+
+// What a job computed, converted to a WritableMap once it is done
+struct JobResult {
+    JobKind kind;
+    double similarity = 0.0;
+    TajweedAnalysis analysis;
+    TajweedAudio::RuleReport report;
+};
+
+// Hands `params` to TajweedAudioModule.onJobEvent, which emits it to JS, and releases it
+static void emit_job_event(JNIEnv *env, jobject module, const char *eventName, jobject params) {
+    jstring jname = env->NewStringUTF(eventName);
+    env->CallVoidMethod(module, jni_cache().moduleOnJobEvent, jname, params);
+    if (env->ExceptionCheck()) env->ExceptionClear();
+    env->DeleteLocalRef(jname);
+    env->DeleteLocalRef(params);
+}
+
+static jobject job_event_map(JNIEnv *env, const TajweedAudio::JobControl& job) {
+    jobject params = jni_new_map(env);
+    jni_put_int(env, params, "jobId", static_cast<int>(job.id()));
+    jni_put_string(env, params, "segmentKey", job.key());
+    return params;
+}
+
+// Runs one job on the scheduler thread with that thread's workspaces
+static void run_job(TajweedAudio::JobControl& job, const std::string& userPath, const std::string& referencePath,
+                    TajweedAudio::RuleSet rules, JobResult& result) {
+    TajweedAudio::WavFile userAudio, refAudio;
+    if (!userAudio.open(userPath)) throw std::runtime_error("Failed to load " + userPath + ": " + userAudio.lastError());
+    
+    TajweedAudio::FeatureWorkspace& userWorkspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::User);
+    TajweedAudio::JobBinding userBinding(userWorkspace, job);
+    if (result.kind == JobKind::Rules) {
+        TajweedAudio::extractFeatures(userAudio, userWorkspace, userWorkspace.features);
+        if (job.cancelled()) return;
+        TAJWEED_PERF_SCOPE(Rules);
+        userWorkspace.rules.run(userWorkspace.features.frames, rules, result.report, nullptr, userWorkspace.timeline());
+        return;
+    }
+    
+    if (!refAudio.open(referencePath)) throw std::runtime_error("Failed to load " + referencePath + ": " + refAudio.lastError());
+    TajweedAudio::FeatureWorkspace& refWorkspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::Reference);
+    TajweedAudio::JobBinding refBinding(refWorkspace, job);
+    TajweedAudio::extractFeaturesConcurrently(userAudio, userWorkspace, refAudio, refWorkspace);
+    if (job.cancelled()) return;
+    
+    if (result.kind == JobKind::Similarity) {
+        const TajweedAudio::FeatureMatrix& frames2 = refWorkspace.features.frames;
+        TajweedAudio::performDTW(userWorkspace.features, frames2.data(), frames2.numFrames(), refWorkspace.features.sampleRate,
+                                 TajweedAudio::DTWOptions(), userWorkspace, userWorkspace.comparison,
+                                 {userWorkspace.timeline(), refWorkspace.timeline()});
+        result.similarity = userWorkspace.comparison.similarity;
+    } else {
+        result.analysis = TajweedAudio::analyzeTajweedRules(userWorkspace.features, refWorkspace.features);
+    }
+}
+
+static jobject job_result_to_map(JNIEnv *env, const JobResult& result) {
+    switch (result.kind) {
+        case JobKind::Similarity: {
+            jobject map = jni_new_map(env);
+            jni_put_double(env, map, "similarity", result.similarity);
+            jni_put_double(env, map, "score", result.similarity * 100.0);
+            return map;
+        }
+        case JobKind::Tajweed:
+            return analysis_to_map(env, result.analysis);
+        case JobKind::Rules:
+            return rule_report_to_map(env, result.report);
+    }
+    return nullptr;
 }
 
 // JNI Implementation
 extern "C" {
 
-JNIEXPORT jdoubleArray JNICALL
-Java_com_tajweedtutor_TajweedAudioModule_extractAudioFeatures(JNIEnv *env, jobject thiz, jstring audioPath) {
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved) {
+    JNIEnv *env = nullptr;
+    if (vm->GetEnv(reinterpret_cast<void**>(&env), JNI_VERSION_1_6) != JNI_OK) {
+        return JNI_ERR;
+    }
+    gJavaVm = vm;
+    
+    TajweedAudio::setLogSink(android_log_sink);
+    TajweedAudio::setMinLogLevel(TajweedAudio::LogLevel::Debug);
+    
+    // Class and method lookups happen once here instead of on every call
+    if (!jni_cache_init(env)) {
+        if (env->ExceptionCheck()) env->ExceptionClear();
+        LOGE("Failed to resolve React Native bridge classes");
+        return JNI_ERR;
+    }
+    return JNI_VERSION_1_6;
+}
+
+JNIEXPORT jlong JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_extractFeatureHandle(JNIEnv *env, jobject thiz, jstring audioPath) {
     std::string path = jstring_to_string(env, audioPath);
     LOGD("Extracting features from: %s", path.c_str());
     
     try {
-        std::vector<double> samples;
-        int sampleRate, channels;
-        
-        if (!TajweedAudio::loadAudioFile(path, samples, sampleRate, channels)) {
-            LOGE("Failed to load audio file: %s", path.c_str());
-            return nullptr;
+        TajweedAudio::WavFile audio;
+        if (!audio.open(path)) {
+            LOGE("Failed to load audio file: %s (%s)", path.c_str(), audio.lastError().c_str());
+            return 0;
         }
         
-        AudioFeatures features = TajweedAudio::extractFeatures(samples, sampleRate);
-        
-        // Combine all features into a single vector
-        std::vector<double> allFeatures;
-        allFeatures.insert(allFeatures.end(), features.mfcc.begin(), features.mfcc.end());
-        allFeatures.insert(allFeatures.end(), features.formants.begin(), features.formants.end());
-        allFeatures.insert(allFeatures.end(), features.energy.begin(), features.energy.end());
-        allFeatures.insert(allFeatures.end(), features.pitch.begin(), features.pitch.end());
-        allFeatures.insert(allFeatures.end(), features.spectralCentroid.begin(), features.spectralCentroid.end());
-        allFeatures.insert(allFeatures.end(), features.spectralRolloff.begin(), features.spectralRolloff.end());
-        
-        // Add metadata
-        allFeatures.push_back(features.duration);
-        allFeatures.push_back(static_cast<double>(sampleRate));
-        allFeatures.push_back(static_cast<double>(channels));
-        
-        return vector_to_jdoubleArray(env, allFeatures);
+        // The handle owns its matrix; the workspace only lends scratch memory
+        std::unique_ptr<AudioFeatures> features(new AudioFeatures());
+        TajweedAudio::extractFeatures(audio, TajweedAudio::FeatureWorkspace::forThisThread(), *features);
+        return static_cast<jlong>(reinterpret_cast<intptr_t>(features.release()));
     } catch (const std::exception& e) {
-        LOGE("Exception in extractAudioFeatures: %s", e.what());
-        return nullptr;
+        LOGE("Exception in extractFeatureHandle: %s", e.what());
+        return 0;
+    }
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_featureFrames(JNIEnv *env, jobject thiz, jlong handle) {
+    AudioFeatures* features = features_from_handle(handle);
+    if (!features || features->frames.empty()) return nullptr;
+    
+    // Direct view of the frame-major rows (kFeatureStride floats each, native
+    // byte order); valid until the handle is released
+    TajweedAudio::FeatureMatrix& frames = features->frames;
+    return env->NewDirectByteBuffer(frames.data(), static_cast<jlong>(frames.sizeBytes()));
+}
+
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_featureInfo(JNIEnv *env, jobject thiz, jlong handle) {
+    AudioFeatures* features = features_from_handle(handle);
+    if (!features) return nullptr;
+    
+    jobject result = jni_new_map(env);
+    if (!result) return nullptr;
+    jni_put_int(env, result, "frameCount", static_cast<int>(features->frames.numFrames()));
+    jni_put_int(env, result, "featureCount", static_cast<int>(TajweedAudio::kFeatureColumns));
+    jni_put_int(env, result, "frameStride", static_cast<int>(TajweedAudio::kFeatureStride));
+    jni_put_double(env, result, "frameSeconds", features->frames.frameSeconds());
+    jni_put_double(env, result, "duration", features->duration);
+    jni_put_int(env, result, "sampleRate", features->sampleRate);
+    jni_put_int(env, result, "channels", features->channels);
+    return result;
+}
+
+JNIEXPORT void JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_releaseFeatureHandle(JNIEnv *env, jobject thiz, jlong handle) {
+    delete features_from_handle(handle);
+}
+
+JNIEXPORT jdouble JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_calculateSimilarityFromHandles(JNIEnv *env, jobject thiz, jlong handle1, jlong handle2) {
+    const AudioFeatures* features1 = features_from_handle(handle1);
+    const AudioFeatures* features2 = features_from_handle(handle2);
+    if (!features1 || !features2) {
+        LOGE("calculateSimilarityFromHandles called with a released handle");
+        return 0.0;
+    }
+    
+    try {
+        // Only DTW runs here; both recordings were decoded and analyzed already
+        TajweedAudio::FeatureWorkspace& workspace = TajweedAudio::FeatureWorkspace::forThisThread();
+        const TajweedAudio::FeatureMatrix& frames2 = features2->frames;
+        TajweedAudio::performDTW(*features1, frames2.data(), frames2.numFrames(), features2->sampleRate,
+                                 TajweedAudio::DTWOptions(), workspace, workspace.comparison);
+        return workspace.comparison.similarity;
+    } catch (const std::exception& e) {
+        LOGE("Exception in calculateSimilarityFromHandles: %s", e.what());
+        return 0.0;
     }
 }
 
@@ -80,23 +322,27 @@ Java_com_tajweedtutor_TajweedAudioModule_calculateSimilarity(JNIEnv *env, jobjec
     LOGD("Calculating similarity between: %s and %s", path1.c_str(), path2.c_str());
     
     try {
-        // Load and extract features for both audio files
-        std::vector<double> samples1, samples2;
-        int sampleRate1, channels1, sampleRate2, channels2;
+        // Map both audio files and extract features
+        TajweedAudio::WavFile audio1, audio2;
         
-        if (!TajweedAudio::loadAudioFile(path1, samples1, sampleRate1, channels1) ||
-            !TajweedAudio::loadAudioFile(path2, samples2, sampleRate2, channels2)) {
-            LOGE("Failed to load one or both audio files");
+        if (!audio1.open(path1) || !audio2.open(path2)) {
+            LOGE("Failed to load one or both audio files: %s%s",
+                 audio1.lastError().c_str(), audio2.lastError().c_str());
             return 0.0;
         }
         
-        AudioFeatures features1 = TajweedAudio::extractFeatures(samples1, sampleRate1);
-        AudioFeatures features2 = TajweedAudio::extractFeatures(samples2, sampleRate2);
+        // Both files are analyzed concurrently, each in its own workspace
+        TajweedAudio::FeatureWorkspace& workspace1 = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::User);
+        TajweedAudio::FeatureWorkspace& workspace2 = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::Reference);
+        TajweedAudio::extractFeaturesConcurrently(audio1, workspace1, audio2, workspace2);
         
         // Perform DTW comparison
-        ComparisonResult result = TajweedAudio::performDTW(features1, features2);
+        const TajweedAudio::FeatureMatrix& frames2 = workspace2.features.frames;
+        TajweedAudio::performDTW(workspace1.features, frames2.data(), frames2.numFrames(), workspace2.features.sampleRate,
+                                 TajweedAudio::DTWOptions(), workspace1, workspace1.comparison,
+                                 {workspace1.timeline(), workspace2.timeline()});
         
-        return result.similarity;
+        return workspace1.comparison.similarity;
     } catch (const std::exception& e) {
         LOGE("Exception in calculateSimilarity: %s", e.what());
         return 0.0;
@@ -110,58 +356,45 @@ Java_com_tajweedtutor_TajweedAudioModule_analyzeTajweed(JNIEnv *env, jobject thi
     LOGD("Analyzing Tajweed between: %s and %s", userPath.c_str(), refPath.c_str());
     
     try {
-        // Load and extract features
-        std::vector<double> userSamples, refSamples;
-        int userSampleRate, userChannels, refSampleRate, refChannels;
-        
-        if (!TajweedAudio::loadAudioFile(userPath, userSamples, userSampleRate, userChannels) ||
-            !TajweedAudio::loadAudioFile(refPath, refSamples, refSampleRate, refChannels)) {
-            LOGE("Failed to load audio files for Tajweed analysis");
+        TajweedAudio::AnalysisCache& cache = TajweedAudio::AnalysisCache::instance();
+        TajweedAudio::FeatureWorkspace& userWorkspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::User);
+        TajweedAudio::FeatureWorkspace& refWorkspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::Reference);
+        
+        // An unchanged pair is answered without opening either file
+        uint64_t userKey, refKey;
+        if (!cache.fileKey(userPath, userKey) || !cache.fileKey(refPath, refKey)) {
+            LOGE("Failed to load audio files for Tajweed analysis: %s or %s", userPath.c_str(), refPath.c_str());
             return nullptr;
         }
-        
-        AudioFeatures userFeatures = TajweedAudio::extractFeatures(userSamples, userSampleRate);
-        AudioFeatures refFeatures = TajweedAudio::extractFeatures(refSamples, refSampleRate);
-        
-        // Analyze Tajweed rules
-        TajweedAnalysis analysis = TajweedAudio::analyzeTajweedRules(userFeatures, refFeatures);
-        
-        // Create Java object
-        jclass analysisClass = env->FindClass("java/util/HashMap");
-        jmethodID initMethod = env->GetMethodID(analysisClass, "<init>", "()V");
-        jobject result = env->NewObject(analysisClass, initMethod);
-        
-        jmethodID putMethod = env->GetMethodID(analysisClass, "put", "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-        
-        // Add score
-        jclass doubleClass = env->FindClass("java/lang/Double");
-        jmethodID doubleInit = env->GetMethodID(doubleClass, "<init>", "(D)V");
-        jobject scoreObj = env->NewObject(doubleClass, doubleInit, analysis.overallScore);
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("score"), scoreObj);
-        
-        // Add confidence
-        jobject confidenceObj = env->NewObject(doubleClass, doubleInit, analysis.confidence);
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("confidence"), confidenceObj);
-        
-        // Add errors
-        jclass arrayListClass = env->FindClass("java/util/ArrayList");
-        jmethodID arrayListInit = env->GetMethodID(arrayListClass, "<init>", "()V");
-        jobject errorsList = env->NewObject(arrayListClass, arrayListInit);
-        jmethodID addMethod = env->GetMethodID(arrayListClass, "add", "(Ljava/lang/Object;)Z");
-        
-        for (const auto& error : analysis.errors) {
-            env->CallBooleanMethod(errorsList, addMethod, env->NewStringUTF(error.c_str()));
+        uint64_t config = TajweedAudio::comparisonConfigHash(TajweedAudio::extractionConfigHash(userWorkspace),
+                                                             TajweedAudio::extractionConfigHash(refWorkspace),
+                                                             TajweedAudio::DTWOptions(), "rules");
+        std::shared_ptr<const TajweedAudio::CachedComparison> cached = cache.findComparison(userKey, refKey, config);
+        if (cached) return analysis_to_map(env, cached->analysis);
+        
+        // Only the files whose features are not cached are extracted, both at once
+        std::shared_ptr<const AudioFeatures> userFeatures, refFeatures;
+        bool userHit = false, refHit = false;
+        TajweedAudio::parallelFor(userWorkspace.pool(), 2, 1, [&](size_t side, size_t) {
+            if (side == 0) {
+                userFeatures = TajweedAudio::cachedFeatures(cache, userPath, userKey, userWorkspace, userHit);
+            } else {
+                refFeatures = TajweedAudio::cachedFeatures(cache, refPath, refKey, refWorkspace, refHit);
+            }
+        });
+        if (!userFeatures || !refFeatures) {
+            LOGE("Failed to load audio files for Tajweed analysis: %s or %s", userPath.c_str(), refPath.c_str());
+            return nullptr;
         }
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("errors"), errorsList);
+        LOGD("Tajweed analysis features: user %s, reference %s", userHit ? "cached" : "extracted",
+             refHit ? "cached" : "extracted");
         
-        // Add suggestions
-        jobject suggestionsList = env->NewObject(arrayListClass, arrayListInit);
-        for (const auto& suggestion : analysis.suggestions) {
-            env->CallBooleanMethod(suggestionsList, addMethod, env->NewStringUTF(suggestion.c_str()));
-        }
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("suggestions"), suggestionsList);
+        // Analyze Tajweed rules
+        auto comparison = std::make_shared<TajweedAudio::CachedComparison>();
+        comparison->analysis = TajweedAudio::analyzeTajweedRules(*userFeatures, *refFeatures);
+        cache.putComparison(userKey, refKey, config, comparison);
         
-        return result;
+        return analysis_to_map(env, comparison->analysis);
     } catch (const std::exception& e) {
         LOGE("Exception in analyzeTajweed: %s", e.what());
         return nullptr;
@@ -174,52 +407,24 @@ Java_com_tajweedtutor_TajweedAudioModule_detectTajweedRules(JNIEnv *env, jobject
     LOGD("Detecting Tajweed rules in: %s", path.c_str());
     
     try {
-        std::vector<double> samples;
-        int sampleRate, channels;
-        
-        if (!TajweedAudio::loadAudioFile(path, samples, sampleRate, channels)) {
-            LOGE("Failed to load audio file for rule detection");
+        TajweedAudio::WavFile audio;
+        if (!audio.open(path)) {
+            LOGE("Failed to load audio file for rule detection: %s", audio.lastError().c_str());
             return nullptr;
         }
         
-        AudioFeatures features = TajweedAudio::extractFeatures(samples, sampleRate);
-        
-        // Create result object
-        jclass resultClass = env->FindClass("java/util/HashMap");
-        jmethodID initMethod = env->GetMethodID(resultClass, "<init>", "()V");
-        jobject result = env->NewObject(resultClass, initMethod);
-        jmethodID putMethod = env->GetMethodID(resultClass, "put", "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-        
-        // Detect specific rules (simplified implementation)
-        std::vector<std::string> detectedRules;
-        std::vector<std::string> violations;
-        std::vector<std::string> recommendations;
-        
-        // Basic rule detection logic
-        if (TajweedAudio::detectMadd(features.pitch, features.energy, 2.0)) {
-            detectedRules.push_back("Madd");
-        }
-        
-        if (TajweedAudio::detectGhunna(features.energy, features.pitch)) {
-            detectedRules.push_back("Ghunna");
-        }
-        
-        if (TajweedAudio::detectQalqalah(features.energy, features.pitch)) {
-            detectedRules.push_back("Qalqalah");
-        }
-        
-        // Add results to Java object
-        jclass arrayListClass = env->FindClass("java/util/ArrayList");
-        jmethodID arrayListInit = env->GetMethodID(arrayListClass, "<init>", "()V");
-        jmethodID addMethod = env->GetMethodID(arrayListClass, "add", "(Ljava/lang/Object;)Z");
+        TajweedAudio::FeatureWorkspace& workspace = TajweedAudio::FeatureWorkspace::forThisThread();
+        AudioFeatures& features = workspace.features;
+        TajweedAudio::extractFeatures(audio, workspace, features);
         
-        jobject detectedRulesList = env->NewObject(arrayListClass, arrayListInit);
-        for (const auto& rule : detectedRules) {
-            env->CallBooleanMethod(detectedRulesList, addMethod, env->NewStringUTF(rule.c_str()));
+        TajweedAudio::RuleSet selected = rule_set_from_map(env, rules);
+        TajweedAudio::RuleReport& report = workspace.ruleReport;
+        {
+            TAJWEED_PERF_SCOPE(Rules);
+            workspace.rules.run(features.frames, selected, report, nullptr, workspace.timeline());
         }
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("detectedRules"), detectedRulesList);
         
-        return result;
+        return rule_report_to_map(env, report);
     } catch (const std::exception& e) {
         LOGE("Exception in detectTajweedRules: %s", e.what());
         return nullptr;
@@ -232,36 +437,21 @@ Java_com_tajweedtutor_TajweedAudioModule_getAudioInfo(JNIEnv *env, jobject thiz,
     LOGD("Getting audio info for: %s", path.c_str());
     
     try {
-        std::vector<double> samples;
-        int sampleRate, channels;
-        
-        if (!TajweedAudio::loadAudioFile(path, samples, sampleRate, channels)) {
-            LOGE("Failed to load audio file for info");
+        // Only the header is parsed; no samples are decoded
+        TajweedAudio::WavFile audio;
+        if (!audio.open(path)) {
+            LOGE("Failed to load audio file for info: %s", audio.lastError().c_str());
             return nullptr;
         }
+        int sampleRate = audio.sampleRate();
+        int channels = audio.channels();
         
         // Create result object
-        jclass resultClass = env->FindClass("java/util/HashMap");
-        jmethodID initMethod = env->GetMethodID(resultClass, "<init>", "()V");
-        jobject result = env->NewObject(resultClass, initMethod);
-        jmethodID putMethod = env->GetMethodID(resultClass, "put", "(Ljava/lang/Object;Ljava/lang/Object;)Ljava/lang/Object;");
-        
-        // Add audio information
-        jclass doubleClass = env->FindClass("java/lang/Double");
-        jmethodID doubleInit = env->GetMethodID(doubleClass, "<init>", "(D)V");
-        
-        double duration = static_cast<double>(samples.size()) / sampleRate;
-        jobject durationObj = env->NewObject(doubleClass, doubleInit, duration);
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("duration"), durationObj);
-        
-        jclass integerClass = env->FindClass("java/lang/Integer");
-        jmethodID intInit = env->GetMethodID(integerClass, "<init>", "(I)V");
-        
-        jobject sampleRateObj = env->NewObject(integerClass, intInit, sampleRate);
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("sampleRate"), sampleRateObj);
-        
-        jobject channelsObj = env->NewObject(integerClass, intInit, channels);
-        env->CallObjectMethod(result, putMethod, env->NewStringUTF("channels"), channelsObj);
+        jobject result = jni_new_map(env);
+        if (!result) return nullptr;
+        jni_put_double(env, result, "duration", audio.duration());
+        jni_put_int(env, result, "sampleRate", sampleRate);
+        jni_put_int(env, result, "channels", channels);
         
         return result;
     } catch (const std::exception& e) {
@@ -270,353 +460,485 @@ Java_com_tajweedtutor_TajweedAudioModule_getAudioInfo(JNIEnv *env, jobject thiz,
     }
 }
 
-} // extern "C"
-
-// C++ Implementation
-namespace TajweedAudio {
-
-bool loadAudioFile(const std::string& path, std::vector<double>& samples, int& sampleRate, int& channels) {
-    // This is a simplified implementation
-    // In a real implementation, you would use a library like libsndfile or FFmpeg
-    
-    LOGD("Loading audio file: %s", path.c_str());
-    
-    // For now, create dummy data
-    // In production, integrate with libsndfile or similar
-    sampleRate = 44100;
-    channels = 1;
-    
-    // Generate dummy audio data (sine wave for testing)
-    int duration = 3; // 3 seconds
-    int numSamples = sampleRate * duration;
-    samples.resize(numSamples);
-    
-    for (int i = 0; i < numSamples; i++) {
-        double t = static_cast<double>(i) / sampleRate;
-        samples[i] = 0.5 * sin(2.0 * M_PI * 440.0 * t); // 440 Hz sine wave
-    }
-    
-    LOGD("Loaded %zu samples at %d Hz", samples.size(), sampleRate);
-    return true;
+JNIEXPORT void JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_setFeatureStoreDirectory(JNIEnv *env, jobject thiz, jstring directory) {
+    std::string dir = jstring_to_string(env, directory);
+    LOGD("Feature store directory: %s", dir.c_str());
+    TajweedAudio::FeatureStore::instance().setDirectory(dir);
 }
 
-AudioFeatures extractFeatures(const std::vector<double>& samples, int sampleRate) {
-    AudioFeatures features;
-    
-    // Extract different types of features
-    features.mfcc = extractMFCC(samples, sampleRate);
-    features.formants = extractFormants(samples, sampleRate);
-    features.energy = extractEnergy(samples, 1024);
-    features.pitch = extractPitch(samples, sampleRate);
-    features.spectralCentroid = extractSpectralCentroid(samples, sampleRate);
-    features.spectralRolloff = extractSpectralRolloff(samples, sampleRate);
-    
-    features.duration = static_cast<double>(samples.size()) / sampleRate;
-    features.sampleRate = sampleRate;
-    features.channels = 1; // Assuming mono for now
-    
-    return features;
+// Config hash that reference bundles are built, and looked up, under: every
+// thread's Reference workspace has the same settings
+// A reference bundle built under the thread's Reference settings, from a WAV
+// file (VAD-trimmed) or from compressed audio (streamed, untrimmed)
+static std::shared_ptr<const TajweedAudio::FeatureBundle> open_reference_bundle(const std::string& id,
+                                                                                std::string& error) {
+    const TajweedAudio::FeatureWorkspace& workspace =
+        TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::Reference);
+    return TajweedAudio::FeatureStore::instance().open(
+        id, {TajweedAudio::extractionConfigHash(workspace), TajweedAudio::streamingConfigHash(workspace)}, error);
 }
 
-std::vector<double> extractMFCC(const std::vector<double>& samples, int sampleRate) {
-    // Simplified MFCC extraction
-    // In production, use a proper MFCC library
-    std::vector<double> mfcc(13, 0.0); // 13 MFCC coefficients
-    
-    // Basic spectral analysis
-    std::vector<double> fft = computeFFT(samples);
-    
-    // Calculate MFCC coefficients (simplified)
-    for (int i = 0; i < 13; i++) {
-        mfcc[i] = sin(2.0 * M_PI * i / 13.0) * 0.1; // Dummy values
+// Reference features from a WAV file, extracted as usual, or from compressed
+// audio decoded block by block straight into a streaming extraction, so no
+// PCM copy of a long recitation is ever written or held. The streamed rows
+// match extractFeatures with VAD off: silence around the recitation is kept.
+// `configHash` is the hash of the config the features were extracted under.
+static bool extract_reference_features(const std::string& path, TajweedAudio::FeatureWorkspace& workspace,
+                                       AudioFeatures& features, uint64_t& configHash, std::string& error) {
+    TajweedAudio::WavFile wav;
+    if (wav.open(path)) {
+        TajweedAudio::extractFeatures(wav, workspace, features);
+        configHash = TajweedAudio::extractionConfigHash(workspace);
+        return true;
     }
     
-    return mfcc;
+    TajweedAudio::MediaDecoder decoder;
+    if (!decoder.open(path)) {
+        error = wav.lastError() + "; " + decoder.lastError();
+        return false;
+    }
+    TajweedAudio::StreamingOptions options;
+    options.resample = workspace.resample;
+    options.preprocess = workspace.preprocess;
+    TajweedAudio::StreamingAnalyzer analyzer(decoder.sampleRate(), options);
+    TajweedAudio::DecodeStats stats;
+    if (!TajweedAudio::decodeFeatures(decoder, analyzer, workspace.job, &stats, error)) return false;
+    LOGD("Decoded %zu frames at %d Hz in %zu blocks: first features after %.1f ms, done in %.1f ms",
+         stats.frames, decoder.sampleRate(), stats.blocks, stats.firstFrameMs, stats.totalMs);
+    
+    features = analyzer.features();
+    features.channels = decoder.channels();
+    configHash = TajweedAudio::streamingConfigHash(workspace);
+    return true;
 }
 
-std::vector<double> extractFormants(const std::vector<double>& samples, int sampleRate) {
-    // Simplified formant extraction
-    std::vector<double> formants(4, 0.0); // F1, F2, F3, F4
-    
-    // Basic formant estimation (simplified)
-    formants[0] = 800.0;  // F1
-    formants[1] = 1200.0; // F2
-    formants[2] = 2500.0; // F3
-    formants[3] = 3500.0; // F4
+JNIEXPORT jboolean JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_buildReferenceBundle(JNIEnv *env, jobject thiz, jstring audioPath, jstring bundleId) {
+    std::string path = jstring_to_string(env, audioPath);
+    std::string id = jstring_to_string(env, bundleId);
+    LOGD("Building reference bundle %s from: %s", id.c_str(), path.c_str());
     
-    return formants;
+    try {
+        TajweedAudio::FeatureWorkspace& workspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::Reference);
+        AudioFeatures& features = workspace.features;
+        std::string error;
+        uint64_t configHash;
+        if (!extract_reference_features(path, workspace, features, configHash, error)) {
+            LOGE("Failed to load reference audio: %s", error.c_str());
+            return JNI_FALSE;
+        }
+        
+        // The whole reference is one segment until segmentation is available
+        TajweedAudio::BundleSegment whole = {0.0, features.duration, 0,
+                                             static_cast<uint32_t>(features.frames.numFrames())};
+        
+        if (!TajweedAudio::FeatureStore::instance().put(id, features, {whole}, configHash, error)) {
+            LOGE("Failed to write reference bundle %s: %s", id.c_str(), error.c_str());
+            return JNI_FALSE;
+        }
+        return JNI_TRUE;
+    } catch (const std::exception& e) {
+        LOGE("Exception in buildReferenceBundle: %s", e.what());
+        return JNI_FALSE;
+    }
 }
 
-std::vector<double> extractEnergy(const std::vector<double>& samples, int windowSize) {
-    std::vector<double> energy;
-    int numWindows = samples.size() / windowSize;
+JNIEXPORT jdouble JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_calculateSimilarityWithReference(JNIEnv *env, jobject thiz, jstring userAudioPath, jstring bundleId) {
+    std::string userPath = jstring_to_string(env, userAudioPath);
+    std::string id = jstring_to_string(env, bundleId);
+    LOGD("Calculating similarity between: %s and bundle %s", userPath.c_str(), id.c_str());
     
-    for (int i = 0; i < numWindows; i++) {
-        double sum = 0.0;
-        for (int j = 0; j < windowSize; j++) {
-            int index = i * windowSize + j;
-            if (index < samples.size()) {
-                sum += samples[index] * samples[index];
-            }
+    try {
+        std::string error;
+        std::shared_ptr<const TajweedAudio::FeatureBundle> reference = open_reference_bundle(id, error);
+        TajweedAudio::WavFile userAudio;
+        
+        if (!reference || !userAudio.open(userPath)) {
+            LOGE("Failed to load user audio or reference bundle: %s%s", userAudio.lastError().c_str(), error.c_str());
+            return 0.0;
         }
-        energy.push_back(sum / windowSize);
+        
+        // Only the user recording is extracted; reference frames come from the mapping
+        TajweedAudio::FeatureWorkspace& workspace = TajweedAudio::FeatureWorkspace::forThisThread();
+        TajweedAudio::extractFeatures(userAudio, workspace, workspace.features);
+        size_t refFrames;
+        const float* refRows = reference->frames(refFrames);
+        
+        TajweedAudio::performDTW(workspace.features, refRows, refFrames, reference->sampleRate(),
+                                 TajweedAudio::DTWOptions(), workspace, workspace.comparison,
+                                 {workspace.timeline(), nullptr});
+        return workspace.comparison.similarity;
+    } catch (const std::exception& e) {
+        LOGE("Exception in calculateSimilarityWithReference: %s", e.what());
+        return 0.0;
     }
-    
-    return energy;
 }
 
-std::vector<double> extractPitch(const std::vector<double>& samples, int sampleRate) {
-    // Simplified pitch extraction using autocorrelation
-    std::vector<double> pitch;
-    int windowSize = 1024;
-    int hopSize = 512;
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_analyzeTajweedWithReference(JNIEnv *env, jobject thiz, jstring userAudioPath, jstring bundleId) {
+    std::string userPath = jstring_to_string(env, userAudioPath);
+    std::string id = jstring_to_string(env, bundleId);
+    LOGD("Analyzing Tajweed between: %s and bundle %s", userPath.c_str(), id.c_str());
     
-    for (size_t i = 0; i < samples.size() - windowSize; i += hopSize) {
-        std::vector<double> window(samples.begin() + i, samples.begin() + i + windowSize);
-        
-        // Autocorrelation-based pitch detection
-        double maxCorr = 0.0;
-        int bestLag = 0;
+    try {
+        std::string error;
+        std::shared_ptr<const TajweedAudio::FeatureBundle> reference = open_reference_bundle(id, error);
+        TajweedAudio::WavFile userAudio;
         
-        for (int lag = 20; lag < windowSize / 2; lag++) {
-            double corr = 0.0;
-            for (int j = 0; j < windowSize - lag; j++) {
-                corr += window[j] * window[j + lag];
-            }
-            
-            if (corr > maxCorr) {
-                maxCorr = corr;
-                bestLag = lag;
-            }
+        if (!reference || !userAudio.open(userPath)) {
+            LOGE("Failed to load user audio or reference bundle: %s%s", userAudio.lastError().c_str(), error.c_str());
+            return nullptr;
         }
         
-        double pitchFreq = static_cast<double>(sampleRate) / bestLag;
-        pitch.push_back(pitchFreq);
+        TajweedAudio::FeatureWorkspace& userWorkspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::User);
+        TajweedAudio::FeatureWorkspace& refWorkspace = TajweedAudio::FeatureWorkspace::forThisThread(TajweedAudio::Pipeline::Reference);
+        TajweedAudio::extractFeatures(userAudio, userWorkspace, userWorkspace.features);
+        reference->features(refWorkspace.features);
+        
+        TajweedAnalysis analysis = TajweedAudio::analyzeTajweedRules(userWorkspace.features, refWorkspace.features);
+        return analysis_to_map(env, analysis);
+    } catch (const std::exception& e) {
+        LOGE("Exception in analyzeTajweedWithReference: %s", e.what());
+        return nullptr;
     }
-    
-    return pitch;
 }
 
-std::vector<double> extractSpectralCentroid(const std::vector<double>& samples, int sampleRate) {
-    // Simplified spectral centroid calculation
-    std::vector<double> centroid;
-    int windowSize = 1024;
-    int hopSize = 512;
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_alignLongRecitation(JNIEnv *env, jobject thiz, jstring userAudioPath, jstring bundleId) {
+    std::string userPath = jstring_to_string(env, userAudioPath);
+    std::string id = jstring_to_string(env, bundleId);
+    LOGD("Aligning long recitation: %s against bundle %s", userPath.c_str(), id.c_str());
     
-    for (size_t i = 0; i < samples.size() - windowSize; i += hopSize) {
-        std::vector<double> window(samples.begin() + i, samples.begin() + i + windowSize);
-        std::vector<double> fft = computeFFT(window);
-        
-        double weightedSum = 0.0;
-        double magnitudeSum = 0.0;
+    try {
+        std::string error;
+        std::shared_ptr<const TajweedAudio::FeatureBundle> reference = open_reference_bundle(id, error);
+        TajweedAudio::WavFile userAudio;
         
-        for (size_t j = 0; j < fft.size() / 2; j++) {
-            double magnitude = sqrt(fft[j] * fft[j] + fft[j + fft.size()/2] * fft[j + fft.size()/2]);
-            double frequency = static_cast<double>(j) * sampleRate / windowSize;
-            
-            weightedSum += frequency * magnitude;
-            magnitudeSum += magnitude;
+        if (!reference || !userAudio.open(userPath)) {
+            LOGE("Failed to load user audio or reference bundle: %s%s", userAudio.lastError().c_str(), error.c_str());
+            return nullptr;
         }
         
-        centroid.push_back(magnitudeSum > 0 ? weightedSum / magnitudeSum : 0.0);
+        TajweedAudio::FeatureWorkspace& workspace = TajweedAudio::FeatureWorkspace::forThisThread();
+        TajweedAudio::extractFeatures(userAudio, workspace, workspace.features);
+        size_t refFrames;
+        const float* refRows = reference->frames(refFrames);
+        
+        std::vector<TajweedAudio::AlignmentChunk> chunks;
+        TajweedAudio::LongAlignmentStats stats;
+        TajweedAudio::performLongDTW(workspace.features, refRows, refFrames, reference->sampleRate(),
+                                     TajweedAudio::LongAlignmentOptions(), workspace, workspace.comparison,
+                                     chunks, &stats, {workspace.timeline(), nullptr});
+        LOGD("Long alignment: %zu chunks (%zu on pauses), coarse %.1f ms, chunks %.1f ms",
+             chunks.size(), stats.pauseAnchors, stats.coarseMs, stats.chunksMs);
+        
+        jobject result = jni_new_map(env);
+        if (!result) return nullptr;
+        jni_put_double(env, result, "similarity", workspace.comparison.similarity);
+        jni_put_double(env, result, "score", workspace.comparison.score);
+        jobject list = jni_new_array(env);
+        for (const TajweedAudio::AlignmentChunk& chunk : chunks) {
+            jobject item = jni_new_map(env);
+            jni_put_double(env, item, "startTime", chunk.startTime1);
+            jni_put_double(env, item, "endTime", chunk.endTime1);
+            jni_put_double(env, item, "referenceStartTime", chunk.startTime2);
+            jni_put_double(env, item, "referenceEndTime", chunk.endTime2);
+            jni_put_boolean(env, item, "pauseAnchored", chunk.pauseAnchored);
+            jni_put_double(env, item, "similarity", chunk.similarity);
+            jni_put_double(env, item, "score", chunk.score);
+            jni_push_map(env, list, item);
+        }
+        jni_put_array(env, result, "chunks", list);
+        
+        jobject counts = jni_new_map(env);
+        jni_put_int(env, counts, "pauses", static_cast<int>(stats.pauses1));
+        jni_put_int(env, counts, "referencePauses", static_cast<int>(stats.pauses2));
+        jni_put_int(env, counts, "pauseAnchors", static_cast<int>(stats.pauseAnchors));
+        jni_put_int(env, counts, "coarseFactor", static_cast<int>(stats.coarseFactor));
+        jni_put_double(env, counts, "coarseMs", stats.coarseMs);
+        jni_put_double(env, counts, "chunksMs", stats.chunksMs);
+        jni_put_map(env, result, "stats", counts);
+        return result;
+    } catch (const std::exception& e) {
+        LOGE("Exception in alignLongRecitation: %s", e.what());
+        return nullptr;
     }
-    
-    return centroid;
 }
 
-std::vector<double> extractSpectralRolloff(const std::vector<double>& samples, int sampleRate) {
-    // Simplified spectral rolloff calculation
-    std::vector<double> rolloff;
-    int windowSize = 1024;
-    int hopSize = 512;
+JNIEXPORT jdoubleArray JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_analyzeLessonBatch(JNIEnv *env, jobject thiz, jobjectArray userAudioPaths, jobjectArray referenceAudioPaths) {
+    jsize count = env->GetArrayLength(userAudioPaths);
+    if (env->GetArrayLength(referenceAudioPaths) != count) {
+        LOGE("analyzeLessonBatch: %d user paths but %d references", count, env->GetArrayLength(referenceAudioPaths));
+        return nullptr;
+    }
+    LOGD("Analyzing lesson batch of %d segments", count);
     
-    for (size_t i = 0; i < samples.size() - windowSize; i += hopSize) {
-        std::vector<double> window(samples.begin() + i, samples.begin() + i + windowSize);
-        std::vector<double> fft = computeFFT(window);
-        
-        // Calculate total energy
-        double totalEnergy = 0.0;
-        for (size_t j = 0; j < fft.size() / 2; j++) {
-            double magnitude = sqrt(fft[j] * fft[j] + fft[j + fft.size()/2] * fft[j + fft.size()/2]);
-            totalEnergy += magnitude * magnitude;
+    try {
+        std::vector<TajweedAudio::BatchSegment> segments(count);
+        for (jsize i = 0; i < count; i++) {
+            jstring userPath = static_cast<jstring>(env->GetObjectArrayElement(userAudioPaths, i));
+            jstring refPath = static_cast<jstring>(env->GetObjectArrayElement(referenceAudioPaths, i));
+            segments[i].userPath = jstring_to_string(env, userPath);
+            segments[i].referencePath = jstring_to_string(env, refPath);
+            env->DeleteLocalRef(userPath);
+            env->DeleteLocalRef(refPath);
         }
         
-        // Find rolloff point (85% of energy)
-        double targetEnergy = 0.85 * totalEnergy;
-        double currentEnergy = 0.0;
-        double rolloffFreq = 0.0;
+        std::vector<TajweedAudio::BatchSegmentResult> results;
+        TajweedAudio::BatchStats stats;
+        TajweedAudio::analyzeLessonBatch(segments, results, stats, TajweedAudio::ThreadPool::shared(),
+                                         &TajweedAudio::AnalysisCache::instance());
+        LOGD("Lesson batch: %zu segments (%zu from cache), %zu references (%zu from bundles) in %.1f ms",
+             stats.segments, stats.comparisonsFromCache, stats.references, stats.referencesFromStore, stats.totalMs);
         
-        for (size_t j = 0; j < fft.size() / 2; j++) {
-            double magnitude = sqrt(fft[j] * fft[j] + fft[j + fft.size()/2] * fft[j + fft.size()/2]);
-            currentEnergy += magnitude * magnitude;
-            
-            if (currentEnergy >= targetEnergy) {
-                rolloffFreq = static_cast<double>(j) * sampleRate / windowSize;
-                break;
-            }
-        }
+        // One flat buffer for the whole lesson; see lesson_batch.h for the layout
+        std::vector<double> packed(TajweedAudio::packedBatchSize(results.size()));
+        TajweedAudio::packBatchResults(results, stats, packed.data());
         
-        rolloff.push_back(rolloffFreq);
+        jdoubleArray result = env->NewDoubleArray(static_cast<jsize>(packed.size()));
+        if (!result) return nullptr;
+        env->SetDoubleArrayRegion(result, 0, static_cast<jsize>(packed.size()), packed.data());
+        return result;
+    } catch (const std::exception& e) {
+        LOGE("Exception in analyzeLessonBatch: %s", e.what());
+        return nullptr;
     }
-    
-    return rolloff;
 }
 
-ComparisonResult performDTW(const AudioFeatures& features1, const AudioFeatures& features2) {
-    ComparisonResult result;
-    
-    // Use MFCC features for DTW
-    double dtwDistance = calculateDTWDistance(features1.mfcc, features2.mfcc);
-    
-    // Convert distance to similarity (0-1 scale)
-    result.similarity = 1.0 / (1.0 + dtwDistance);
-    result.score = result.similarity * 100.0;
-    
-    return result;
-}
+// Searched by any thread; a rebuild swaps in a whole new index
+static std::mutex gReferenceIndexMutex;
+static std::shared_ptr<const TajweedAudio::ReferenceIndex> gReferenceIndex;
 
-double calculateDTWDistance(const std::vector<double>& seq1, const std::vector<double>& seq2) {
-    // Simplified DTW implementation
-    // In production, use a proper DTW library
-    
-    size_t n = seq1.size();
-    size_t m = seq2.size();
-    
-    if (n == 0 || m == 0) return 0.0;
+JNIEXPORT jint JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_buildReferenceIndex(JNIEnv *env, jobject thiz, jobjectArray bundleIds) {
+    jsize count = env->GetArrayLength(bundleIds);
+    LOGD("Building reference index from %d bundles", count);
     
-    // Create distance matrix
-    std::vector<std::vector<double>> dtw(n + 1, std::vector<double>(m + 1, INFINITY));
-    dtw[0][0] = 0.0;
-    
-    // Fill the matrix
-    for (size_t i = 1; i <= n; i++) {
-        for (size_t j = 1; j <= m; j++) {
-            double cost = abs(seq1[i-1] - seq2[j-1]);
-            dtw[i][j] = cost + std::min({dtw[i-1][j], dtw[i][j-1], dtw[i-1][j-1]});
+    try {
+        auto index = std::make_shared<TajweedAudio::ReferenceIndex>();
+        for (jsize i = 0; i < count; i++) {
+            jstring bundleId = static_cast<jstring>(env->GetObjectArrayElement(bundleIds, i));
+            std::string id = jstring_to_string(env, bundleId);
+            env->DeleteLocalRef(bundleId);
+            
+            std::string error;
+            std::shared_ptr<const TajweedAudio::FeatureBundle> bundle = open_reference_bundle(id, error);
+            if (!bundle) {
+                LOGE("Skipping reference bundle %s: %s", id.c_str(), error.c_str());
+                continue;
+            }
+            size_t numFrames, numSegments;
+            const float* rows = bundle->frames(numFrames);
+            const TajweedAudio::BundleSegment* segments = bundle->segments(numSegments);
+            index->add(id, rows, numFrames, segments, numSegments);
         }
+        index->build();
+        LOGD("Reference index: %zu segments%s", index->size(), index->clustered() ? ", clustered" : "");
+        
+        std::lock_guard<std::mutex> lock(gReferenceIndexMutex);
+        gReferenceIndex = index;
+        return static_cast<jint>(index->size());
+    } catch (const std::exception& e) {
+        LOGE("Exception in buildReferenceIndex: %s", e.what());
+        return -1;
     }
-    
-    return dtw[n][m];
 }
 
-TajweedAnalysis analyzeTajweedRules(const AudioFeatures& userFeatures, const AudioFeatures& referenceFeatures) {
-    TajweedAnalysis analysis;
-    
-    // Basic rule analysis
-    bool maddCorrect = detectMadd(userFeatures.pitch, userFeatures.energy, 2.0);
-    bool makharijCorrect = detectMakharij(userFeatures.formants, referenceFeatures.formants);
-    bool ghunnaCorrect = detectGhunna(userFeatures.energy, userFeatures.pitch);
-    bool qalqalahCorrect = detectQalqalah(userFeatures.energy, userFeatures.pitch);
-    
-    // Calculate overall score
-    int correctRules = 0;
-    int totalRules = 4;
-    
-    if (maddCorrect) correctRules++;
-    if (makharijCorrect) correctRules++;
-    if (ghunnaCorrect) correctRules++;
-    if (qalqalahCorrect) correctRules++;
-    
-    analysis.overallScore = static_cast<double>(correctRules) / totalRules * 100.0;
-    analysis.confidence = 0.8; // Placeholder confidence
-    
-    // Add errors and suggestions
-    if (!maddCorrect) {
-        analysis.errors.push_back("Madd not properly elongated");
-        analysis.suggestions.push_back("Focus on elongating the Madd letters");
-    }
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_searchReferences(JNIEnv *env, jobject thiz, jstring userAudioPath, jint k) {
+    std::string userPath = jstring_to_string(env, userAudioPath);
+    LOGD("Searching references for: %s", userPath.c_str());
     
-    if (!makharijCorrect) {
-        analysis.errors.push_back("Articulation point needs adjustment");
-        analysis.suggestions.push_back("Practice the articulation points of Arabic letters");
+    std::shared_ptr<const TajweedAudio::ReferenceIndex> index;
+    {
+        std::lock_guard<std::mutex> lock(gReferenceIndexMutex);
+        index = gReferenceIndex;
     }
-    
-    if (!ghunnaCorrect) {
-        analysis.errors.push_back("Ghunna not properly pronounced");
-        analysis.suggestions.push_back("Practice nasal sounds");
+    if (!index) {
+        LOGE("searchReferences: no reference index has been built");
+        return nullptr;
     }
     
-    if (!qalqalahCorrect) {
-        analysis.errors.push_back("Qalqalah not properly pronounced");
-        analysis.suggestions.push_back("Practice the bouncing sound of Qalqalah letters");
+    try {
+        TajweedAudio::WavFile userAudio;
+        if (!userAudio.open(userPath)) {
+            LOGE("Failed to load user audio: %s", userAudio.lastError().c_str());
+            return nullptr;
+        }
+        
+        TajweedAudio::FeatureWorkspace& workspace = TajweedAudio::FeatureWorkspace::forThisThread();
+        TajweedAudio::extractFeatures(userAudio, workspace, workspace.features);
+        
+        std::vector<TajweedAudio::IndexMatch> matches;
+        TajweedAudio::IndexSearchStats stats;
+        index->search(workspace.features.frames, k > 0 ? static_cast<size_t>(k) : 0,
+                      TajweedAudio::IndexSearchOptions(), matches, &stats);
+        
+        jobject result = jni_new_map(env);
+        if (!result) return nullptr;
+        jobject list = jni_new_array(env);
+        for (const TajweedAudio::IndexMatch& match : matches) {
+            jobject item = jni_new_map(env);
+            jni_put_string(env, item, "bundleId", match.id);
+            jni_put_int(env, item, "segment", static_cast<int>(match.segment));
+            jni_put_double(env, item, "startTime", match.startTime);
+            jni_put_double(env, item, "endTime", match.endTime);
+            jni_put_double(env, item, "similarity", match.similarity);
+            jni_put_double(env, item, "score", match.score);
+            jni_push_map(env, list, item);
+        }
+        jni_put_array(env, result, "matches", list);
+        
+        jobject counts = jni_new_map(env);
+        jni_put_int(env, counts, "entries", static_cast<int>(stats.entries));
+        jni_put_int(env, counts, "scanned", static_cast<int>(stats.scanned));
+        jni_put_int(env, counts, "shortlisted", static_cast<int>(stats.shortlisted));
+        jni_put_int(env, counts, "pruned", static_cast<int>(stats.pruned));
+        jni_put_int(env, counts, "aligned", static_cast<int>(stats.aligned));
+        jni_put_double(env, counts, "searchMs", stats.searchMs);
+        jni_put_map(env, result, "stats", counts);
+        return result;
+    } catch (const std::exception& e) {
+        LOGE("Exception in searchReferences: %s", e.what());
+        return nullptr;
     }
-    
-    return analysis;
 }
 
-bool detectMadd(const std::vector<double>& pitch, const std::vector<double>& energy, double expectedDuration) {
-    // Simplified Madd detection
-    // Look for sustained pitch and energy
-    if (pitch.empty() || energy.empty()) return false;
-    
-    double avgPitch = std::accumulate(pitch.begin(), pitch.end(), 0.0) / pitch.size();
-    double avgEnergy = std::accumulate(energy.begin(), energy.end(), 0.0) / energy.size();
-    
-    // Check if pitch and energy are sustained
-    return avgPitch > 100.0 && avgEnergy > 0.1;
+JNIEXPORT void JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_configureAnalysisCache(JNIEnv *env, jobject thiz, jdouble budgetMb, jboolean hashContents) {
+    TajweedAudio::AnalysisCache& cache = TajweedAudio::AnalysisCache::instance();
+    cache.setBudget(budgetMb > 0.0 ? static_cast<size_t>(budgetMb * 1024.0 * 1024.0) : 0);
+    cache.setKeyMode(hashContents ? TajweedAudio::CacheKeyMode::ContentHash : TajweedAudio::CacheKeyMode::PathSizeMtime);
+    LOGD("Analysis cache: %.1f MB, keyed by %s", budgetMb, hashContents ? "content" : "path, size and mtime");
 }
 
-bool detectMakharij(const std::vector<double>& formants, const std::vector<double>& referenceFormants) {
-    // Simplified Makharij detection
-    // Compare formant frequencies
-    if (formants.size() != referenceFormants.size()) return false;
-    
-    double totalDiff = 0.0;
-    for (size_t i = 0; i < formants.size(); i++) {
-        totalDiff += abs(formants[i] - referenceFormants[i]);
-    }
-    
-    double avgDiff = totalDiff / formants.size();
-    return avgDiff < 200.0; // Threshold for acceptable difference
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_getAnalysisCacheStats(JNIEnv *env, jobject thiz) {
+    TajweedAudio::AnalysisCacheStats stats = TajweedAudio::AnalysisCache::instance().stats();
+    
+    // Counts cross as doubles, like the perf counters
+    jobject result = jni_new_map(env);
+    if (!result) return nullptr;
+    jni_put_double(env, result, "entries", static_cast<double>(stats.entries));
+    jni_put_double(env, result, "bytes", static_cast<double>(stats.bytes));
+    jni_put_double(env, result, "budgetBytes", static_cast<double>(stats.budgetBytes));
+    jni_put_double(env, result, "featureHits", static_cast<double>(stats.featureHits));
+    jni_put_double(env, result, "featureMisses", static_cast<double>(stats.featureMisses));
+    jni_put_double(env, result, "comparisonHits", static_cast<double>(stats.comparisonHits));
+    jni_put_double(env, result, "comparisonMisses", static_cast<double>(stats.comparisonMisses));
+    jni_put_double(env, result, "evictions", static_cast<double>(stats.evictions));
+    jni_put_double(env, result, "evictedBytes", static_cast<double>(stats.evictedBytes));
+    jni_put_double(env, result, "rejected", static_cast<double>(stats.rejected));
+    return result;
 }
 
-bool detectGhunna(const std::vector<double>& energy, const std::vector<double>& pitch) {
-    // Simplified Ghunna detection
-    // Look for nasal characteristics in energy and pitch
-    if (energy.empty() || pitch.empty()) return false;
-    
-    double avgEnergy = std::accumulate(energy.begin(), energy.end(), 0.0) / energy.size();
-    double avgPitch = std::accumulate(pitch.begin(), pitch.end(), 0.0) / pitch.size();
-    
-    // Nasal sounds typically have specific energy and pitch characteristics
-    return avgEnergy > 0.05 && avgPitch > 80.0;
+JNIEXPORT void JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_clearAnalysisCache(JNIEnv *env, jobject thiz) {
+    TajweedAudio::AnalysisCache::instance().clear();
 }
 
-bool detectQalqalah(const std::vector<double>& energy, const std::vector<double>& pitch) {
-    // Simplified Qalqalah detection
-    // Look for bouncing characteristics
-    if (energy.empty() || pitch.empty()) return false;
+JNIEXPORT jobject JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_getPerfStats(JNIEnv *env, jobject thiz) {
+    TajweedAudio::PerfSnapshot snapshot = TajweedAudio::perfSnapshot();
+    
+    jobject result = jni_new_map(env);
+    if (!result) return nullptr;
+    jni_put_boolean(env, result, "enabled", snapshot.enabled);
+    
+    jobject stages = jni_new_map(env);
+    for (size_t s = 0; s < TajweedAudio::kPerfStageCount; s++) {
+        const TajweedAudio::StageSnapshot& stage = snapshot.stages[s];
+        jobject entry = jni_new_map(env);
+        jni_put_double(env, entry, "count", static_cast<double>(stage.count));
+        jni_put_double(env, entry, "totalMs", stage.totalMs);
+        jni_put_double(env, entry, "p50Us", stage.p50Us);
+        jni_put_double(env, entry, "p95Us", stage.p95Us);
+        jni_put_double(env, entry, "p99Us", stage.p99Us);
+        jni_put_double(env, entry, "maxUs", stage.maxUs);
+        jni_put_map(env, stages, TajweedAudio::perfStageName(static_cast<TajweedAudio::PerfStage>(s)), entry);
+    }
+    jni_put_map(env, result, "stages", stages);
     
-    // Check for energy variations that indicate bouncing
-    double maxEnergy = *std::max_element(energy.begin(), energy.end());
-    double minEnergy = *std::min_element(energy.begin(), energy.end());
+    // Counters cross as doubles: byte totals outgrow a jint
+    jobject counters = jni_new_map(env);
+    for (size_t c = 0; c < TajweedAudio::kPerfCounterCount; c++) {
+        jni_put_double(env, counters, TajweedAudio::perfCounterName(static_cast<TajweedAudio::PerfCounter>(c)),
+                       static_cast<double>(snapshot.counters[c]));
+    }
+    jni_put_map(env, result, "counters", counters);
     
-    return (maxEnergy - minEnergy) > 0.1; // Significant energy variation
+    return result;
 }
 
-std::vector<double> computeFFT(const std::vector<double>& samples) {
-    // Simplified FFT implementation
-    // In production, use a proper FFT library like FFTW or Kiss FFT
-    
-    size_t n = samples.size();
-    std::vector<double> fft(n * 2, 0.0); // Real and imaginary parts
-    
-    // Basic DFT implementation (not optimized)
-    for (size_t k = 0; k < n; k++) {
-        double real = 0.0;
-        double imag = 0.0;
-        
-        for (size_t j = 0; j < n; j++) {
-            double angle = -2.0 * M_PI * k * j / n;
-            real += samples[j] * cos(angle);
-            imag += samples[j] * sin(angle);
-        }
-        
-        fft[k] = real;
-        fft[k + n] = imag;
+JNIEXPORT void JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_resetPerfStats(JNIEnv *env, jobject thiz) {
+    TajweedAudio::resetPerfStats();
+}
+
+JNIEXPORT jint JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_submitAnalysisJob(JNIEnv *env, jobject thiz, jstring type, jstring userAudioPath,
+                                                           jstring referenceAudioPath, jobject rules, jstring segmentKey) {
+    std::string kindName = jstring_to_string(env, type);
+    auto result = std::make_shared<JobResult>();
+    if (kindName == "calculateSimilarity") {
+        result->kind = JobKind::Similarity;
+    } else if (kindName == "analyzeTajweed") {
+        result->kind = JobKind::Tajweed;
+    } else if (kindName == "detectTajweedRules") {
+        result->kind = JobKind::Rules;
+    } else {
+        LOGE("Unknown analysis job type: %s", kindName.c_str());
+        return -1;
     }
     
-    return fft;
+    std::string userPath = jstring_to_string(env, userAudioPath);
+    std::string referencePath = jstring_to_string(env, referenceAudioPath);
+    TajweedAudio::RuleSet selected = rule_set_from_map(env, rules);
+    
+    // The module reference lives until the job has been reported
+    jobject module = env->NewGlobalRef(thiz);
+    
+    uint64_t id = TajweedAudio::JobScheduler::shared().submit(
+        jstring_to_string(env, segmentKey),
+        [=](TajweedAudio::JobControl& job) {
+            run_job(job, userPath, referencePath, selected, *result);
+        },
+        [=](const TajweedAudio::JobControl& job, TajweedAudio::JobState state, const std::string& error) {
+            GlobalRefRelease release{module};
+            JNIEnv *jobEnv = current_env();
+            if (!jobEnv) return;
+            jobject params = job_event_map(jobEnv, job);
+            jni_put_string(jobEnv, params, "status", TajweedAudio::jobStateName(state));
+            if (state == TajweedAudio::JobState::Done) {
+                jni_put_map(jobEnv, params, "result", job_result_to_map(jobEnv, *result));
+            } else if (state == TajweedAudio::JobState::Failed) {
+                jni_put_string(jobEnv, params, "error", error);
+            }
+            emit_job_event(jobEnv, module, "TajweedJobFinished", params);
+        },
+        [=](const TajweedAudio::JobControl& job, double progress) {
+            JNIEnv *jobEnv = current_env();
+            if (!jobEnv) return;
+            jobject params = job_event_map(jobEnv, job);
+            jni_put_double(jobEnv, params, "progress", progress);
+            emit_job_event(jobEnv, module, "TajweedJobProgress", params);
+        });
+    
+    LOGD("Submitted %s job %llu", kindName.c_str(), static_cast<unsigned long long>(id));
+    return static_cast<jint>(id);
+}
+
+JNIEXPORT jboolean JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_cancelAnalysisJob(JNIEnv *env, jobject thiz, jint jobId) {
+    return TajweedAudio::JobScheduler::shared().cancel(static_cast<uint64_t>(jobId)) ? JNI_TRUE : JNI_FALSE;
 }
 
-} // namespace TajweedAudio
+JNIEXPORT void JNICALL
+Java_com_tajweedtutor_TajweedAudioModule_cancelAllJobs(JNIEnv *env, jobject thiz) {
+    TajweedAudio::JobScheduler::shared().cancelAll();
+}
+
+} // extern "C"
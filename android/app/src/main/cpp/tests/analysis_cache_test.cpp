@@ -0,0 +1,223 @@
+// Tests for the analysis cache: LRU order and budget, file keys under both
+// modes, config hashes, and a lesson batch re-scored after one segment is
+// re-recorded extracting only that segment.
+
+#include "analysis_cache.h"
+#include "lesson_batch.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Features whose cache entry is about `frames` rows
+static std::shared_ptr<const AudioFeatures> cachedFeatures(size_t frames) {
+    return std::make_shared<const AudioFeatures>(makeFeatures(frames, 1));
+}
+
+static size_t rowBytes(size_t frames) {
+    return frames * kFeatureStride * sizeof(float);
+}
+
+static void testLru() {
+    const size_t entry = sizeof(AudioFeatures) + rowBytes(100);
+    AnalysisCache cache(3 * entry);
+
+    for (uint64_t key = 1; key <= 3; key++) cache.putFeatures(key, 7, cachedFeatures(100));
+    AnalysisCacheStats stats = cache.stats();
+    CHECK(stats.entries == 3 && stats.bytes == 3 * entry, "%zu entries, %zu bytes", stats.entries, stats.bytes);
+
+    // Touching 1 makes 2 the oldest, so the fourth entry evicts 2
+    CHECK(cache.findFeatures(1, 7) != nullptr, "entry 1 missing");
+    cache.putFeatures(4, 7, cachedFeatures(100));
+    CHECK(cache.findFeatures(2, 7) == nullptr, "entry 2 survived");
+    CHECK(cache.findFeatures(1, 7) && cache.findFeatures(3, 7) && cache.findFeatures(4, 7), "recent entries evicted");
+    CHECK(cache.findFeatures(1, 8) == nullptr, "another config hash matched");
+    stats = cache.stats();
+    CHECK(stats.evictions == 1 && stats.evictedBytes == entry, "%llu evictions of %llu bytes",
+          static_cast<unsigned long long>(stats.evictions), static_cast<unsigned long long>(stats.evictedBytes));
+    CHECK(stats.featureHits == 4 && stats.featureMisses == 2, "%llu hits, %llu misses",
+          static_cast<unsigned long long>(stats.featureHits), static_cast<unsigned long long>(stats.featureMisses));
+
+    // A smaller budget keeps the most recent; a holder keeps an evicted entry alive
+    std::shared_ptr<const AudioFeatures> held = cache.findFeatures(4, 7);
+    cache.findFeatures(3, 7);
+    cache.setBudget(entry);
+    CHECK(cache.stats().entries == 1 && cache.findFeatures(3, 7) && !cache.findFeatures(4, 7),
+          "budget cut kept %zu entries", cache.stats().entries);
+    CHECK(held && held->frames.numFrames() == 100, "held entry lost its frames");
+
+    // Too big for the whole budget: not stored, nothing evicted for it
+    cache.putFeatures(9, 7, cachedFeatures(1000));
+    CHECK(cache.stats().rejected == 1 && cache.stats().entries == 1, "oversized entry stored");
+
+    // Re-putting a key replaces it rather than adding a second entry
+    cache.setBudget(3 * entry);
+    cache.putFeatures(5, 7, cachedFeatures(100));
+    cache.putFeatures(5, 7, cachedFeatures(50));
+    CHECK(cache.stats().entries == 2, "%zu entries after a replacement", cache.stats().entries);
+    CHECK(cache.findFeatures(5, 7)->frames.numFrames() == 50, "replacement not kept");
+
+    // Comparisons share the budget, under their own keys
+    auto comparison = std::make_shared<CachedComparison>();
+    comparison->similarity = 0.8;
+    comparison->analysis.ruleScores["madd"] = 90.0;
+    cache.putComparison(5, 6, 7, comparison);
+    CHECK(cache.findComparison(5, 6, 7) && cache.findComparison(5, 6, 7)->similarity == 0.8, "comparison missing");
+    CHECK(cache.findComparison(6, 5, 7) == nullptr, "swapped pair matched");
+    CHECK(cache.findFeatures(5, 7) != nullptr, "comparison displaced features with the same user key");
+
+    cache.clear();
+    stats = cache.stats();
+    CHECK(stats.entries == 0 && stats.bytes == 0 && cache.findComparison(5, 6, 7) == nullptr, "clear left entries");
+    CHECK(stats.comparisonHits == 2, "clear reset the counters");
+    cache.resetStats();
+    CHECK(cache.stats().comparisonHits == 0 && cache.stats().budgetBytes == 3 * entry, "resetStats");
+
+    // Budget 0 is off: nothing stored, nothing counted as rejected
+    cache.setBudget(0);
+    cache.putFeatures(1, 7, cachedFeatures(10));
+    CHECK(cache.stats().entries == 0 && cache.stats().rejected == 0, "stored with caching off");
+}
+
+static void testFileKeys(const std::string& dir) {
+    std::string a = dir + "/key_a.wav", b = dir + "/key_b.wav";
+    CHECK(writeWav(a, 0.5, 200.0, 1) && writeWav(b, 0.5, 200.0, 1), "cannot write test files in %s", dir.c_str());
+
+    AnalysisCache cache;
+    uint64_t keyA, keyA2, keyB;
+    CHECK(cache.fileKey(a, keyA) && cache.fileKey(a, keyA2) && keyA == keyA2, "key of an unchanged file moved");
+    CHECK(cache.fileKey(b, keyB) && keyB != keyA, "identical copies share a path key");
+    CHECK(!cache.fileKey(dir + "/missing.wav", keyB), "key for a missing file");
+
+    // Content keys follow the bytes, not the path
+    cache.setKeyMode(CacheKeyMode::ContentHash);
+    CHECK(cache.fileKey(a, keyA) && cache.fileKey(b, keyB) && keyA == keyB, "copies differ by content key");
+    CHECK(writeWav(b, 0.5, 210.0, 1), "cannot rewrite %s", b.c_str());
+    CHECK(cache.fileKey(b, keyB) && keyB != keyA, "same-size rewrite kept its content key");
+    cache.setKeyMode(CacheKeyMode::PathSizeMtime);
+    CHECK(cache.fileKey(a, keyA2) && keyA2 != keyA, "modes share keys");
+    unlink(a.c_str());
+    unlink(b.c_str());
+}
+
+static void testConfigHashes() {
+    FeatureWorkspace plain, filtered;
+    filtered.preprocess.enabled = true;
+    uint64_t plainHash = extractionConfigHash(plain);
+    CHECK(plainHash == extractionConfigHash(plain), "config hash not stable");
+    CHECK(plainHash != extractionConfigHash(filtered), "preprocessing not in the config hash");
+    filtered.preprocess.enabled = false;
+    filtered.preprocess.highPassHz = 100.0;
+    CHECK(plainHash == extractionConfigHash(filtered), "settings of a disabled stage changed the hash");
+    filtered.vad.enabled = true;
+    CHECK(plainHash != extractionConfigHash(filtered), "VAD not in the config hash");
+
+    DTWOptions banded;
+    banded.band = DTWBand::SakoeChiba;
+    banded.window = 10;
+    uint64_t rules = comparisonConfigHash(1, 2, DTWOptions(), "dtw+rules");
+    CHECK(rules != comparisonConfigHash(1, 2, banded, "dtw+rules"), "DTW band not in the comparison hash");
+    CHECK(rules != comparisonConfigHash(1, 2, DTWOptions(), "dtw"), "analyses not in the comparison hash");
+    CHECK(rules != comparisonConfigHash(2, 1, DTWOptions(), "dtw+rules"), "extraction configs commute");
+}
+
+static bool sameScores(const BatchSegmentResult& a, const BatchSegmentResult& b) {
+    bool same = a.status == b.status && a.similarity == b.similarity && a.score == b.score &&
+                a.confidence == b.confidence;
+    for (size_t r = 0; r < kBatchRuleCount; r++) same = same && a.ruleScores[r] == b.ruleScores[r];
+    return same;
+}
+
+static void testLessonRescoring(const std::string& dir) {
+    // Four segments over two references
+    std::vector<BatchSegment> segments(4);
+    for (size_t i = 0; i < segments.size(); i++) {
+        segments[i].userPath = dir + "/take_" + std::to_string(i) + ".wav";
+        segments[i].referencePath = dir + "/ref_" + std::to_string(i % 2) + ".wav";
+        CHECK(writeWav(segments[i].userPath, 1.2, 180.0 + 15.0 * i, 10 + static_cast<unsigned>(i)),
+              "cannot write %s", segments[i].userPath.c_str());
+    }
+    CHECK(writeWav(segments[0].referencePath, 1.2, 180.0, 2) && writeWav(segments[1].referencePath, 1.3, 195.0, 3),
+          "cannot write the references");
+
+    ThreadPool pool(2);
+    std::vector<BatchSegmentResult> uncached, first, again;
+    BatchStats stats;
+    analyzeLessonBatch(segments, uncached, stats, pool);
+
+    AnalysisCache cache;
+    analyzeLessonBatch(segments, first, stats, pool, &cache);
+    CHECK(stats.comparisonsFromCache == 0 && stats.usersFromCache == 0, "cold cache answered %zu segments",
+          stats.comparisonsFromCache);
+    bool same = first.size() == uncached.size();
+    for (size_t i = 0; same && i < first.size(); i++) same = first[i].status == BatchStatus::Ok && sameScores(first[i], uncached[i]);
+    CHECK(same, "cached batch scores differ from the uncached ones");
+
+    // Nothing changed: every segment from the cache, nothing extracted
+    AnalysisCacheStats before = cache.stats();
+    analyzeLessonBatch(segments, again, stats, pool, &cache);
+    CHECK(stats.comparisonsFromCache == 4, "%zu of 4 segments from the cache", stats.comparisonsFromCache);
+    same = again.size() == first.size();
+    for (size_t i = 0; same && i < again.size(); i++) same = sameScores(again[i], first[i]) && again[i].userMs == 0.0;
+    CHECK(same, "cached scores differ");
+    CHECK(cache.stats().featureMisses == before.featureMisses, "features looked up for answered segments");
+
+    // Segment 2 re-recorded: only its take is extracted, against the cached reference
+    CHECK(writeWav(segments[2].userPath, 1.4, 240.0, 99), "cannot re-record %s", segments[2].userPath.c_str());
+    before = cache.stats();
+    analyzeLessonBatch(segments, again, stats, pool, &cache);
+    AnalysisCacheStats after = cache.stats();
+    CHECK(stats.comparisonsFromCache == 3, "%zu of 3 unchanged segments from the cache", stats.comparisonsFromCache);
+    CHECK(after.featureMisses - before.featureMisses == 1, "%llu extractions for one re-recording",
+          static_cast<unsigned long long>(after.featureMisses - before.featureMisses));
+    CHECK(after.featureHits - before.featureHits == 1, "reference not served from the cache");
+
+    std::vector<BatchSegmentResult> fresh;
+    analyzeLessonBatch(segments, fresh, stats, pool);
+    same = again.size() == fresh.size();
+    for (size_t i = 0; same && i < again.size(); i++) same = sameScores(again[i], fresh[i]);
+    CHECK(same, "re-scored lesson differs from a fresh one");
+    CHECK(again[2].similarity != first[2].similarity, "re-recorded segment kept its old score");
+
+    // A cache too small for any features still scores correctly
+    AnalysisCache tiny(1024);
+    analyzeLessonBatch(segments, again, stats, pool, &tiny);
+    same = again.size() == fresh.size();
+    for (size_t i = 0; same && i < again.size(); i++) same = sameScores(again[i], fresh[i]);
+    CHECK(same && tiny.stats().rejected > 0, "tiny cache changed the scores");
+
+    // A missing take fails alone, and is never answered from the cache
+    unlink(segments[3].userPath.c_str());
+    analyzeLessonBatch(segments, again, stats, pool, &cache);
+    CHECK(again[3].status == BatchStatus::UserAudioFailed, "missing take status %d", static_cast<int>(again[3].status));
+    CHECK(stats.comparisonsFromCache == 3, "%zu segments from the cache", stats.comparisonsFromCache);
+
+    for (const BatchSegment& segment : segments) unlink(segment.userPath.c_str());
+    unlink(segments[0].referencePath.c_str());
+    unlink(segments[1].referencePath.c_str());
+}
+
+int main() {
+    char pattern[] = "/tmp/analysis_cache_test_XXXXXX";
+    const char* dir = mkdtemp(pattern);
+    if (!dir) {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+
+    testLru();
+    testFileKeys(dir);
+    testConfigHashes();
+    testLessonRescoring(dir);
+    rmdir(dir);
+
+    if (failures == 0) printf("analysis_cache_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+// Tests for the decode-ahead path: sequential decoding of a source, and
+// decodeFeatures feeding a StreamingAnalyzer through a small ring without
+// losing samples, failing cleanly and stopping on cancellation.
+
+#include "decoder.h"
+#include "jobs.h"
+#include "streaming.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Two harmonic syllables over quiet noise, rounded to floats as a decoder
+// would hand them out
+static std::vector<double> recitation(double seconds, int rate) {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    std::vector<double> samples(static_cast<size_t>(seconds * rate));
+    double phase = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        double t = static_cast<double>(i) / rate;
+        samples[i] = noise(rng);
+        if ((t > 0.3 && t < 1.2) || (t > 1.5 && t < 2.7)) {
+            phase += 2.0 * M_PI * 180.0 * (1.0 + 0.05 * sin(2.0 * M_PI * 1.5 * t)) / rate;
+            for (int h = 1; h <= 6; h++) samples[i] += 0.2 * sin(h * phase) / h;
+        }
+    }
+    for (double& sample : samples) sample = static_cast<float>(sample);
+    return samples;
+}
+
+// Hands out a source in blocks, then fails or cancels a job part way
+class ScriptedDecoder : public SourceDecoder {
+public:
+    ScriptedDecoder(const SampleSource& source, size_t failAfter, JobControl* cancelJob = nullptr)
+        : SourceDecoder(source), failAfter_(failAfter), cancelJob_(cancelJob) {}
+
+    size_t decode(float* out, size_t maxFrames) override {
+        if (calls_++ == failAfter_) {
+            if (cancelJob_) {
+                cancelJob_->cancel();
+            } else {
+                error_ = "corrupt frame";
+                return 0;
+            }
+        }
+        return SourceDecoder::decode(out, maxFrames);
+    }
+
+private:
+    size_t failAfter_;
+    JobControl* cancelJob_;
+    size_t calls_ = 0;
+};
+
+static void testSourceDecoder() {
+    std::vector<double> samples = recitation(0.5, 16000);
+    BufferSource source(samples, 16000);
+    SourceDecoder decoder(source);
+    CHECK(decoder.sampleRate() == 16000 && decoder.channels() == 1, "format %d Hz x %d", decoder.sampleRate(), decoder.channels());
+    CHECK(decoder.frameCountHint() == samples.size(), "hint %zu of %zu", decoder.frameCountHint(), samples.size());
+
+    std::vector<float> decoded, block(1000);
+    for (;;) {
+        size_t n = decoder.decode(block.data(), block.size());
+        if (n == 0) break;
+        decoded.insert(decoded.end(), block.begin(), block.begin() + n);
+    }
+    CHECK(decoded.size() == samples.size(), "decoded %zu of %zu frames", decoded.size(), samples.size());
+    bool same = decoded.size() == samples.size();
+    for (size_t i = 0; same && i < samples.size(); i++) same = decoded[i] == static_cast<float>(samples[i]);
+    CHECK(same, "decoded frames differ from the source");
+    CHECK(decoder.lastError().empty(), "clean end reported '%s'", decoder.lastError().c_str());
+}
+
+static void testDecodeAhead() {
+    // 44.1 kHz, so the analyzer also resamples on the way
+    const int rate = 44100;
+    std::vector<double> samples = recitation(3.0, rate);
+    BufferSource source(samples, rate);
+
+    // Reference: every sample queued up front into a ring that holds them all
+    StreamingOptions roomy;
+    roomy.ringCapacity = samples.size();
+    StreamingAnalyzer direct(rate, roomy);
+    std::vector<float> all(samples.begin(), samples.end());
+    direct.push(all.data(), all.size());
+    direct.process();
+    direct.finish();
+
+    // A ring a few blocks long, so the decoder keeps waiting on the analysis
+    StreamingOptions tight;
+    tight.ringCapacity = 2 * kDecodeBlock;
+    StreamingAnalyzer analyzer(rate, tight);
+    SourceDecoder decoder(source);
+    JobControl job(1, "", JobProgress());
+    DecodeStats stats;
+    std::string error;
+    bool ok = decodeFeatures(decoder, analyzer, &job, &stats, error);
+    CHECK(ok, "decodeFeatures failed: %s", error.c_str());
+    CHECK(analyzer.status().finished, "analyzer not finished");
+    CHECK(analyzer.status().dropped == 0, "%zu samples dropped", analyzer.status().dropped);
+    CHECK(stats.frames == samples.size(), "decoded %zu of %zu frames", stats.frames, samples.size());
+    CHECK(stats.blocks == (samples.size() + kDecodeBlock - 1) / kDecodeBlock, "%zu blocks", stats.blocks);
+    CHECK(stats.firstFrameMs > 0.0 && stats.firstFrameMs <= stats.totalMs, "first frame at %.2f of %.2f ms",
+          stats.firstFrameMs, stats.totalMs);
+    CHECK(fabs(job.progress() - 1.0) < 1e-9, "job progress %.3f", job.progress());
+
+    const FeatureMatrix& expected = direct.features().frames;
+    const FeatureMatrix& actual = analyzer.features().frames;
+    CHECK(actual.numFrames() == expected.numFrames() && actual.numFrames() > 0, "%zu frames, expected %zu",
+          actual.numFrames(), expected.numFrames());
+    if (actual.numFrames() == expected.numFrames()) {
+        CHECK(memcmp(actual.data(), expected.data(), actual.sizeBytes()) == 0, "rows differ from the direct take");
+    }
+    CHECK(fabs(analyzer.features().duration - 3.0) < 1e-3, "duration %.4f", analyzer.features().duration);
+
+    // The analyzer is reusable after a reset, and an empty stream finishes with no frames
+    analyzer.reset();
+    std::vector<double> none;
+    BufferSource empty(none, rate);
+    SourceDecoder nothing(empty);
+    CHECK(decodeFeatures(nothing, analyzer, nullptr, &stats, error), "empty stream failed: %s", error.c_str());
+    CHECK(analyzer.features().frames.numFrames() == 0 && stats.frames == 0, "empty stream gave %zu frames",
+          analyzer.features().frames.numFrames());
+}
+
+static void testFailure() {
+    std::vector<double> samples = recitation(2.0, 16000);
+    BufferSource source(samples, 16000);
+    StreamingOptions options;
+    options.ringCapacity = kDecodeBlock;
+
+    StreamingAnalyzer analyzer(16000, options);
+    ScriptedDecoder broken(source, 3);
+    std::string error;
+    DecodeStats stats;
+    CHECK(!decodeFeatures(broken, analyzer, nullptr, &stats, error), "decoder error not reported");
+    CHECK(error == "corrupt frame", "error '%s'", error.c_str());
+    CHECK(stats.blocks == 3, "%zu blocks before the error", stats.blocks);
+    CHECK(!analyzer.status().finished, "failed take finished");
+
+    // Cancelled by the job half way through: returns promptly, unfinished
+    analyzer.reset();
+    JobControl job(2, "", JobProgress());
+    ScriptedDecoder interrupted(source, 4, &job);
+    error.clear();
+    CHECK(!decodeFeatures(interrupted, analyzer, &job, &stats, error), "cancelled decode succeeded");
+    CHECK(error == "cancelled", "error '%s'", error.c_str());
+    CHECK(stats.frames < samples.size(), "cancelled decode read every frame");
+    CHECK(!analyzer.status().finished, "cancelled take finished");
+}
+
+int main() {
+    testSourceDecoder();
+    testDecodeAhead();
+    testFailure();
+
+    if (failures == 0) printf("decoder_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,293 @@
+// Tests for the banded two-row DTW against a naive full-matrix DTW:
+// distances, band limits, early abandoning and the backtracked path.
+
+#include "audio_analysis.h"
+#include "dtw.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const double kInf = std::numeric_limits<double>::infinity();
+
+// Full (n + 1) x (m + 1) cumulative cost matrix; `allowed(i, j)` (1-based)
+// masks cells out of a band. `cost(i, j)` is the local distance of frames
+// i - 1 and j - 1.
+template <typename Cost, typename Allowed>
+static double naiveDTW(size_t n, size_t m, Cost cost, Allowed allowed) {
+    std::vector<std::vector<double>> d(n + 1, std::vector<double>(m + 1, kInf));
+    d[0][0] = 0.0;
+    for (size_t i = 1; i <= n; i++) {
+        for (size_t j = 1; j <= m; j++) {
+            if (!allowed(i, j)) continue;
+            d[i][j] = cost(i - 1, j - 1) + std::min({d[i - 1][j], d[i][j - 1], d[i - 1][j - 1]});
+        }
+    }
+    return d[n][m];
+}
+
+static double naiveScalar(const std::vector<double>& a, const std::vector<double>& b) {
+    return naiveDTW(a.size(), b.size(), [&](size_t i, size_t j) { return std::fabs(a[i] - b[j]); },
+                    [](size_t, size_t) { return true; });
+}
+
+static std::vector<double> randomSequence(size_t n, std::mt19937& rng) {
+    std::normal_distribution<double> dist(0.0, 1.0);
+    std::vector<double> sequence(n);
+    for (double& v : sequence) v = dist(rng);
+    return sequence;
+}
+
+static std::vector<float> randomFrames(size_t n, size_t dims, std::mt19937& rng) {
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    std::vector<float> frames(n * dims);
+    for (float& v : frames) v = dist(rng);
+    return frames;
+}
+
+// The Sakoe-Chiba cells of row i of an n x m grid, n >= m, as dtw.cpp defines them
+static bool inSakoeChiba(size_t i, size_t j, size_t n, size_t m, int window) {
+    double center = static_cast<double>(i) / n * m;
+    double radius = std::max(1, window);
+    return j >= std::max(1.0, floor(center - radius)) && j <= ceil(center + radius);
+}
+
+// Monotone, continuous, and from (0, 0) to (n - 1, m - 1)
+static bool validPath(const DTWAlignment& path, size_t n, size_t m) {
+    size_t steps = path.frames1.size();
+    if (steps == 0 || path.frames2.size() != steps || path.costs.size() != steps) return false;
+    if (path.frames1[0] != 0 || path.frames2[0] != 0) return false;
+    if (path.frames1[steps - 1] != n - 1 || path.frames2[steps - 1] != m - 1) return false;
+    for (size_t k = 1; k < steps; k++) {
+        size_t di = path.frames1[k] - path.frames1[k - 1];
+        size_t dj = path.frames2[k] - path.frames2[k - 1];
+        if (path.frames1[k] < path.frames1[k - 1] || path.frames2[k] < path.frames2[k - 1]) return false;
+        if (di > 1 || dj > 1 || di + dj == 0) return false;
+    }
+    return steps <= n + m - 1;
+}
+
+static double pathSum(const DTWAlignment& path) {
+    double sum = 0.0;
+    for (float cost : path.costs) sum += cost;
+    return sum;
+}
+
+static void testScalarDistance(std::mt19937& rng) {
+    const size_t sizes[][2] = {{1, 1}, {1, 7}, {7, 1}, {5, 5}, {13, 40}, {40, 13}, {64, 64}, {100, 37}};
+    for (const auto& size : sizes) {
+        std::vector<double> a = randomSequence(size[0], rng);
+        std::vector<double> b = randomSequence(size[1], rng);
+        double expected = naiveScalar(a, b);
+        double actual = dtwDistance(a.data(), a.size(), b.data(), b.size());
+        CHECK(actual == expected, "%zux%zu: %.17g vs naive %.17g", size[0], size[1], actual, expected);
+        CHECK(calculateDTWDistance(a, b) == expected, "%zux%zu: calculateDTWDistance differs", size[0], size[1]);
+    }
+
+    CHECK(dtwDistance(nullptr, 0, nullptr, 0) == 0.0, "empty sequences");
+
+    // Identical sequences align at zero cost
+    std::vector<double> a = randomSequence(30, rng);
+    CHECK(dtwDistance(a.data(), a.size(), a.data(), a.size()) == 0.0, "self distance");
+}
+
+static void testAlignedDistanceAndPath(std::mt19937& rng) {
+    const size_t dims = 6;
+    const size_t sizes[][2] = {{1, 1}, {1, 9}, {9, 1}, {12, 12}, {25, 60}, {60, 25}, {80, 80}};
+    for (FrameMetric metric : {FrameMetric::Euclidean, FrameMetric::Cosine}) {
+        DTWOptions options;
+        options.metric = metric;
+        for (const auto& size : sizes) {
+            size_t n = size[0], m = size[1];
+            std::vector<float> a = randomFrames(n, dims, rng);
+            std::vector<float> b = randomFrames(m, dims, rng);
+            double expected = naiveDTW(n, m,
+                                       [&](size_t i, size_t j) {
+                                           return static_cast<double>(
+                                               frameDistance(metric, &a[i * dims], &b[j * dims], dims));
+                                       },
+                                       [](size_t, size_t) { return true; });
+
+            DTWAlignment path = dtwAlign(a.data(), n, b.data(), m, dims, options);
+            CHECK(path.distance == expected, "%zux%zu: %.17g vs naive %.17g", n, m, path.distance, expected);
+            CHECK(!path.abandoned, "%zux%zu abandoned", n, m);
+            CHECK(validPath(path, n, m), "%zux%zu: invalid path", n, m);
+            CHECK(std::fabs(pathSum(path) - expected) <= 1e-9 * std::max(1.0, expected),
+                  "%zux%zu: path costs sum to %.9g, distance %.9g", n, m, pathSum(path), expected);
+            for (size_t k = 0; k < path.costs.size(); k++) {
+                float cost = frameDistance(metric, &a[path.frames1[k] * dims], &b[path.frames2[k] * dims], dims);
+                if (path.costs[k] != cost) {
+                    CHECK(false, "%zux%zu: step %zu cost %g, frames give %g", n, m, k, path.costs[k], cost);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Equal sequences align one-to-one along the diagonal
+    std::vector<float> a = randomFrames(20, dims, rng);
+    DTWAlignment self = dtwAlign(a.data(), 20, a.data(), 20, dims);
+    bool diagonal = self.frames1.size() == 20;
+    for (size_t k = 0; diagonal && k < 20; k++) diagonal = self.frames1[k] == k && self.frames2[k] == k;
+    CHECK(diagonal && self.distance == 0.0, "self alignment left the diagonal");
+
+    // Strided rows compare only their first `dims` floats
+    const size_t stride = dims + 3;
+    std::vector<float> b = randomFrames(15, dims, rng);
+    std::vector<float> wideA(20 * stride, 99.0f), wideB(15 * stride, -99.0f);
+    for (size_t f = 0; f < 20; f++) std::copy(&a[f * dims], &a[f * dims] + dims, &wideA[f * stride]);
+    for (size_t f = 0; f < 15; f++) std::copy(&b[f * dims], &b[f * dims] + dims, &wideB[f * stride]);
+    DTWAlignment packed = dtwAlign(a.data(), 20, b.data(), 15, dims);
+    DTWAlignment strided = dtwAlign(wideA.data(), 20, wideB.data(), 15, dims, stride, DTWOptions());
+    CHECK(packed.distance == strided.distance && packed.frames1 == strided.frames1 &&
+              packed.frames2 == strided.frames2,
+          "stride changed the alignment");
+
+    // A reused scratch gives the same answer as a fresh one, and stops allocating
+    DTWScratch scratch;
+    DTWAlignment reused;
+    DTWOptions options;
+    dtwAlign(wideA.data(), 20, wideB.data(), 15, dims, stride, options, scratch, reused);
+    uint64_t grown = scratch.stats.allocations;
+    dtwAlign(wideA.data(), 20, wideB.data(), 15, dims, stride, options, scratch, reused);
+    CHECK(reused.distance == strided.distance && reused.frames1 == strided.frames1, "scratch reuse changed the path");
+    CHECK(scratch.stats.allocations == grown, "second alignment of the same size allocated");
+}
+
+static void testBands(std::mt19937& rng) {
+    const size_t dims = 4;
+    const size_t n = 90, m = 60;
+    std::vector<float> a = randomFrames(n, dims, rng);
+    std::vector<float> b = randomFrames(m, dims, rng);
+    auto cost = [&](size_t i, size_t j) {
+        return static_cast<double>(euclideanDistance(&a[i * dims], &b[j * dims], dims));
+    };
+    double unbanded = naiveDTW(n, m, cost, [](size_t, size_t) { return true; });
+
+    for (int window : {1, 3, 8, 20}) {
+        DTWOptions options;
+        options.band = DTWBand::SakoeChiba;
+        options.window = window;
+        double expected = naiveDTW(n, m, cost, [&](size_t i, size_t j) { return inSakoeChiba(i, j, n, m, window); });
+        DTWAlignment path = dtwAlign(a.data(), n, b.data(), m, dims, options);
+        CHECK(path.distance == expected, "window %d: %.17g vs naive banded %.17g", window, path.distance, expected);
+        CHECK(path.distance >= unbanded, "window %d beat the unbanded distance", window);
+        CHECK(validPath(path, n, m), "window %d: invalid path", window);
+
+        bool inside = true;
+        for (size_t k = 0; k < path.frames1.size(); k++) {
+            inside = inside && inSakoeChiba(path.frames1[k] + 1, path.frames2[k] + 1, n, m, window);
+        }
+        CHECK(inside, "window %d: path left the band", window);
+
+        // Swapped inputs take the same band over the longer sequence
+        DTWAlignment swapped = dtwAlign(b.data(), m, a.data(), n, dims, options);
+        CHECK(swapped.distance == path.distance && swapped.frames1 == path.frames2 && swapped.frames2 == path.frames1,
+              "window %d: swapping the inputs changed the alignment", window);
+
+        std::vector<double> sa(n), sb(m);
+        for (size_t i = 0; i < n; i++) sa[i] = a[i * dims];
+        for (size_t j = 0; j < m; j++) sb[j] = b[j * dims];
+        double scalarExpected = naiveDTW(n, m, [&](size_t i, size_t j) { return std::fabs(sa[i] - sb[j]); },
+                                         [&](size_t i, size_t j) { return inSakoeChiba(i, j, n, m, window); });
+        CHECK(dtwDistance(sa.data(), n, sb.data(), m, options) == scalarExpected, "window %d: scalar banded distance",
+              window);
+    }
+
+    // A wide enough band is the full search
+    DTWOptions wide;
+    wide.band = DTWBand::SakoeChiba;
+    wide.window = static_cast<int>(n);
+    CHECK(dtwAlign(a.data(), n, b.data(), m, dims, wide).distance == unbanded, "full-width band differs");
+
+    // Itakura: every step stays inside the parallelogram, up to the kept diagonal
+    for (double slope : {1.5, 2.0, 3.0}) {
+        DTWOptions options;
+        options.band = DTWBand::Itakura;
+        options.itakuraSlope = slope;
+        DTWAlignment path = dtwAlign(a.data(), n, b.data(), m, dims, options);
+        CHECK(validPath(path, n, m) && path.distance >= unbanded, "slope %.1f: invalid path", slope);
+        bool inside = true;
+        for (size_t k = 0; k < path.frames1.size(); k++) {
+            double x = static_cast<double>(path.frames1[k] + 1) / n;
+            double y = static_cast<double>(path.frames2[k] + 1) / m;
+            double low = std::max(x / slope, 1.0 - slope * (1.0 - x));
+            double high = std::min(slope * x, 1.0 - (1.0 - x) / slope);
+            double diagonal = std::max(1.0, std::round(x * m)) / m;
+            inside = inside && y >= std::min(low, diagonal) - 1.0 / m && y <= std::max(high, diagonal) + 1.0 / m;
+        }
+        CHECK(inside, "slope %.1f: path left the parallelogram", slope);
+    }
+}
+
+static void testAbandon(std::mt19937& rng) {
+    std::vector<double> a = randomSequence(50, rng);
+    std::vector<double> b = randomSequence(70, rng);
+    double distance = naiveScalar(a, b);
+
+    DTWOptions options;
+    options.abandonThreshold = distance * 0.5;
+    CHECK(dtwDistance(a.data(), a.size(), b.data(), b.size(), options) == kInf, "scalar distance not abandoned");
+    CHECK(calculateDTWDistance(a, b, options) == kInf, "calculateDTWDistance hid the abandon");
+    options.abandonThreshold = distance * 1.01;
+    CHECK(dtwDistance(a.data(), a.size(), b.data(), b.size(), options) == distance, "cutoff above the distance changed it");
+
+    const size_t dims = 5;
+    std::vector<float> fa = randomFrames(40, dims, rng);
+    std::vector<float> fb = randomFrames(45, dims, rng);
+    DTWAlignment full = dtwAlign(fa.data(), 40, fb.data(), 45, dims);
+
+    // Abandoned inside the grid (a row over the cutoff) and at the last cell
+    for (double fraction : {0.1, 0.999}) {
+        options.abandonThreshold = full.distance * fraction;
+        DTWAlignment path = dtwAlign(fa.data(), 40, fb.data(), 45, dims, options);
+        CHECK(path.abandoned && path.distance == kInf, "cutoff %.3f of the distance not abandoned", fraction);
+        CHECK(path.frames1.empty() && path.frames2.empty() && path.costs.empty(), "abandoned alignment kept a path");
+    }
+    options.abandonThreshold = full.distance;
+    DTWAlignment exact = dtwAlign(fa.data(), 40, fb.data(), 45, dims, options);
+    CHECK(!exact.abandoned && exact.distance == full.distance && exact.frames1 == full.frames1,
+          "cutoff equal to the distance abandoned");
+
+    // performDTW reports the abandon through ComparisonResult
+    AudioFeatures user = {}, reference = {};
+    user.frames.reset(40, 16000);
+    reference.frames.reset(45, 16000);
+    user.sampleRate = reference.sampleRate = 16000;
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    for (size_t f = 0; f < 40; f++) {
+        for (size_t d = 0; d < FeatureColumns::Distance.count; d++) user.frames.row(f)[d] = dist(rng);
+    }
+    for (size_t f = 0; f < 45; f++) {
+        for (size_t d = 0; d < FeatureColumns::Distance.count; d++) reference.frames.row(f)[d] = dist(rng);
+    }
+    ComparisonResult scored = performDTW(user, reference);
+    CHECK(!scored.abandoned && scored.similarity > 0.0 && scored.alignment.size() == 40, "unbounded comparison failed");
+    double meanCost = 1.0 / scored.similarity - 1.0;
+
+    DTWOptions cutoff;
+    cutoff.abandonThreshold = meanCost * 0.5;
+    ComparisonResult abandoned = performDTW(user, reference, cutoff);
+    CHECK(abandoned.abandoned && abandoned.similarity == 0.0 && abandoned.alignment.empty(),
+          "performDTW did not report the abandon");
+    cutoff.abandonThreshold = meanCost * 1.01;
+    ComparisonResult kept = performDTW(user, reference, cutoff);
+    CHECK(!kept.abandoned && kept.similarity == scored.similarity, "cutoff above the mean cost changed the result");
+}
+
+int main() {
+    std::mt19937 rng(4242);
+
+    testScalarDistance(rng);
+    testAlignedDistanceAndPath(rng);
+    testBands(rng);
+    testAbandon(rng);
+
+    if (failures == 0) printf("dtw_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
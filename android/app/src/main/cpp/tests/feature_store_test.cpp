@@ -0,0 +1,269 @@
+// Tests for feature bundles: a write/open round trip keeps the frames byte
+// for byte, and bundles of another version, another extraction config or
+// cut short are refused with lastError() set.
+
+#include "analysis_cache.h"
+#include "feature_store.h"
+#include "test_util.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Names in `dir` other than . and ..
+static std::vector<std::string> listDirectory(const std::string& dir) {
+    std::vector<std::string> names;
+    DIR* handle = opendir(dir.c_str());
+    if (!handle) return names;
+    while (dirent* entry = readdir(handle)) {
+        std::string name = entry->d_name;
+        if (name != "." && name != "..") names.push_back(name);
+    }
+    closedir(handle);
+    return names;
+}
+
+static std::vector<uint8_t> readBytes(const std::string& path) {
+    std::vector<uint8_t> bytes;
+    FILE* file = fopen(path.c_str(), "rb");
+    if (!file) return bytes;
+    uint8_t buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+    return bytes;
+}
+
+static void writeBytes(const std::string& path, const std::vector<uint8_t>& bytes) {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return;
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+}
+
+// Opening `path` fails with an error that mentions `reason`
+static void expectRefused(const std::string& path, uint64_t configHash, const char* reason) {
+    FeatureBundle bundle;
+    bool ok = bundle.open(path, configHash);
+    CHECK(!ok, "%s opened", path.c_str());
+    CHECK(bundle.lastError().find(reason) != std::string::npos, "error \"%s\", expected \"%s\"",
+          bundle.lastError().c_str(), reason);
+    size_t frames;
+    CHECK(bundle.frames(frames) == nullptr && frames == 0 && bundle.sampleRate() == 0, "refused bundle has frames");
+}
+
+static void testRoundTrip(const std::string& dir) {
+    const uint64_t config = 0x1234abcdULL;
+    AudioFeatures features = makeFeatures(137, 1);
+    std::vector<BundleSegment> segments = {{0.0, 0.8, 0, 50}, {0.8, features.duration, 50, 87}};
+    std::string path = dir + "/round_trip.tjfb";
+    std::string error;
+    CHECK(writeFeatureBundle(path, features, segments, config, error), "write failed: %s", error.c_str());
+    CHECK(listDirectory(dir).size() == 1, "temporary file left behind");
+
+    FeatureBundle bundle;
+    CHECK(bundle.open(path, config), "open failed: %s", bundle.lastError().c_str());
+    CHECK(bundle.configHash() == config && bundle.sampleRate() == kAnalysisSampleRate && bundle.channels() == 2 &&
+              bundle.duration() == features.duration,
+          "header fields changed");
+
+    size_t numFrames = 0;
+    const float* rows = bundle.frames(numFrames);
+    CHECK(rows && numFrames == 137, "%zu frames", numFrames);
+    CHECK(rows && reinterpret_cast<uintptr_t>(rows) % 64 == 0, "feature section not 64-byte aligned");
+    CHECK(rows && memcmp(rows, features.frames.data(), features.frames.sizeBytes()) == 0, "mapped frames differ");
+
+    size_t numSegments = 0;
+    const BundleSegment* stored = bundle.segments(numSegments);
+    CHECK(numSegments == 2 && stored[1].firstFrame == 50 && stored[1].frameCount == 87 &&
+              stored[1].endTime == features.duration,
+          "segments changed");
+
+    AudioFeatures copy = bundle.features();
+    CHECK(copy.frames.numFrames() == 137 && copy.sampleRate == kAnalysisSampleRate &&
+              memcmp(copy.frames.data(), features.frames.data(), features.frames.sizeBytes()) == 0,
+          "copied frames differ");
+
+    // An empty reference still round-trips
+    AudioFeatures empty = makeFeatures(0, 2);
+    std::string emptyPath = dir + "/empty.tjfb";
+    CHECK(writeFeatureBundle(emptyPath, empty, {}, config, error), "empty write failed: %s", error.c_str());
+    FeatureBundle emptyBundle;
+    CHECK(emptyBundle.open(emptyPath, config) && emptyBundle.features().frames.numFrames() == 0, "empty bundle");
+
+    CHECK(!writeFeatureBundle(dir + "/missing/dir.tjfb", features, segments, config, error) && !error.empty(),
+          "write into a missing directory succeeded");
+
+    unlink(path.c_str());
+    unlink(emptyPath.c_str());
+}
+
+static void testRefused(const std::string& dir) {
+    const uint64_t config = 77;
+    AudioFeatures features = makeFeatures(40, 3);
+    std::string path = dir + "/refused.tjfb";
+    std::string error;
+    CHECK(writeFeatureBundle(path, features, {}, config, error), "write failed: %s", error.c_str());
+    std::vector<uint8_t> good = readBytes(path);
+    CHECK(good.size() > sizeof(BundleHeader), "bundle only %zu bytes", good.size());
+
+    expectRefused(path, config + 1, "Stale feature bundle");
+    expectRefused(dir + "/absent.tjfb", config, "No feature bundle");
+
+    // Another format version
+    std::vector<uint8_t> bytes = good;
+    uint32_t version = kBundleVersion - 1;
+    memcpy(bytes.data() + offsetof(BundleHeader, version), &version, sizeof(version));
+    writeBytes(path, bytes);
+    expectRefused(path, config, "Stale feature bundle");
+
+    bytes = good;
+    bytes[0] = 'X';
+    writeBytes(path, bytes);
+    expectRefused(path, config, "Not a feature bundle");
+
+    // Cut inside the header, and inside the feature section
+    bytes.assign(good.begin(), good.begin() + sizeof(BundleHeader) / 2);
+    writeBytes(path, bytes);
+    expectRefused(path, config, "Truncated feature bundle");
+    bytes.assign(good.begin(), good.end() - 100);
+    writeBytes(path, bytes);
+    expectRefused(path, config, "Corrupt feature bundle");
+
+    // A section that claims more rows than the file holds
+    bytes = good;
+    uint32_t rows = 1000;
+    memcpy(bytes.data() + sizeof(BundleHeader) + offsetof(BundleSectionEntry, rows), &rows, sizeof(rows));
+    writeBytes(path, bytes);
+    expectRefused(path, config, "Corrupt feature bundle section");
+
+    // A failed open drops the previous mapping
+    writeBytes(path, good);
+    FeatureBundle bundle;
+    CHECK(bundle.open(path, config), "rewritten bundle: %s", bundle.lastError().c_str());
+    CHECK(!bundle.open(path, config + 1) && bundle.configHash() == 0, "failed reopen kept the old mapping");
+    unlink(path.c_str());
+}
+
+// Changing any setting of the reference workspace refuses bundles built before
+static void testStoreConfig(const std::string& dir) {
+    FeatureStore& store = FeatureStore::instance();
+    store.setDirectory(dir + "/store");
+
+    FeatureWorkspace workspace;
+    workspace.resample.enabled = true;
+    workspace.vad.enabled = true;
+    uint64_t built = extractionConfigHash(workspace);
+
+    AudioFeatures features = makeFeatures(25, 4);
+    std::string error;
+    CHECK(store.put("surah-1", features, {}, built, error), "put failed: %s", error.c_str());
+    std::shared_ptr<const FeatureBundle> bundle = store.open("surah-1", built, error);
+    CHECK(bundle && store.open("surah-1", built, error) == bundle, "open mapping not shared");
+
+    workspace.vad.marginDb += 3.0;
+    uint64_t vadChanged = extractionConfigHash(workspace);
+    CHECK(vadChanged != built, "VAD margin not in the config hash");
+    error.clear();
+    CHECK(store.open("surah-1", vadChanged, error) == nullptr && !error.empty(), "bundle served under new VAD settings");
+    workspace.vad.marginDb -= 3.0;
+
+    workspace.preprocess.enabled = true;
+    CHECK(store.open("surah-1", extractionConfigHash(workspace), error) == nullptr, "bundle served with preprocessing");
+    workspace.preprocess.enabled = false;
+
+    workspace.resample.quality = ResampleQuality::Fast;
+    CHECK(store.open("surah-1", extractionConfigHash(workspace), error) == nullptr,
+          "bundle served under another resampler");
+    workspace.resample.quality = ResampleQuality::Balanced;
+
+    // The original settings still find it; a rebuild under new ones replaces it
+    CHECK(store.open("surah-1", built, error) != nullptr, "bundle lost after a refused open");
+    CHECK(store.put("surah-1", features, {}, vadChanged, error), "rebuild failed: %s", error.c_str());
+    CHECK(store.open("surah-1", built, error) == nullptr, "old settings still served after a rebuild");
+    CHECK(store.open("surah-1", vadChanged, error) != nullptr, "rebuilt bundle refused");
+    size_t held;
+    CHECK(bundle->configHash() == built && bundle->frames(held) != nullptr && held == 25, "holder lost its mapping");
+
+    // A reference streamed from compressed audio is stamped untrimmed, and
+    // readers that take either config find it
+    uint64_t streamed = streamingConfigHash(workspace);
+    CHECK(streamed != built && streamed != vadChanged, "streamed config matches a VAD-trimmed one");
+    FeatureWorkspace untrimmed;
+    untrimmed.resample.enabled = true;
+    CHECK(streamingConfigHash(workspace) == extractionConfigHash(untrimmed), "streamed config is not VAD off");
+    CHECK(store.put("surah-2", features, {}, streamed, error), "put failed: %s", error.c_str());
+    CHECK(store.open("surah-2", built, error) == nullptr, "streamed bundle served as VAD-trimmed");
+    std::shared_ptr<const FeatureBundle> either = store.open("surah-2", {built, streamed}, error);
+    CHECK(either && either->configHash() == streamed, "streamed bundle refused");
+    CHECK(store.open("surah-2", {built, streamed}, error) == either, "open mapping not shared");
+    CHECK(store.open("surah-1", {built, streamed}, error) == nullptr, "bundle of a third config served");
+
+    unlink(store.pathFor("surah-1").c_str());
+    unlink(store.pathFor("surah-2").c_str());
+    rmdir((dir + "/store").c_str());
+}
+
+// Concurrent puts of one id each land a whole bundle; none is torn
+static void testConcurrentPuts(const std::string& dir) {
+    FeatureStore& store = FeatureStore::instance();
+    store.setDirectory(dir + "/racing");
+    const uint64_t config = 0x5eedULL;
+
+    std::vector<AudioFeatures> versions;
+    for (unsigned v = 0; v < 4; v++) versions.push_back(makeFeatures(200 + 10 * v, 10 + v));
+    std::vector<std::thread> writers;
+    std::vector<int> written(versions.size(), 0);
+    for (size_t v = 0; v < versions.size(); v++) {
+        writers.emplace_back([&, v] {
+            for (int round = 0; round < 20; round++) {
+                std::string error;
+                written[v] += store.put("surah-1", versions[v], {}, config, error) ? 1 : 0;
+            }
+        });
+    }
+    for (std::thread& writer : writers) writer.join();
+
+    for (size_t v = 0; v < versions.size(); v++) CHECK(written[v] == 20, "writer %zu: %d of 20 puts", v, written[v]);
+    FeatureBundle bundle;
+    CHECK(bundle.open(store.pathFor("surah-1"), config), "racing bundle refused: %s", bundle.lastError().c_str());
+    size_t frames;
+    const float* rows = bundle.frames(frames);
+    bool whole = false;
+    for (const AudioFeatures& version : versions) {
+        whole = whole || (rows && frames == version.frames.numFrames() &&
+                          memcmp(rows, version.frames.data(), frames * kFeatureStride * sizeof(float)) == 0);
+    }
+    CHECK(whole, "bundle matches none of the versions put");
+    bundle.close();
+    CHECK(listDirectory(dir + "/racing").size() == 1, "temporary files left behind");
+
+    unlink(store.pathFor("surah-1").c_str());
+    rmdir((dir + "/racing").c_str());
+}
+
+int main() {
+    char pattern[] = "/tmp/feature_store_test_XXXXXX";
+    const char* dir = mkdtemp(pattern);
+    if (!dir) {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+
+    testRoundTrip(dir);
+    testRefused(dir);
+    testStoreConfig(dir);
+    testConcurrentPuts(dir);
+    rmdir(dir);
+
+    if (failures == 0) printf("feature_store_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
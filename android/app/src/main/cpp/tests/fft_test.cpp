@@ -0,0 +1,129 @@
+// Accuracy tests for FftPlan against the direct O(n^2) DFT it replaced.
+
+#include "fft.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using TajweedAudio::FftPlan;
+
+// The original TajweedAudio::computeFFT loop, kept as the reference
+static std::vector<std::complex<double>> referenceDFT(const std::vector<double>& samples) {
+    size_t n = samples.size();
+    std::vector<std::complex<double>> result(n);
+
+    for (size_t k = 0; k < n; k++) {
+        double real = 0.0;
+        double imag = 0.0;
+
+        for (size_t j = 0; j < n; j++) {
+            double angle = -2.0 * M_PI * k * j / n;
+            real += samples[j] * cos(angle);
+            imag += samples[j] * sin(angle);
+        }
+
+        result[k] = std::complex<double>(real, imag);
+    }
+
+    return result;
+}
+
+static void checkAgainstReference(size_t n, std::mt19937& rng) {
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<double> samples(n);
+    for (double& s : samples) s = dist(rng);
+
+    FftPlan plan(n);
+    std::vector<std::complex<double>> bins(plan.numBins());
+    plan.forward(samples.data(), bins.data());
+
+    std::vector<std::complex<double>> expected = referenceDFT(samples);
+
+    double maxError = 0.0;
+    for (size_t k = 0; k < bins.size(); k++) {
+        maxError = std::max(maxError, std::abs(bins[k] - expected[k]));
+    }
+
+    // Error bound scales with the input's L1 norm (at most n here)
+    double tolerance = 1e-9 * static_cast<double>(n);
+    CHECK(maxError <= tolerance, "n=%zu max error %.3e exceeds %.3e", n, maxError, tolerance);
+}
+
+static void testPureTone() {
+    const size_t n = 1024;
+    const size_t bin = 37;
+    std::vector<double> samples(n);
+    for (size_t i = 0; i < n; i++) {
+        samples[i] = cos(2.0 * M_PI * bin * i / n);
+    }
+
+    auto plan = FftPlan::forSize(n);
+    std::vector<std::complex<double>> bins(plan->numBins());
+    plan->forward(samples.data(), bins.data());
+
+    for (size_t k = 0; k < bins.size(); k++) {
+        double expected = (k == bin) ? n / 2.0 : 0.0;
+        CHECK(std::abs(std::abs(bins[k]) - expected) < 1e-8, "tone bin %zu magnitude %.6f", k, std::abs(bins[k]));
+    }
+}
+
+// inverse(forward(x)) == x on the power-of-two path
+static void checkRoundTrip(size_t n, std::mt19937& rng) {
+    std::uniform_real_distribution<double> dist(-1.0, 1.0);
+    std::vector<double> samples(n);
+    for (double& s : samples) s = dist(rng);
+
+    FftPlan plan(n);
+    std::vector<std::complex<double>> bins(plan.numBins());
+    std::vector<double> restored(n);
+    plan.forward(samples.data(), bins.data());
+    plan.inverse(bins.data(), restored.data());
+
+    double maxError = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        maxError = std::max(maxError, std::fabs(restored[i] - samples[i]));
+    }
+    CHECK(maxError <= 1e-12, "n=%zu round trip error %.3e", n, maxError);
+}
+
+static void testPlanCache() {
+    auto a = FftPlan::forSize(512);
+    auto b = FftPlan::forSize(512);
+    auto c = FftPlan::forSize(1000);
+    CHECK(a == b, "plans of equal size should be shared");
+    CHECK(a != c, "plans of different size must differ");
+    CHECK(c->numBins() == 501, "numBins for n=1000 was %zu", c->numBins());
+
+    // One plan per recording length must not pile up: odd sizes age out
+    std::weak_ptr<const FftPlan> odd = c;
+    c.reset();
+    for (size_t n = 2001; n < 2041; n += 2) FftPlan::forSize(n);
+    CHECK(odd.expired(), "a stale odd-size plan stayed cached");
+    CHECK(FftPlan::forSize(512) == a, "power-of-two plan was evicted");
+}
+
+int main() {
+    std::mt19937 rng(1234);
+
+    // Power-of-two sizes take the packed real path
+    for (size_t n : {1, 2, 4, 8, 16, 32, 256, 1024, 4096}) {
+        checkAgainstReference(n, rng);
+    }
+
+    // Everything else goes through Bluestein
+    for (size_t n : {3, 5, 6, 12, 100, 441, 1000, 1023, 1500}) {
+        checkAgainstReference(n, rng);
+    }
+
+    for (size_t n : {1, 2, 4, 8, 64, 512, 1024, 4096}) {
+        checkRoundTrip(n, rng);
+    }
+
+    testPureTone();
+    testPlanCache();
+
+    if (failures == 0) printf("fft_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,194 @@
+// Tests for LPC formant analysis and tracking on synthetic vowels with
+// known resonances.
+
+#include "audio_analysis.h"
+#include "formants.h"
+#include "test_util.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// Glottal pulse train at f0, tilted like a voice source (a pole at 0.97,
+// i.e. glottal roll-off net of lip radiation), through a cascade of two-pole
+// resonators. `formantAt(t, k)` gives formant k's frequency at time t.
+template <typename FormantFn>
+static std::vector<double> vowel(double seconds, double f0, FormantFn formantAt) {
+    const double bandwidths[4] = {80.0, 100.0, 120.0, 150.0};
+    std::vector<double> samples(static_cast<size_t>(seconds * kRate));
+    double state[4][2] = {};
+    double phase = 0.0;
+    double glottal = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        double t = static_cast<double>(i) / kRate;
+        phase += f0 / kRate;
+        double x = 0.0;
+        if (phase >= 1.0) {
+            phase -= 1.0;
+            x = 1.0;
+        }
+        glottal = x + 0.97 * glottal;
+        x = glottal;
+        for (int k = 0; k < 4; k++) {
+            double r = exp(-M_PI * bandwidths[k] / kRate);
+            double theta = 2.0 * M_PI * formantAt(t, k) / kRate;
+            double y = (1.0 - r) * x + 2.0 * r * cos(theta) * state[k][0] - r * r * state[k][1];
+            state[k][1] = state[k][0];
+            state[k][0] = y;
+            x = y;
+        }
+        samples[i] = x;
+    }
+
+    double peak = 0.0;
+    for (double s : samples) peak = std::max(peak, fabs(s));
+    for (double& s : samples) s *= 0.5 / peak;
+    return samples;
+}
+
+static double median(std::vector<double> values) {
+    if (values.empty()) return 0.0;
+    std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+    return values[values.size() / 2];
+}
+
+// Levinson-Durbin recovers a known AR(2) predictor
+static void testLpc() {
+    const double a1 = -1.2, a2 = 0.6;
+    std::vector<double> samples(kFrameSize);
+    unsigned seed = 1;
+    double y1 = 0.0, y2 = 0.0;
+    for (size_t i = 0; i < samples.size() + 2000; i++) {
+        seed = seed * 1103515245u + 12345u;
+        double noise = static_cast<double>((seed >> 8) & 0xffff) / 65536.0 - 0.5;
+        double y = noise - a1 * y1 - a2 * y2;
+        y2 = y1;
+        y1 = y;
+        if (i >= 2000) samples[i - 2000] = y;
+    }
+
+    FormantConfig config;
+    config.order = 2;
+    config.preEmphasis = 0.0;
+    FormantAnalyzer analyzer(kRate, config);
+    FormantCandidates candidates;
+    analyzer.analyze(samples.data(), candidates);
+    CHECK(fabs(analyzer.lpc()[1] - a1) < 0.05 && fabs(analyzer.lpc()[2] - a2) < 0.05,
+          "AR(2) estimated as %.3f %.3f", analyzer.lpc()[1], analyzer.lpc()[2]);
+}
+
+// Steady vowels: the tracked F1..F4 sit on the synthesis formants
+static void testSteadyVowels() {
+    const double vowels[][4] = {
+        {730.0, 1090.0, 2440.0, 3400.0},   // /a/
+        {270.0, 2290.0, 3010.0, 3700.0},   // /i/
+        {300.0, 870.0, 2240.0, 3300.0},    // /u/
+    };
+    for (const auto& target : vowels) {
+        std::vector<double> samples = vowel(0.6, 120.0, [&](double, int k) { return target[k]; });
+        FeatureWorkspace workspace;
+        AudioFeatures features;
+        extractFeatures(BufferSource(samples, kRate), workspace, features);
+
+        for (size_t k = 0; k < kNumFormants; k++) {
+            std::vector<double> track;
+            for (size_t f = 0; f < features.frames.numFrames(); f++) {
+                float value = features.frames.at(f, FeatureColumns::Formants, k);
+                if (value > 0.0f) track.push_back(value);
+            }
+            double estimate = median(track);
+            CHECK(track.size() > features.frames.numFrames() / 2, "F%zu of %.0f Hz found in %zu of %zu frames",
+                  k + 1, target[0], track.size(), features.frames.numFrames());
+            CHECK(fabs(estimate / target[k] - 1.0) < 0.08, "F%zu estimated at %.0f Hz, expected %.0f",
+                  k + 1, estimate, target[k]);
+        }
+    }
+}
+
+// A glide: F2 follows the sweep without jumping to F1 or F3
+static void testTracking() {
+    std::vector<double> samples = vowel(1.0, 110.0, [](double t, int k) {
+        const double start[4] = {600.0, 1000.0, 2600.0, 3500.0};
+        return k == 1 ? 1000.0 + 1000.0 * t : start[k];
+    });
+    FeatureWorkspace workspace;
+    AudioFeatures features;
+    extractFeatures(BufferSource(samples, kRate), workspace, features);
+
+    const FeatureMatrix& frames = features.frames;
+    size_t jumps = 0;
+    size_t tracked = 0;
+    for (size_t f = 1; f < frames.numFrames(); f++) {
+        float previous = frames.at(f - 1, FeatureColumns::Formants, 1);
+        float current = frames.at(f, FeatureColumns::Formants, 1);
+        if (previous <= 0.0f || current <= 0.0f) continue;
+        tracked++;
+        if (fabs(current - previous) > 150.0f) jumps++;
+    }
+    CHECK(tracked > frames.numFrames() / 2, "F2 tracked in %zu frames", tracked);
+    CHECK(jumps == 0, "%zu F2 jumps", jumps);
+
+    double t = frames.frameTime(frames.numFrames() / 2) + kFrameSize / 2.0 / kRate;
+    float middle = frames.at(frames.numFrames() / 2, FeatureColumns::Formants, 1);
+    CHECK(fabs(middle - (1000.0 + 1000.0 * t)) < 120.0, "F2 %.0f Hz at %.2f s", middle, t);
+}
+
+// Silence and noise carry no formants; the mean API skips them
+static void testUnvoiced() {
+    std::vector<double> samples(kRate / 2, 0.0);
+    unsigned seed = 7;
+    for (size_t i = 0; i < samples.size() / 2; i++) {
+        seed = seed * 1103515245u + 12345u;
+        samples[i] = 0.1 * (static_cast<double>((seed >> 8) & 0xffff) / 65536.0 - 0.5);
+    }
+    FeatureWorkspace workspace;
+    AudioFeatures features;
+    extractFeatures(BufferSource(samples, kRate), workspace, features);
+    for (size_t f = 0; f < features.frames.numFrames(); f++) {
+        CHECK(features.frames.at(f, FeatureColumns::Formants, 0) == 0.0f, "formant in unvoiced frame %zu", f);
+    }
+
+    std::vector<double> a = vowel(0.5, 120.0, [](double, int k) {
+        const double target[4] = {730.0, 1090.0, 2440.0, 3400.0};
+        return target[k];
+    });
+    std::vector<double> mean = extractFormants(BufferSource(a, kRate));
+    CHECK(fabs(mean[0] - 730.0) < 60.0 && fabs(mean[1] - 1090.0) < 90.0, "mean F1 %.0f F2 %.0f", mean[0], mean[1]);
+}
+
+// Real-time budget: one frame's analysis stays far below a millisecond
+static void testSpeed() {
+    std::vector<double> samples = vowel(0.2, 120.0, [](double, int k) {
+        const double target[4] = {730.0, 1090.0, 2440.0, 3400.0};
+        return target[k];
+    });
+    StftScratch stft;
+    prepareStft(stft, kFrameSize);
+    std::vector<double> power(kFrameSize / 2 + 1);
+    framePowerSpectrum(samples.data() + kRate / 10, stft, power.data());
+
+    FormantAnalyzer analyzer(kRate);
+    FormantCandidates candidates;
+    const int reps = 200;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < reps; i++) analyzer.analyze(stft.frame.data(), candidates);
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / reps;
+    CHECK(us < 500.0, "%.1f us per frame", us);
+    CHECK(analyzer.stats().allocations == 1, "%llu allocations", static_cast<unsigned long long>(analyzer.stats().allocations));
+}
+
+int main() {
+    testLpc();
+    testSteadyVowels();
+    testTracking();
+    testUnvoiced();
+    testSpeed();
+
+    if (failures == 0) printf("formants_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,163 @@
+// Tests for the job scheduler: completion states, superseding by key,
+// cancellation checkpoints inside feature extraction and progress reports.
+
+#include "audio_analysis.h"
+#include "jobs.h"
+#include "test_util.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Outcome of every job, recorded by its done callback
+struct Outcomes {
+    std::mutex mutex;
+    std::vector<std::pair<uint64_t, JobState>> states;
+    std::vector<std::string> errors;
+
+    JobDone callback() {
+        return [this](const JobControl& job, JobState state, const std::string& error) {
+            std::lock_guard<std::mutex> lock(mutex);
+            states.push_back({job.id(), state});
+            errors.push_back(error);
+        };
+    }
+
+    JobState state(uint64_t id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (const auto& entry : states) {
+            if (entry.first == id) return entry.second;
+        }
+        return JobState::Queued;
+    }
+};
+
+// Spins until cancelled, like work between checkpoints
+static void untilCancelled(JobControl& job) {
+    while (!job.cancelled()) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+}
+
+static void testStates() {
+    JobScheduler scheduler;
+    Outcomes outcomes;
+    int ran = 0;
+    uint64_t ok = scheduler.submit("", [&](JobControl&) { ran++; }, outcomes.callback());
+    uint64_t failed = scheduler.submit("", [](JobControl&) { throw std::runtime_error("bad file"); },
+                                       outcomes.callback());
+    scheduler.wait(failed);
+    CHECK(ok < failed, "ids %llu, %llu not increasing", static_cast<unsigned long long>(ok),
+          static_cast<unsigned long long>(failed));
+    CHECK(ran == 1 && outcomes.state(ok) == JobState::Done, "first job %s", jobStateName(outcomes.state(ok)));
+    CHECK(outcomes.state(failed) == JobState::Failed && outcomes.errors[1] == "bad file", "second job %s (%s)",
+          jobStateName(outcomes.state(failed)), outcomes.errors[1].c_str());
+    CHECK(scheduler.pending() == 0, "%zu pending", scheduler.pending());
+}
+
+// A new take of a segment cancels the running and queued takes of that segment only
+static void testSupersede() {
+    JobScheduler scheduler;
+    Outcomes outcomes;
+    uint64_t first = scheduler.submit("lesson1/seg2", untilCancelled, outcomes.callback());
+    uint64_t other = scheduler.submit("lesson1/seg3", [](JobControl&) {}, outcomes.callback());
+    uint64_t queued = scheduler.submit("lesson1/seg2", [](JobControl&) {}, outcomes.callback());
+    uint64_t latest = scheduler.submit("lesson1/seg2", [](JobControl&) {}, outcomes.callback());
+    scheduler.wait(latest);
+
+    CHECK(outcomes.state(first) == JobState::Cancelled, "running take %s", jobStateName(outcomes.state(first)));
+    CHECK(outcomes.state(queued) == JobState::Cancelled, "queued take %s", jobStateName(outcomes.state(queued)));
+    CHECK(outcomes.state(other) == JobState::Done, "other segment %s", jobStateName(outcomes.state(other)));
+    CHECK(outcomes.state(latest) == JobState::Done, "latest take %s", jobStateName(outcomes.state(latest)));
+
+    // Explicit cancellation, and unknown ids
+    uint64_t spinning = scheduler.submit("", untilCancelled, outcomes.callback());
+    CHECK(scheduler.cancel(spinning), "cancel refused");
+    scheduler.wait(spinning);
+    CHECK(outcomes.state(spinning) == JobState::Cancelled, "cancelled job %s", jobStateName(outcomes.state(spinning)));
+    CHECK(!scheduler.cancel(spinning) && !scheduler.cancel(9999), "cancelled a finished or unknown job");
+}
+
+// Destroying the scheduler reports every outstanding job as cancelled
+static void testShutdown() {
+    Outcomes outcomes;
+    {
+        JobScheduler scheduler;
+        scheduler.submit("", untilCancelled, outcomes.callback());
+        scheduler.submit("", [](JobControl&) {}, outcomes.callback());
+    }
+    CHECK(outcomes.states.size() == 2, "%zu jobs reported", outcomes.states.size());
+    for (const auto& entry : outcomes.states) {
+        CHECK(entry.second == JobState::Cancelled, "job %llu %s", static_cast<unsigned long long>(entry.first),
+              jobStateName(entry.second));
+    }
+}
+
+// Extraction reports progress in steps up to 1 and stops at the next frame
+// block once cancelled, leaving no frames
+static void testExtraction() {
+    std::vector<double> samples = tone(220.0, 16000, 60.0, 0.5, 6);
+    BufferSource source(samples, 16000);
+    JobScheduler scheduler;
+    Outcomes outcomes;
+
+    std::mutex mutex;
+    std::vector<double> reports;
+    auto progress = [&](const JobControl&, double value) {
+        std::lock_guard<std::mutex> lock(mutex);
+        reports.push_back(value);
+    };
+    size_t frames = 0;
+    uint64_t whole = scheduler.submit("", [&](JobControl& job) {
+        FeatureWorkspace workspace;
+        JobBinding binding(workspace, job);
+        AudioFeatures features;
+        extractFeatures(source, workspace, features);
+        frames = features.frames.numFrames();
+    }, outcomes.callback(), progress);
+    scheduler.wait(whole);
+
+    CHECK(outcomes.state(whole) == JobState::Done && frames > 0, "extraction %s with %zu frames",
+          jobStateName(outcomes.state(whole)), frames);
+    CHECK(reports.size() >= 10 && fabs(reports.back() - 1.0) < 1e-9, "%zu progress reports, last %.2f",
+          reports.size(), reports.empty() ? 0.0 : reports.back());
+    for (size_t i = 1; i < reports.size(); i++) {
+        CHECK(reports[i] > reports[i - 1], "progress went from %.2f to %.2f", reports[i - 1], reports[i]);
+    }
+
+    // Cancel once a fifth of the frames are done
+    std::atomic<bool> sawCancel{false};
+    size_t cancelledFrames = 1;
+    double cancelledAt = 0.0, finishedAt = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    uint64_t stopped = 0;
+    stopped = scheduler.submit("", [&](JobControl& job) {
+        FeatureWorkspace workspace;
+        JobBinding binding(workspace, job);
+        AudioFeatures features;
+        extractFeatures(source, workspace, features);
+        cancelledFrames = features.frames.numFrames();
+        finishedAt = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }, outcomes.callback(), [&](const JobControl& job, double value) {
+        if (value >= 0.2 && !sawCancel.exchange(true)) {
+            cancelledAt = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            scheduler.cancel(job.id());
+        }
+    });
+    scheduler.wait(stopped);
+    CHECK(outcomes.state(stopped) == JobState::Cancelled, "cancelled extraction %s", jobStateName(outcomes.state(stopped)));
+    CHECK(cancelledFrames == 0, "cancelled extraction left %zu frames", cancelledFrames);
+    CHECK(finishedAt - cancelledAt < 200.0, "stopped %.1f ms after cancel", finishedAt - cancelledAt);
+}
+
+int main() {
+    testStates();
+    testSupersede();
+    testShutdown();
+    testExtraction();
+
+    if (failures == 0) printf("jobs_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
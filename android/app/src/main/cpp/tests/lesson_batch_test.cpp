@@ -0,0 +1,227 @@
+// Tests for lesson batches: every segment scores what a pairwise
+// extraction and performDTW would give it, shared references are loaded
+// once, and a segment whose audio fails reports its own status in the
+// packed record without disturbing the others.
+
+#include "audio_analysis.h"
+#include "feature_store.h"
+#include "lesson_batch.h"
+#include "test_util.h"
+#include "thread_pool.h"
+#include "wav_file.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Workspaces set up the way analyzeLessonBatch sets up its own
+static void userWorkspace(FeatureWorkspace& workspace) {
+    workspace.resample.enabled = true;
+    workspace.preprocess.enabled = true;
+    workspace.vad.enabled = true;
+}
+
+static void referenceWorkspace(FeatureWorkspace& workspace) {
+    workspace.resample.enabled = true;
+    workspace.vad.enabled = true;
+}
+
+static bool extract(const std::string& path, FeatureWorkspace& workspace) {
+    WavFile audio;
+    if (!audio.open(path)) return false;
+    extractFeatures(audio, workspace, workspace.features);
+    return true;
+}
+
+// The pairwise analysis of one segment, outside any batch
+static bool pairwise(const BatchSegment& segment, double& similarity, double& score) {
+    FeatureWorkspace user, reference;
+    userWorkspace(user);
+    referenceWorkspace(reference);
+    if (!extract(segment.userPath, user) || !extract(segment.referencePath, reference)) return false;
+    const FeatureMatrix& frames = reference.features.frames;
+    performDTW(user.features, frames.data(), frames.numFrames(), frames.sampleRate(), DTWOptions(), user,
+               user.comparison);
+    similarity = user.comparison.similarity;
+    score = analyzeTajweedRules(user.features, reference.features).overallScore;
+    return true;
+}
+
+static void testMatchesPairwise(const std::string& dir) {
+    std::string refA = dir + "/ref_a.wav", refB = dir + "/ref_b.wav";
+    CHECK(writeWav(refA, 1.2, 180.0, 1) && writeWav(refB, 0.9, 240.0, 2), "cannot write references in %s",
+          dir.c_str());
+
+    std::vector<BatchSegment> segments;
+    const double pitches[] = {175.0, 190.0, 235.0, 250.0};
+    for (int i = 0; i < 4; i++) {
+        std::string user = dir + "/user_" + std::to_string(i) + ".wav";
+        CHECK(writeWav(user, 0.8 + 0.15 * i, pitches[i], 10 + i), "cannot write %s", user.c_str());
+        segments.push_back({user, i < 2 ? refA : refB});
+    }
+
+    ThreadPool pool(3);
+    std::vector<BatchSegmentResult> results;
+    BatchStats stats;
+    analyzeLessonBatch(segments, results, stats, pool);
+
+    CHECK(results.size() == segments.size() && stats.segments == segments.size(), "%zu results", results.size());
+    CHECK(stats.references == 2 && stats.referencesFromStore == 0, "%zu references, %zu from the store",
+          stats.references, stats.referencesFromStore);
+    CHECK(stats.usersFromCache == 0 && stats.comparisonsFromCache == 0, "cache used without one");
+
+    for (size_t i = 0; i < results.size(); i++) {
+        const BatchSegmentResult& result = results[i];
+        double similarity = 0.0, score = 0.0;
+        CHECK(pairwise(segments[i], similarity, score), "segment %zu: pairwise analysis failed", i);
+        CHECK(result.status == BatchStatus::Ok, "segment %zu: status %d", i, static_cast<int>(result.status));
+        CHECK(result.similarity > 0.0 && std::fabs(result.similarity - similarity) < 1e-9,
+              "segment %zu: batch similarity %.12f, pairwise %.12f", i, result.similarity, similarity);
+        CHECK(std::fabs(result.score - score) < 1e-9, "segment %zu: batch score %.6f, pairwise %.6f", i, result.score,
+              score);
+    }
+
+    // Segments sharing a reference share its load time
+    CHECK(results[0].referenceMs == results[1].referenceMs && results[2].referenceMs == results[3].referenceMs,
+          "a shared reference was loaded more than once");
+
+    for (const BatchSegment& segment : segments) unlink(segment.userPath.c_str());
+    unlink(refA.c_str());
+    unlink(refB.c_str());
+}
+
+// A bundled reference is mapped instead of extracted and scores the same
+static void testBundledReference(const std::string& dir) {
+    FeatureStore& store = FeatureStore::instance();
+    store.setDirectory(dir + "/store");
+
+    std::string reference = dir + "/bundled.wav", user = dir + "/take.wav";
+    CHECK(writeWav(reference, 1.0, 200.0, 3) && writeWav(user, 1.0, 205.0, 4), "cannot write test files");
+
+    FeatureWorkspace workspace;
+    referenceWorkspace(workspace);
+    std::string error;
+    CHECK(extract(reference, workspace), "cannot extract %s", reference.c_str());
+    CHECK(store.put(reference, workspace.features, {}, extractionConfigHash(workspace), error), "put failed: %s",
+          error.c_str());
+
+    std::vector<BatchSegment> segments = {{user, reference}};
+    std::vector<BatchSegmentResult> results;
+    BatchStats stats;
+    analyzeLessonBatch(segments, results, stats);
+    double similarity = 0.0, score = 0.0;
+    CHECK(pairwise(segments[0], similarity, score), "pairwise analysis failed");
+    CHECK(stats.referencesFromStore == 1, "bundle not used");
+    CHECK(results[0].status == BatchStatus::Ok && std::fabs(results[0].similarity - similarity) < 1e-9,
+          "bundled reference: similarity %.12f, pairwise %.12f", results[0].similarity, similarity);
+
+    // A bundle streamed from compressed audio carries its own (untrimmed) config
+    CHECK(store.put(reference, workspace.features, {}, streamingConfigHash(workspace), error), "put failed: %s",
+          error.c_str());
+    analyzeLessonBatch(segments, results, stats);
+    CHECK(stats.referencesFromStore == 1 && results[0].status == BatchStatus::Ok, "streamed bundle not used");
+
+    unlink(store.pathFor(reference).c_str());
+    rmdir((dir + "/store").c_str());
+    store.setDirectory(dir);
+    unlink(reference.c_str());
+    unlink(user.c_str());
+}
+
+// Failed audio is reported per segment, and the packed buffer says so
+static void testFailures(const std::string& dir) {
+    std::string reference = dir + "/ref.wav", good = dir + "/good.wav", garbage = dir + "/garbage.wav";
+    CHECK(writeWav(reference, 1.0, 200.0, 5) && writeWav(good, 1.0, 210.0, 6), "cannot write test files");
+    FILE* file = fopen(garbage.c_str(), "wb");
+    if (file) {
+        fputs("not a wav file at all", file);
+        fclose(file);
+    }
+
+    std::vector<BatchSegment> segments = {
+        {good, reference},
+        {dir + "/missing_take.wav", reference},
+        {good, dir + "/missing_reference.wav"},
+        {garbage, reference},
+        {good, garbage},
+        {good, reference},
+    };
+    const BatchStatus expected[] = {BatchStatus::Ok, BatchStatus::UserAudioFailed, BatchStatus::ReferenceFailed,
+                                    BatchStatus::UserAudioFailed, BatchStatus::ReferenceFailed, BatchStatus::Ok};
+
+    std::vector<BatchSegmentResult> results;
+    BatchStats stats;
+    analyzeLessonBatch(segments, results, stats);
+    CHECK(results.size() == segments.size() && stats.references == 3, "%zu results, %zu references", results.size(),
+          stats.references);
+
+    double similarity = 0.0, score = 0.0;
+    CHECK(pairwise(segments[0], similarity, score), "pairwise analysis failed");
+    for (size_t i = 0; i < results.size(); i++) {
+        CHECK(results[i].status == expected[i], "segment %zu: status %d, expected %d", i,
+              static_cast<int>(results[i].status), static_cast<int>(expected[i]));
+        if (expected[i] == BatchStatus::Ok) {
+            CHECK(std::fabs(results[i].similarity - similarity) < 1e-9, "segment %zu: similarity %.12f next to failures",
+                  i, results[i].similarity);
+        } else {
+            CHECK(results[i].similarity == 0.0 && results[i].score == 0.0, "segment %zu: failed segment scored", i);
+        }
+    }
+
+    // Packed: header and record sizes first, then the stats, then one record per segment
+    std::vector<double> packed(packedBatchSize(results.size()));
+    packBatchResults(results, stats, packed.data());
+    CHECK(packed.size() == kBatchHeaderSize + results.size() * kBatchRecordSize, "packed size %zu", packed.size());
+    CHECK(packed[0] == kBatchHeaderSize && packed[1] == kBatchRecordSize, "packed sizes %.0f and %.0f", packed[0],
+          packed[1]);
+    CHECK(packed[2] == results.size() && packed[3] == 3 && packed[4] == 0 && packed[5] == stats.totalMs &&
+              packed[6] == 0 && packed[7] == 0,
+          "packed header differs from the stats");
+
+    size_t headerSize = static_cast<size_t>(packed[0]), recordSize = static_cast<size_t>(packed[1]);
+    for (size_t i = 0; i < results.size(); i++) {
+        const double* record = &packed[headerSize + i * recordSize];
+        CHECK(record[0] == static_cast<int>(expected[i]), "record %zu: status %.0f", i, record[0]);
+        CHECK(record[1] == results[i].similarity && record[2] == results[i].score &&
+                  record[3] == results[i].confidence,
+              "record %zu: scores differ", i);
+        for (size_t r = 0; r < kBatchRuleCount; r++) {
+            CHECK(record[4 + r] == results[i].ruleScores[r], "record %zu: %s score differs", i, kBatchRules[r]);
+        }
+        CHECK(record[recordSize - 3] == results[i].userMs && record[recordSize - 2] == results[i].referenceMs &&
+                  record[recordSize - 1] == results[i].compareMs,
+              "record %zu: timings differ", i);
+    }
+
+    // An empty lesson packs to just the header
+    analyzeLessonBatch({}, results, stats);
+    CHECK(results.empty() && stats.segments == 0 && packedBatchSize(0) == kBatchHeaderSize, "empty batch");
+
+    unlink(reference.c_str());
+    unlink(good.c_str());
+    unlink(garbage.c_str());
+}
+
+int main() {
+    char pattern[] = "/tmp/lesson_batch_test_XXXXXX";
+    const char* dir = mkdtemp(pattern);
+    if (!dir) {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+    FeatureStore::instance().setDirectory(dir);
+
+    testMatchesPairwise(dir);
+    testBundledReference(dir);
+    testFailures(dir);
+    rmdir(dir);
+
+    if (failures == 0) printf("lesson_batch_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
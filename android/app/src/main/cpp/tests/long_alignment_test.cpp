@@ -0,0 +1,236 @@
+// Tests for chunked alignment of long recitations: pause detection, anchors
+// landing on matching waqf in both takes, contiguous chunks and a stitched
+// path that stays close to the full DTW, independent of the pool size.
+
+#include "audio_analysis.h"
+#include "long_alignment.h"
+#include "test_util.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// A recitation as feature rows: ayat with smooth random trajectories in the
+// distance columns, separated by quiet pauses. The reference recites the
+// same ayat at its own tempo and pause lengths.
+struct Recitation {
+    FeatureMatrix user;
+    FeatureMatrix reference;
+    std::vector<size_t> userStarts;       // first frame of each ayah
+    std::vector<size_t> referenceStarts;
+};
+
+static Recitation makeRecitation(size_t ayat, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    const size_t dims = FeatureColumns::Distance.count;
+
+    std::vector<float> user, reference;
+    Recitation recitation;
+    auto pause = [&](std::vector<float>& rows, size_t frames) {
+        for (size_t f = 0; f < frames; f++) {
+            std::vector<float> row(kFeatureStride, 0.0f);
+            row[FeatureColumns::LogEnergy.offset] = -2.0f;
+            row[FeatureColumns::Energy.offset] = 1e-7f;
+            rows.insert(rows.end(), row.begin(), row.end());
+        }
+    };
+    auto ayah = [&](std::vector<float>& rows, size_t frames, double length, const std::vector<double>& shape,
+                    bool noisy) {
+        for (size_t f = 0; f < frames; f++) {
+            double t = static_cast<double>(f) / frames * length;
+            std::vector<float> row(kFeatureStride, 0.0f);
+            for (size_t d = 0; d < dims; d++) {
+                double value = sin(shape[3 * d] * t + shape[3 * d + 1]) + 0.5 * sin(shape[3 * d + 2] * t);
+                row[d] = static_cast<float>(value + (noisy ? noise(rng) : 0.0));
+            }
+            row[FeatureColumns::Energy.offset] = static_cast<float>(0.01 + 0.04 * unit(rng));
+            rows.insert(rows.end(), row.begin(), row.end());
+        }
+    };
+
+    pause(user, 10);
+    pause(reference, 12);
+    for (size_t a = 0; a < ayat; a++) {
+        std::vector<double> shape(3 * dims);
+        for (size_t i = 0; i < shape.size(); i++) shape[i] = (i % 3 == 1 ? 6.28 : 0.08) * unit(rng);
+        size_t frames = 200 + static_cast<size_t>(200 * unit(rng));
+        double tempo = 0.8 + 0.45 * unit(rng);
+        recitation.userStarts.push_back(user.size() / kFeatureStride);
+        recitation.referenceStarts.push_back(reference.size() / kFeatureStride);
+        ayah(user, frames, frames, shape, true);
+        ayah(reference, static_cast<size_t>(frames * tempo), frames, shape, false);
+        pause(user, 10 + static_cast<size_t>(6 * unit(rng)));
+        pause(reference, 10 + static_cast<size_t>(14 * unit(rng)));
+    }
+    recitation.user.assign(user.data(), user.size() / kFeatureStride, 16000);
+    recitation.reference.assign(reference.data(), reference.size() / kFeatureStride, 16000);
+    return recitation;
+}
+
+static AudioFeatures userFeatures(const Recitation& recitation) {
+    AudioFeatures features;
+    features.frames = recitation.user;
+    features.duration = recitation.user.numFrames() * recitation.user.frameSeconds();
+    features.sampleRate = 16000;
+    features.channels = 1;
+    return features;
+}
+
+static void testPauses() {
+    Recitation recitation = makeRecitation(8, 5);
+    std::vector<std::pair<size_t, size_t>> pauses;
+    findPauses(recitation.user.data(), recitation.user.numFrames(), 5, 30.0, pauses);
+    CHECK(pauses.size() == 9, "%zu pauses, expected 9", pauses.size());
+    for (size_t a = 0; a < recitation.userStarts.size() && a < pauses.size(); a++) {
+        CHECK(pauses[a].second == recitation.userStarts[a], "pause %zu ends at %zu, ayah starts at %zu", a,
+              pauses[a].second, recitation.userStarts[a]);
+    }
+
+    // Shorter than minFrames, or not quiet enough, is no pause
+    findPauses(recitation.user.data(), recitation.user.numFrames(), 20, 30.0, pauses);
+    CHECK(pauses.empty(), "%zu pauses longer than 20 frames", pauses.size());
+    findPauses(recitation.user.data(), recitation.user.numFrames(), 5, 80.0, pauses);
+    CHECK(pauses.empty(), "%zu pauses 80 dB down", pauses.size());
+    findPauses(nullptr, 0, 5, 30.0, pauses);
+    CHECK(pauses.empty(), "pauses in an empty take");
+}
+
+static void testChunkedAlignment() {
+    // Small enough for the full grid, so the stitched path can be compared with it
+    Recitation recitation = makeRecitation(12, 11);
+    AudioFeatures features = userFeatures(recitation);
+    size_t n1 = recitation.user.numFrames();
+    size_t n2 = recitation.reference.numFrames();
+    CHECK(n1 * n2 <= kMaxDirectAlignmentCells, "test takes too long for a direct alignment");
+
+    FeatureWorkspace workspace;
+    ComparisonResult full;
+    performDTW(features, recitation.reference.data(), n2, 16000, DTWOptions(), workspace, full);
+    double fullDistance = workspace.path.distance;
+
+    ThreadPool pool(3);
+    workspace.setPool(&pool);
+    LongAlignmentOptions options;
+    std::vector<AlignmentChunk> chunks;
+    LongAlignmentStats stats;
+    ComparisonResult result;
+    performLongDTW(features, recitation.reference.data(), n2, 16000, options, workspace, result, chunks, &stats);
+
+    CHECK(chunks.size() >= 4, "%zu chunks over %zu frames", chunks.size(), n1);
+    CHECK(stats.pauses1 == 13 && stats.pauses2 == 13, "%zu and %zu pauses", stats.pauses1, stats.pauses2);
+    CHECK(stats.pauseAnchors + 1 == chunks.size(), "%zu of %zu boundaries on a pause", stats.pauseAnchors,
+          chunks.size() - 1);
+    CHECK(stats.largestChunkCells < n1 * n2 / 8, "largest chunk %zu cells of %zu", stats.largestChunkCells, n1 * n2);
+
+    // Contiguous, covering both takes, with per-chunk scores
+    bool contiguous = !chunks.empty() && chunks.front().begin1 == 0 && chunks.front().begin2 == 0 &&
+                      chunks.back().end1 == n1 && chunks.back().end2 == n2;
+    for (size_t k = 0; k < chunks.size(); k++) {
+        const AlignmentChunk& chunk = chunks[k];
+        contiguous = contiguous && chunk.begin1 < chunk.end1 && chunk.begin2 < chunk.end2;
+        if (k > 0) contiguous = contiguous && chunk.begin1 == chunks[k - 1].end1 && chunk.begin2 == chunks[k - 1].end2;
+        CHECK(chunk.similarity > 0.5 && chunk.similarity <= 1.0, "chunk %zu similarity %.3f", k, chunk.similarity);
+        CHECK(fabs(chunk.endTime1 - chunk.end1 * recitation.user.frameSeconds()) < 1e-9, "chunk %zu end time %.3f", k,
+              chunk.endTime1);
+    }
+    CHECK(contiguous, "chunks are not contiguous over both takes");
+
+    // A valid warping path: starts and ends at the corners, unit steps
+    const DTWAlignment& path = workspace.path;
+    bool valid = !path.costs.empty() && path.frames1.front() == 0 && path.frames2.front() == 0 &&
+                 path.frames1.back() == n1 - 1 && path.frames2.back() == n2 - 1;
+    for (size_t s = 1; valid && s < path.costs.size(); s++) {
+        size_t d1 = path.frames1[s] - path.frames1[s - 1];
+        size_t d2 = path.frames2[s] - path.frames2[s - 1];
+        valid = d1 <= 1 && d2 <= 1 && d1 + d2 > 0;
+    }
+    CHECK(valid, "stitched path is not a warping path");
+
+    // No better than the optimum, and not far from it
+    CHECK(path.distance >= fullDistance - 1e-6 * fullDistance, "stitched %.3f below the optimum %.3f",
+          path.distance, fullDistance);
+    CHECK(fabs(result.similarity - full.similarity) < 0.02, "similarity %.4f, full DTW %.4f", result.similarity,
+          full.similarity);
+    CHECK(result.alignment.size() == n1, "%zu aligned frames of %zu", result.alignment.size(), n1);
+
+    // Each ayah start lands on the reference's
+    double frameSeconds2 = static_cast<double>(kHopSize) / 16000;
+    for (size_t a = 0; a < recitation.userStarts.size() && result.alignment.size() == n1; a++) {
+        double mapped = result.alignment[recitation.userStarts[a]] / frameSeconds2;
+        CHECK(fabs(mapped - recitation.referenceStarts[a]) < 6.0, "ayah %zu maps to frame %.1f, reference %zu", a,
+              mapped, recitation.referenceStarts[a]);
+    }
+
+    // Same chunks and path on a single worker
+    ThreadPool serial(0);
+    workspace.setPool(&serial);
+    std::vector<AlignmentChunk> serialChunks;
+    ComparisonResult serialResult;
+    performLongDTW(features, recitation.reference.data(), n2, 16000, options, workspace, serialResult, serialChunks);
+    bool same = serialChunks.size() == chunks.size() && serialResult.similarity == result.similarity;
+    for (size_t k = 0; same && k < chunks.size(); k++) {
+        same = serialChunks[k].begin1 == chunks[k].begin1 && serialChunks[k].begin2 == chunks[k].begin2 &&
+               serialChunks[k].distance == chunks[k].distance;
+    }
+    CHECK(same, "serial run differs from the pooled one");
+    workspace.setPool(nullptr);
+}
+
+static void testShortAndEmpty() {
+    // Under one and a half chunks: one chunk, exactly the full DTW
+    Recitation recitation = makeRecitation(2, 17);
+    AudioFeatures features = userFeatures(recitation);
+    size_t n2 = recitation.reference.numFrames();
+    FeatureWorkspace workspace;
+    ComparisonResult full, result;
+    performDTW(features, recitation.reference.data(), n2, 16000, DTWOptions(), workspace, full);
+
+    LongAlignmentOptions options;
+    options.chunkFrames = recitation.user.numFrames();
+    std::vector<AlignmentChunk> chunks;
+    performLongDTW(features, recitation.reference.data(), n2, 16000, options, workspace, result, chunks);
+    CHECK(chunks.size() == 1, "%zu chunks for a short take", chunks.size());
+    CHECK(result.similarity == full.similarity, "similarity %.6f, full DTW %.6f", result.similarity, full.similarity);
+
+    performLongDTW(features, nullptr, 0, 16000, options, workspace, result, chunks);
+    CHECK(chunks.empty() && result.similarity == 0.0 && result.alignment.empty(), "empty reference aligned");
+}
+
+static void testPerformDTWFallback() {
+    // Past kMaxDirectAlignmentCells, performDTW switches to chunks and never
+    // grows the backtracking grid to the full size
+    Recitation recitation = makeRecitation(40, 23);
+    AudioFeatures features = userFeatures(recitation);
+    size_t n1 = recitation.user.numFrames();
+    size_t n2 = recitation.reference.numFrames();
+    CHECK(n1 * n2 > kMaxDirectAlignmentCells, "%zu cells do not exceed the cap", n1 * n2);
+
+    FeatureWorkspace workspace;
+    ComparisonResult result;
+    performDTW(features, recitation.reference.data(), n2, 16000, DTWOptions(), workspace, result);
+    CHECK(!result.abandoned && result.similarity > 0.5, "similarity %.3f", result.similarity);
+    CHECK(result.alignment.size() == n1, "%zu aligned frames of %zu", result.alignment.size(), n1);
+    CHECK(workspace.dtw.steps.capacity() < n1 * n2 / 8, "grid of %zu cells for %zu", workspace.dtw.steps.capacity(),
+          n1 * n2);
+
+    // The cutoff still applies, to the mean cost of the stitched path
+    DTWOptions strict;
+    strict.abandonThreshold = similarityCutoffToDistance(0.999);
+    performDTW(features, recitation.reference.data(), n2, 16000, strict, workspace, result);
+    CHECK(result.abandoned && result.similarity == 0.0, "strict cutoff kept similarity %.3f", result.similarity);
+}
+
+int main() {
+    testPauses();
+    testChunkedAlignment();
+    testShortAndEmpty();
+    testPerformDTWFallback();
+
+    if (failures == 0) printf("long_alignment_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,67 @@
+// Tests for the stage histograms and counters behind getPerfStats.
+
+#include "perf_stats.h"
+#include "test_util.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+using TajweedAudio::PerfCounter;
+using TajweedAudio::PerfSnapshot;
+using TajweedAudio::PerfStage;
+using TajweedAudio::StageSnapshot;
+
+static bool near(double value, double expected, double tolerance) {
+    return std::fabs(value - expected) <= tolerance * expected;
+}
+
+// 1..1000 us once each: percentiles fall within a bucket of the exact rank
+static void testPercentiles() {
+    TajweedAudio::resetPerfStats();
+    for (uint64_t us = 1; us <= 1000; us++) TajweedAudio::recordStage(PerfStage::Dtw, us * 1000);
+
+    PerfSnapshot snapshot = TajweedAudio::perfSnapshot();
+    const StageSnapshot& dtw = snapshot.stages[static_cast<size_t>(PerfStage::Dtw)];
+    CHECK(dtw.count == 1000, "count %llu", static_cast<unsigned long long>(dtw.count));
+    CHECK(near(dtw.totalMs, 500.5, 1e-9), "total %.3f ms", dtw.totalMs);
+    CHECK(near(dtw.p50Us, 500.0, 0.125), "p50 %.1f us", dtw.p50Us);
+    CHECK(near(dtw.p95Us, 950.0, 0.125), "p95 %.1f us", dtw.p95Us);
+    CHECK(near(dtw.p99Us, 990.0, 0.125), "p99 %.1f us", dtw.p99Us);
+    CHECK(dtw.maxUs == 1000.0, "max %.1f us", dtw.maxUs);
+    CHECK(dtw.p50Us <= dtw.p95Us && dtw.p95Us <= dtw.p99Us && dtw.p99Us <= dtw.maxUs, "percentiles out of order");
+
+    const StageSnapshot& rules = snapshot.stages[static_cast<size_t>(PerfStage::Rules)];
+    CHECK(rules.count == 0 && rules.p99Us == 0.0, "untouched stage has samples");
+}
+
+// Threads in the pool and threads that have already exited are both counted
+static void testThreads() {
+    TajweedAudio::resetPerfStats();
+    TajweedAudio::ThreadPool pool(3);
+    TajweedAudio::parallelFor(pool, 64, 1, [](size_t, size_t) {
+        TajweedAudio::countPerf(PerfCounter::FramesProcessed, 10);
+        TajweedAudio::recordStage(PerfStage::Stft, 5000);
+    });
+    std::thread([]() { TajweedAudio::countPerf(PerfCounter::FramesProcessed, 1); }).join();
+
+    PerfSnapshot snapshot = TajweedAudio::perfSnapshot();
+    uint64_t frames = snapshot.counters[static_cast<size_t>(PerfCounter::FramesProcessed)];
+    CHECK(frames == 641, "frames %llu", static_cast<unsigned long long>(frames));
+    CHECK(snapshot.stages[static_cast<size_t>(PerfStage::Stft)].count == 64, "stft samples missing");
+
+    TajweedAudio::resetPerfStats();
+    snapshot = TajweedAudio::perfSnapshot();
+    CHECK(snapshot.counters[static_cast<size_t>(PerfCounter::FramesProcessed)] == 0, "reset kept counters");
+    CHECK(snapshot.stages[static_cast<size_t>(PerfStage::Stft)].count == 0, "reset kept samples");
+}
+
+int main() {
+    testPercentiles();
+    testThreads();
+
+    CHECK(TajweedAudio::perfSnapshot().enabled == (TAJWEED_PERF_STATS != 0), "enabled flag mismatch");
+
+    if (failures == 0) printf("perf_stats_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
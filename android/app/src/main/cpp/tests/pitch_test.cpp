@@ -0,0 +1,142 @@
+// Tests for the YIN pitch tracker: accuracy on pure and harmonic tones
+// across the range of recitation, at 16 kHz and at device rates, and
+// unvoiced output for silence and noise.
+
+#include "audio_analysis.h"
+#include "pitch.h"
+#include "test_util.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// Fraction of frames voiced, and the worst relative error among them
+static void summarize(const std::vector<PitchFrame>& frames, double f0, double& voiced, double& worstError) {
+    size_t count = 0;
+    worstError = 0.0;
+    for (const PitchFrame& frame : frames) {
+        if (!frame.voiced) continue;
+        count++;
+        worstError = std::max(worstError, std::fabs(frame.frequency - f0) / f0);
+    }
+    voiced = frames.empty() ? 0.0 : static_cast<double>(count) / frames.size();
+}
+
+static void testTones() {
+    for (double f0 : {80.0, 100.0, 123.0, 150.0, 220.0, 310.0, 440.0, 800.0}) {
+        for (int harmonics : {1, 8}) {
+            std::vector<double> samples = tone(f0, kRate, 0.5, 0.5, harmonics);
+            std::vector<PitchFrame> frames = trackPitch(BufferSource(samples, kRate));
+            double voiced, worstError;
+            summarize(frames, f0, voiced, worstError);
+            CHECK(voiced == 1.0, "%.0f Hz x%d: %.0f%% of frames voiced", f0, harmonics, voiced * 100.0);
+            CHECK(worstError < 0.01, "%.0f Hz x%d: off by %.2f%%", f0, harmonics, worstError * 100.0);
+
+            double minConfidence = 1.0;
+            for (const PitchFrame& frame : frames) minConfidence = std::min(minConfidence, frame.confidence);
+            CHECK(minConfidence > 0.85, "%.0f Hz x%d: confidence %.2f", f0, harmonics, minConfidence);
+        }
+    }
+
+    // extractPitch reports the same track in Hz
+    std::vector<double> samples = tone(200.0, kRate, 0.5, 0.5, 4);
+    std::vector<double> pitch = extractPitch(samples, kRate);
+    std::vector<PitchFrame> frames = trackPitch(BufferSource(samples, kRate));
+    bool same = pitch.size() == frames.size() && !pitch.empty();
+    for (size_t i = 0; same && i < pitch.size(); i++) same = pitch[i] == frames[i].frequency;
+    CHECK(same, "extractPitch differs from trackPitch");
+}
+
+// Low voices at device rates: the window widens so their periods still fit
+static void testHighRates() {
+    for (int rate : {44100, 48000}) {
+        PitchTracker tracker(rate);
+        CHECK(tracker.windowSize() == 2048, "%d Hz: %zu-sample window", rate, tracker.windowSize());
+
+        for (double f0 : {100.0, 123.0, 150.0}) {
+            std::vector<double> samples = tone(f0, rate, 0.5, 0.5, 6);
+            std::vector<PitchFrame> frames = trackPitch(BufferSource(samples, rate));
+            double voiced, worstError;
+            summarize(frames, f0, voiced, worstError);
+            CHECK(frames.size() == (samples.size() - kFrameSize) / kHopSize + 1, "%d Hz: %zu frames", rate,
+                  frames.size());
+            CHECK(voiced == 1.0, "%.0f Hz at %d Hz: %.0f%% of frames voiced", f0, rate, voiced * 100.0);
+            CHECK(worstError < 0.01, "%.0f Hz at %d Hz: off by %.2f%%", f0, rate, worstError * 100.0);
+        }
+    }
+
+    // The public paths see the low voice too
+    std::vector<double> samples = tone(130.0, 44100, 0.5, 0.5, 6);
+    std::vector<double> pitch = extractPitch(samples, 44100);
+    size_t voiced = 0;
+    for (double hz : pitch) voiced += std::fabs(hz - 130.0) < 1.3 ? 1 : 0;
+    CHECK(!pitch.empty() && voiced == pitch.size(), "extractPitch at 44.1 kHz: %zu of %zu frames at 130 Hz", voiced,
+          pitch.size());
+    std::vector<double> formants = extractFormants(samples, 44100);
+    CHECK(formants[0] > 0.0, "extractFormants at 44.1 kHz found no voiced frames");
+
+    // 16 kHz keeps the frame as its window
+    CHECK(PitchTracker(kRate).windowSize() == static_cast<size_t>(kFrameSize), "16 kHz window widened");
+}
+
+static void testUnvoiced() {
+    PitchTracker tracker(kRate);
+    std::vector<double> silence(kFrameSize, 0.0);
+    PitchFrame frame = tracker.analyze(silence.data());
+    CHECK(!frame.voiced && frame.frequency == 0.0 && frame.confidence == 0.0, "silence voiced at %.1f Hz",
+          frame.frequency);
+
+    // Below the silence floor counts as silence, whatever it contains
+    std::vector<double> whisper = tone(200.0, kRate, static_cast<double>(kFrameSize) / kRate);
+    for (double& s : whisper) s *= 1e-5;
+    CHECK(!tracker.analyze(whisper.data()).voiced, "tone under the silence floor voiced");
+
+    // White and low-passed noise have no period
+    std::mt19937 rng(7);
+    std::normal_distribution<double> dist(0.0, 0.3);
+    std::vector<double> noise(kRate);
+    for (double& s : noise) s = dist(rng);
+    double voiced, worstError;
+    summarize(trackPitch(BufferSource(noise, kRate)), 1.0, voiced, worstError);
+    CHECK(voiced == 0.0, "white noise: %.0f%% of frames voiced", voiced * 100.0);
+
+    double smooth = 0.0;
+    for (double& s : noise) s = smooth = 0.7 * smooth + 0.3 * s;
+    summarize(trackPitch(BufferSource(noise, kRate)), 1.0, voiced, worstError);
+    CHECK(voiced < 0.05, "low-passed noise: %.0f%% of frames voiced", voiced * 100.0);
+
+    std::vector<PitchFrame> frames = trackPitch(BufferSource(std::vector<double>(kRate / 2, 0.0), kRate));
+    bool quiet = !frames.empty();
+    for (const PitchFrame& f : frames) quiet = quiet && !f.voiced && f.frequency == 0.0;
+    CHECK(quiet, "silent recording has voiced frames");
+
+    // Too short for one frame
+    CHECK(trackPitch(BufferSource(std::vector<double>(kFrameSize - 1, 0.1), kRate)).empty(), "frame from a short input");
+}
+
+static void testNoAllocation() {
+    PitchTracker tracker(kRate);
+    std::vector<double> samples = tone(140.0, kRate, 1.0, 0.5, 6);
+    std::vector<PitchFrame> frames;
+    tracker.track(BufferSource(samples, kRate), frames);
+    uint64_t allocations = tracker.stats().allocations;
+    tracker.track(BufferSource(samples, kRate), frames);
+    for (size_t start = 0; start + kFrameSize <= samples.size(); start += kHopSize) tracker.analyze(&samples[start]);
+    CHECK(tracker.stats().allocations == allocations, "%llu allocations after warm-up",
+          static_cast<unsigned long long>(tracker.stats().allocations - allocations));
+}
+
+int main() {
+    testTones();
+    testHighRates();
+    testUnvoiced();
+    testNoAllocation();
+
+    if (failures == 0) printf("pitch_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
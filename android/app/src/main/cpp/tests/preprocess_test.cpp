@@ -0,0 +1,138 @@
+// Tests for the biquad filters, spectral subtraction and the fused
+// preprocessing pass.
+
+#include "preprocess.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// RMS over the second half, past any filter transient
+static double steadyRms(const std::vector<double>& samples) {
+    double sum = 0.0;
+    size_t start = samples.size() / 2;
+    for (size_t i = start; i < samples.size(); i++) sum += samples[i] * samples[i];
+    return sqrt(sum / (samples.size() - start));
+}
+
+static void testFilters() {
+    std::vector<double> rumble = tone(20.0, kRate, 1.0);
+    std::vector<double> voice = tone(1000.0, kRate, 1.0);
+    double before = steadyRms(voice);
+    applyHighPassFilter(rumble, kRate, 60.0);
+    applyHighPassFilter(voice, kRate, 60.0);
+    CHECK(steadyRms(rumble) < 0.02 * before, "high-pass left %.4f of a 20 Hz tone", steadyRms(rumble));
+    CHECK(fabs(steadyRms(voice) / before - 1.0) < 0.01, "high-pass changed 1 kHz by %.4f", steadyRms(voice) / before);
+
+    std::vector<double> hiss = tone(7900.0, kRate, 1.0);
+    voice = tone(1000.0, kRate, 1.0);
+    applyLowPassFilter(hiss, kRate, 6000.0);
+    applyLowPassFilter(voice, kRate, 6000.0);
+    CHECK(steadyRms(hiss) < 0.1 * before, "low-pass left %.4f of a 7.9 kHz tone", steadyRms(hiss));
+    CHECK(fabs(steadyRms(voice) / before - 1.0) < 0.01, "low-pass changed 1 kHz by %.4f", steadyRms(voice) / before);
+}
+
+// Block boundaries carry state: any split gives the same output as one call
+static void testBlockInvariance() {
+    std::mt19937 rng(7);
+    std::normal_distribution<double> noise(0.0, 0.1);
+    std::vector<double> input(20000);
+    for (size_t i = 0; i < input.size(); i++) input[i] = 0.3 * sin(2.0 * M_PI * 440.0 * i / kRate) + noise(rng);
+
+    PreprocessOptions options;
+    Preprocessor whole, split;
+    whole.configure(kRate, options);
+    split.configure(kRate, options);
+
+    std::vector<double> a = input, b = input;
+    whole.process(a.data(), a.size());
+    size_t sizes[] = {1, 7, 333, 4096, 100};
+    size_t position = 0;
+    for (size_t k = 0; position < b.size(); k++) {
+        size_t count = std::min(sizes[k % 5], b.size() - position);
+        split.process(b.data() + position, count);
+        position += count;
+    }
+
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < a.size(); i++) maxDiff = std::max(maxDiff, fabs(a[i] - b[i]));
+    CHECK(maxDiff == 0.0, "block split changed output by %.3e", maxDiff);
+}
+
+// With nothing subtracted the denoiser reconstructs its input exactly, one latency late
+static void testDenoiserReconstruction() {
+    SpectralDenoiser denoiser;
+    denoiser.configure(kRate, 0.0, 1.0);
+    std::vector<double> input = tone(300.0, kRate, 0.5);
+    std::vector<double> output = input;
+    denoiser.process(output.data(), output.size());
+
+    size_t latency = denoiser.latency();
+    double maxError = 0.0;
+    for (size_t i = latency; i < output.size(); i++) maxError = std::max(maxError, fabs(output[i] - input[i - latency]));
+    CHECK(maxError < 1e-9, "reconstruction error %.3e", maxError);
+}
+
+// Noise-only lead-in, then a tone in the same noise: the residual noise drops
+static void testNoiseReduction() {
+    std::mt19937 rng(11);
+    std::normal_distribution<double> noise(0.0, 0.05);
+    size_t lead = kRate / 2;
+    std::vector<double> clean(2 * kRate, 0.0);
+    for (size_t i = lead; i < clean.size(); i++) clean[i] = 0.3 * sin(2.0 * M_PI * 500.0 * i / kRate);
+    std::vector<double> noisy(clean.size());
+    for (size_t i = 0; i < clean.size(); i++) noisy[i] = clean[i] + noise(rng);
+
+    // Filters alone would shift the tone's phase; this measures the denoiser
+    PreprocessOptions options;
+    options.highPassHz = 0.0;
+    options.lowPassHz = 0.0;
+    options.normalize = false;
+    std::vector<double> processed = noisy;
+    preprocessAudio(processed, kRate, options);
+    CHECK(processed.size() == noisy.size(), "length changed to %zu", processed.size());
+
+    double noiseBefore = 0.0, noiseAfter = 0.0;
+    for (size_t i = lead + kRate / 4; i < clean.size(); i++) {
+        noiseBefore += (noisy[i] - clean[i]) * (noisy[i] - clean[i]);
+        noiseAfter += (processed[i] - clean[i]) * (processed[i] - clean[i]);
+    }
+    double gainDb = 10.0 * log10(noiseBefore / noiseAfter);
+    CHECK(gainDb > 6.0, "SNR improved by only %.1f dB", gainDb);
+}
+
+static void testNormalization() {
+    std::vector<double> samples = tone(1000.0, kRate, 0.25, 0.1);
+    normalizeAudio(samples, 0.9);
+    double peak = 0.0;
+    for (double s : samples) peak = std::max(peak, fabs(s));
+    CHECK(fabs(peak - 0.9) < 1e-12, "peak %.6f", peak);
+
+    std::vector<double> quiet = tone(1000.0, kRate, 1.0, 0.01);
+    BufferSource source(quiet, kRate);
+    PreprocessedSource preprocessed;
+    PreprocessOptions options;
+    options.denoise = false;
+    preprocessed.process(source, options);
+    std::vector<double> out(quiet.size());
+    CHECK(preprocessed.read(0, out.size(), out.data()) == quiet.size(), "short read");
+    double readPeak = 0.0;
+    for (double s : out) readPeak = std::max(readPeak, fabs(s));
+    CHECK(fabs(readPeak - 0.1) < 0.015, "gain cap not applied, peak %.4f", readPeak);
+}
+
+int main() {
+    testFilters();
+    testBlockInvariance();
+    testDenoiserReconstruction();
+    testNoiseReduction();
+    testNormalization();
+
+    if (failures == 0) printf("preprocess_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
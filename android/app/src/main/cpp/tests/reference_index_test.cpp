@@ -0,0 +1,292 @@
+// Tests for the reference index: pooled embeddings and sketches, the
+// LB_Keogh bound against the sketch DTW, top-k retrieval of time-warped
+// takes, segment lookup, and the clustered shortlist against a full scan.
+
+#include "reference_index.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// Smooth random trajectory per column: a few sinusoids each, so every
+// recitation has its own contour through MFCC, pitch and energy
+struct Recitation {
+    double frequency[kFeatureStride][3];
+    double phase[kFeatureStride][3];
+    double amplitude[kFeatureStride][3];
+};
+
+static Recitation randomRecitation(std::mt19937& rng) {
+    std::uniform_real_distribution<double> frequency(0.3, 3.0), phase(0.0, 2.0 * M_PI), amplitude(0.2, 1.0);
+    Recitation recitation;
+    for (size_t c = 0; c < kFeatureStride; c++) {
+        for (int k = 0; k < 3; k++) {
+            recitation.frequency[c][k] = frequency(rng);
+            recitation.phase[c][k] = phase(rng);
+            recitation.amplitude[c][k] = amplitude(rng);
+        }
+    }
+    return recitation;
+}
+
+// `frames` rows of the recitation with noise; `warp` above 1 lingers over the
+// start and hurries the end, 1.0 is as recorded
+static void render(const Recitation& recitation, size_t frames, double warp, double noise, std::mt19937& rng,
+                   std::vector<float>& rows) {
+    std::normal_distribution<double> jitter(0.0, noise);
+    size_t first = rows.size() / kFeatureStride;
+    rows.resize((first + frames) * kFeatureStride, 0.0f);
+    for (size_t f = 0; f < frames; f++) {
+        double t = pow(static_cast<double>(f) / frames, warp);
+        float* row = rows.data() + (first + f) * kFeatureStride;
+        for (size_t c = 0; c < kFeatureStride; c++) {
+            double value = 0.0;
+            for (int k = 0; k < 3; k++) {
+                value += recitation.amplitude[c][k] * sin(2.0 * M_PI * recitation.frequency[c][k] * t + recitation.phase[c][k]);
+            }
+            row[c] = static_cast<float>(value + (noise > 0.0 ? jitter(rng) : 0.0));
+        }
+    }
+}
+
+static FeatureMatrix takeOf(const Recitation& recitation, size_t frames, double warp, double noise, std::mt19937& rng) {
+    std::vector<float> rows;
+    render(recitation, frames, warp, noise, rng, rows);
+    FeatureMatrix matrix;
+    matrix.assign(rows.data(), frames, kRate);
+    return matrix;
+}
+
+// Library of single-segment references "ref<i>"
+static void buildLibrary(const std::vector<Recitation>& recitations, std::mt19937& rng, ReferenceIndex& index) {
+    std::uniform_int_distribution<size_t> length(80, 200);
+    for (size_t i = 0; i < recitations.size(); i++) {
+        std::vector<float> rows;
+        size_t frames = length(rng);
+        render(recitations[i], frames, 1.0, 0.0, rng, rows);
+        BundleSegment segment = {0.0, frames * kHopSize / static_cast<double>(kRate), 0, static_cast<uint32_t>(frames)};
+        index.add("ref" + std::to_string(i), rows.data(), frames, &segment, 1);
+    }
+}
+
+static void testLowerBound() {
+    std::mt19937 rng(7);
+    std::normal_distribution<float> noise(0.0f, 1.0f);
+    std::vector<float> a(kSketchFrames * kSketchDims), b(kSketchFrames * kSketchDims);
+    std::vector<float> upper(a.size()), lower(a.size());
+
+    for (int trial = 0; trial < 200; trial++) {
+        for (size_t i = 0; i < a.size(); i++) {
+            a[i] = noise(rng);
+            b[i] = noise(rng);
+        }
+        int window = trial % 7;
+        sketchEnvelope(b.data(), window, upper.data(), lower.data());
+        double bound = lbKeogh(a.data(), upper.data(), lower.data());
+        double distance = sketchDistance(a.data(), b.data(), window);
+        CHECK(bound <= distance * (1.0 + 1e-6), "LB_Keogh %.4f above the DTW distance %.4f (window %d)",
+              bound, distance, window);
+        CHECK(bound > 0.0, "LB_Keogh of unrelated sketches is zero");
+        CHECK(std::isinf(sketchDistance(a.data(), b.data(), window, 0.5 * distance)),
+              "DTW not abandoned below its distance");
+    }
+
+    // Identical sketches have a zero bound and distance
+    sketchEnvelope(a.data(), 3, upper.data(), lower.data());
+    CHECK(lbKeogh(a.data(), upper.data(), lower.data()) == 0.0, "bound of a sketch against itself");
+    CHECK(sketchDistance(a.data(), a.data(), 3) < 1e-9, "distance of a sketch to itself");
+}
+
+static void testSummaries() {
+    std::mt19937 rng(11);
+    Recitation recitation = randomRecitation(rng);
+    std::vector<float> rows;
+    render(recitation, 150, 1.0, 0.0, rng, rows);
+
+    // Offsets and scales a recording applies to every frame do not change either summary
+    std::vector<float> scaled(rows);
+    for (size_t f = 0; f < 150; f++) {
+        for (size_t c = 0; c < kFeatureStride; c++) scaled[f * kFeatureStride + c] = 3.0f * rows[f * kFeatureStride + c] + 2.0f;
+    }
+    float e1[kEmbeddingDims], e2[kEmbeddingDims];
+    float s1[kSketchFrames * kSketchDims], s2[kSketchFrames * kSketchDims];
+    poolEmbedding(rows.data(), 150, e1);
+    poolEmbedding(scaled.data(), 150, e2);
+    sketchFrames(rows.data(), 150, s1);
+    sketchFrames(scaled.data(), 150, s2);
+    double embeddingError = 0.0, sketchError = 0.0;
+    for (size_t d = 0; d < kEmbeddingDims; d++) embeddingError = std::max(embeddingError, fabs(e1[d] - e2[d]));
+    for (size_t d = 0; d < kSketchFrames * kSketchDims; d++) sketchError = std::max(sketchError, fabs(s1[d] - s2[d]));
+    CHECK(embeddingError < 1e-4, "embedding depends on the recording's scale (%.6f)", embeddingError);
+    CHECK(sketchError < 1e-4, "sketch depends on the recording's scale (%.6f)", sketchError);
+
+    // Padding stays zero, so it never adds to a distance
+    CHECK(e1[kEmbeddingDims - 1] == 0.0f, "embedding padding is %.4f", e1[kEmbeddingDims - 1]);
+    CHECK(s1[kSketchDims - 1] == 0.0f, "sketch padding is %.4f", s1[kSketchDims - 1]);
+
+    // Shorter than the sketch still fills every frame
+    poolEmbedding(rows.data(), 10, e1);
+    sketchFrames(rows.data(), 10, s1);
+    double energy = 0.0;
+    for (size_t d = 0; d < kSketchDims; d++) energy += fabs(s1[(kSketchFrames - 1) * kSketchDims + d]);
+    CHECK(energy > 0.0, "last sketch frame of a short segment is empty");
+}
+
+static void testRetrieval() {
+    std::mt19937 rng(23);
+    std::vector<Recitation> recitations;
+    for (int i = 0; i < 300; i++) recitations.push_back(randomRecitation(rng));
+    ReferenceIndex index;
+    buildLibrary(recitations, rng, index);
+    index.build();
+    CHECK(index.size() == 300, "index holds %zu segments", index.size());
+    CHECK(!index.clustered(), "300 segments clustered");
+
+    IndexSearchOptions options;
+    std::vector<IndexMatch> matches;
+    IndexSearchStats stats;
+    int correct = 0;
+    size_t pruned = 0, aligned = 0;
+    for (int q = 0; q < 30; q++) {
+        size_t target = q * 10;
+        // Paced differently and noisier than the reference, as a student's take is
+        FeatureMatrix take = takeOf(recitations[target], 170, 1.15, 0.15, rng);
+
+        // The best match alone: its distance rules out nearly the whole shortlist
+        index.search(take, 1, options, matches, &stats);
+        CHECK(matches.size() == 1, "query %d: %zu matches", q, matches.size());
+        if (!matches.empty() && matches[0].id == "ref" + std::to_string(target)) correct++;
+        if (!matches.empty()) {
+            CHECK(matches[0].score > 0.0 && matches[0].score <= 100.0, "score %.2f", matches[0].score);
+            CHECK(fabs(matches[0].similarity * 100.0 - matches[0].score) < 1e-9, "score is not similarity x 100");
+        }
+        CHECK(stats.entries == 300 && stats.scanned == 300, "query %d scanned %zu of %zu", q, stats.scanned, stats.entries);
+        CHECK(stats.shortlisted == options.shortlist, "shortlist of %zu", stats.shortlisted);
+        CHECK(stats.aligned + stats.pruned == stats.shortlisted, "aligned %zu + pruned %zu != %zu",
+              stats.aligned, stats.pruned, stats.shortlisted);
+        pruned += stats.pruned;
+        aligned += stats.aligned;
+
+        // Top five, nearest first, led by the same match
+        std::vector<IndexMatch> top;
+        index.search(take, 5, options, top);
+        CHECK(top.size() == 5, "query %d: %zu of 5 matches", q, top.size());
+        for (size_t m = 1; m < top.size(); m++) {
+            CHECK(top[m].distance >= top[m - 1].distance, "query %d: matches out of order", q);
+        }
+        CHECK(!top.empty() && !matches.empty() && top[0].id == matches[0].id, "query %d: top 1 and top 5 disagree", q);
+    }
+    CHECK(correct == 30, "%d of 30 takes found their reference first", correct);
+    CHECK(pruned > 10 * aligned, "LB_Keogh pruned %zu, aligned %zu", pruned, aligned);
+
+    // Pruning never changes the answer: aligning the whole library agrees
+    IndexSearchOptions exhaustive;
+    exhaustive.shortlist = index.size();
+    FeatureMatrix take = takeOf(recitations[42], 160, 1.15, 0.15, rng);
+    std::vector<IndexMatch> all;
+    index.search(take, 3, exhaustive, all, &stats);
+    index.search(take, 3, options, matches);
+    CHECK(all.size() == 3 && all[0].id == "ref42", "exhaustive search missed ref42");
+    CHECK(!all.empty() && !matches.empty() && all[0].id == matches[0].id &&
+          all[0].distance == matches[0].distance, "shortlist changed the best match");
+
+    // Nothing to search, or nothing asked for
+    index.search(FeatureMatrix(), 5, options, matches, &stats);
+    CHECK(matches.empty(), "empty take matched");
+    index.search(take, 0, options, matches, &stats);
+    CHECK(matches.empty(), "k = 0 matched");
+}
+
+static void testSegments() {
+    // One bundle of three ayat; a take of the middle one finds that segment
+    std::mt19937 rng(31);
+    Recitation ayat[3] = {randomRecitation(rng), randomRecitation(rng), randomRecitation(rng)};
+    std::vector<float> rows;
+    BundleSegment segments[3];
+    double seconds = static_cast<double>(kHopSize) / kRate;
+    for (int s = 0; s < 3; s++) {
+        size_t first = rows.size() / kFeatureStride;
+        render(ayat[s], 120, 1.0, 0.0, rng, rows);
+        segments[s] = {first * seconds, (first + 120) * seconds, static_cast<uint32_t>(first), 120};
+    }
+    ReferenceIndex index;
+    CHECK(index.add("surah", rows.data(), rows.size() / kFeatureStride, segments, 3) == 3, "segments not added");
+
+    // Segments past the end of the frames are skipped
+    BundleSegment beyond = {0.0, 1.0, 300, 100};
+    CHECK(index.add("broken", rows.data(), rows.size() / kFeatureStride, &beyond, 1) == 0, "out-of-range segment added");
+
+    std::vector<IndexMatch> matches;
+    index.search(takeOf(ayat[1], 140, 1.1, 0.1, rng), 1, IndexSearchOptions(), matches);
+    CHECK(matches.size() == 1 && matches[0].id == "surah" && matches[0].segment == 1,
+          "take of ayah 2 matched %s/%zu", matches.empty() ? "-" : matches[0].id.c_str(),
+          matches.empty() ? 0 : matches[0].segment);
+    if (!matches.empty()) {
+        CHECK(fabs(matches[0].startTime - segments[1].startTime) < 1e-9 &&
+              fabs(matches[0].endTime - segments[1].endTime) < 1e-9, "segment times %.3f-%.3f",
+              matches[0].startTime, matches[0].endTime);
+    }
+
+    index.clear();
+    CHECK(index.size() == 0, "clear left %zu", index.size());
+}
+
+static void testClustered() {
+    std::mt19937 rng(47);
+    std::vector<Recitation> recitations;
+    for (int i = 0; i < 2000; i++) recitations.push_back(randomRecitation(rng));
+    ReferenceIndex index;
+    buildLibrary(recitations, rng, index);
+    index.build();
+    CHECK(index.clustered(), "2000 segments not clustered");
+
+    IndexSearchOptions options;
+    std::vector<IndexMatch> matches;
+    IndexSearchStats stats;
+    int correct = 0;
+    double slowest = 0.0;
+    for (int q = 0; q < 20; q++) {
+        size_t target = q * 97;
+        index.search(takeOf(recitations[target], 170, 1.15, 0.15, rng), 5, options, matches, &stats);
+        if (!matches.empty() && matches[0].id == "ref" + std::to_string(target)) correct++;
+        CHECK(stats.scanned < index.size() / 2, "clustered search scanned %zu of %zu", stats.scanned, index.size());
+        slowest = std::max(slowest, stats.searchMs);
+    }
+    CHECK(correct >= 19, "%d of 20 takes found their reference through the lists", correct);
+    // A few milliseconds on a phone; generous for loaded CI machines
+    CHECK(slowest < 50.0, "slowest search %.2f ms", slowest);
+
+    // Rebuilding gives the same lists
+    FeatureMatrix take = takeOf(recitations[500], 170, 1.0, 0.15, rng);
+    std::vector<IndexMatch> before;
+    index.search(take, 5, options, before);
+    index.build();
+    index.search(take, 5, options, matches);
+    CHECK(before.size() == matches.size(), "rebuild changed the match count");
+    for (size_t m = 0; m < before.size() && m < matches.size(); m++) {
+        CHECK(before[m].id == matches[m].id, "rebuild changed match %zu", m);
+    }
+
+    // Adding after a build drops the lists until the next one
+    std::vector<float> rows;
+    render(recitations[0], 100, 1.0, 0.0, rng, rows);
+    BundleSegment segment = {0.0, 1.0, 0, 100};
+    index.add("late", rows.data(), 100, &segment, 1);
+    CHECK(!index.clustered(), "lists kept after add");
+}
+
+int main() {
+    testLowerBound();
+    testSummaries();
+    testRetrieval();
+    testSegments();
+    testClustered();
+
+    if (failures == 0) printf("reference_index_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
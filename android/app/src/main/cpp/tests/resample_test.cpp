@@ -0,0 +1,134 @@
+// Tests for the polyphase resampler: passband accuracy, alias rejection at
+// each quality, streaming block invariance and ResampledSource.
+
+#include "resample.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Level of `actual - expected` relative to `expected`, in dB, away from the
+// edges where the filter sees the zero padding
+static double errorDb(const std::vector<double>& actual, const std::vector<double>& expected) {
+    size_t margin = actual.size() / 10;
+    double error = 0.0, signal = 0.0;
+    for (size_t i = margin; i + margin < actual.size() && i < expected.size(); i++) {
+        error += (actual[i] - expected[i]) * (actual[i] - expected[i]);
+        signal += expected[i] * expected[i];
+    }
+    return 10.0 * log10(error / signal + 1e-30);
+}
+
+static double levelDb(const std::vector<double>& samples, double reference) {
+    size_t margin = samples.size() / 10;
+    double sum = 0.0;
+    size_t count = 0;
+    for (size_t i = margin; i + margin < samples.size(); i++, count++) sum += samples[i] * samples[i];
+    return 10.0 * log10(sqrt(sum / count) / reference + 1e-30) * 2.0;
+}
+
+// In-band tones come through at the same amplitude and phase: no delay
+static void testPassband() {
+    struct Case { int from; int to; double hz; double maxDb; };
+    const Case cases[] = {
+        {44100, 16000, 1000.0, -70.0},
+        {48000, 16000, 3000.0, -70.0},
+        {8000, 16000, 1000.0, -70.0},
+        {22050, 16000, 6500.0, -60.0},
+        {44099, 16000, 1000.0, -50.0},   // coprime rates: quantized phases
+    };
+    for (const Case& c : cases) {
+        std::vector<double> output = resampleAudio(tone(c.hz, c.from, 1.0), c.from, c.to);
+        std::vector<double> expected = tone(c.hz, c.to, 1.0);
+        CHECK(output.size() == expected.size(), "%d->%d: %zu samples, expected %zu", c.from, c.to,
+              output.size(), expected.size());
+        double error = errorDb(output, expected);
+        CHECK(error < c.maxDb, "%d->%d at %.0f Hz: error %.1f dB", c.from, c.to, c.hz, error);
+    }
+}
+
+// Tones above the output Nyquist must not fold back into the band
+static void testAliasRejection() {
+    struct Case { ResampleQuality quality; double maxDb; };
+    const Case cases[] = {
+        {ResampleQuality::Fast, -55.0},
+        {ResampleQuality::Balanced, -80.0},
+        {ResampleQuality::Best, -95.0},
+    };
+    for (const Case& c : cases) {
+        for (double hz : {8200.0, 9000.0, 12000.0, 20000.0}) {
+            std::vector<double> output = resampleAudio(tone(hz, 44100, 1.0), 44100, 16000, c.quality);
+            double level = levelDb(output, 0.5 / sqrt(2.0));
+            CHECK(level < c.maxDb, "quality %d: %.0f Hz aliased at %.1f dB", static_cast<int>(c.quality), hz, level);
+        }
+    }
+
+    // The passband edge of each quality is kept
+    std::vector<double> edge = resampleAudio(tone(7000.0, 44100, 1.0), 44100, 16000, ResampleQuality::Balanced);
+    double level = levelDb(edge, 0.5 / sqrt(2.0));
+    CHECK(fabs(level) < 0.1, "7 kHz came through at %.2f dB", level);
+}
+
+// Any split of the input into process() calls gives the same output
+static void testStreaming() {
+    std::vector<double> input = tone(440.0, 44100, 0.5);
+    for (size_t i = 0; i < input.size(); i++) input[i] += 0.2 * sin(2.0 * M_PI * 3100.0 * i / 44100);
+    std::vector<double> whole = resampleAudio(input, 44100, 16000);
+
+    PolyphaseResampler resampler;
+    CHECK(resampler.configure(44100, 16000), "configure failed");
+    CHECK(resampler.numPhases() == 160, "%zu phases", resampler.numPhases());
+    std::vector<double> split;
+    std::vector<double> block(resampler.maxOutput(5000) + resampler.flushSize());
+    size_t sizes[] = {1, 7, 333, 5000, 100};
+    size_t position = 0;
+    for (size_t k = 0; position < input.size(); k++) {
+        size_t count = std::min(sizes[k % 5], input.size() - position);
+        size_t written = resampler.process(input.data() + position, count, block.data());
+        CHECK(written <= resampler.maxOutput(count), "%zu outputs for %zu inputs", written, count);
+        split.insert(split.end(), block.begin(), block.begin() + written);
+        position += count;
+    }
+    size_t written = resampler.flush(block.data());
+    split.insert(split.end(), block.begin(), block.begin() + written);
+
+    CHECK(split.size() == whole.size(), "split gave %zu samples, whole %zu", split.size(), whole.size());
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < std::min(split.size(), whole.size()); i++) maxDiff = std::max(maxDiff, fabs(split[i] - whole[i]));
+    CHECK(maxDiff == 0.0, "block split changed output by %.3e", maxDiff);
+}
+
+static void testResampledSource() {
+    std::vector<double> input = tone(500.0, 48000, 2.0);
+    BufferSource source(input, 48000);
+    ResampledSource resampled;
+    resampled.process(source, 16000);
+    CHECK(resampled.sampleRate() == 16000, "rate %d", resampled.sampleRate());
+    CHECK(resampled.frameCount() == 32000, "%zu frames", resampled.frameCount());
+    CHECK(fabs(resampled.duration() - source.duration()) < 1e-9, "duration %.6f", resampled.duration());
+
+    std::vector<double> out(resampled.frameCount());
+    CHECK(resampled.read(0, out.size(), out.data()) == out.size(), "short read");
+    CHECK(errorDb(out, tone(500.0, 16000, 2.0)) < -70.0, "source output differs from the tone");
+
+    // Reuse at the same rates does not reallocate
+    AllocationStats before = resampled.stats();
+    resampled.process(source, 16000);
+    CHECK(resampled.stats().allocations == before.allocations, "second pass allocated");
+
+    std::vector<double> empty;
+    resampled.process(BufferSource(empty, 0), 16000);
+    CHECK(resampled.frameCount() == 0, "invalid input produced %zu frames", resampled.frameCount());
+}
+
+int main() {
+    testPassband();
+    testAliasRejection();
+    testStreaming();
+    testResampledSource();
+
+    if (failures == 0) printf("resample_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
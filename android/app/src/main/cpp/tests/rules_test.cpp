@@ -0,0 +1,282 @@
+// Tests for the rule engine: Madd, Ghunna and Qalqalah findings on
+// synthetic recitations, rule selection, VAD time mapping and registering
+// a new detector.
+
+#include "audio_analysis.h"
+#include "rules.h"
+#include "test_util.h"
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// Glottal pulses through four resonators at `formants`, scaled to `peak`
+static void appendVowel(std::vector<double>& out, double seconds, const double* formants, double peak) {
+    const double bandwidths[4] = {80.0, 100.0, 120.0, 150.0};
+    std::vector<double> samples(static_cast<size_t>(seconds * kRate));
+    double state[4][2] = {};
+    double phase = 0.0, glottal = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        phase += 120.0 / kRate;
+        double x = 0.0;
+        if (phase >= 1.0) {
+            phase -= 1.0;
+            x = 1.0;
+        }
+        glottal = x + 0.97 * glottal;
+        x = glottal;
+        for (int k = 0; k < 4; k++) {
+            double r = exp(-M_PI * bandwidths[k] / kRate);
+            double theta = 2.0 * M_PI * formants[k] / kRate;
+            double y = (1.0 - r) * x + 2.0 * r * cos(theta) * state[k][0] - r * r * state[k][1];
+            state[k][1] = state[k][0];
+            state[k][0] = y;
+            x = y;
+        }
+        samples[i] = x;
+    }
+    double max = 0.0;
+    for (double s : samples) max = std::max(max, fabs(s));
+    for (double s : samples) out.push_back(s * peak / max);
+}
+
+static void appendSilence(std::vector<double>& out, double seconds) {
+    out.insert(out.end(), static_cast<size_t>(seconds * kRate), 0.0);
+}
+
+static const double kVowelA[4] = {730.0, 1090.0, 2440.0, 3400.0};
+static const double kNasal[4] = {250.0, 1100.0, 2300.0, 3300.0};
+
+static AudioFeatures extract(const std::vector<double>& samples, bool vad, FeatureWorkspace& workspace) {
+    workspace.vad.enabled = vad;
+    AudioFeatures features;
+    extractFeatures(BufferSource(samples, kRate), workspace, features);
+    return features;
+}
+
+static const RuleEvent* firstEvent(const RuleReport& report, const char* name) {
+    int rule = findRule(name);
+    for (const RuleEvent& event : report.events) {
+        if (static_cast<int>(event.rule) == rule) return &event;
+    }
+    return nullptr;
+}
+
+// Short vowels set the count; a vowel held four times as long is a Madd of 4
+static void testMadd() {
+    std::vector<double> samples;
+    appendSilence(samples, 0.3);
+    for (int i = 0; i < 5; i++) {
+        appendVowel(samples, 0.2, kVowelA, 0.5);
+        appendSilence(samples, 0.15);
+    }
+    appendVowel(samples, 0.8, kVowelA, 0.5);
+    appendSilence(samples, 0.3);
+
+    FeatureWorkspace workspace;
+    AudioFeatures features = extract(samples, false, workspace);
+    RuleEngine engine;
+    RuleReport report;
+    engine.run(features.frames, ruleBit(findRule("madd")), report);
+
+    CHECK(fabs(report.harakaSeconds - 0.2) < 0.05, "count estimated at %.3f s", report.harakaSeconds);
+    const RuleResult* result = report.result(findRule("madd"));
+    CHECK(result && result->detections == 1, "%zu Madd findings", result ? result->detections : 0);
+    const RuleEvent* madd = firstEvent(report, "madd");
+    CHECK(madd != nullptr, "no Madd event");
+    if (madd) {
+        double start = 0.3 + 5 * 0.35;
+        CHECK(fabs(madd->startTime - start) < 0.05 && fabs(madd->endTime - (start + 0.8)) < 0.06,
+              "Madd at %.2f-%.2f s, expected %.2f-%.2f", madd->startTime, madd->endTime, start, start + 0.8);
+        CHECK(madd->expected == 4.0 && !madd->violation, "measured %.2f counts vs %.0f", madd->measured, madd->expected);
+        CHECK(madd->message.find("Madd") == 0 && madd->message.find("counts") != std::string::npos,
+              "message '%s'", madd->message.c_str());
+    }
+
+    // Asking for 2 counts turns the same vowel into a violation
+    engine.options.maddCounts = 2.0;
+    engine.run(features.frames, ruleBit(findRule("madd")), report);
+    madd = firstEvent(report, "madd");
+    CHECK(madd && madd->violation && madd->score < 50.0, "overlong Madd not flagged");
+    CHECK(!detectMadd(features.frames, 2.0) && detectMadd(features.frames, 4.0), "detectMadd disagrees with the engine");
+}
+
+// With VAD on, frames skip the silences; event times still point into the recording
+static void testTimeline() {
+    std::vector<double> samples;
+    appendSilence(samples, 1.0);
+    appendVowel(samples, 0.2, kVowelA, 0.5);
+    appendSilence(samples, 1.0);
+    appendVowel(samples, 0.8, kVowelA, 0.5);
+    appendSilence(samples, 0.5);
+
+    FeatureWorkspace workspace;
+    AudioFeatures features = extract(samples, true, workspace);
+    CHECK(workspace.timeline() != nullptr, "VAD did not trim the take");
+    CHECK(features.frames.numFrames() * features.frames.frameSeconds() < 1.6, "%zu frames after trimming",
+          features.frames.numFrames());
+
+    RuleEngine engine;
+    engine.options.harakaSeconds = 0.2;
+    RuleReport report;
+    engine.run(features.frames, ruleBit(findRule("madd")), report, nullptr, workspace.timeline());
+    const RuleEvent* madd = firstEvent(report, "madd");
+    CHECK(madd && fabs(madd->startTime - 2.2) < 0.05 && fabs(madd->endTime - 3.0) < 0.06,
+          "Madd mapped to %.2f-%.2f s, expected 2.20-3.00", madd ? madd->startTime : 0.0, madd ? madd->endTime : 0.0);
+
+    // Re-extraction without VAD drops the timeline
+    extract(samples, false, workspace);
+    CHECK(workspace.timeline() == nullptr, "stale timeline after extraction without VAD");
+}
+
+// A quiet, dark murmur between vowels, two counts long
+static void testGhunna() {
+    std::vector<double> samples;
+    appendSilence(samples, 0.2);
+    appendVowel(samples, 0.2, kVowelA, 0.5);
+    appendVowel(samples, 0.4, kNasal, 0.12);
+    appendVowel(samples, 0.2, kVowelA, 0.5);
+    appendSilence(samples, 0.2);
+
+    FeatureWorkspace workspace;
+    AudioFeatures features = extract(samples, false, workspace);
+    RuleEngine engine;
+    engine.options.harakaSeconds = 0.2;
+    RuleReport report;
+    engine.run(features.frames, ruleBit(findRule("ghunna")), report);
+    const RuleEvent* ghunna = firstEvent(report, "ghunna");
+    CHECK(ghunna && ghunna->startTime > 0.3 && ghunna->endTime < 0.9 && ghunna->measured > 1.5 && !ghunna->violation,
+          "Ghunna %.2f-%.2f s, %.2f counts", ghunna ? ghunna->startTime : 0.0, ghunna ? ghunna->endTime : 0.0,
+          ghunna ? ghunna->measured : 0.0);
+    CHECK(report.events.size() == 1, "%zu Ghunna findings", report.events.size());
+}
+
+// A stop released into silence bounces; the same release into a vowel does not
+static void testQalqalah() {
+    std::vector<double> samples;
+    appendSilence(samples, 0.1);
+    appendVowel(samples, 0.3, kVowelA, 0.5);
+    appendSilence(samples, 0.08);
+    size_t burst = samples.size();
+    unsigned seed = 3;
+    for (size_t i = 0; i < static_cast<size_t>(0.03 * kRate); i++) {
+        seed = seed * 1103515245u + 12345u;
+        double noise = static_cast<double>((seed >> 8) & 0xffff) / 32768.0 - 1.0;
+        samples.push_back(0.4 * noise * exp(-static_cast<double>(i) / (0.008 * kRate)));
+    }
+    appendSilence(samples, 0.3);
+    appendVowel(samples, 0.3, kVowelA, 0.5);
+    appendSilence(samples, 0.2);
+
+    FeatureWorkspace workspace;
+    AudioFeatures features = extract(samples, false, workspace);
+    RuleEngine engine;
+    RuleReport report;
+    engine.run(features.frames, ruleBit(findRule("qalqalah")), report);
+    CHECK(report.events.size() == 1, "%zu Qalqalah findings", report.events.size());
+    const RuleEvent* qalqalah = firstEvent(report, "qalqalah");
+    double at = static_cast<double>(burst) / kRate;
+    CHECK(qalqalah && qalqalah->startTime < at && qalqalah->endTime > at && qalqalah->endTime < at + 0.15,
+          "Qalqalah %.2f-%.2f s around %.2f", qalqalah ? qalqalah->startTime : 0.0,
+          qalqalah ? qalqalah->endTime : 0.0, at);
+    CHECK(qalqalah && qalqalah->measured >= 12.0 && !qalqalah->violation, "burst rose %.1f dB",
+          qalqalah ? qalqalah->measured : 0.0);
+}
+
+// Counts the frames it is shown
+class FrameCounter : public RuleDetector {
+public:
+    static size_t frames;  // seen in the last pass
+    static size_t passes;
+    void begin(const RuleContext&) override {
+        seen_ = 0;
+        passes++;
+    }
+    void frame(const RuleFrame& frame) override {
+        CHECK(frame.index == seen_, "frame %zu out of order", frame.index);
+        seen_++;
+    }
+    void finish(const RuleContext&, RuleEmitter& emitter) override {
+        frames = seen_;
+        emitter.emit(0, seen_, static_cast<double>(seen_), 0.0, 100.0, false);
+    }
+
+private:
+    size_t seen_ = 0;
+};
+size_t FrameCounter::frames = 0;
+size_t FrameCounter::passes = 0;
+
+static std::unique_ptr<RuleDetector> makeFrameCounter() {
+    return std::unique_ptr<RuleDetector>(new FrameCounter());
+}
+
+// Only requested rules run; a registered rule joins the same pass
+static void testSelection() {
+    size_t counter = registerRule({"frames", "Frames", "frames", 0, false, "", "", makeFrameCounter});
+    CHECK(findRule("frames") == static_cast<int>(counter) && findRule("idgham") == -1, "registry lookup");
+
+    std::vector<double> samples;
+    appendVowel(samples, 0.5, kVowelA, 0.5);
+    FeatureWorkspace workspace;
+    AudioFeatures features = extract(samples, false, workspace);
+
+    RuleEngine engine;
+    RuleReport report;
+    engine.run(features.frames, ruleBit(findRule("qalqalah")) | ruleBit(findRule("makharij")), report);
+    CHECK(report.results.size() == 2, "%zu results for two rules", report.results.size());
+    const RuleResult* makharij = report.result(findRule("makharij"));
+    CHECK(makharij && !makharij->evaluated, "Makharij ran without a reference");
+    CHECK(FrameCounter::passes == 0, "unrequested rule ran");
+
+    engine.run(features.frames, ruleBit(counter) | ruleBit(findRule("madd")), report, &features.frames);
+    CHECK(FrameCounter::passes == 1 && FrameCounter::frames == features.frames.numFrames(),
+          "counter saw %zu of %zu frames in %zu passes", FrameCounter::frames, features.frames.numFrames(),
+          FrameCounter::passes);
+    const RuleResult* frames = report.result(counter);
+    CHECK(frames && frames->detections == 1 && frames->score == 100.0, "registered rule's result missing");
+}
+
+// The whole analysis: a take against itself meets every rule it finds
+static void testAnalysis() {
+    std::vector<double> samples;
+    appendSilence(samples, 0.2);
+    for (int i = 0; i < 3; i++) {
+        appendVowel(samples, 0.2, kVowelA, 0.5);
+        appendSilence(samples, 0.15);
+    }
+    appendVowel(samples, 0.4, kVowelA, 0.5);
+    appendSilence(samples, 0.2);
+
+    FeatureWorkspace workspace;
+    AudioFeatures features = extract(samples, false, workspace);
+    TajweedAnalysis analysis = analyzeTajweedRules(features, features);
+    for (const char* name : {"madd", "makharij", "ghunna", "qalqalah"}) {
+        CHECK(analysis.ruleScores.count(name) == 1, "no %s score", name);
+    }
+    CHECK(analysis.ruleScores["makharij"] == 100.0, "Makharij against itself scored %.1f", analysis.ruleScores["makharij"]);
+    CHECK(analysis.ruleScores["ghunna"] == 100.0, "absent Ghunna scored %.1f", analysis.ruleScores["ghunna"]);
+    CHECK(analysis.overallScore > 50.0, "overall %.1f", analysis.overallScore);
+
+    // Silence against the take: the held vowel the reference has is missing
+    std::vector<double> quiet(samples.size(), 0.0);
+    FeatureWorkspace quietWorkspace;
+    AudioFeatures silent = extract(quiet, false, quietWorkspace);
+    analysis = analyzeTajweedRules(silent, features);
+    CHECK(analysis.ruleScores["madd"] == 0.0 && !analysis.errors.empty(), "missing Madd not reported");
+}
+
+int main() {
+    testMadd();
+    testTimeline();
+    testGhunna();
+    testQalqalah();
+    testSelection();
+    testAnalysis();
+
+    if (failures == 0) printf("rules_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,294 @@
+// Tests for streaming extraction: the SPSC ring, the incremental DTW, and
+// a StreamingAnalyzer fed by a synthetic recording thread.
+
+#include "audio_analysis.h"
+#include "ring_buffer.h"
+#include "streaming.h"
+#include "test_util.h"
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// Harmonic syllables at `pitch` Hz over quiet noise; every sample is a float,
+// so the ring carries it exactly
+static std::vector<double> recitation(double seconds, double pitch, int rate = kRate,
+                                      const std::vector<std::pair<double, double>>& voiced = {{0.3, 1.1}, {1.4, 2.6}}) {
+    std::mt19937 rng(5);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    std::vector<double> samples(static_cast<size_t>(seconds * rate));
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = noise(rng);
+    for (const auto& span : voiced) {
+        // Pitch drifts by 5% so frames differ along the syllable
+        double phase = 0.0;
+        size_t end = std::min(samples.size(), static_cast<size_t>(span.second * rate));
+        for (size_t i = static_cast<size_t>(span.first * rate); i < end; i++) {
+            double t = static_cast<double>(i) / rate;
+            phase += 2.0 * M_PI * pitch * (1.0 + 0.05 * sin(2.0 * M_PI * 1.5 * t)) / rate;
+            double voice = 0.0;
+            for (int h = 1; h <= 6; h++) voice += sin(h * phase) / h;
+            samples[i] += 0.2 * voice;
+        }
+    }
+    for (double& sample : samples) sample = static_cast<float>(sample);
+    return samples;
+}
+
+// Features the batch path gives for the same samples, with VAD off as streaming has it
+static void batchFeatures(const std::vector<double>& samples, int rate, bool resample, AudioFeatures& features) {
+    FeatureWorkspace workspace;
+    workspace.resample.enabled = resample;
+    extractFeatures(BufferSource(samples, rate), workspace, features);
+}
+
+// Plays `samples` into the analyzer from a producer thread in uneven chunks
+// while the calling thread analyzes, then finishes the take
+static double streamTake(StreamingAnalyzer& analyzer, const std::vector<double>& samples, bool paced = false) {
+    std::atomic<bool> done{false};
+    std::thread recorder([&] {
+        std::mt19937 rng(9);
+        std::uniform_int_distribution<size_t> sizes(64, 700);
+        std::vector<float> chunk;
+        for (size_t position = 0; position < samples.size();) {
+            size_t n = std::min(sizes(rng), samples.size() - position);
+            chunk.assign(samples.begin() + position, samples.begin() + position + n);
+            size_t queued = 0;
+            while (queued < n) {
+                // A real callback would drop; the test waits so every sample arrives
+                queued += analyzer.push(chunk.data() + queued, n - queued);
+                if (queued < n) std::this_thread::yield();
+            }
+            position += n;
+            if (paced) std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+        done = true;
+    });
+    while (!done) {
+        if (analyzer.process() == 0) std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    recorder.join();
+
+    auto start = std::chrono::steady_clock::now();
+    analyzer.finish();
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void testRing() {
+    SpscRing<float> ring(1000);
+    CHECK(ring.capacity() == 1024, "capacity %zu", ring.capacity());
+
+    std::vector<float> data(1500, 1.0f);
+    CHECK(ring.write(data.data(), data.size()) == 1024, "overfilled ring");
+    CHECK(ring.write(data.data(), 1) == 0, "wrote to a full ring");
+    std::vector<float> out(600);
+    CHECK(ring.read(out.data(), 600) == 600 && ring.size() == 424, "partial read left %zu", ring.size());
+    ring.clear();
+    CHECK(ring.size() == 0, "%zu left after clear", ring.size());
+
+    // One producer and one consumer moving a counter through many wraps
+    const size_t total = 300000;
+    SpscRing<float> small(256);
+    std::thread producer([&] {
+        float block[97];
+        size_t next = 0;
+        while (next < total) {
+            size_t n = std::min<size_t>(97, total - next);
+            for (size_t i = 0; i < n; i++) block[i] = static_cast<float>((next + i) % 4096);
+            size_t written = 0;
+            while (written < n) {
+                size_t w = small.write(block + written, n - written);
+                if (w == 0) std::this_thread::yield();
+                written += w;
+            }
+            next += n;
+        }
+    });
+    size_t received = 0, wrong = 0;
+    float block[61];
+    while (received < total) {
+        size_t n = small.read(block, 61);
+        if (n == 0) std::this_thread::yield();
+        for (size_t i = 0; i < n; i++) {
+            if (block[i] != static_cast<float>((received + i) % 4096)) wrong++;
+        }
+        received += n;
+    }
+    producer.join();
+    CHECK(wrong == 0, "%zu samples out of order", wrong);
+}
+
+static void testIncrementalDtw() {
+    std::mt19937 rng(2);
+    std::normal_distribution<float> value(0.0f, 1.0f);
+    const size_t dims = 6, stride = 8;
+    for (size_t n : {1, 7, 40, 90}) {
+        size_t m = 50;
+        std::vector<float> a(n * stride), b(m * stride);
+        for (float& x : a) x = value(rng);
+        for (float& x : b) x = value(rng);
+
+        IncrementalDTW dtw;
+        dtw.reset(b.data(), m, dims, stride);
+        for (size_t i = 0; i < n; i++) dtw.push(a.data() + i * stride);
+        DTWAlignment streamed;
+        dtw.finish(streamed);
+        DTWAlignment batch = dtwAlign(a.data(), n, b.data(), m, dims, stride, DTWOptions());
+
+        CHECK(fabs(streamed.distance - batch.distance) < 1e-6 * batch.distance, "n=%zu: distance %.6f vs %.6f",
+              n, streamed.distance, batch.distance);
+        CHECK(streamed.frames1.size() == streamed.costs.size() && streamed.frames1.front() == 0 &&
+              streamed.frames2.back() == m - 1, "n=%zu: path does not span the grid", n);
+        if (n >= m) {
+            CHECK(streamed.frames1 == batch.frames1 && streamed.frames2 == batch.frames2, "n=%zu: paths differ", n);
+        }
+
+        // Past its cap the grid drops the path but keeps the running alignment
+        IncrementalDTW capped;
+        capped.reset(b.data(), m, dims, stride, FrameMetric::Euclidean, 20 * m);
+        for (size_t i = 0; i < n; i++) capped.push(a.data() + i * stride);
+        DTWAlignment partial;
+        bool complete = capped.finish(partial);
+        CHECK(complete == (n <= 20) && capped.hasPath() == complete, "n=%zu: path kept past the cap", n);
+        CHECK(partial.distance == streamed.distance && capped.position() == dtw.position() &&
+                  capped.meanCost() == dtw.meanCost(),
+              "n=%zu: capped alignment differs", n);
+        CHECK(complete ? partial.frames1 == streamed.frames1 : partial.frames1.empty(), "n=%zu: capped path", n);
+    }
+}
+
+// Streamed rows equal the batch rows however the take was chunked
+static void testMatchesBatch() {
+    std::vector<double> samples = recitation(3.0, 180.0);
+    AudioFeatures batch;
+    batchFeatures(samples, kRate, false, batch);
+
+    StreamingAnalyzer analyzer(kRate);
+    size_t callbacks = 0;
+    analyzer.setFrameCallback([&](const StreamFrame&) { callbacks++; });
+    streamTake(analyzer, samples);
+
+    const FeatureMatrix& streamed = analyzer.features().frames;
+    CHECK(streamed.numFrames() == batch.frames.numFrames() && callbacks == streamed.numFrames(),
+          "%zu frames (%zu callbacks) vs %zu", streamed.numFrames(), callbacks, batch.frames.numFrames());
+    double worst = 0.0;
+    for (size_t f = 0; f < std::min(streamed.numFrames(), batch.frames.numFrames()); f++) {
+        for (size_t c = 0; c < kFeatureColumns; c++) {
+            worst = std::max(worst, static_cast<double>(fabs(streamed.row(f)[c] - batch.frames.row(f)[c])));
+        }
+    }
+    CHECK(worst < 1e-4, "rows differ by up to %g", worst);
+    CHECK(fabs(analyzer.features().duration - 3.0) < 1e-9, "duration %.3f", analyzer.features().duration);
+    CHECK(analyzer.status().finished && analyzer.status().dropped == 0, "status after finish");
+
+    // A 48 kHz take is converted on the fly to the analysis rate
+    std::vector<double> high = recitation(3.0, 180.0, 48000);
+    AudioFeatures resampled;
+    batchFeatures(high, 48000, true, resampled);
+    StreamingAnalyzer converter(48000);
+    streamTake(converter, high);
+    const FeatureMatrix& converted = converter.features().frames;
+    CHECK(converter.analysisRate() == kRate && converted.sampleRate() == kRate, "analysis rate %d",
+          converter.analysisRate());
+    CHECK(converted.numFrames() == resampled.frames.numFrames(), "%zu resampled frames vs %zu",
+          converted.numFrames(), resampled.frames.numFrames());
+    size_t pitchMismatches = 0;
+    for (size_t f = 0; f < std::min(converted.numFrames(), resampled.frames.numFrames()); f++) {
+        if (fabs(converted.at(f, FeatureColumns::Pitch) - resampled.frames.at(f, FeatureColumns::Pitch)) > 1.0) {
+            pitchMismatches++;
+        }
+    }
+    CHECK(pitchMismatches <= 2, "%zu frames with a different pitch", pitchMismatches);
+}
+
+// Live frames carry pitch and the running vowel length; the running DTW
+// follows the reference and scores the matching take higher
+static void testLiveFeedback() {
+    std::vector<double> reference = recitation(3.0, 180.0);
+    AudioFeatures referenceFeatures;
+    batchFeatures(reference, kRate, false, referenceFeatures);
+
+    StreamingAnalyzer analyzer(kRate);
+    analyzer.setReference(referenceFeatures);
+    double longestCounts = 0.0, lastReferenceTime = 0.0, voicedPitch = 0.0;
+    size_t backwards = 0;
+    analyzer.setFrameCallback([&](const StreamFrame& frame) {
+        longestCounts = std::max(longestCounts, frame.counts);
+        // Once the running statistics have seen a syllable the position only moves forward
+        if (frame.time > 0.6 && frame.referenceTime + 0.2 < lastReferenceTime) backwards++;
+        lastReferenceTime = frame.referenceTime;
+        if (frame.time > 0.6 && frame.time < 0.7 && frame.voiced) voicedPitch = frame.pitch;
+    });
+    double finishMs = streamTake(analyzer, recitation(3.0, 180.0), true);
+
+    // The second syllable holds its vowel for 1.2 s, six counts of 0.2 s
+    CHECK(longestCounts > 5.5 && longestCounts < 6.5, "longest vowel %.2f counts", longestCounts);
+    CHECK(fabs(voicedPitch - 180.0) < 15.0, "live pitch %.1f Hz", voicedPitch);
+    CHECK(backwards == 0 && lastReferenceTime > 2.5, "reference position ended at %.2f s, %zu jumps back",
+          lastReferenceTime, backwards);
+
+    double same = analyzer.comparison().similarity;
+    CHECK(analyzer.comparison().alignment.size() == analyzer.features().frames.numFrames(), "alignment has %zu frames",
+          analyzer.comparison().alignment.size());
+
+    // The running path, costed on the finished features, scores close to a
+    // fresh alignment of them
+    ComparisonResult batch = performDTW(analyzer.features(), referenceFeatures);
+    CHECK(fabs(same - batch.similarity) < 0.1 * batch.similarity, "streamed similarity %.6f, performDTW %.6f", same,
+          batch.similarity);
+
+    // A take past the path cap is aligned again from its features
+    StreamingOptions capped;
+    capped.maxPathCells = 1000;
+    StreamingAnalyzer realigned(kRate, capped);
+    realigned.setReference(referenceFeatures);
+    streamTake(realigned, recitation(3.0, 180.0));
+    ComparisonResult fresh = performDTW(realigned.features(), referenceFeatures);
+    CHECK(realigned.comparison().similarity == fresh.similarity && !realigned.comparison().alignment.empty(),
+          "capped take: similarity %.6f, performDTW %.6f", realigned.comparison().similarity, fresh.similarity);
+    CHECK(finishMs < 50.0, "finish took %.2f ms", finishMs);
+
+    // A take in another place and at another pitch aligns worse
+    analyzer.setFrameCallback(StreamFrameCallback());
+    analyzer.reset();
+    streamTake(analyzer, recitation(3.0, 260.0, kRate, {{0.2, 0.5}, {0.9, 1.2}, {1.8, 2.9}}));
+    double other = analyzer.comparison().similarity;
+    CHECK(same > other, "matching take %.3f vs other take %.3f", same, other);
+}
+
+// A callback that outruns the analysis loses samples instead of blocking
+static void testOverflow() {
+    StreamingOptions options;
+    options.ringCapacity = 4096;
+    StreamingAnalyzer analyzer(kRate, options);
+    std::vector<int16_t> pcm(10000, 1000);
+    size_t queued = analyzer.push(pcm.data(), pcm.size());
+    CHECK(queued == 4096 && analyzer.status().dropped == pcm.size() - 4096, "queued %zu, dropped %zu", queued,
+          analyzer.status().dropped);
+    CHECK(analyzer.process() == stftFrameCount(4096, kFrameSize, kHopSize), "frames from a full ring");
+
+    bool threw = false;
+    try {
+        StreamingAnalyzer invalid(0);
+    } catch (const std::invalid_argument&) {
+        threw = true;
+    }
+    CHECK(threw, "accepted a zero sample rate");
+}
+
+int main() {
+    testRing();
+    testIncrementalDtw();
+    testMatchesBatch();
+    testLiveFeedback();
+    testOverflow();
+
+    if (failures == 0) printf("streaming_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,94 @@
+// Shared by the test executables: the CHECK macro and failure count each
+// test's main() reports, and the signals and fixtures several tests build.
+
+#ifndef TAJWEED_TEST_UTIL_H
+#define TAJWEED_TEST_UTIL_H
+
+#include "audio_features.h"
+#include "resample.h"
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+static int failures = 0;
+
+#define CHECK(cond, ...)                                   \
+    do {                                                   \
+        if (!(cond)) {                                     \
+            fprintf(stderr, "FAIL %s:%d: ", __FILE__, __LINE__); \
+            fprintf(stderr, __VA_ARGS__);                  \
+            fprintf(stderr, "\n");                         \
+            failures++;                                    \
+        }                                                  \
+    } while (0)
+
+// `harmonics` partials of hz with 1/h amplitudes, scaled by `amplitude`
+inline std::vector<double> tone(double hz, int rate, double seconds, double amplitude = 0.5, int harmonics = 1) {
+    std::vector<double> samples(static_cast<size_t>(seconds * rate));
+    for (size_t i = 0; i < samples.size(); i++) {
+        double t = static_cast<double>(i) / rate;
+        double value = 0.0;
+        for (int h = 1; h <= harmonics; h++) value += sin(2.0 * M_PI * hz * h * t) / h;
+        samples[i] = amplitude * value;
+    }
+    return samples;
+}
+
+// Random feature rows at the analysis rate
+inline AudioFeatures makeFeatures(size_t frames, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<float> dist(0.0f, 1.0f);
+    AudioFeatures features = {};
+    features.frames.reset(frames, TajweedAudio::kAnalysisSampleRate);
+    for (size_t i = 0; i < frames * TajweedAudio::kFeatureStride; i++) features.frames.data()[i] = dist(rng);
+    features.duration = features.frames.frameTime(frames);
+    features.sampleRate = TajweedAudio::kAnalysisSampleRate;
+    features.channels = 2;
+    return features;
+}
+
+// 16-bit mono 16 kHz recitation: a wavering harmonic tone at `pitch` Hz
+// between short silences
+inline bool writeWav(const std::string& path, double seconds, double pitch, unsigned seed) {
+    const int rate = 16000;
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    std::vector<int16_t> samples(static_cast<size_t>(seconds * rate));
+    double phase = 0.0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        double t = static_cast<double>(i) / rate;
+        double value = noise(rng);
+        if (t > 0.2 && t < seconds - 0.2) {
+            phase += 2.0 * M_PI * pitch * (1.0 + 0.05 * sin(2.0 * M_PI * 1.5 * t)) / rate;
+            for (int h = 1; h <= 6; h++) value += 0.2 * sin(h * phase) / h;
+        }
+        samples[i] = static_cast<int16_t>(std::max(-1.0, std::min(1.0, value)) * 32767.0);
+    }
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return false;
+    uint32_t dataBytes = static_cast<uint32_t>(samples.size() * sizeof(int16_t));
+    uint32_t riffBytes = 36 + dataBytes, fmtBytes = 16, byteRate = rate * 2, sampleRate = rate;
+    uint16_t format = 1, channels = 1, blockAlign = 2, bits = 16;
+    fwrite("RIFF", 1, 4, file);
+    fwrite(&riffBytes, 4, 1, file);
+    fwrite("WAVEfmt ", 1, 8, file);
+    fwrite(&fmtBytes, 4, 1, file);
+    fwrite(&format, 2, 1, file);
+    fwrite(&channels, 2, 1, file);
+    fwrite(&sampleRate, 4, 1, file);
+    fwrite(&byteRate, 4, 1, file);
+    fwrite(&blockAlign, 2, 1, file);
+    fwrite(&bits, 2, 1, file);
+    fwrite("data", 1, 4, file);
+    fwrite(&dataBytes, 4, 1, file);
+    bool ok = fwrite(samples.data(), sizeof(int16_t), samples.size(), file) == samples.size();
+    return fclose(file) == 0 && ok;
+}
+
+#endif // TAJWEED_TEST_UTIL_H
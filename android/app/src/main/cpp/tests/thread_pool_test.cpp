@@ -0,0 +1,96 @@
+// Tests for the work-stealing ThreadPool, TaskGroup and parallelFor.
+
+#include "test_util.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <vector>
+
+using TajweedAudio::TaskGroup;
+using TajweedAudio::ThreadPool;
+using TajweedAudio::parallelFor;
+
+// Every index is visited exactly once, including a short final block
+static void testCoverage(ThreadPool& pool) {
+    for (size_t count : {0, 1, 63, 64, 65, 1000}) {
+        std::vector<std::atomic<int>> visits(count);
+        for (auto& v : visits) v = 0;
+
+        parallelFor(pool, count, 64, [&](size_t begin, size_t end) {
+            CHECK(begin < end && end <= count, "bad block [%zu, %zu) of %zu", begin, end, count);
+            CHECK(begin % 64 == 0, "block starts at %zu", begin);
+            for (size_t i = begin; i < end; i++) visits[i]++;
+        });
+
+        for (size_t i = 0; i < count; i++) {
+            CHECK(visits[i] == 1, "workers=%zu count=%zu index %zu visited %d times",
+                  pool.numWorkers(), count, i, visits[i].load());
+        }
+    }
+}
+
+// Blocks that fan out again and wait on their own sub-blocks
+static void testNested(ThreadPool& pool) {
+    std::atomic<size_t> total{0};
+    parallelFor(pool, 8, 1, [&](size_t, size_t) {
+        parallelFor(pool, 100, 10, [&](size_t begin, size_t end) {
+            total += end - begin;
+        });
+    });
+    CHECK(total == 800, "workers=%zu nested total %zu", pool.numWorkers(), total.load());
+}
+
+// The first failure reaches the waiting thread, and the pool stays usable
+static void testException(ThreadPool& pool) {
+    bool caught = false;
+    try {
+        parallelFor(pool, 16, 1, [&](size_t begin, size_t) {
+            if (begin == 5) throw std::runtime_error("block failed");
+        });
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+    CHECK(caught, "workers=%zu exception was not propagated", pool.numWorkers());
+
+    std::atomic<int> runs{0};
+    TaskGroup group(pool);
+    for (size_t i = 0; i < 4; i++) {
+        group.run([](void* context, size_t) { (*static_cast<std::atomic<int>*>(context))++; }, &runs, i);
+    }
+    group.wait();
+    CHECK(runs == 4, "workers=%zu pool unusable after exception (%d runs)", pool.numWorkers(), runs.load());
+}
+
+// Per-block floating point sums, combined in block order
+static std::vector<double> blockSums(ThreadPool& pool) {
+    const size_t count = 10000;
+    const size_t blockSize = 128;
+    std::vector<double> sums((count + blockSize - 1) / blockSize);
+    parallelFor(pool, count, blockSize, [&](size_t begin, size_t end) {
+        double sum = 0.0;
+        for (size_t i = begin; i < end; i++) sum += sin(i * 0.001) / (i + 1);
+        sums[begin / blockSize] = sum;
+    });
+    return sums;
+}
+
+int main() {
+    ThreadPool serial(0);
+    std::vector<double> expected = blockSums(serial);
+
+    for (size_t workers : {0, 1, 3, 8}) {
+        ThreadPool pool(workers);
+        testCoverage(pool);
+        testNested(pool);
+        testException(pool);
+        CHECK(blockSums(pool) == expected, "workers=%zu results differ from the serial run", workers);
+    }
+
+    CHECK(ThreadPool::shared().numWorkers() >= 1, "shared pool has no workers");
+    CHECK(TajweedAudio::bigCoreCount() >= 1, "no big cores");
+
+    if (failures == 0) printf("thread_pool_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
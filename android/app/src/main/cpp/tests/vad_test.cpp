@@ -0,0 +1,166 @@
+// Tests for voice activity detection, segmentAudio and the trimmed source
+// that keeps silence out of feature extraction.
+
+#include "audio_analysis.h"
+#include "test_util.h"
+#include "vad.h"
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static const int kRate = 16000;
+
+// Quiet room noise with harmonic "syllables" at the given spans (seconds)
+static std::vector<double> recording(double seconds, const std::vector<std::pair<double, double>>& voiced) {
+    std::mt19937 rng(3);
+    std::normal_distribution<double> noise(0.0, 0.002);
+    std::vector<double> samples(static_cast<size_t>(seconds * kRate));
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = noise(rng);
+
+    for (const auto& span : voiced) {
+        size_t begin = static_cast<size_t>(span.first * kRate);
+        size_t end = static_cast<size_t>(span.second * kRate);
+        for (size_t i = begin; i < end; i++) {
+            double t = static_cast<double>(i) / kRate;
+            double voice = 0.0;
+            for (int h = 1; h <= 6; h++) voice += sin(2.0 * M_PI * 160.0 * h * t) / h;
+            samples[i] += 0.2 * voice;
+        }
+    }
+    return samples;
+}
+
+static void testLeadingAndTrailingSilence() {
+    std::vector<double> samples = recording(4.0, {{1.0, 2.5}});
+    VoiceActivityDetector detector;
+    detector.detect(BufferSource(samples, kRate), VadOptions());
+
+    const std::vector<SpeechRegion>& regions = detector.regions();
+    CHECK(regions.size() == 1, "%zu regions", regions.size());
+    if (regions.size() == 1) {
+        double start = static_cast<double>(regions[0].start) / kRate;
+        double end = static_cast<double>(regions[0].end) / kRate;
+        CHECK(start > 0.85 && start < 1.0, "speech starts at %.3f s", start);
+        CHECK(end > 2.5 && end < 2.65, "speech ends at %.3f s", end);
+    }
+}
+
+// Short pauses are bridged by the hangover, long ones split the segment
+static void testHangover() {
+    std::vector<double> samples = recording(5.0, {{0.5, 1.0}, {1.1, 1.5}, {3.0, 3.5}});
+    std::vector<AudioSegment> segments = segmentAudio(samples, kRate, std::vector<double>());
+    CHECK(segments.size() == 2, "%zu segments", segments.size());
+    if (segments.size() == 2) {
+        CHECK(segments[0].startTime < 0.5 && segments[0].endTime > 1.5, "first segment %.3f-%.3f",
+              segments[0].startTime, segments[0].endTime);
+        CHECK(segments[1].startTime < 3.0 && segments[1].endTime > 3.5, "second segment %.3f-%.3f",
+              segments[1].startTime, segments[1].endTime);
+    }
+
+    // A caller-supplied boundary inside a speech region cuts it
+    segments = segmentAudio(samples, kRate, {3.25});
+    CHECK(segments.size() == 3, "%zu segments with a cut", segments.size());
+    if (segments.size() == 3) {
+        CHECK(segments[1].endTime == 3.25 && segments[2].startTime == 3.25, "cut at %.3f/%.3f",
+              segments[1].endTime, segments[2].startTime);
+    }
+}
+
+static void testSilenceOnly() {
+    std::vector<double> samples = recording(2.0, {});
+    VoiceActivityDetector detector;
+    detector.detect(BufferSource(samples, kRate), VadOptions());
+    CHECK(detector.regions().empty(), "%zu regions in pure noise", detector.regions().size());
+
+    std::vector<double> zeros(kRate, 0.0);
+    detector.detect(BufferSource(zeros, kRate), VadOptions());
+    CHECK(detector.regions().empty(), "%zu regions in digital silence", detector.regions().size());
+}
+
+// Reads through the trimmed view match the regions, across region boundaries
+static void testTrimmedSource() {
+    std::vector<double> samples(1000);
+    for (size_t i = 0; i < samples.size(); i++) samples[i] = static_cast<double>(i);
+    std::vector<SpeechRegion> regions = {{100, 200}, {500, 520}, {900, 1000}};
+    BufferSource source(samples, kRate);
+    TrimmedSource trimmed;
+    trimmed.assign(source, regions);
+
+    CHECK(trimmed.frameCount() == 220, "frame count %zu", trimmed.frameCount());
+    std::vector<double> out(220);
+    CHECK(trimmed.read(90, 40, out.data()) == 40, "short read across regions");
+    for (size_t i = 0; i < 40; i++) {
+        double expected = static_cast<double>(trimmed.sourceSample(90 + i));
+        CHECK(out[i] == expected, "sample %zu is %.0f, expected %.0f", 90 + i, out[i], expected);
+    }
+    CHECK(trimmed.sourceSample(110) == 510 && trimmed.sourceSample(125) == 905, "sample mapping");
+    CHECK(trimmed.read(210, 50, out.data()) == 10, "read past the end");
+}
+
+// Extraction with VAD on analyzes only the speech frames
+static void testExtraction() {
+    std::vector<double> samples = recording(6.0, {{2.0, 4.0}});
+    BufferSource source(samples, kRate);
+
+    FeatureWorkspace whole, trimmed;
+    trimmed.vad.enabled = true;
+    AudioFeatures all, speech;
+    extractFeatures(source, whole, all);
+    extractFeatures(source, trimmed, speech);
+
+    CHECK(speech.duration == all.duration, "duration changed to %.3f", speech.duration);
+    double kept = static_cast<double>(speech.frames.numFrames()) / all.frames.numFrames();
+    CHECK(kept > 0.3 && kept < 0.4, "kept %.2f of the frames", kept);
+}
+
+// With leading silence trimmed, alignment times are still recording times
+static void testAlignmentTimes() {
+    std::vector<double> userSamples = recording(6.0, {{2.0, 4.0}});
+    std::vector<double> refSamples = recording(3.0, {{0.5, 2.5}});
+    BufferSource user(userSamples, kRate), reference(refSamples, kRate);
+
+    FeatureWorkspace userWorkspace, refWorkspace;
+    userWorkspace.vad.enabled = true;
+    refWorkspace.vad.enabled = true;
+    extractFeatures(user, userWorkspace, userWorkspace.features);
+    extractFeatures(reference, refWorkspace, refWorkspace.features);
+    const FeatureMatrix& frames2 = refWorkspace.features.frames;
+    CHECK(userWorkspace.timeline() && refWorkspace.timeline(), "inputs not trimmed");
+
+    ComparisonResult mapped, raw;
+    performDTW(userWorkspace.features, frames2.data(), frames2.numFrames(), refWorkspace.features.sampleRate,
+               DTWOptions(), userWorkspace, mapped, {userWorkspace.timeline(), refWorkspace.timeline()});
+    performDTW(userWorkspace.features, frames2.data(), frames2.numFrames(), refWorkspace.features.sampleRate,
+               DTWOptions(), userWorkspace, raw);
+
+    size_t n = userWorkspace.features.frames.numFrames();
+    CHECK(mapped.times.size() == n && mapped.alignment.size() == n, "%zu times for %zu frames", mapped.times.size(), n);
+    if (mapped.times.size() != n || n == 0) return;
+    CHECK(mapped.times[0] > 1.7 && mapped.times[0] < 2.05, "first user frame at %.3f s", mapped.times[0]);
+    CHECK(mapped.times[n - 1] > 3.5 && mapped.times[n - 1] < 4.3, "last user frame at %.3f s", mapped.times[n - 1]);
+    CHECK(mapped.alignment[0] > 0.2 && mapped.alignment[0] < 0.55, "first match at %.3f s", mapped.alignment[0]);
+    CHECK(mapped.alignment[n - 1] > 2.0 && mapped.alignment[n - 1] < 2.8, "last match at %.3f s", mapped.alignment[n - 1]);
+    for (size_t f = 1; f < n; f++) {
+        CHECK(mapped.times[f] > mapped.times[f - 1], "times not increasing at frame %zu", f);
+    }
+
+    // Untrimmed times start at zero; the mapping changes nothing else
+    CHECK(raw.times[0] == 0.0 && raw.alignment[0] == 0.0, "raw times %.3f, %.3f", raw.times[0], raw.alignment[0]);
+    CHECK(raw.similarity == mapped.similarity, "similarity %.6f vs %.6f", raw.similarity, mapped.similarity);
+    CHECK(raw.deviations == mapped.deviations, "deviations differ");
+}
+
+int main() {
+    testLeadingAndTrailingSilence();
+    testHangover();
+    testSilenceOnly();
+    testTrimmedSource();
+    testExtraction();
+    testAlignmentTimes();
+
+    if (failures == 0) printf("vad_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
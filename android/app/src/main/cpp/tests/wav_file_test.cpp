@@ -0,0 +1,338 @@
+// Tests for the memory-mapped WAV reader: every supported encoding, the
+// extensible header, stereo downmix, chunk walking (LIST before fmt, odd
+// sizes, streaming data sizes) and rejection of malformed files.
+
+#include "test_util.h"
+#include "wav_file.h"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace TajweedAudio;
+
+static std::string testDir;
+
+// Little-endian byte builder for hand-made RIFF files
+struct Bytes {
+    std::vector<uint8_t> data;
+
+    void tag(const char* text) { data.insert(data.end(), text, text + 4); }
+    void u16(uint32_t value) {
+        for (int b = 0; b < 2; b++) data.push_back(static_cast<uint8_t>(value >> (8 * b)));
+    }
+    void u24(uint32_t value) {
+        for (int b = 0; b < 3; b++) data.push_back(static_cast<uint8_t>(value >> (8 * b)));
+    }
+    void u32(uint32_t value) {
+        for (int b = 0; b < 4; b++) data.push_back(static_cast<uint8_t>(value >> (8 * b)));
+    }
+    void f32(float value) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        u32(bits);
+    }
+    void append(const Bytes& other) { data.insert(data.end(), other.data.begin(), other.data.end()); }
+};
+
+// A 16-byte fmt chunk, or the 40-byte WAVE_FORMAT_EXTENSIBLE form with `tag`
+// carried in the sub-format GUID
+static Bytes fmtChunk(uint16_t tag, int channels, int rate, int bits, bool extensible = false) {
+    Bytes chunk;
+    int blockAlign = channels * bits / 8;
+    chunk.tag("fmt ");
+    chunk.u32(extensible ? 40 : 16);
+    chunk.u16(extensible ? 0xFFFE : tag);
+    chunk.u16(channels);
+    chunk.u32(rate);
+    chunk.u32(rate * blockAlign);
+    chunk.u16(blockAlign);
+    chunk.u16(bits);
+    if (extensible) {
+        chunk.u16(22);     // cbSize
+        chunk.u16(bits);   // valid bits
+        chunk.u32(0);      // channel mask
+        chunk.u16(tag);    // sub-format GUID: tag, then the fixed KSDATAFORMAT suffix
+        const uint8_t suffix[] = {0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00,
+                                  0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+        chunk.data.insert(chunk.data.end(), suffix, suffix + sizeof(suffix));
+    }
+    return chunk;
+}
+
+static Bytes dataChunk(const Bytes& samples, uint32_t declaredSize) {
+    Bytes chunk;
+    chunk.tag("data");
+    chunk.u32(declaredSize);
+    chunk.append(samples);
+    return chunk;
+}
+
+// RIFF header around `chunks`
+static Bytes riff(const Bytes& chunks) {
+    Bytes file;
+    file.tag("RIFF");
+    file.u32(static_cast<uint32_t>(4 + chunks.data.size()));
+    file.tag("WAVE");
+    file.append(chunks);
+    return file;
+}
+
+static std::string writeFile(const std::string& name, const Bytes& bytes) {
+    std::string path = testDir + "/" + name;
+    FILE* file = fopen(path.c_str(), "wb");
+    if (!file) return path;
+    fwrite(bytes.data.data(), 1, bytes.data.size(), file);
+    fclose(file);
+    return path;
+}
+
+static std::vector<double> readAll(const WavFile& wav) {
+    std::vector<double> samples(wav.frameCount());
+    size_t n = wav.read(0, samples.size(), samples.data());
+    samples.resize(n);
+    return samples;
+}
+
+static bool near(const std::vector<double>& actual, const std::vector<double>& expected, double tolerance) {
+    if (actual.size() != expected.size()) return false;
+    for (size_t i = 0; i < actual.size(); i++) {
+        if (std::fabs(actual[i] - expected[i]) > tolerance) return false;
+    }
+    return true;
+}
+
+// Opens `bytes` as a WAV file, expecting success
+static bool openWav(WavFile& wav, const std::string& name, const Bytes& bytes) {
+    std::string path = writeFile(name, bytes);
+    bool ok = wav.open(path);
+    unlink(path.c_str());
+    CHECK(ok, "%s: %s", name.c_str(), wav.lastError().c_str());
+    return ok;
+}
+
+// Opens `bytes` as a WAV file, expecting a failure whose message mentions `reason`
+static void expectRejected(const std::string& name, const Bytes& bytes, const char* reason) {
+    std::string path = writeFile(name, bytes);
+    WavFile wav;
+    bool ok = wav.open(path);
+    unlink(path.c_str());
+    CHECK(!ok && !wav.isOpen(), "%s opened", name.c_str());
+    CHECK(wav.lastError().find(reason) != std::string::npos, "%s: error \"%s\", expected \"%s\"", name.c_str(),
+          wav.lastError().c_str(), reason);
+}
+
+static void testEncodings() {
+    const std::vector<double> expected = {0.0, 0.5, -0.5, 0.25, -1.0};
+
+    Bytes pcm16;
+    for (double v : expected) pcm16.u16(static_cast<uint16_t>(static_cast<int16_t>(v * 32768.0)));
+    Bytes chunks16 = fmtChunk(1, 1, 16000, 16);
+    chunks16.append(dataChunk(pcm16, static_cast<uint32_t>(pcm16.data.size())));
+    WavFile wav;
+    if (openWav(wav, "pcm16.wav", riff(chunks16))) {
+        CHECK(wav.format() == SampleFormat::Pcm16 && wav.sampleRate() == 16000 && wav.channels() == 1,
+              "pcm16 header");
+        CHECK(near(readAll(wav), expected, 1e-9), "pcm16 samples");
+    }
+
+    Bytes pcm24;
+    for (double v : expected) pcm24.u24(static_cast<uint32_t>(static_cast<int32_t>(v * 8388608.0)));
+    Bytes chunks24 = fmtChunk(1, 1, 44100, 24);
+    chunks24.append(dataChunk(pcm24, static_cast<uint32_t>(pcm24.data.size())));
+    if (openWav(wav, "pcm24.wav", riff(chunks24))) {
+        CHECK(wav.format() == SampleFormat::Pcm24 && wav.frameCount() == expected.size(), "pcm24 header");
+        CHECK(near(readAll(wav), expected, 1e-9), "pcm24 samples");
+    }
+
+    Bytes pcm32;
+    for (double v : expected) pcm32.u32(static_cast<uint32_t>(static_cast<int32_t>(v * 2147483648.0)));
+    Bytes chunks32 = fmtChunk(1, 1, 48000, 32);
+    chunks32.append(dataChunk(pcm32, static_cast<uint32_t>(pcm32.data.size())));
+    if (openWav(wav, "pcm32.wav", riff(chunks32))) {
+        CHECK(wav.format() == SampleFormat::Pcm32 && wav.sampleRate() == 48000, "pcm32 header");
+        CHECK(near(readAll(wav), expected, 1e-9), "pcm32 samples");
+    }
+
+    Bytes float32;
+    for (double v : expected) float32.f32(static_cast<float>(v));
+    Bytes chunksFloat = fmtChunk(3, 1, 16000, 32);
+    chunksFloat.append(dataChunk(float32, static_cast<uint32_t>(float32.data.size())));
+    if (openWav(wav, "float32.wav", riff(chunksFloat))) {
+        CHECK(wav.format() == SampleFormat::Float32, "float32 format");
+        CHECK(near(readAll(wav), expected, 1e-7), "float32 samples");
+    }
+
+    // Extensible header around float and 24-bit PCM
+    Bytes extensibleFloat = fmtChunk(3, 1, 16000, 32, true);
+    extensibleFloat.append(dataChunk(float32, static_cast<uint32_t>(float32.data.size())));
+    if (openWav(wav, "extensible_float.wav", riff(extensibleFloat))) {
+        CHECK(wav.format() == SampleFormat::Float32, "extensible float format");
+        CHECK(near(readAll(wav), expected, 1e-7), "extensible float samples");
+    }
+    Bytes extensible24 = fmtChunk(1, 1, 16000, 24, true);
+    extensible24.append(dataChunk(pcm24, static_cast<uint32_t>(pcm24.data.size())));
+    if (openWav(wav, "extensible_pcm24.wav", riff(extensible24))) {
+        CHECK(wav.format() == SampleFormat::Pcm24, "extensible pcm24 format");
+        CHECK(near(readAll(wav), expected, 1e-9), "extensible pcm24 samples");
+    }
+}
+
+static void testStereoDownmix() {
+    // Left, right pairs averaged into one mono frame
+    Bytes samples;
+    const int16_t pairs[][2] = {{16384, 0}, {-16384, -16384}, {8192, -8192}};
+    for (const auto& pair : pairs) {
+        samples.u16(static_cast<uint16_t>(pair[0]));
+        samples.u16(static_cast<uint16_t>(pair[1]));
+    }
+    Bytes chunks = fmtChunk(1, 2, 22050, 16);
+    chunks.append(dataChunk(samples, static_cast<uint32_t>(samples.data.size())));
+
+    WavFile wav;
+    if (openWav(wav, "stereo.wav", riff(chunks))) {
+        CHECK(wav.channels() == 2 && wav.frameCount() == 3 && wav.blockAlign() == 4, "stereo header");
+        CHECK(near(readAll(wav), {0.25, -0.5, 0.0}, 1e-9), "stereo downmix");
+
+        // Reads past the end stop at the last frame
+        double tail[4];
+        CHECK(wav.read(2, 4, tail) == 1 && std::fabs(tail[0]) < 1e-9, "read past the end");
+        CHECK(wav.read(3, 1, tail) == 0, "read at the end returned frames");
+    }
+}
+
+static void testChunkWalking() {
+    Bytes samples;
+    for (int16_t v : {1000, -1000, 2000, -2000}) samples.u16(static_cast<uint16_t>(v));
+    std::vector<double> expected = {1000 / 32768.0, -1000 / 32768.0, 2000 / 32768.0, -2000 / 32768.0};
+
+    // LIST metadata before fmt, then an odd-size chunk with its pad byte
+    Bytes chunks;
+    chunks.tag("LIST");
+    chunks.u32(10);
+    chunks.tag("INFO");
+    chunks.tag("ISFT");
+    chunks.u16(0);
+    chunks.append(fmtChunk(1, 1, 16000, 16));
+    chunks.tag("junk");
+    chunks.u32(3);
+    chunks.data.insert(chunks.data.end(), {'a', 'b', 'c', 0});
+    chunks.append(dataChunk(samples, static_cast<uint32_t>(samples.data.size())));
+
+    WavFile wav;
+    if (openWav(wav, "list_first.wav", riff(chunks))) {
+        CHECK(wav.frameCount() == 4 && near(readAll(wav), expected, 1e-9), "chunks around LIST and junk");
+    }
+
+    // Streaming writers leave the data size at 0 or 0xFFFFFFFF
+    for (uint32_t declared : {0u, 0xFFFFFFFFu}) {
+        Bytes streamed = fmtChunk(1, 1, 16000, 16);
+        streamed.append(dataChunk(samples, declared));
+        if (openWav(wav, "streamed.wav", riff(streamed))) {
+            CHECK(wav.frameCount() == 4, "data size %08x gave %zu frames", declared, wav.frameCount());
+        }
+    }
+
+    // A data chunk cut short keeps the whole frames that are there
+    Bytes cut = fmtChunk(1, 1, 16000, 16);
+    cut.append(dataChunk(samples, 64));
+    cut.data.pop_back();
+    if (openWav(wav, "cut_data.wav", riff(cut))) {
+        CHECK(wav.frameCount() == 3 && near(readAll(wav), {expected[0], expected[1], expected[2]}, 1e-9),
+              "truncated data gave %zu frames", wav.frameCount());
+    }
+
+    // Reopening resets the previous file's state
+    WavFile reused;
+    openWav(reused, "first.wav", riff(chunks));
+    Bytes bad;
+    bad.tag("RIFX");
+    std::string path = writeFile("second.wav", bad);
+    CHECK(!reused.open(path) && reused.frameCount() == 0 && reused.data() == nullptr, "failed reopen kept old data");
+    unlink(path.c_str());
+}
+
+static void testRejected() {
+    Bytes samples;
+    samples.u16(0);
+    samples.u16(0);
+
+    Bytes notRiff;
+    notRiff.tag("RIFF");
+    notRiff.u32(4);
+    notRiff.tag("AVI ");
+    expectRejected("not_wave.wav", notRiff, "Not a RIFF/WAVE");
+    expectRejected("tiny.wav", Bytes{{'R', 'I', 'F', 'F'}}, "Not a RIFF/WAVE");
+
+    // fmt chunk cut off inside its fields
+    Bytes shortFmt = fmtChunk(1, 1, 16000, 16);
+    shortFmt.data.resize(8 + 10);
+    expectRejected("short_fmt.wav", riff(shortFmt), "Truncated fmt");
+
+    // fmt declaring fewer than 16 bytes
+    Bytes smallFmt;
+    smallFmt.tag("fmt ");
+    smallFmt.u32(12);
+    smallFmt.data.resize(smallFmt.data.size() + 12);
+    smallFmt.append(dataChunk(samples, 4));
+    expectRejected("small_fmt.wav", riff(smallFmt), "Truncated fmt");
+
+    // Extensible header without room for the sub-format
+    Bytes shortExtensible = fmtChunk(1, 1, 16000, 16, true);
+    shortExtensible.data.resize(8 + 30);
+    expectRejected("short_extensible.wav", riff(shortExtensible), "Truncated extensible");
+
+    Bytes dataFirst = dataChunk(samples, 4);
+    dataFirst.append(fmtChunk(1, 1, 16000, 16));
+    expectRejected("data_first.wav", riff(dataFirst), "data chunk before fmt");
+
+    expectRejected("no_data.wav", riff(fmtChunk(1, 1, 16000, 16)), "Missing data");
+    expectRejected("no_fmt.wav", riff(Bytes()), "Missing fmt");
+
+    // A chunk whose size runs past the file ends the walk without a data chunk
+    Bytes overrun = fmtChunk(1, 1, 16000, 16);
+    overrun.tag("LIST");
+    overrun.u32(1000);
+    overrun.append(dataChunk(samples, 4));
+    expectRejected("overrun.wav", riff(overrun), "Missing data");
+
+    // ADPCM, 8-bit PCM and 64-bit float are not decoded
+    const struct {
+        uint16_t tag;
+        int bits;
+    } unsupported[] = {{2, 16}, {1, 8}, {3, 64}, {6, 8}};
+    for (const auto& format : unsupported) {
+        Bytes chunks = fmtChunk(format.tag, 1, 16000, format.bits);
+        chunks.append(dataChunk(samples, 4));
+        expectRejected("unsupported.wav", riff(chunks), "Unsupported WAV encoding");
+    }
+
+    Bytes noChannels = fmtChunk(1, 0, 16000, 16);
+    noChannels.append(dataChunk(samples, 4));
+    expectRejected("no_channels.wav", riff(noChannels), "Invalid channel count");
+
+    WavFile missing;
+    CHECK(!missing.open(testDir + "/missing.wav") && !missing.lastError().empty(), "missing file opened");
+}
+
+int main() {
+    char pattern[] = "/tmp/wav_file_test_XXXXXX";
+    const char* dir = mkdtemp(pattern);
+    if (!dir) {
+        fprintf(stderr, "cannot create a temporary directory\n");
+        return 1;
+    }
+    testDir = dir;
+
+    testEncodings();
+    testStereoDownmix();
+    testChunkWalking();
+    testRejected();
+    rmdir(dir);
+
+    if (failures == 0) printf("wav_file_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
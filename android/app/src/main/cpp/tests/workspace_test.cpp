@@ -0,0 +1,133 @@
+// Tests the FeatureWorkspace promise that steady-state analysis does not
+// allocate: a counting global operator new sees no heap traffic from
+// extraction (resample, preprocess, VAD, frame blocks on the pool) and DTW
+// once the buffers have grown.
+
+#include "audio_analysis.h"
+#include "test_util.h"
+#include "thread_pool.h"
+#include "workspace.h"
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <random>
+#include <vector>
+
+using namespace TajweedAudio;
+
+// Every operator new on any thread, pool workers included. Kept out of line
+// so the compiler pairs the deletes with these news, not with malloc.
+static std::atomic<bool> gCounting(false);
+static std::atomic<unsigned long> gAllocations(0);
+
+__attribute__((noinline)) void* operator new(size_t size) {
+    if (gCounting.load(std::memory_order_relaxed)) gAllocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+__attribute__((noinline)) void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+// Harmonic tone with a pause in the middle and a little noise, at `rate`
+static std::vector<double> recitation(double seconds, double f0, int rate, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::normal_distribution<double> noise(0.0, 0.003);
+    std::vector<double> samples(static_cast<size_t>(seconds * rate));
+    for (size_t i = 0; i < samples.size(); i++) {
+        double t = static_cast<double>(i) / rate;
+        double value = noise(rng);
+        bool pause = t > 0.45 * seconds && t < 0.55 * seconds;
+        if (!pause && t > 0.1 && t < seconds - 0.1) {
+            for (int h = 1; h <= 5; h++) value += 0.15 * sin(2.0 * M_PI * f0 * h * t) / h;
+        }
+        samples[i] = value;
+    }
+    return samples;
+}
+
+// One lesson attempt: both recordings extracted, then aligned
+static void analyze(const SampleSource& user, const SampleSource& reference, FeatureWorkspace& userWorkspace,
+                    FeatureWorkspace& referenceWorkspace) {
+    extractFeatures(user, userWorkspace, userWorkspace.features);
+    extractFeatures(reference, referenceWorkspace, referenceWorkspace.features);
+    const FeatureMatrix& frames = referenceWorkspace.features.frames;
+    performDTW(userWorkspace.features, frames.data(), frames.numFrames(), frames.sampleRate(), DTWOptions(),
+               userWorkspace, userWorkspace.comparison);
+}
+
+int main() {
+    // The replacement is the one in use
+    gCounting = true;
+    std::vector<int> probe(16);
+    gCounting = false;
+    CHECK(gAllocations == 1 && probe.size() == 16, "counting operator new saw %lu allocations, expected 1",
+          gAllocations.load());
+
+    ThreadPool pool(3);
+    std::vector<double> userSamples = recitation(1.6, 140.0, 44100, 1);
+    std::vector<double> referenceSamples = recitation(1.4, 150.0, 48000, 2);
+    BufferSource user(userSamples, 44100);
+    BufferSource reference(referenceSamples, 48000);
+
+    // Configured the way the calling thread's pipelines are
+    FeatureWorkspace userWorkspace, referenceWorkspace;
+    userWorkspace.setPool(&pool);
+    referenceWorkspace.setPool(&pool);
+    userWorkspace.resample.enabled = true;
+    userWorkspace.preprocess.enabled = true;
+    userWorkspace.vad.enabled = true;
+    referenceWorkspace.resample.enabled = true;
+    referenceWorkspace.vad.enabled = true;
+
+    // Warm-up: buffers grow to the largest sizes, on every worker's frame scratch
+    for (int i = 0; i < 3; i++) analyze(user, reference, userWorkspace, referenceWorkspace);
+    CHECK(userWorkspace.features.frames.numFrames() > 0 && userWorkspace.comparison.similarity > 0.0,
+          "analysis produced nothing");
+    CHECK(userWorkspace.trimmed, "VAD did not trim the user recording");
+    uint64_t userGrowth = userWorkspace.stats().allocations;
+    uint64_t referenceGrowth = referenceWorkspace.stats().allocations;
+    double similarity = userWorkspace.comparison.similarity;
+
+    gAllocations = 0;
+    gCounting = true;
+    for (int i = 0; i < 5; i++) analyze(user, reference, userWorkspace, referenceWorkspace);
+    gCounting = false;
+
+    CHECK(gAllocations == 0, "%lu heap allocations in 5 steady-state analyses", gAllocations.load());
+    CHECK(userWorkspace.stats().allocations == userGrowth && referenceWorkspace.stats().allocations == referenceGrowth,
+          "workspace buffers grew after warm-up");
+    CHECK(userWorkspace.comparison.similarity == similarity, "repeated analysis changed the result");
+
+    // A shorter recording fits the buffers already there
+    std::vector<double> shorter = recitation(1.0, 140.0, 44100, 3);
+    BufferSource shortUser(shorter, 44100);
+    gAllocations = 0;
+    gCounting = true;
+    analyze(shortUser, reference, userWorkspace, referenceWorkspace);
+    gCounting = false;
+    CHECK(gAllocations == 0, "%lu heap allocations for a shorter recording", gAllocations.load());
+
+    if (failures == 0) printf("workspace_test: all checks passed\n");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,219 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#endif
+
+namespace TajweedAudio {
+
+namespace {
+
+// Worker identity of the current thread, used to pick its own deque
+thread_local ThreadPool* tCurrentPool = nullptr;
+thread_local size_t tWorkerIndex = 0;
+
+const size_t kMaxSharedWorkers = 7;
+
+} // namespace
+
+void ThreadPool::Queue::pushBack(const Task& task) {
+    if (count == ring.size()) {
+        // Unroll into a ring twice the size
+        std::vector<Task> grown(std::max<size_t>(16, ring.size() * 2));
+        for (size_t i = 0; i < count; i++) grown[i] = ring[(head + i) % ring.size()];
+        ring.swap(grown);
+        head = 0;
+    }
+    ring[(head + count) % ring.size()] = task;
+    count++;
+}
+
+bool ThreadPool::Queue::popBack(Task& task) {
+    if (count == 0) return false;
+    count--;
+    task = ring[(head + count) % ring.size()];
+    return true;
+}
+
+bool ThreadPool::Queue::popFront(Task& task) {
+    if (count == 0) return false;
+    task = ring[head];
+    head = (head + 1) % ring.size();
+    count--;
+    return true;
+}
+
+ThreadPool::ThreadPool(size_t numWorkers) {
+    for (size_t i = 0; i <= numWorkers; i++) {
+        queues_.emplace_back(new Queue());
+    }
+    workers_.reserve(numWorkers);
+    for (size_t i = 0; i < numWorkers; i++) {
+        workers_.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(std::min(kMaxSharedWorkers, std::max<size_t>(1, bigCoreCount() - 1)));
+    return pool;
+}
+
+void ThreadPool::submit(const Task& task) {
+    // Workers push onto their own deque; everyone else uses the injection queue
+    Queue& queue = tCurrentPool == this ? *queues_[tWorkerIndex] : *queues_.back();
+
+    // Counted before it is visible, so the thief that pops it never takes
+    // queued_ below zero
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        queued_++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.pushBack(task);
+    }
+    wake_.notify_one();
+}
+
+bool ThreadPool::tryRunOne() {
+    Task task;
+    bool found = false;
+    size_t numQueues = queues_.size();
+
+    // Own deque newest first (its data is still in cache)...
+    if (tCurrentPool == this) {
+        Queue& own = *queues_[tWorkerIndex];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        found = own.popBack(task);
+    }
+
+    // ...then the oldest task anywhere else, starting after ourselves
+    size_t start = tCurrentPool == this ? tWorkerIndex + 1 : 0;
+    for (size_t i = 0; !found && i < numQueues; i++) {
+        Queue& victim = *queues_[(start + i) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        found = victim.popFront(task);
+    }
+
+    if (!found) return false;
+    queued_--;
+    execute(task);
+    return true;
+}
+
+void ThreadPool::execute(const Task& task) {
+    std::exception_ptr error;
+    try {
+        task.run(task.context, task.index);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    task.group->finish(error);
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    tCurrentPool = this;
+    tWorkerIndex = index;
+
+#if defined(__linux__)
+    char name[16];
+    snprintf(name, sizeof(name), "tajweed-%zu", index);
+    pthread_setname_np(pthread_self(), name);
+#endif
+
+    for (;;) {
+        if (tryRunOne()) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wake_.wait(lock, [this] { return stopping_ || queued_ > 0; });
+        if (stopping_ && queued_ == 0) return;
+    }
+}
+
+TaskGroup::~TaskGroup() {
+    try {
+        wait();
+    } catch (...) {
+        // Errors are reported by an explicit wait(); never throw from here
+    }
+}
+
+void TaskGroup::run(void (*run)(void* context, size_t index), void* context, size_t index) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        remaining_++;
+    }
+    pool_.submit({run, context, index, this});
+}
+
+void TaskGroup::wait() {
+    for (;;) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (remaining_ == 0) break;
+        }
+
+        // Help with queued work instead of idling; if nothing is queued, every
+        // remaining task of this group is already running somewhere
+        if (!pool_.tryRunOne()) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            done_.wait(lock, [this] { return remaining_ == 0; });
+            break;
+        }
+    }
+
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::swap(error, error_);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void TaskGroup::finish(std::exception_ptr error) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (error && !error_) error_ = error;
+    if (--remaining_ == 0) done_.notify_all();
+}
+
+size_t bigCoreCount() {
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+#if defined(__linux__)
+    // big.LITTLE clusters differ in their maximum clock; count the cores
+    // above the slowest cluster
+    std::vector<long> maxFreq;
+    for (size_t cpu = 0; cpu < cores; cpu++) {
+        std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/cpufreq/cpuinfo_max_freq";
+        FILE* file = fopen(path.c_str(), "r");
+        if (!file) return cores;
+        long freq = 0;
+        bool ok = fscanf(file, "%ld", &freq) == 1;
+        fclose(file);
+        if (!ok) return cores;
+        maxFreq.push_back(freq);
+    }
+
+    long slowest = *std::min_element(maxFreq.begin(), maxFreq.end());
+    size_t big = std::count_if(maxFreq.begin(), maxFreq.end(), [slowest](long f) { return f > slowest; });
+    if (big > 0) return big;
+#endif
+
+    return cores;
+}
+
+} // namespace TajweedAudio
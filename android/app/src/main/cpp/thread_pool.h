@@ -0,0 +1,138 @@
+#ifndef TAJWEED_THREAD_POOL_H
+#define TAJWEED_THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace TajweedAudio {
+
+class TaskGroup;
+
+// Work-stealing thread pool. Each worker owns a deque: it runs its own tasks
+// newest first and, when that runs dry, steals the oldest task of another
+// worker. Threads blocked in TaskGroup::wait() run queued tasks too, so
+// groups can nest (a task may fan out and wait on its own sub-tasks).
+class ThreadPool {
+public:
+    explicit ThreadPool(size_t numWorkers);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Process-wide pool sized to the big cores, leaving one for the caller
+    static ThreadPool& shared();
+
+    size_t numWorkers() const { return workers_.size(); }
+
+private:
+    friend class TaskGroup;
+
+    struct Task {
+        void (*run)(void* context, size_t index);
+        void* context;
+        size_t index;
+        TaskGroup* group;
+    };
+
+    // Grow-only ring buffer deque guarded by its own mutex
+    struct Queue {
+        std::mutex mutex;
+        std::vector<Task> ring;
+        size_t head = 0;
+        size_t count = 0;
+
+        void pushBack(const Task& task);
+        bool popBack(Task& task);
+        bool popFront(Task& task);
+    };
+
+    void submit(const Task& task);
+    bool tryRunOne();
+    void execute(const Task& task);
+    void workerLoop(size_t index);
+
+    // queues_[i] belongs to worker i; the last queue takes submissions from other threads
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> workers_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wake_;
+    std::atomic<size_t> queued_{0};  // submitted and not yet popped
+    bool stopping_ = false;
+};
+
+// Set of tasks that can be waited on together. The first exception thrown
+// by a task is rethrown from wait().
+class TaskGroup {
+public:
+    explicit TaskGroup(ThreadPool& pool) : pool_(pool) {}
+    ~TaskGroup();
+
+    TaskGroup(const TaskGroup&) = delete;
+    TaskGroup& operator=(const TaskGroup&) = delete;
+
+    // Schedules run(context, index); context must stay valid until wait() returns
+    void run(void (*run)(void* context, size_t index), void* context, size_t index);
+
+    // Runs queued tasks (of any group) until every task of this group finished
+    void wait();
+
+private:
+    friend class ThreadPool;
+    void finish(std::exception_ptr error);
+
+    ThreadPool& pool_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t remaining_ = 0;
+    std::exception_ptr error_;
+};
+
+// Calls body(begin, end) over [0, count) in blocks of blockSize frames.
+// Block boundaries depend only on count and blockSize, never on the number
+// of threads, so per-block results are identical for any pool size.
+template <typename Body>
+void parallelFor(ThreadPool& pool, size_t count, size_t blockSize, const Body& body) {
+    if (count == 0) return;
+    if (blockSize == 0) blockSize = count;
+
+    struct Blocks {
+        const Body* body;
+        size_t count;
+        size_t blockSize;
+
+        static void run(void* context, size_t block) {
+            const Blocks* blocks = static_cast<const Blocks*>(context);
+            size_t begin = block * blocks->blockSize;
+            size_t end = begin + blocks->blockSize < blocks->count ? begin + blocks->blockSize : blocks->count;
+            (*blocks->body)(begin, end);
+        }
+    };
+
+    Blocks blocks = {&body, count, blockSize};
+    size_t numBlocks = (count + blockSize - 1) / blockSize;
+    if (numBlocks == 1 || pool.numWorkers() == 0) {
+        for (size_t b = 0; b < numBlocks; b++) Blocks::run(&blocks, b);
+        return;
+    }
+
+    TaskGroup group(pool);
+    for (size_t b = 0; b < numBlocks; b++) {
+        group.run(&Blocks::run, &blocks, b);
+    }
+    group.wait();
+}
+
+// Size of the high-performance cluster on big.LITTLE parts (all cores elsewhere)
+size_t bigCoreCount();
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_THREAD_POOL_H
@@ -0,0 +1,186 @@
+#include "vad.h"
+#include "perf_stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace TajweedAudio {
+
+namespace {
+
+const double kPowerEpsilon = 1e-20;
+
+size_t secondsToFrames(double seconds, int sampleRate, size_t frameSize) {
+    if (seconds <= 0.0) return 0;
+    return static_cast<size_t>(ceil(seconds * sampleRate / frameSize));
+}
+
+double frameZeroCrossings(const double* samples, size_t count) {
+    size_t crossings = 0;
+    for (size_t i = 1; i < count; i++) {
+        crossings += (samples[i - 1] < 0.0) != (samples[i] < 0.0);
+    }
+    return static_cast<double>(crossings) / count;
+}
+
+// Geometric over arithmetic mean of the power spectrum, DC left out:
+// near 1 for noise, near 0 for harmonic sound
+double spectralFlatness(const double* power, size_t numBins) {
+    double logSum = 0.0;
+    double sum = 0.0;
+    for (size_t k = 1; k < numBins; k++) {
+        double p = power[k] + kPowerEpsilon;
+        logSum += log(p);
+        sum += p;
+    }
+    size_t n = numBins - 1;
+    return exp(logSum / n) / (sum / n);
+}
+
+} // namespace
+
+void VoiceActivityDetector::detect(const SampleSource& source, const VadOptions& options) {
+    TAJWEED_PERF_SCOPE(Vad);
+    regions_.clear();
+    int sampleRate = source.sampleRate();
+    if (sampleRate <= 0) {
+        smoothed_.clear();
+        return;
+    }
+
+    frameSize_ = std::max<size_t>(nextPowerOfTwo(static_cast<size_t>(options.frameSeconds * sampleRate)), 16);
+    size_t numFrames = source.frameCount() / frameSize_;
+    prepareStft(stft_, static_cast<int>(frameSize_));
+    size_t numBins = frameSize_ / 2 + 1;
+    double* power = growScratch(power_, numBins, stats_);
+    double* energyDb = growScratch(energyDb_, numFrames, stats_);
+    float* zcr = growScratch(zcr_, numFrames, stats_);
+    float* flatness = growScratch(flatness_, numFrames, stats_);
+    uint8_t* speech = growScratch(smoothed_, numFrames, stats_);
+    if (numFrames == 0) return;
+
+    // Frame measures in one pass over the source
+    double* raw = stft_.raw.data();
+    for (size_t f = 0; f < numFrames; f++) {
+        source.read(f * frameSize_, frameSize_, raw);
+        double energy = framePowerSpectrum(raw, stft_, power);
+        energyDb[f] = 10.0 * log10(energy + kPowerEpsilon);
+        zcr[f] = static_cast<float>(frameZeroCrossings(raw, frameSize_));
+        flatness[f] = static_cast<float>(spectralFlatness(power, numBins));
+    }
+
+    double* sorted = growScratch(sorted_, numFrames, stats_);
+    std::copy(energyDb, energyDb + numFrames, sorted);
+    size_t rank = std::min(numFrames - 1, static_cast<size_t>(options.noisePercentile * numFrames));
+    std::nth_element(sorted, sorted + rank, sorted + numFrames);
+    noiseFloorDb_ = sorted[rank];
+
+    // Tonal frames above the floor are voiced, noisy ones need a high
+    // crossing rate to pass as fricatives, and anything far above the
+    // floor counts whatever its shape
+    double threshold = std::max(noiseFloorDb_ + options.marginDb, options.minLevelDb);
+    double loud = threshold + options.marginDb;
+    for (size_t f = 0; f < numFrames; f++) {
+        bool aboveFloor = energyDb[f] > threshold;
+        bool voiced = aboveFloor && flatness[f] < options.maxFlatness;
+        bool unvoiced = aboveFloor && zcr[f] > options.minUnvoicedZcr;
+        speech[f] = voiced || unvoiced || energyDb[f] > loud;
+    }
+
+    // Hangover smoothing: a run of onsetFrames opens a segment, a gap of
+    // hangoverFrames closes it at its last speech frame
+    size_t onsetFrames = std::max<size_t>(1, secondsToFrames(options.onsetSeconds, sampleRate, frameSize_));
+    size_t hangoverFrames = secondsToFrames(options.hangoverSeconds, sampleRate, frameSize_);
+    size_t minFrames = secondsToFrames(options.minSpeechSeconds, sampleRate, frameSize_);
+    size_t pad = static_cast<size_t>(options.padSeconds * sampleRate);
+    size_t totalSamples = source.frameCount();
+
+    size_t capacity = regions_.capacity();
+    bool inSpeech = false;
+    size_t run = 0;
+    size_t segmentStart = 0;
+    size_t lastSpeech = 0;
+    auto closeSegment = [&](size_t end) {
+        if (end - segmentStart < minFrames) return;
+        size_t start = segmentStart * frameSize_;
+        start = start > pad ? start - pad : 0;
+        size_t stop = std::min(end * frameSize_ + pad, totalSamples);
+        if (!regions_.empty() && start <= regions_.back().end) {
+            regions_.back().end = stop;
+        } else {
+            regions_.push_back({start, stop});
+        }
+    };
+
+    for (size_t f = 0; f < numFrames; f++) {
+        if (!inSpeech) {
+            run = speech[f] ? run + 1 : 0;
+            if (run >= onsetFrames) {
+                inSpeech = true;
+                segmentStart = f + 1 - run;
+                lastSpeech = f;
+            }
+        } else if (speech[f]) {
+            lastSpeech = f;
+        } else if (f - lastSpeech > hangoverFrames) {
+            closeSegment(lastSpeech + 1);
+            inSpeech = false;
+            run = 0;
+        }
+    }
+    if (inSpeech) closeSegment(lastSpeech + 1);
+    recordGrowth(regions_, capacity, stats_);
+
+    // Report the smoothed decision per frame
+    std::fill(speech, speech + numFrames, 0);
+    for (const SpeechRegion& region : regions_) {
+        size_t first = region.start / frameSize_;
+        size_t last = std::min(numFrames, (region.end + frameSize_ - 1) / frameSize_);
+        std::fill(speech + first, speech + last, 1);
+    }
+}
+
+size_t VoiceActivityDetector::speechSamples() const {
+    size_t total = 0;
+    for (const SpeechRegion& region : regions_) total += region.end - region.start;
+    return total;
+}
+
+void TrimmedSource::assign(const SampleSource& source, const std::vector<SpeechRegion>& regions) {
+    source_ = &source;
+    regions_ = regions.data();
+    numRegions_ = regions.size();
+
+    size_t* offsets = growScratch(offsets_, numRegions_, stats_);
+    total_ = 0;
+    for (size_t r = 0; r < numRegions_; r++) {
+        offsets[r] = total_;
+        total_ += regions[r].end - regions[r].start;
+    }
+}
+
+size_t TrimmedSource::read(size_t start, size_t count, double* out) const {
+    if (start >= total_) return 0;
+    count = std::min(count, total_ - start);
+
+    // Region holding `start`, then forward through as many as the read spans
+    size_t r = std::upper_bound(offsets_.begin(), offsets_.begin() + numRegions_, start) - offsets_.begin() - 1;
+    size_t written = 0;
+    while (written < count && r < numRegions_) {
+        size_t within = start + written - offsets_[r];
+        size_t available = regions_[r].end - regions_[r].start - within;
+        size_t n = std::min(count - written, available);
+        size_t got = source_->read(regions_[r].start + within, n, out + written);
+        written += got;
+        if (got < n) break;
+        r++;
+    }
+    return written;
+}
+
+size_t TrimmedSource::sourceSample(size_t sample) const {
+    if (numRegions_ == 0) return sample;
+    size_t r = std::upper_bound(offsets_.begin(), offsets_.begin() + numRegions_, sample) - offsets_.begin() - 1;
+    return regions_[r].start + (sample - offsets_[r]);
+}
+
+} // namespace TajweedAudio
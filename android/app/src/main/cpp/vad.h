@@ -0,0 +1,95 @@
+#ifndef TAJWEED_VAD_H
+#define TAJWEED_VAD_H
+
+#include "audio_source.h"
+#include "scratch.h"
+#include "spectral.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace TajweedAudio {
+
+struct VadOptions {
+    bool enabled = false;            // read by extractFeatures; detect() always runs
+    double frameSeconds = 0.02;      // rounded up to a power-of-two frame, frames do not overlap
+    double noisePercentile = 0.1;    // frame energy taken as the noise floor
+    double marginDb = 10.0;          // speech sits at least this far above the floor
+    double minLevelDb = -70.0;       // nothing quieter than this (dBFS) is speech
+    double maxFlatness = 0.5;        // voiced frames are tonal: spectral flatness below this
+    double minUnvoicedZcr = 0.25;    // fricatives: zero crossings per sample above this
+    double onsetSeconds = 0.04;      // speech must last this long to open a segment
+    double hangoverSeconds = 0.2;    // and stay away this long to close it
+    double minSpeechSeconds = 0.08;  // shorter segments are dropped
+    double padSeconds = 0.05;        // kept either side of each segment
+};
+
+// Half-open sample range [start, end) of the source
+struct SpeechRegion {
+    size_t start;
+    size_t end;
+};
+
+// Energy, zero-crossing and spectral-flatness voice activity detection with
+// hangover smoothing. Frame measures are computed in one pass; the noise
+// floor is a low percentile of the frame energies, so a recording needs no
+// leading silence for the floor to be right. Buffers are kept between calls.
+class VoiceActivityDetector {
+public:
+    // Fills regions() with the padded, merged speech regions of `source`
+    void detect(const SampleSource& source, const VadOptions& options);
+
+    const std::vector<SpeechRegion>& regions() const { return regions_; }
+    size_t speechSamples() const;
+
+    // Per-frame decision after smoothing, frameSize() samples per frame
+    const std::vector<uint8_t>& frameSpeech() const { return smoothed_; }
+    size_t frameSize() const { return frameSize_; }
+    double noiseFloorDb() const { return noiseFloorDb_; }
+
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    StftScratch stft_;
+    std::vector<double> power_;
+    std::vector<double> energyDb_;
+    std::vector<double> sorted_;
+    std::vector<float> zcr_;
+    std::vector<float> flatness_;
+    std::vector<uint8_t> smoothed_;
+    std::vector<SpeechRegion> regions_;
+    size_t frameSize_ = 0;
+    double noiseFloorDb_ = 0.0;
+    AllocationStats stats_;
+};
+
+// The speech regions of a source played back to back. Reads are mapped
+// through the region table, so nothing is copied and it is as thread-safe
+// as the source underneath.
+class TrimmedSource : public SampleSource {
+public:
+    // `source` and `regions` must outlive this view's use
+    void assign(const SampleSource& source, const std::vector<SpeechRegion>& regions);
+
+    int sampleRate() const override { return source_ ? source_->sampleRate() : 0; }
+    int channels() const override { return source_ ? source_->channels() : 0; }
+    size_t frameCount() const override { return total_; }
+    size_t read(size_t start, size_t count, double* out) const override;
+
+    // Position in the original source of trimmed sample `sample`
+    size_t sourceSample(size_t sample) const;
+
+    const AllocationStats& stats() const { return stats_; }
+
+private:
+    const SampleSource* source_ = nullptr;
+    const SpeechRegion* regions_ = nullptr;
+    size_t numRegions_ = 0;
+    std::vector<size_t> offsets_;        // trimmed position where each region starts
+    size_t total_ = 0;
+    AllocationStats stats_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_VAD_H
@@ -0,0 +1,236 @@
+#include "wav_file.h"
+#include "perf_stats.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace TajweedAudio {
+
+namespace {
+
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+uint16_t readU16(const uint8_t* p) {
+    return static_cast<uint16_t>(p[0] | (p[1] << 8));
+}
+
+uint32_t readU32(const uint8_t* p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+           (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Per-format sample decoders, little-endian and alignment-agnostic
+struct DecodePcm16 {
+    static double sample(const uint8_t* p) {
+        return static_cast<int16_t>(readU16(p)) / 32768.0;
+    }
+};
+
+struct DecodePcm24 {
+    static double sample(const uint8_t* p) {
+        int32_t value = p[0] | (p[1] << 8) | (p[2] << 16);
+        if (value & 0x800000) value -= 0x1000000;
+        return value / 8388608.0;
+    }
+};
+
+struct DecodePcm32 {
+    static double sample(const uint8_t* p) {
+        return static_cast<int32_t>(readU32(p)) / 2147483648.0;
+    }
+};
+
+struct DecodeFloat32 {
+    static double sample(const uint8_t* p) {
+        uint32_t bits = readU32(p);
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+};
+
+template <typename Decoder>
+void decodeMono(const uint8_t* frames, size_t count, int channels, size_t blockAlign,
+                size_t bytesPerSample, double* out) {
+    if (channels == 1) {
+        for (size_t i = 0; i < count; i++) {
+            out[i] = Decoder::sample(frames + i * blockAlign);
+        }
+        return;
+    }
+
+    double scale = 1.0 / channels;
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* frame = frames + i * blockAlign;
+        double sum = 0.0;
+        for (int c = 0; c < channels; c++) {
+            sum += Decoder::sample(frame + c * bytesPerSample);
+        }
+        out[i] = sum * scale;
+    }
+}
+
+} // namespace
+
+WavFile::~WavFile() {
+    close();
+}
+
+bool WavFile::open(const std::string& path) {
+    TAJWEED_PERF_SCOPE(Load);
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return fail("Cannot open " + path);
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return fail("Cannot stat " + path);
+    }
+
+    mappingSize_ = static_cast<size_t>(info.st_size);
+    void* mapping = mmap(nullptr, mappingSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        mappingSize_ = 0;
+        return fail("Cannot map " + path);
+    }
+
+    mapping_ = mapping;
+    madvise(mapping_, mappingSize_, MADV_SEQUENTIAL);
+
+    if (!parse()) {
+        std::string message = error_;
+        close();
+        error_ = message;
+        return false;
+    }
+
+    return true;
+}
+
+void WavFile::close() {
+    if (mapping_) {
+        munmap(mapping_, mappingSize_);
+    }
+    mapping_ = nullptr;
+    mappingSize_ = 0;
+    data_ = nullptr;
+    frameCount_ = 0;
+    blockAlign_ = 0;
+    sampleRate_ = 0;
+    channels_ = 0;
+    bitsPerSample_ = 0;
+    error_.clear();
+}
+
+bool WavFile::fail(const std::string& message) {
+    error_ = message;
+    return false;
+}
+
+bool WavFile::parse() {
+    const uint8_t* base = static_cast<const uint8_t*>(mapping_);
+    size_t size = mappingSize_;
+
+    if (size < 12 || memcmp(base, "RIFF", 4) != 0 || memcmp(base + 8, "WAVE", 4) != 0) {
+        return fail("Not a RIFF/WAVE file");
+    }
+
+    bool haveFormat = false;
+    uint16_t formatTag = 0;
+    size_t offset = 12;
+
+    while (offset + 8 <= size) {
+        const uint8_t* chunk = base + offset;
+        size_t chunkSize = readU32(chunk + 4);
+        size_t body = offset + 8;
+
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            if (chunkSize < 16 || body + 16 > size) return fail("Truncated fmt chunk");
+
+            formatTag = readU16(base + body);
+            channels_ = readU16(base + body + 2);
+            sampleRate_ = static_cast<int>(readU32(base + body + 4));
+            blockAlign_ = readU16(base + body + 12);
+            bitsPerSample_ = readU16(base + body + 14);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real format tag in its sub-format GUID
+            if (formatTag == kFormatExtensible) {
+                if (chunkSize < 40 || body + 40 > size) return fail("Truncated extensible fmt chunk");
+                formatTag = readU16(base + body + 24);
+            }
+            haveFormat = true;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            if (!haveFormat) return fail("data chunk before fmt chunk");
+
+            // Streaming writers leave the size at 0 or 0xFFFFFFFF; trust the file length
+            size_t available = size - body;
+            if (chunkSize == 0 || chunkSize > available) chunkSize = available;
+
+            data_ = base + body;
+            frameCount_ = blockAlign_ > 0 ? chunkSize / blockAlign_ : 0;
+            break;
+        }
+
+        // Chunks are word aligned
+        offset = body + chunkSize + (chunkSize & 1);
+    }
+
+    if (!haveFormat) return fail("Missing fmt chunk");
+    if (!data_) return fail("Missing data chunk");
+    if (channels_ <= 0 || sampleRate_ <= 0) return fail("Invalid channel count or sample rate");
+
+    if (formatTag == kFormatPcm && bitsPerSample_ == 16) {
+        format_ = SampleFormat::Pcm16;
+    } else if (formatTag == kFormatPcm && bitsPerSample_ == 24) {
+        format_ = SampleFormat::Pcm24;
+    } else if (formatTag == kFormatPcm && bitsPerSample_ == 32) {
+        format_ = SampleFormat::Pcm32;
+    } else if (formatTag == kFormatFloat && bitsPerSample_ == 32) {
+        format_ = SampleFormat::Float32;
+    } else {
+        return fail("Unsupported WAV encoding (format " + std::to_string(formatTag) +
+                    ", " + std::to_string(bitsPerSample_) + " bits)");
+    }
+
+    if (blockAlign_ < static_cast<size_t>(channels_) * (bitsPerSample_ / 8)) {
+        return fail("Invalid block alignment");
+    }
+
+    return true;
+}
+
+size_t WavFile::read(size_t start, size_t count, double* out) const {
+    if (!data_ || start >= frameCount_) return 0;
+    size_t n = std::min(count, frameCount_ - start);
+    TAJWEED_PERF_COUNT(BytesDecoded, n * blockAlign_);
+
+    const uint8_t* frames = data_ + start * blockAlign_;
+    size_t bytesPerSample = bitsPerSample_ / 8;
+
+    switch (format_) {
+        case SampleFormat::Pcm16:
+            decodeMono<DecodePcm16>(frames, n, channels_, blockAlign_, bytesPerSample, out);
+            break;
+        case SampleFormat::Pcm24:
+            decodeMono<DecodePcm24>(frames, n, channels_, blockAlign_, bytesPerSample, out);
+            break;
+        case SampleFormat::Pcm32:
+            decodeMono<DecodePcm32>(frames, n, channels_, blockAlign_, bytesPerSample, out);
+            break;
+        case SampleFormat::Float32:
+            decodeMono<DecodeFloat32>(frames, n, channels_, blockAlign_, bytesPerSample, out);
+            break;
+    }
+
+    return n;
+}
+
+} // namespace TajweedAudio
@@ -0,0 +1,64 @@
+#ifndef TAJWEED_WAV_FILE_H
+#define TAJWEED_WAV_FILE_H
+
+#include "audio_source.h"
+#include <cstdint>
+#include <string>
+
+namespace TajweedAudio {
+
+enum class SampleFormat {
+    Pcm16,
+    Pcm24,
+    Pcm32,
+    Float32
+};
+
+// Memory-mapped RIFF/WAVE file. The sample data stays in the page cache and
+// is converted to floating point and downmixed only when frames are read.
+class WavFile : public SampleSource {
+public:
+    WavFile() = default;
+    ~WavFile() override;
+
+    WavFile(const WavFile&) = delete;
+    WavFile& operator=(const WavFile&) = delete;
+
+    // Maps and parses the file; on failure lastError() says why
+    bool open(const std::string& path);
+    void close();
+
+    bool isOpen() const { return mapping_ != nullptr; }
+    const std::string& lastError() const { return error_; }
+
+    int sampleRate() const override { return sampleRate_; }
+    int channels() const override { return channels_; }
+    size_t frameCount() const override { return frameCount_; }
+    size_t read(size_t start, size_t count, double* out) const override;
+
+    SampleFormat format() const { return format_; }
+    int bitsPerSample() const { return bitsPerSample_; }
+
+    // Raw interleaved sample bytes, blockAlign() bytes per frame
+    const uint8_t* data() const { return data_; }
+    size_t blockAlign() const { return blockAlign_; }
+
+private:
+    bool parse();
+    bool fail(const std::string& message);
+
+    void* mapping_ = nullptr;
+    size_t mappingSize_ = 0;
+    const uint8_t* data_ = nullptr;
+    size_t frameCount_ = 0;
+    size_t blockAlign_ = 0;
+    int sampleRate_ = 0;
+    int channels_ = 0;
+    int bitsPerSample_ = 0;
+    SampleFormat format_ = SampleFormat::Pcm16;
+    std::string error_;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_WAV_FILE_H
@@ -0,0 +1,90 @@
+#include "workspace.h"
+#include <atomic>
+
+namespace TajweedAudio {
+
+namespace {
+
+std::atomic<uint64_t> gFrameScratchAllocations{0};
+std::atomic<uint64_t> gFrameScratchBytes{0};
+
+} // namespace
+
+FrameScratch& FrameScratch::forThisThread() {
+    thread_local FrameScratch scratch;
+    return scratch;
+}
+
+PitchTracker& FrameScratch::pitchTracker(int sampleRate) {
+    if (!tracker_ || tracker_->sampleRate() != sampleRate) {
+        if (tracker_) retiredTrackers_ += tracker_->stats();
+        tracker_.reset(new PitchTracker(sampleRate));
+        countAllocation(stats, sizeof(PitchTracker));
+    }
+    return *tracker_;
+}
+
+FormantAnalyzer& FrameScratch::formantAnalyzer(int sampleRate) {
+    if (!formants_ || formants_->sampleRate() != sampleRate) {
+        if (formants_) retiredTrackers_ += formants_->stats();
+        formants_.reset(new FormantAnalyzer(sampleRate));
+        countAllocation(stats, sizeof(FormantAnalyzer));
+    }
+    return *formants_;
+}
+
+void FrameScratch::publishStats() {
+    AllocationStats total = stats;
+    total += stft.stats;
+    total += retiredTrackers_;
+    if (tracker_) total += tracker_->stats();
+    if (formants_) total += formants_->stats();
+
+    if (total.allocations != published_.allocations) {
+        gFrameScratchAllocations += total.allocations - published_.allocations;
+        gFrameScratchBytes += total.bytes - published_.bytes;
+        published_ = total;
+    }
+}
+
+AllocationStats FrameScratch::allThreads() {
+    AllocationStats total;
+    total.allocations = gFrameScratchAllocations.load();
+    total.bytes = gFrameScratchBytes.load();
+    return total;
+}
+
+FeatureWorkspace& FeatureWorkspace::forThisThread(Pipeline pipeline) {
+    thread_local FeatureWorkspace workspaces[2];
+    thread_local bool initialized = false;
+    if (!initialized) {
+        workspaces[static_cast<int>(Pipeline::User)].resample.enabled = true;
+        workspaces[static_cast<int>(Pipeline::User)].preprocess.enabled = true;
+        workspaces[static_cast<int>(Pipeline::User)].vad.enabled = true;
+        workspaces[static_cast<int>(Pipeline::Reference)].resample.enabled = true;
+        workspaces[static_cast<int>(Pipeline::Reference)].vad.enabled = true;
+        initialized = true;
+    }
+    return workspaces[static_cast<int>(pipeline)];
+}
+
+void FeatureWorkspace::prepare(FeatureMatrix& matrix, size_t numFrames, int sampleRate, int hopSize) {
+    if (numFrames > matrix.capacity()) {
+        countAllocation(stats_, numFrames * kFeatureStride * sizeof(float));
+    }
+    matrix.reset(numFrames, sampleRate, hopSize);
+}
+
+AllocationStats FeatureWorkspace::stats() const {
+    AllocationStats total = stats_;
+    total += cepstrum.stats();
+    total += dtw.stats;
+    total += resampled.stats();
+    total += preprocessed.stats();
+    total += activity.stats();
+    total += speech.stats();
+    total += FrameScratch::allThreads();
+    return total;
+}
+
+} // namespace TajweedAudio
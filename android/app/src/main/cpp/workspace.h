@@ -0,0 +1,154 @@
+#ifndef TAJWEED_WORKSPACE_H
+#define TAJWEED_WORKSPACE_H
+
+#include "audio_features.h"
+#include "dtw.h"
+#include "formants.h"
+#include "jobs.h"
+#include "pitch.h"
+#include "preprocess.h"
+#include "resample.h"
+#include "rules.h"
+#include "scratch.h"
+#include "spectral.h"
+#include "thread_pool.h"
+#include "vad.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace TajweedAudio {
+
+// Per-thread buffers for analyzing a block of frames. Frame blocks are leaf
+// tasks, so a thread never works on two blocks at once and can keep one of
+// these for every block it runs, whichever pipeline the block belongs to.
+struct FrameScratch {
+    StftScratch stft;
+    std::vector<double> power;
+    AllocationStats stats;
+
+    static FrameScratch& forThisThread();
+
+    // Trackers for the given sample rate, rebuilt only when the rate changes
+    PitchTracker& pitchTracker(int sampleRate);
+    FormantAnalyzer& formantAnalyzer(int sampleRate);
+
+    // Adds growth since the last call to the process-wide frame scratch totals
+    void publishStats();
+
+    // Growth of every thread's FrameScratch
+    static AllocationStats allThreads();
+
+private:
+    std::unique_ptr<PitchTracker> tracker_;
+    std::unique_ptr<FormantAnalyzer> formants_;
+    AllocationStats retiredTrackers_;  // growth of trackers and analyzers that have since been replaced
+    AllocationStats published_;
+};
+
+// Independent analysis pipelines that may run at the same time on one thread's behalf
+enum class Pipeline {
+    User = 0,
+    Reference = 1
+};
+
+// Scratch memory and result slots for one analysis pipeline. Buffers only
+// grow, so after the first few calls a workspace serves extraction and DTW
+// without touching the heap. A workspace is used by one pipeline at a time;
+// frame blocks of that pipeline borrow FrameScratch from the threads they run on.
+class FeatureWorkspace {
+public:
+    FeatureWorkspace() = default;
+
+    FeatureWorkspace(const FeatureWorkspace&) = delete;
+    FeatureWorkspace& operator=(const FeatureWorkspace&) = delete;
+
+    // Workspaces of the calling thread, reused by every JNI call made on it
+    static FeatureWorkspace& forThisThread(Pipeline pipeline = Pipeline::User);
+
+    // Starts a new analysis; buffers keep their capacity
+    void reset() {
+        analyses_++;
+        trimmed = false;
+    }
+
+    // Pool that frame blocks run on; ThreadPool::shared() unless overridden
+    ThreadPool& pool() const { return pool_ ? *pool_ : ThreadPool::shared(); }
+    void setPool(ThreadPool* pool) { pool_ = pool; }
+
+    // Sizes a feature matrix, counting storage growth against this workspace
+    void prepare(FeatureMatrix& matrix, size_t numFrames, int sampleRate, int hopSize = kHopSize);
+
+    // Grows one of the workspace-owned vectors below
+    template <typename T>
+    T* grow(std::vector<T>& buffer, size_t count) { return growScratch(buffer, count, stats_); }
+
+    // Every buffer (re)allocation made on behalf of this workspace, plus the
+    // per-thread frame scratch shared by all pipelines
+    AllocationStats stats() const;
+    uint64_t analyses() const { return analyses_; }
+
+    // Conversion to resample.targetRate first, when resample.enabled (on for
+    // both of the thread's workspaces) and the input is at another rate, so
+    // recordings at any rate give comparable frames at the cost of 16 kHz.
+    ResampleOptions resample;
+    ResampledSource resampled;
+
+    // Filtering and denoising ahead of extraction, when preprocess.enabled.
+    // The calling thread's User workspace has it on: user recordings come
+    // from phone microphones, references are clean studio recordings.
+    PreprocessOptions preprocess;
+    PreprocessedSource preprocessed;
+
+    // Non-speech dropped ahead of extraction, when vad.enabled (on for both
+    // of the thread's workspaces). Feature frames then follow the speech
+    // regions back to back; speech.sourceSample() maps them to the recording.
+    VadOptions vad;
+    VoiceActivityDetector activity;
+    TrimmedSource speech;
+
+    // Set by extractFeatures when the frames follow `speech`; timeline() is
+    // then the map back to the recording, else nullptr
+    bool trimmed = false;
+    const TrimmedSource* timeline() const { return trimmed ? &speech : nullptr; }
+
+    // Job whose cancellation extraction checks between frame blocks and
+    // whose progress it advances by the frames done; see JobBinding
+    JobControl* job = nullptr;
+
+    // Spectral feature configuration, read concurrently by frame blocks
+    MelCepstrum cepstrum;
+
+    // LPC resonances per frame, written by frame blocks and then tracked
+    // into F1..F4 in frame order
+    std::vector<FormantCandidates> formants;
+
+    // Alignment
+    DTWScratch dtw;
+    DTWAlignment path;
+    std::vector<int> hits;
+
+    // Result slots reused by the JNI entry points
+    AudioFeatures features;
+    ComparisonResult comparison;
+    RuleEngine rules;
+    RuleReport ruleReport;
+
+private:
+    ThreadPool* pool_ = nullptr;
+    AllocationStats stats_;
+    uint64_t analyses_ = 0;
+
+};
+
+// Maps from VAD-trimmed frames back to the recordings when an alignment is
+// summarized (the workspaces' timeline()); null for a side that was not
+// trimmed, or whose map is not at hand, as for a bundled reference
+struct AlignmentTimelines {
+    const TrimmedSource* first = nullptr;
+    const TrimmedSource* second = nullptr;
+};
+
+} // namespace TajweedAudio
+
+#endif // TAJWEED_WORKSPACE_H
@@ -4,31 +4,83 @@ import com.facebook.react.bridge.ReactApplicationContext;
 import com.facebook.react.bridge.ReactContextBaseJavaModule;
 import com.facebook.react.bridge.ReactMethod;
 import com.facebook.react.bridge.Promise;
+import com.facebook.react.bridge.ReadableArray;
 import com.facebook.react.bridge.ReadableMap;
 import com.facebook.react.bridge.WritableMap;
 import com.facebook.react.bridge.WritableArray;
 import com.facebook.react.bridge.Arguments;
+import com.facebook.react.modules.core.DeviceEventManagerModule;
 
 import java.io.File;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
+import java.nio.FloatBuffer;
 import java.util.Map;
 import java.util.HashMap;
 
 public class TajweedAudioModule extends ReactContextBaseJavaModule {
     private static final String MODULE_NAME = "TajweedAudioModule";
     
+    // Rule order of a packed lesson batch record (see lesson_batch.h)
+    private static final String[] BATCH_RULES = {"madd", "makharij", "ghunna", "qalqalah"};
+    
     // Load native C++ library
     static {
         System.loadLibrary("tajweed_audio");
     }
     
     // Native methods
-    private native double[] extractAudioFeatures(String audioPath);
-    private native double calculateSimilarity(double[] features1, double[] features2);
+    private native long extractFeatureHandle(String audioPath);
+    private native ByteBuffer featureFrames(long handle);
+    private native WritableMap featureInfo(long handle);
+    private native void releaseFeatureHandle(long handle);
+    private native double calculateSimilarity(String audioPath1, String audioPath2);
+    private native double calculateSimilarityFromHandles(long handle1, long handle2);
     private native WritableMap analyzeTajweed(String userAudioPath, String referenceAudioPath);
     private native WritableMap detectTajweedRules(String audioPath, ReadableMap rules);
+    private native WritableMap getAudioInfo(String audioPath);
+    private native double[] analyzeLessonBatch(String[] userAudioPaths, String[] referenceAudioPaths);
+    private native WritableMap getPerfStats();
+    private native void resetPerfStats();
+    private native void configureAnalysisCache(double budgetMb, boolean hashContents);
+    private native WritableMap getAnalysisCacheStats();
+    private native void clearAnalysisCache();
+    private native void setFeatureStoreDirectory(String directory);
+    private native boolean buildReferenceBundle(String audioPath, String bundleId);
+    private native double calculateSimilarityWithReference(String userAudioPath, String bundleId);
+    private native WritableMap analyzeTajweedWithReference(String userAudioPath, String bundleId);
+    private native WritableMap alignLongRecitation(String userAudioPath, String bundleId);
+    private native int buildReferenceIndex(String[] bundleIds);
+    private native WritableMap searchReferences(String userAudioPath, int k);
+    
+    // Background analysis jobs; progress and results arrive through onJobEvent
+    private native int submitAnalysisJob(String type, String userAudioPath, String referenceAudioPath,
+                                         ReadableMap rules, String segmentKey);
+    private native boolean cancelAnalysisJob(int jobId);
+    private native void cancelAllJobs();
+    
+    // A native feature matrix and the comparisons running on it. A matrix
+    // released while pinned is freed when the last comparison unpins it.
+    private static final class FeatureHandle {
+        final long handle;
+        int pins;
+        boolean released;
+        
+        FeatureHandle(long handle) {
+            this.handle = handle;
+        }
+    }
+    
+    // Extracted feature matrices still held natively, keyed by the id handed to JS
+    private final Map<String, FeatureHandle> featureHandles = new HashMap<>();
+    private int nextFeatureId = 1;
     
     public TajweedAudioModule(ReactApplicationContext reactContext) {
         super(reactContext);
+        
+        // Precomputed reference features live in app-private storage
+        File bundleDir = new File(reactContext.getFilesDir(), "feature_bundles");
+        setFeatureStoreDirectory(bundleDir.getAbsolutePath());
     }
     
     @Override
@@ -55,18 +107,21 @@ public class TajweedAudioModule extends ReactContextBaseJavaModule {
                 return;
             }
             
-            // Extract audio features using native C++ code
-            double[] features = extractAudioFeatures(audioPath);
+            // Features stay in native memory; JS gets an id to compare or release them
+            long handle = extractFeatureHandle(audioPath);
+            if (handle == 0) {
+                promise.reject("FEATURE_EXTRACTION_ERROR", "Failed to extract audio features from: " + audioPath);
+                return;
+            }
             
-            // Convert to React Native array
-            WritableArray featureArray = Arguments.createArray();
-            for (double feature : features) {
-                featureArray.pushDouble(feature);
+            String featureId;
+            synchronized (featureHandles) {
+                featureId = String.valueOf(nextFeatureId++);
+                featureHandles.put(featureId, new FeatureHandle(handle));
             }
             
-            WritableMap result = Arguments.createMap();
-            result.putArray("features", featureArray);
-            result.putInt("featureCount", features.length);
+            WritableMap result = featureInfo(handle);
+            result.putString("featureId", featureId);
             
             promise.resolve(result);
         } catch (Exception e) {
@@ -74,6 +129,95 @@ public class TajweedAudioModule extends ReactContextBaseJavaModule {
         }
     }
     
+    @ReactMethod
+    public void calculateSimilarityFromFeatures(String featureId1, String featureId2, Promise promise) {
+        try {
+            // Pin both matrices so a release mid-comparison is deferred, and
+            // run the DTW outside the lock so other ids stay usable meanwhile
+            FeatureHandle features1;
+            FeatureHandle features2;
+            synchronized (featureHandles) {
+                features1 = featureHandles.get(featureId1);
+                features2 = featureHandles.get(featureId2);
+                if (features1 == null || features2 == null) {
+                    promise.reject("FEATURES_NOT_FOUND", "Unknown or released feature id");
+                    return;
+                }
+                features1.pins++;
+                features2.pins++;
+            }
+            
+            double similarity;
+            try {
+                similarity = calculateSimilarityFromHandles(features1.handle, features2.handle);
+            } finally {
+                synchronized (featureHandles) {
+                    unpin(features1);
+                    unpin(features2);
+                }
+            }
+            
+            WritableMap result = Arguments.createMap();
+            result.putDouble("similarity", similarity);
+            result.putDouble("score", similarity * 100); // Convert to percentage
+            
+            promise.resolve(result);
+        } catch (Exception e) {
+            promise.reject("SIMILARITY_CALCULATION_ERROR", "Failed to calculate similarity: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void releaseFeatures(String featureId, Promise promise) {
+        FeatureHandle features;
+        synchronized (featureHandles) {
+            features = featureHandles.remove(featureId);
+            if (features != null) {
+                release(features);
+            }
+        }
+        promise.resolve(features != null);
+    }
+    
+    // Both called with featureHandles locked
+    private void release(FeatureHandle features) {
+        features.released = true;
+        if (features.pins == 0) {
+            releaseFeatureHandle(features.handle);
+        }
+    }
+    
+    private void unpin(FeatureHandle features) {
+        if (--features.pins == 0 && features.released) {
+            releaseFeatureHandle(features.handle);
+        }
+    }
+    
+    /**
+     * Frame-major feature rows of an extracted recording, read in place from native
+     * memory. Each row is frameStride floats; the first featureCount are used.
+     * The buffer is only valid until the features are released.
+     */
+    public FloatBuffer getFeatureFrames(String featureId) {
+        synchronized (featureHandles) {
+            FeatureHandle features = featureHandles.get(featureId);
+            ByteBuffer frames = features != null ? featureFrames(features.handle) : null;
+            return frames != null ? frames.order(ByteOrder.nativeOrder()).asFloatBuffer() : null;
+        }
+    }
+    
+    @Override
+    public void invalidate() {
+        cancelAllJobs();
+        synchronized (featureHandles) {
+            for (FeatureHandle features : featureHandles.values()) {
+                release(features);
+            }
+            featureHandles.clear();
+        }
+        super.invalidate();
+    }
+    
     @ReactMethod
     public void calculateSimilarity(String audioPath1, String audioPath2, Promise promise) {
         try {
@@ -86,12 +230,8 @@ public class TajweedAudioModule extends ReactContextBaseJavaModule {
                 return;
             }
             
-            // Extract features for both audio files
-            double[] features1 = extractAudioFeatures(audioPath1);
-            double[] features2 = extractAudioFeatures(audioPath2);
-            
-            // Calculate similarity
-            double similarity = calculateSimilarity(features1, features2);
+            // Both files are decoded and analyzed natively, concurrently
+            double similarity = calculateSimilarity(audioPath1, audioPath2);
             
             WritableMap result = Arguments.createMap();
             result.putDouble("similarity", similarity);
@@ -143,6 +283,303 @@ public class TajweedAudioModule extends ReactContextBaseJavaModule {
         }
     }
     
+    /**
+     * Called from native threads with TajweedJobProgress and TajweedJobFinished events
+     */
+    private void onJobEvent(String eventName, WritableMap params) {
+        ReactApplicationContext context = getReactApplicationContext();
+        if (!context.hasActiveReactInstance()) {
+            return;
+        }
+        context.getJSModule(DeviceEventManagerModule.RCTDeviceEventEmitter.class).emit(eventName, params);
+    }
+    
+    // Required by NativeEventEmitter
+    @ReactMethod
+    public void addListener(String eventName) {
+    }
+    
+    @ReactMethod
+    public void removeListeners(int count) {
+    }
+    
+    @ReactMethod
+    public void submitAnalysisJob(ReadableMap request, Promise promise) {
+        try {
+            String type = request.hasKey("type") ? request.getString("type") : null;
+            String userAudioPath = request.hasKey("userAudioPath") ? request.getString("userAudioPath") : null;
+            String referenceAudioPath = request.hasKey("referenceAudioPath") ? request.getString("referenceAudioPath") : "";
+            ReadableMap rules = request.hasKey("rules") ? request.getMap("rules") : null;
+            String segmentKey = request.hasKey("segmentKey") ? request.getString("segmentKey") : "";
+            
+            if (type == null || userAudioPath == null) {
+                promise.reject("INVALID_JOB", "A job needs a type and a userAudioPath");
+                return;
+            }
+            
+            // Rule detection runs on the user take alone
+            boolean needsReference = !"detectTajweedRules".equals(type);
+            if (!new File(userAudioPath).exists() || (needsReference && !new File(referenceAudioPath).exists())) {
+                promise.reject("FILE_NOT_FOUND", "One or both audio files not found");
+                return;
+            }
+            
+            // A new job for the same segment cancels the earlier ones
+            int jobId = submitAnalysisJob(type, userAudioPath, referenceAudioPath, rules, segmentKey);
+            if (jobId < 0) {
+                promise.reject("INVALID_JOB", "Unknown job type: " + type);
+                return;
+            }
+            promise.resolve(jobId);
+        } catch (Exception e) {
+            promise.reject("JOB_SUBMIT_ERROR", "Failed to submit analysis job: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void cancelAnalysisJob(int jobId, Promise promise) {
+        promise.resolve(cancelAnalysisJob(jobId));
+    }
+    
+    @ReactMethod
+    public void buildReferenceBundle(String audioPath, String bundleId, Promise promise) {
+        try {
+            File audioFile = new File(audioPath);
+            if (!audioFile.exists()) {
+                promise.reject("FILE_NOT_FOUND", "Audio file not found: " + audioPath);
+                return;
+            }
+            
+            // Extract reference features once and persist them for later analyses
+            boolean built = buildReferenceBundle(audioPath, bundleId);
+            
+            WritableMap result = Arguments.createMap();
+            result.putString("bundleId", bundleId);
+            result.putBoolean("built", built);
+            
+            promise.resolve(result);
+        } catch (Exception e) {
+            promise.reject("BUNDLE_BUILD_ERROR", "Failed to build reference bundle: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void calculateSimilarityWithReference(String userAudioPath, String bundleId, Promise promise) {
+        try {
+            File userFile = new File(userAudioPath);
+            if (!userFile.exists()) {
+                promise.reject("FILE_NOT_FOUND", "Audio file not found: " + userAudioPath);
+                return;
+            }
+            
+            double similarity = calculateSimilarityWithReference(userAudioPath, bundleId);
+            
+            WritableMap result = Arguments.createMap();
+            result.putDouble("similarity", similarity);
+            result.putDouble("score", similarity * 100); // Convert to percentage
+            
+            promise.resolve(result);
+        } catch (Exception e) {
+            promise.reject("SIMILARITY_CALCULATION_ERROR", "Failed to calculate similarity: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void analyzeTajweedWithReference(String userAudioPath, String bundleId, Promise promise) {
+        try {
+            File userFile = new File(userAudioPath);
+            if (!userFile.exists()) {
+                promise.reject("FILE_NOT_FOUND", "Audio file not found: " + userAudioPath);
+                return;
+            }
+            
+            WritableMap analysis = analyzeTajweedWithReference(userAudioPath, bundleId);
+            if (analysis == null) {
+                promise.reject("REFERENCE_NOT_FOUND", "No usable reference bundle for: " + bundleId);
+                return;
+            }
+            
+            promise.resolve(analysis);
+        } catch (Exception e) {
+            promise.reject("TAJWEED_ANALYSIS_ERROR", "Failed to analyze Tajweed: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void alignLongRecitation(String userAudioPath, String bundleId, Promise promise) {
+        try {
+            File userFile = new File(userAudioPath);
+            if (!userFile.exists()) {
+                promise.reject("FILE_NOT_FOUND", "Audio file not found: " + userAudioPath);
+                return;
+            }
+            
+            WritableMap result = alignLongRecitation(userAudioPath, bundleId);
+            if (result == null) {
+                promise.reject("REFERENCE_NOT_FOUND", "No usable reference bundle for: " + bundleId);
+                return;
+            }
+            
+            promise.resolve(result);
+        } catch (Exception e) {
+            promise.reject("ALIGNMENT_ERROR", "Failed to align recitation: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void buildReferenceIndex(ReadableArray bundleIds, Promise promise) {
+        try {
+            String[] ids = new String[bundleIds.size()];
+            for (int i = 0; i < ids.length; i++) {
+                ids[i] = bundleIds.getString(i);
+            }
+            
+            // Replaces any earlier index; bundles that fail to open are skipped
+            int segments = buildReferenceIndex(ids);
+            if (segments < 0) {
+                promise.reject("INDEX_BUILD_ERROR", "Failed to build reference index");
+                return;
+            }
+            
+            WritableMap result = Arguments.createMap();
+            result.putInt("segments", segments);
+            promise.resolve(result);
+        } catch (Exception e) {
+            promise.reject("INDEX_BUILD_ERROR", "Failed to build reference index: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void searchReferences(String userAudioPath, int k, Promise promise) {
+        try {
+            File userFile = new File(userAudioPath);
+            if (!userFile.exists()) {
+                promise.reject("FILE_NOT_FOUND", "Audio file not found: " + userAudioPath);
+                return;
+            }
+            
+            WritableMap result = searchReferences(userAudioPath, k);
+            if (result == null) {
+                promise.reject("REFERENCE_SEARCH_ERROR", "No reference index, or the recording could not be analyzed");
+                return;
+            }
+            
+            promise.resolve(result);
+        } catch (Exception e) {
+            promise.reject("REFERENCE_SEARCH_ERROR", "Failed to search references: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void analyzeLessonBatch(ReadableArray segments, Promise promise) {
+        try {
+            int count = segments.size();
+            String[] userPaths = new String[count];
+            String[] referencePaths = new String[count];
+            for (int i = 0; i < count; i++) {
+                ReadableMap segment = segments.getMap(i);
+                userPaths[i] = segment.getString("userPath");
+                referencePaths[i] = segment.getString("referencePath");
+            }
+            
+            // Every segment is scored in one native call; references are loaded once
+            double[] packed = analyzeLessonBatch(userPaths, referencePaths);
+            if (packed == null) {
+                promise.reject("LESSON_BATCH_ERROR", "Failed to analyze lesson batch");
+                return;
+            }
+            
+            // The packed buffer states its own header and record sizes
+            int headerSize = (int) packed[0];
+            int recordSize = (int) packed[1];
+            WritableArray results = Arguments.createArray();
+            for (int i = 0; i < count; i++) {
+                int k = headerSize + i * recordSize;
+                WritableMap result = Arguments.createMap();
+                result.putInt("status", (int) packed[k++]);
+                result.putDouble("similarity", packed[k++]);
+                result.putDouble("score", packed[k++]);
+                result.putDouble("confidence", packed[k++]);
+                
+                WritableMap rules = Arguments.createMap();
+                for (String rule : BATCH_RULES) {
+                    rules.putDouble(rule, packed[k++]);
+                }
+                result.putMap("rules", rules);
+                
+                WritableMap timings = Arguments.createMap();
+                timings.putDouble("userMs", packed[k++]);
+                timings.putDouble("referenceMs", packed[k++]);
+                timings.putDouble("compareMs", packed[k++]);
+                result.putMap("timings", timings);
+                
+                results.pushMap(result);
+            }
+            
+            WritableMap batch = Arguments.createMap();
+            batch.putArray("segments", results);
+            batch.putInt("referenceCount", (int) packed[3]);
+            batch.putInt("referencesFromBundles", (int) packed[4]);
+            batch.putDouble("totalMs", packed[5]);
+            batch.putInt("usersFromCache", (int) packed[6]);
+            batch.putInt("segmentsFromCache", (int) packed[7]);
+            
+            promise.resolve(batch);
+        } catch (Exception e) {
+            promise.reject("LESSON_BATCH_ERROR", "Failed to analyze lesson batch: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void getPerfStats(Promise promise) {
+        try {
+            // Per-stage timing histograms and counters since the last reset
+            promise.resolve(getPerfStats());
+        } catch (Exception e) {
+            promise.reject("PERF_STATS_ERROR", "Failed to read perf stats: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void resetPerfStats(Promise promise) {
+        try {
+            resetPerfStats();
+            promise.resolve(null);
+        } catch (Exception e) {
+            promise.reject("PERF_STATS_ERROR", "Failed to reset perf stats: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void configureAnalysisCache(double budgetMb, boolean hashContents, Promise promise) {
+        try {
+            // 0 MB turns the cache off; shrinking evicts at once
+            configureAnalysisCache(budgetMb, hashContents);
+            promise.resolve(null);
+        } catch (Exception e) {
+            promise.reject("ANALYSIS_CACHE_ERROR", "Failed to configure the analysis cache: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void getAnalysisCacheStats(Promise promise) {
+        try {
+            promise.resolve(getAnalysisCacheStats());
+        } catch (Exception e) {
+            promise.reject("ANALYSIS_CACHE_ERROR", "Failed to read analysis cache stats: " + e.getMessage());
+        }
+    }
+    
+    @ReactMethod
+    public void clearAnalysisCache(Promise promise) {
+        try {
+            clearAnalysisCache();
+            promise.resolve(null);
+        } catch (Exception e) {
+            promise.reject("ANALYSIS_CACHE_ERROR", "Failed to clear the analysis cache: " + e.getMessage());
+        }
+    }
+    
     @ReactMethod
     public void getAudioInfo(String audioPath, Promise promise) {
         try {
@@ -158,11 +595,11 @@ public class TajweedAudioModule extends ReactContextBaseJavaModule {
             info.putDouble("size", audioFile.length());
             info.putDouble("lastModified", audioFile.lastModified());
             
-            // Get additional audio info from native code
-            // This would call native methods to get duration, sample rate, etc.
-            info.putDouble("duration", 0.0); // Placeholder
-            info.putInt("sampleRate", 44100); // Placeholder
-            info.putInt("channels", 1); // Placeholder
+            // Duration, sample rate and channels come from the parsed header
+            WritableMap nativeInfo = getAudioInfo(audioPath);
+            if (nativeInfo != null) {
+                info.merge(nativeInfo);
+            }
             
             promise.resolve(info);
         } catch (Exception e) {
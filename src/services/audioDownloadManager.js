@@ -92,8 +92,8 @@ class AudioDownloadManager extends EventEmitter {
       // Process downloaded files with native module
       for (const filePath of downloadedFiles) {
         try {
-          // Extract audio features using native module
-          const features = await TajweedAudioModule.extractFeatures(filePath);
+          // Precompute reference features once; analyses map the bundle by ID
+          const features = await TajweedAudioModule.buildReferenceBundle(filePath, filePath);
           
           // Get audio info
           const audioInfo = await TajweedAudioModule.getAudioInfo(filePath);
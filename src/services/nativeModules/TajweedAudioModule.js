@@ -2,6 +2,10 @@ import { NativeModules, NativeEventEmitter } from 'react-native';
 
 const { TajweedAudioModule } = NativeModules;
 
+// Events of background analysis jobs
+export const JOB_PROGRESS_EVENT = 'TajweedJobProgress';
+export const JOB_FINISHED_EVENT = 'TajweedJobFinished';
+
 class TajweedAudioService {
   constructor() {
     this.eventEmitter = new NativeEventEmitter(TajweedAudioModule);
@@ -30,8 +34,12 @@ class TajweedAudioService {
     try {
       const result = await TajweedAudioModule.extractFeatures(audioPath);
       return {
-        features: result.features,
+        featureId: result.featureId,
+        frameCount: result.frameCount,
         featureCount: result.featureCount,
+        duration: result.duration,
+        sampleRate: result.sampleRate,
+        channels: result.channels,
       };
     } catch (error) {
       console.error('Error extracting audio features:', error);
@@ -39,6 +47,33 @@ class TajweedAudioService {
     }
   }
 
+  // Compare two recordings already extracted with extractFeatures (no decoding)
+  async calculateSimilarityFromFeatures(featureId1, featureId2) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.calculateSimilarityFromFeatures(featureId1, featureId2);
+      return {
+        similarity: result.similarity,
+        score: result.score,
+      };
+    } catch (error) {
+      console.error('Error calculating similarity from features:', error);
+      throw error;
+    }
+  }
+
+  // Free the native memory behind a featureId
+  async releaseFeatures(featureId) {
+    if (!this.isAvailable) {
+      return false;
+    }
+
+    return TajweedAudioModule.releaseFeatures(featureId);
+  }
+
   // Calculate similarity between two audio files
   async calculateSimilarity(audioPath1, audioPath2) {
     if (!this.isAvailable) {
@@ -79,7 +114,230 @@ class TajweedAudioService {
     }
   }
 
-  // Detect specific Tajweed rules in audio
+  // Extract a downloaded reference (WAV, or compressed audio such as MP3 and M4A,
+  // decoded on the fly) once and store its features under bundleId
+  async buildReferenceBundle(audioPath, bundleId) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.buildReferenceBundle(audioPath, bundleId);
+      return {
+        bundleId: result.bundleId,
+        built: result.built,
+      };
+    } catch (error) {
+      console.error('Error building reference bundle:', error);
+      throw error;
+    }
+  }
+
+  // Calculate similarity between a user recording and a stored reference bundle
+  async calculateSimilarityWithReference(userAudioPath, bundleId) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.calculateSimilarityWithReference(userAudioPath, bundleId);
+      return {
+        similarity: result.similarity,
+        score: result.score,
+      };
+    } catch (error) {
+      console.error('Error calculating similarity with reference:', error);
+      throw error;
+    }
+  }
+
+  // Analyze Tajweed against a stored reference bundle instead of a reference file
+  async analyzeTajweedWithReference(userAudioPath, bundleId) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.analyzeTajweedWithReference(userAudioPath, bundleId);
+      return {
+        score: result.score || 0,
+        errors: result.errors || [],
+        suggestions: result.suggestions || [],
+        duration: result.duration || 0,
+        confidence: result.confidence || 0,
+        analysis: result.analysis || {},
+      };
+    } catch (error) {
+      console.error('Error analyzing Tajweed with reference:', error);
+      throw error;
+    }
+  }
+
+  // Align a whole-surah recitation against a stored reference bundle, in
+  // chunks cut at matching pauses: chunks: [{ startTime, endTime,
+  // referenceStartTime, referenceEndTime, pauseAnchored, similarity, score }]
+  async alignLongRecitation(userAudioPath, bundleId) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.alignLongRecitation(userAudioPath, bundleId);
+      return {
+        similarity: result.similarity || 0,
+        score: result.score || 0,
+        chunks: result.chunks || [],
+        stats: result.stats || {},
+      };
+    } catch (error) {
+      console.error('Error aligning long recitation:', error);
+      throw error;
+    }
+  }
+
+  // Index the segments of stored reference bundles for searchReferences;
+  // replaces any earlier index
+  async buildReferenceIndex(bundleIds) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.buildReferenceIndex(bundleIds);
+      return {
+        segments: result.segments || 0,
+      };
+    } catch (error) {
+      console.error('Error building reference index:', error);
+      throw error;
+    }
+  }
+
+  // The k indexed reference segments closest to a recording, best first:
+  // matches: [{ bundleId, segment, startTime, endTime, similarity, score }]
+  async searchReferences(userAudioPath, k = 3) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.searchReferences(userAudioPath, k);
+      return {
+        matches: result.matches || [],
+        stats: result.stats || {},
+      };
+    } catch (error) {
+      console.error('Error searching references:', error);
+      throw error;
+    }
+  }
+
+  // Score a whole lesson in one native call.
+  // segments: [{ userPath, referencePath }]; status 0 means the segment was scored
+  async analyzeLessonBatch(segments) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.analyzeLessonBatch(segments);
+      return {
+        segments: result.segments || [],
+        referenceCount: result.referenceCount || 0,
+        referencesFromBundles: result.referencesFromBundles || 0,
+        usersFromCache: result.usersFromCache || 0,
+        segmentsFromCache: result.segmentsFromCache || 0,
+        totalMs: result.totalMs || 0,
+      };
+    } catch (error) {
+      console.error('Error analyzing lesson batch:', error);
+      throw error;
+    }
+  }
+
+  // Native stage timings since the last reset:
+  // { enabled, stages: { load, resample, preprocess, vad, stft, pitch, formants, extract, dtw, rules, search },
+  //   counters: { framesProcessed, bytesDecoded, allocations, allocatedBytes } }
+  // Each stage reports count, totalMs, p50Us, p95Us, p99Us and maxUs
+  async getPerfStats() {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      const result = await TajweedAudioModule.getPerfStats();
+      return {
+        enabled: result.enabled || false,
+        stages: result.stages || {},
+        counters: result.counters || {},
+      };
+    } catch (error) {
+      console.error('Error reading perf stats:', error);
+      throw error;
+    }
+  }
+
+  async resetPerfStats() {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      await TajweedAudioModule.resetPerfStats();
+    } catch (error) {
+      console.error('Error resetting perf stats:', error);
+      throw error;
+    }
+  }
+
+  // Size the native cache of extracted features and scored pairs; 0 turns it
+  // off. hashContents keys recordings by their bytes instead of path, size
+  // and modification time.
+  async configureAnalysisCache(budgetMb = 32, hashContents = false) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      await TajweedAudioModule.configureAnalysisCache(budgetMb, hashContents);
+    } catch (error) {
+      console.error('Error configuring analysis cache:', error);
+      throw error;
+    }
+  }
+
+  // { entries, bytes, budgetBytes, featureHits, featureMisses, comparisonHits,
+  //   comparisonMisses, evictions, evictedBytes, rejected }
+  async getAnalysisCacheStats() {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      return await TajweedAudioModule.getAnalysisCacheStats();
+    } catch (error) {
+      console.error('Error reading analysis cache stats:', error);
+      throw error;
+    }
+  }
+
+  async clearAnalysisCache() {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      await TajweedAudioModule.clearAnalysisCache();
+    } catch (error) {
+      console.error('Error clearing analysis cache:', error);
+      throw error;
+    }
+  }
+
+  // Detect specific Tajweed rules in audio. `rules` maps rule keys to
+  // booleans ({ madd: true, ghunna: false, ... }); only the true ones run.
+  // Each event is { rule, start, end, measured, expected, unit, score,
+  // violation, message }, with times in seconds of the recording.
   async detectTajweedRules(audioPath, rules) {
     if (!this.isAvailable) {
       throw new Error('TajweedAudioModule is not available');
@@ -91,6 +349,9 @@ class TajweedAudioService {
         detectedRules: result.detectedRules || [],
         violations: result.violations || [],
         recommendations: result.recommendations || [],
+        events: result.events || [],
+        skipped: result.skipped || [],
+        harakaSeconds: result.harakaSeconds || 0,
       };
     } catch (error) {
       console.error('Error detecting Tajweed rules:', error);
@@ -98,6 +359,46 @@ class TajweedAudioService {
     }
   }
 
+  // Queue an analysis in the background and return its job id at once.
+  // `type` is 'calculateSimilarity', 'analyzeTajweed' or 'detectTajweedRules'.
+  // A job submitted with the same segmentKey as an earlier one cancels it, so
+  // re-recording a segment only analyzes the latest take. Progress arrives as
+  // JOB_PROGRESS_EVENT { jobId, segmentKey, progress } and the outcome as
+  // JOB_FINISHED_EVENT { jobId, segmentKey, status, result, error }, where
+  // status is 'done', 'cancelled' or 'failed'.
+  async submitAnalysisJob({ type, userAudioPath, referenceAudioPath, rules, segmentKey }) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      return await TajweedAudioModule.submitAnalysisJob({
+        type,
+        userAudioPath,
+        referenceAudioPath: referenceAudioPath || '',
+        rules: rules || null,
+        segmentKey: segmentKey || '',
+      });
+    } catch (error) {
+      console.error('Error submitting analysis job:', error);
+      throw error;
+    }
+  }
+
+  // Cancel a queued or running job; resolves false once it has finished
+  async cancelAnalysisJob(jobId) {
+    if (!this.isAvailable) {
+      throw new Error('TajweedAudioModule is not available');
+    }
+
+    try {
+      return await TajweedAudioModule.cancelAnalysisJob(jobId);
+    } catch (error) {
+      console.error('Error cancelling analysis job:', error);
+      throw error;
+    }
+  }
+
   // Get audio file information
   async getAudioInfo(audioPath) {
     if (!this.isAvailable) {